@@ -20,5 +20,32 @@
 
 #include <stdbool.h>
 
+#include "tar.h"
+
+typedef enum {
+  TM_ARCHIVE_COMP_NONE,
+  TM_ARCHIVE_COMP_GZIP,
+  TM_ARCHIVE_COMP_XZ,
+  TM_ARCHIVE_COMP_ZSTD,
+  TM_ARCHIVE_COMP_BZIP2
+} archive_comp_t;
+
 bool archive_tar_extract(const char *dst, const char *src);
-bool archive_extract(const char *dst, const char *src, const char *file_type);
+bool archive_tar_native_extract(const char    *dst,
+                                const char    *src,
+                                archive_comp_t comp,
+                                tar_opts_t    *opts);
+// opts is only used if the archive is extracted natively, see
+// opts->complete. It may be NULL
+bool archive_extract(const char *dst,
+                     const char *src,
+                     const char *file_type,
+                     tar_opts_t *opts);
+
+// Extracts into dst, hard linking the files that did not change from the
+// previous version in opts->base, described by opts->manifest. Fails if the
+// archive can only be handled by a plugin or by the system's tar
+bool archive_update(const char *dst,
+                    const char *src,
+                    const char *file_type,
+                    tar_opts_t *opts);
@@ -30,9 +30,18 @@
 #define TARMAN_CMD_UPDATE_ALL  "update-all"
 #define TARMAN_CMD_ADD_REPO    "add-repo"
 #define TARMAN_CMD_REMOVE_REPO "remove-repo"
+#define TARMAN_CMD_UPDATE_REPO "update-repo"
 #define TARMAN_CMD_LIST_REPOS  "list-repos"
 #define TARMAN_CMD_TEST        "test"
 #define TARMAN_CMD_VERSION     "version"
+#define TARMAN_CMD_VERIFY      "verify"
+#define TARMAN_CMD_OUTDATED    "outdated"
+#define TARMAN_CMD_ROLLBACK    "rollback"
+#define TARMAN_CMD_BATCH       "batch"
+#define TARMAN_CMD_FETCH       "fetch"
+#define TARMAN_CMD_BUNDLE      "bundle"
+#define TARMAN_CMD_SERVE_CACHE "serve-cache"
+#define TARMAN_CMD_STORE       "store"
 
 int cli_cmd_help(cli_info_t info);
 int cli_cmd_install(cli_info_t info);
@@ -42,6 +51,15 @@ int cli_cmd_update(cli_info_t info);
 int cli_cmd_update_all(cli_info_t info);
 int cli_cmd_add_repo(cli_info_t info);
 int cli_cmd_remove_repo(cli_info_t info);
+int cli_cmd_update_repo(cli_info_t info);
 int cli_cmd_list_repos(cli_info_t info);
 int cli_cmd_test(cli_info_t info);
 int cli_cmd_version(cli_info_t info);
+int cli_cmd_verify(cli_info_t info);
+int cli_cmd_outdated(cli_info_t info);
+int cli_cmd_rollback(cli_info_t info);
+int cli_cmd_batch(cli_info_t info);
+int cli_cmd_fetch(cli_info_t info);
+int cli_cmd_bundle(cli_info_t info);
+int cli_cmd_serve_cache(cli_info_t info);
+int cli_cmd_store(cli_info_t info);
@@ -31,6 +31,7 @@
 #define TARMAN_SOPT_ADD_PATH    "-p"
 #define TARMAN_SOPT_ADD_DESKTOP "-d"
 #define TARMAN_SOPT_ADD_TARMAN  "-t"
+#define TARMAN_SOPT_YES         "-y"
 
 #define TARMAN_FOPT_FROM_URL    "--from-url"
 #define TARMAN_FOPT_FROM_REPO   "--from-repo"
@@ -43,6 +44,10 @@
 #define TARMAN_FOPT_ADD_PATH    "--add-path"
 #define TARMAN_FOPT_ADD_DESKTOP "--add-desktop"
 #define TARMAN_FOPT_ADD_TARMAN  "--add-tarman"
+#define TARMAN_FOPT_YES         "--yes"
+#define TARMAN_FOPT_ALL         "--all"
+#define TARMAN_FOPT_HEADLESS    "--headless"
+#define TARMAN_FOPT_OFFLINE     "--offline"
 
 bool cli_opt_from_url(cli_info_t *info, const char *next);
 bool cli_opt_from_repo(cli_info_t *info, const char *next);
@@ -55,3 +60,7 @@ bool cli_opt_icon(cli_info_t *info, const char *next);
 bool cli_opt_add_path(cli_info_t *info, const char *next);
 bool cli_opt_add_desktop(cli_info_t *info, const char *next);
 bool cli_opt_add_tarman(cli_info_t *info, const char *next);
+bool cli_opt_yes(cli_info_t *info, const char *next);
+bool cli_opt_all(cli_info_t *info, const char *next);
+bool cli_opt_headless(cli_info_t *info, const char *next);
+bool cli_opt_offline(cli_info_t *info, const char *next);
@@ -19,20 +19,27 @@
 #pragma once
 
 #include <stdbool.h>
+#include <stdlib.h>
 
 typedef struct {
-  const char *input;
-  bool        from_url;
-  bool        from_repo;
-  const char *pkg_fmt;
-  const char *pkg_name;
-  const char *app_name;
-  const char *exec_path;
-  const char *working_dir;
-  const char *icon_path;
-  bool        add_path;
-  bool        add_desktop;
-  bool        add_tarman;
+  const char  *input;
+  const char **inputs; // All inputs, only for commands that take several
+  size_t       num_inputs;
+  bool         from_url;
+  bool         from_repo;
+  const char  *pkg_fmt;
+  const char  *pkg_name;
+  const char  *app_name;
+  const char  *exec_path;
+  const char  *working_dir;
+  const char  *icon_path;
+  bool         add_path;
+  bool         add_desktop;
+  bool         add_tarman;
+  bool         yes;
+  bool         all;
+  bool         headless;
+  bool         offline;
 } cli_info_t;
 
 typedef bool (*cli_fcn_t)(cli_info_t *info, const char *next);
@@ -45,4 +52,5 @@ typedef struct {
   bool        has_argument;
   cli_exec_t  exec_handler;
   const char *description;
+  bool        many_inputs;
 } cli_drt_desc_t;
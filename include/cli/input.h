@@ -21,7 +21,9 @@
 #include <stdbool.h>
 #include <stdlib.h>
 
+void   cli_in_set_headless(bool headless);
 int    cli_in_int(const char *msg, int range_min, int range_max);
-bool   cli_in_bool(const char *msg);
+// dflt is the answer given by pressing enter, and in headless mode
+bool   cli_in_bool(const char *msg, bool dflt);
 void   cli_in_str(const char *msg, char *buf, size_t len);
 size_t cli_in_dystr(const char *msg, char **dst);
@@ -24,3 +24,4 @@ bool cli_parse(int         argc,
                char       *argv[],
                cli_info_t *cli_info,
                cli_exec_t *handler);
+int  cli_run(int argc, char *argv[]);
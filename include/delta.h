@@ -0,0 +1,31 @@
+/*************************************************************************
+| tarman                                                                 |
+| Copyright (C) 2024 Alessandro Salerno                                  |
+|                                                                        |
+| This program is free software: you can redistribute it and/or modify   |
+| it under the terms of the GNU General Public License as published by   |
+| the Free Software Foundation, either version 3 of the License, or      |
+| (at your option) any later version.                                    |
+|                                                                        |
+| This program is distributed in the hope that it will be useful,        |
+| but WITHOUT ANY WARRANTY; without even the implied warranty of         |
+| MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the          |
+| GNU General Public License for more details.                           |
+|                                                                        |
+| You should have received a copy of the GNU General Public License      |
+| along with this program.  If not, see <https://www.gnu.org/licenses/>. |
+*************************************************************************/
+
+#pragma once
+
+#include <stdbool.h>
+#include <stdlib.h>
+
+// Replaced with the SHA-256 of the archive the patch applies to
+#define TM_DELTA_FROM_PLACEHOLDER "{from}"
+
+size_t delta_dyurl(char **dst, const char *url_template, const char *from_hash);
+bool   delta_apply(const char *dst,
+                   const char *base,
+                   const char *patch,
+                   const char *format);
@@ -16,8 +16,36 @@
 | along with this program.  If not, see <https://www.gnu.org/licenses/>. |
 *************************************************************************/
 
+
 #pragma once
 
 #include <stdbool.h>
+#include <stdio.h>
+
+// HTTP validators of a downloaded resource, either may be NULL
+typedef struct {
+  char *etag;
+  char *last_modified;
+} download_meta_t;
+
+typedef enum {
+  TM_DOWNLOAD_CHECK_CURRENT,
+  TM_DOWNLOAD_CHECK_CHANGED,
+  TM_DOWNLOAD_CHECK_UNKNOWN,
+  TM_DOWNLOAD_CHECK_ERROR
+} download_check_t;
+
+typedef struct {
+  const char *dst;
+  const char *url;
+  bool        ok;
+} download_item_t;
 
+void download_set_offline(bool offline);
+bool download_offline(void);
 bool download(const char *dst, const char *url);
+void download_many(download_item_t *items, size_t count);
+bool download_meta(const char *dst, const char *url, download_meta_t *meta);
+download_check_t download_check(const char *url, download_meta_t meta);
+int              download_parse_headers(FILE *stream, download_meta_t *meta);
+void             download_free_meta(download_meta_t meta);
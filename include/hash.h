@@ -0,0 +1,42 @@
+/*************************************************************************
+| tarman                                                                 |
+| Copyright (C) 2024 Alessandro Salerno                                  |
+|                                                                        |
+| This program is free software: you can redistribute it and/or modify   |
+| it under the terms of the GNU General Public License as published by   |
+| the Free Software Foundation, either version 3 of the License, or      |
+| (at your option) any later version.                                    |
+|                                                                        |
+| This program is distributed in the hope that it will be useful,        |
+| but WITHOUT ANY WARRANTY; without even the implied warranty of         |
+| MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the          |
+| GNU General Public License for more details.                           |
+|                                                                        |
+| You should have received a copy of the GNU General Public License      |
+| along with this program.  If not, see <https://www.gnu.org/licenses/>. |
+*************************************************************************/
+
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+#define TM_HASH_SHA256_LEN    32
+#define TM_HASH_SHA256_HEXLEN (TM_HASH_SHA256_LEN * 2)
+
+typedef struct {
+  uint32_t      state[8];
+  uint64_t      len;
+  unsigned char block[64];
+  size_t        block_len;
+} hash_sha256_t;
+
+void hash_sha256_init(hash_sha256_t *ctx);
+void hash_sha256_update(hash_sha256_t *ctx, const void *data, size_t len);
+void hash_sha256_final(hash_sha256_t *ctx, unsigned char *digest);
+bool hash_sha256_file(unsigned char *digest, const char *path);
+void hash_sha256_str(unsigned char *digest, const char *str);
+
+void hash_tohex(char *dst, const unsigned char *digest, size_t len);
+bool hash_fromhex(unsigned char *dst, const char *hex, size_t len);
@@ -0,0 +1,51 @@
+/*************************************************************************
+| tarman                                                                 |
+| Copyright (C) 2024 Alessandro Salerno                                  |
+|                                                                        |
+| This program is free software: you can redistribute it and/or modify   |
+| it under the terms of the GNU General Public License as published by   |
+| the Free Software Foundation, either version 3 of the License, or      |
+| (at your option) any later version.                                    |
+|                                                                        |
+| This program is distributed in the hope that it will be useful,        |
+| but WITHOUT ANY WARRANTY; without even the implied warranty of         |
+| MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the          |
+| GNU General Public License for more details.                           |
+|                                                                        |
+| You should have received a copy of the GNU General Public License      |
+| along with this program.  If not, see <https://www.gnu.org/licenses/>. |
+*************************************************************************/
+
+
+#pragma once
+
+#include <stdbool.h>
+#include <stdlib.h>
+
+#include "download.h"
+
+// Connections kept open to the same server at the same time
+#define TM_HTTP_MAX_HOST_CONNS 6
+
+// Same limit as curl -L
+#define TM_HTTP_MAX_REDIRECTS 50
+
+// Transfers fail after this long (in seconds) without receiving anything
+#define TM_HTTP_IDLE_TIMEOUT 30
+
+typedef enum {
+  TM_HTTP_RESULT_OK,
+  TM_HTTP_RESULT_FAILED,
+  TM_HTTP_RESULT_UNSUPPORTED // e.g., redirected to HTTPS
+} http_result_t;
+
+typedef struct {
+  const char     *url;
+  const char     *dst;
+  download_meta_t meta; // Validators of the final response, if successful
+  http_result_t   result;
+} http_transfer_t;
+
+bool        http_supports(const char *url);
+const char *http_header_value(const char *line, const char *name);
+void        http_fetch_all(http_transfer_t *transfers, size_t count);
@@ -0,0 +1,41 @@
+/*************************************************************************
+| tarman                                                                 |
+| Copyright (C) 2024 Alessandro Salerno                                  |
+|                                                                        |
+| This program is free software: you can redistribute it and/or modify   |
+| it under the terms of the GNU General Public License as published by   |
+| the Free Software Foundation, either version 3 of the License, or      |
+| (at your option) any later version.                                    |
+|                                                                        |
+| This program is distributed in the hope that it will be useful,        |
+| but WITHOUT ANY WARRANTY; without even the implied warranty of         |
+| MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the          |
+| GNU General Public License for more details.                           |
+|                                                                        |
+| You should have received a copy of the GNU General Public License      |
+| along with this program.  If not, see <https://www.gnu.org/licenses/>. |
+*************************************************************************/
+
+
+#pragma once
+
+#include <stdbool.h>
+#include <stdlib.h>
+
+#include "magic.h"
+
+// The best candidate is picked without asking only if it scores at least
+// TM_INFER_MIN_SCORE and leads the runner-up by TM_INFER_MIN_MARGIN
+#define TM_INFER_MIN_SCORE  60
+#define TM_INFER_MIN_MARGIN 15
+
+typedef struct {
+  char        *path; // Relative to the package root
+  magic_exec_t magic;
+  size_t       size;
+  int          score;
+} infer_exec_t;
+
+void infer_exec_rank(infer_exec_t *execs, size_t count, const char *pkg_name);
+bool infer_exec_confident(const infer_exec_t *execs, size_t count);
+void infer_exec_free(infer_exec_t *execs, size_t count);
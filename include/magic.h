@@ -0,0 +1,52 @@
+/*************************************************************************
+| tarman                                                                 |
+| Copyright (C) 2024 Alessandro Salerno                                  |
+|                                                                        |
+| This program is free software: you can redistribute it and/or modify   |
+| it under the terms of the GNU General Public License as published by   |
+| the Free Software Foundation, either version 3 of the License, or      |
+| (at your option) any later version.                                    |
+|                                                                        |
+| This program is distributed in the hope that it will be useful,        |
+| but WITHOUT ANY WARRANTY; without even the implied warranty of         |
+| MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the          |
+| GNU General Public License for more details.                           |
+|                                                                        |
+| You should have received a copy of the GNU General Public License      |
+| along with this program.  If not, see <https://www.gnu.org/licenses/>. |
+*************************************************************************/
+
+#pragma once
+
+#include <stdlib.h>
+
+// Number of leading bytes needed to recognize all supported
+// executable formats
+#define TM_MAGIC_EXEC_LEN 4
+
+typedef enum {
+  TM_MAGIC_EXEC_NONE,
+  TM_MAGIC_EXEC_ELF,
+  TM_MAGIC_EXEC_MACHO,
+  TM_MAGIC_EXEC_SCRIPT
+} magic_exec_t;
+
+// Number of leading bytes needed to recognize all supported archive
+// formats, the ustar magic being the farthest one
+#define TM_MAGIC_ARCHIVE_LEN 263
+
+typedef enum {
+  TM_MAGIC_ARCHIVE_NONE,
+  TM_MAGIC_ARCHIVE_TAR, // Uncompressed ustar or GNU tar
+  TM_MAGIC_ARCHIVE_GZIP,
+  TM_MAGIC_ARCHIVE_XZ,
+  TM_MAGIC_ARCHIVE_ZSTD,
+  TM_MAGIC_ARCHIVE_BZIP2,
+  TM_MAGIC_ARCHIVE_ZIP
+} magic_archive_t;
+
+magic_exec_t magic_exec_detect(const unsigned char *buf, size_t len);
+magic_exec_t magic_exec_fdetect(const char *path);
+
+magic_archive_t magic_archive_detect(const unsigned char *buf, size_t len);
+magic_archive_t magic_archive_fdetect(const char *path);
@@ -0,0 +1,54 @@
+/*************************************************************************
+| tarman                                                                 |
+| Copyright (C) 2024 Alessandro Salerno                                  |
+|                                                                        |
+| This program is free software: you can redistribute it and/or modify   |
+| it under the terms of the GNU General Public License as published by   |
+| the Free Software Foundation, either version 3 of the License, or      |
+| (at your option) any later version.                                    |
+|                                                                        |
+| This program is distributed in the hope that it will be useful,        |
+| but WITHOUT ANY WARRANTY; without even the implied warranty of         |
+| MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the          |
+| GNU General Public License for more details.                           |
+|                                                                        |
+| You should have received a copy of the GNU General Public License      |
+| along with this program.  If not, see <https://www.gnu.org/licenses/>. |
+*************************************************************************/
+
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+#include "hash.h"
+
+#define TM_MANIFEST_FILE "manifest.tarman"
+
+typedef enum {
+  TM_MANIFEST_STATUS_OK,
+  TM_MANIFEST_STATUS_MISSING,
+  TM_MANIFEST_STATUS_MODIFIED,
+  TM_MANIFEST_STATUS_MODE
+} manifest_status_t;
+
+typedef struct {
+  char         *path; // Relative to the package directory
+  uint64_t      size;
+  uint32_t      mode;
+  unsigned char hash[TM_HASH_SHA256_LEN];
+} manifest_entry_t;
+
+typedef struct {
+  manifest_entry_t *entries;
+  size_t            count;
+} manifest_t;
+
+bool manifest_dycreate(manifest_t *manifest, const char *pkg_path);
+bool manifest_dump(const char *file_path, manifest_t manifest);
+bool manifest_dyload(manifest_t *manifest, const char *file_path);
+void manifest_check(manifest_status_t *statuses,
+                    manifest_t         manifest,
+                    const char        *pkg_path);
+void manifest_free(manifest_t manifest);
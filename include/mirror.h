@@ -0,0 +1,52 @@
+/*************************************************************************
+| tarman                                                                 |
+| Copyright (C) 2024 Alessandro Salerno                                  |
+|                                                                        |
+| This program is free software: you can redistribute it and/or modify   |
+| it under the terms of the GNU General Public License as published by   |
+| the Free Software Foundation, either version 3 of the License, or      |
+| (at your option) any later version.                                    |
+|                                                                        |
+| This program is distributed in the hope that it will be useful,        |
+| but WITHOUT ANY WARRANTY; without even the implied warranty of         |
+| MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the          |
+| GNU General Public License for more details.                           |
+|                                                                        |
+| You should have received a copy of the GNU General Public License      |
+| along with this program.  If not, see <https://www.gnu.org/licenses/>. |
+*************************************************************************/
+
+
+#pragma once
+
+#include <stdbool.h>
+#include <stdlib.h>
+
+#include "download.h"
+
+// Latencies measured when probing mirrors, kept in tarman's home directory
+#define TM_MIRROR_TABLE_FILE "mirrors.tarman"
+
+// Measured latencies are trusted for this long (in seconds)
+// before mirrors are probed again
+#define TM_MIRROR_TABLE_TTL (24 * 60 * 60)
+
+// How long a transfer may go without receiving any data
+// before a second mirror is raced against it
+#define TM_MIRROR_STALL_MS 3000
+
+// Candidate URLs for the same file, the first one being the primary URL
+typedef struct {
+  char **urls;
+  size_t count;
+} mirror_list_t;
+
+bool mirror_parse_list(mirror_list_t *list,
+                       const char    *primary,
+                       const char    *mirrors);
+void mirror_free_list(mirror_list_t list);
+bool mirror_download(const char      *dst,
+                     mirror_list_t    list,
+                     size_t          *used,
+                     download_meta_t *meta,
+                     bool             log);
@@ -19,6 +19,7 @@
 #pragma once
 
 #include <stdbool.h>
+#include <stdio.h>
 #include <stdlib.h>
 
 typedef struct {
@@ -38,3 +39,4 @@ typedef enum {
 
 csz_t os_console_get_sz(void);
 void  os_console_set_color(color_t color, bool bold);
+FILE *os_console_detach_stdout(void);
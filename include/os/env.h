@@ -27,3 +27,4 @@ bool os_env_desktop_add(const char *app_name,
                         const char *icon_path,
                         const char *wkr_dir);
 bool os_env_desktop_rm(const char *app_name);
+bool os_env_set(const char *name, const char *value);
@@ -19,6 +19,42 @@
 #pragma once
 
 #include <stdarg.h>
+#include <stdbool.h>
+#include <stdio.h>
 
-int os_vexec(const char *executable, va_list args);
-int os_exec(const char *executable, ...);
+typedef void *os_proc_t;
+typedef int (*os_exec_fn_t)(int argc, char *argv[]);
+
+int  os_vexec(const char *executable, va_list args);
+int  os_exec(const char *executable, ...);
+bool os_exec_vpipe(os_proc_t  *proc,
+                   FILE      **out,
+                   const char *executable,
+                   va_list     args);
+bool os_exec_pipe(os_proc_t *proc, FILE **out, const char *executable, ...);
+bool os_exec_vpipe_from(os_proc_t  *proc,
+                        FILE      **out,
+                        FILE       *in,
+                        const char *executable,
+                        va_list     args);
+bool os_exec_pipe_from(
+    os_proc_t *proc, FILE **out, FILE *in, const char *executable, ...);
+bool os_exec_vpipe_to(os_proc_t  *proc,
+                      FILE      **in,
+                      FILE       *out,
+                      const char *executable,
+                      va_list     args);
+bool os_exec_pipe_to(
+    os_proc_t *proc, FILE **in, FILE *out, const char *executable, ...);
+bool os_exec_vspawn(os_proc_t *proc, const char *executable, va_list args);
+bool os_exec_spawn(os_proc_t *proc, const char *executable, ...);
+bool os_exec_fork(os_proc_t   *proc,
+                  FILE        *out,
+                  os_exec_fn_t function,
+                  int          argc,
+                  char        *argv[]);
+int  os_exec_wait(os_proc_t proc);
+bool os_exec_poll(os_proc_t proc, int *status);
+void os_exec_kill(os_proc_t proc);
+bool os_exec_exists(const char *executable);
+bool os_exec_idle_priority(void);
@@ -20,8 +20,15 @@
 
 #include <stdarg.h>
 #include <stdbool.h>
+#include <stdio.h>
 #include <stdlib.h>
 
+// Name of the link to the active version inside each package directory
+#define TM_FS_PKG_CURRENT "current"
+
+// Overrides the location of tarman's data directory (~/.tarman by default)
+#define TM_FS_ROOT_ENV "TARMAN_ROOT"
+
 typedef enum {
   TM_FS_DIROP_STATUS_NOEXIST = 0,
   TM_FS_DIROP_STATUS_EXIST   = 1,
@@ -35,7 +42,8 @@ typedef enum {
   TM_FS_FILEOP_STATUS_NOEXIST = 0,
   TM_FS_FILEOP_STATUS_PERM    = 1,
   TM_FS_FILEOP_STATUS_ERR     = 2,
-  TM_FS_FILEOP_STATUS_OK      = 3
+  TM_FS_FILEOP_STATUS_OK      = 3,
+  TM_FS_FILEOP_STATUS_BUSY    = 4
 } fs_fileop_status_t;
 
 typedef enum {
@@ -46,21 +54,52 @@ typedef enum {
 } fs_filetype_t;
 
 typedef void *os_fs_dirstream_t;
+typedef void *os_fs_filestream_t;
 
 typedef struct {
   fs_filetype_t file_type;
   const char   *name;
 } fs_dirent_t;
 
+typedef struct {
+  fs_filetype_t file_type;
+  size_t        size;
+  unsigned int  mode; // Permission bits (e.g., 0755)
+} fs_fileinfo_t;
+
 fs_dirop_status_t os_fs_mkdir(const char *path);
 fs_dirop_status_t os_fs_dir_rm(const char *path);
 fs_dirop_status_t os_fs_dir_count(size_t *count, const char *path);
 fs_dirop_status_t os_fs_dir_open(os_fs_dirstream_t *stream, const char *path);
 fs_dirop_status_t os_fs_dir_close(os_fs_dirstream_t stream);
 fs_dirop_status_t os_fs_dir_next(os_fs_dirstream_t stream, fs_dirent_t *ent);
+fs_dirop_status_t os_fs_dir_mv(const char *dst, const char *src);
 
 fs_fileop_status_t os_fs_file_rm(const char *path);
+fs_fileop_status_t os_fs_file_mv(const char *dst, const char *src);
 fs_fileop_status_t os_fs_file_gettype(fs_filetype_t *dst, const char *path);
+fs_fileop_status_t os_fs_file_getinfo(fs_fileinfo_t *dst, const char *path);
+fs_fileop_status_t os_fs_file_fgetinfo(fs_fileinfo_t *dst, FILE *file);
+fs_fileop_status_t os_fs_file_create(os_fs_filestream_t *stream,
+                                     const char         *path,
+                                     unsigned int        mode);
+fs_fileop_status_t
+os_fs_file_write(os_fs_filestream_t stream, const void *buf, size_t len);
+fs_fileop_status_t os_fs_file_reserve(os_fs_filestream_t stream, size_t size);
+fs_fileop_status_t
+os_fs_file_copy(os_fs_filestream_t stream, FILE *src, size_t len);
+fs_fileop_status_t os_fs_file_close(os_fs_filestream_t stream);
+fs_fileop_status_t os_fs_file_link(const char *dst, const char *target);
+fs_fileop_status_t os_fs_file_symlink(const char *dst, const char *target);
+fs_fileop_status_t os_fs_file_dyreadlink(char **dst, const char *path);
+fs_fileop_status_t os_fs_file_chmod(const char *path, unsigned int mode);
+fs_fileop_status_t os_fs_file_lock(os_fs_filestream_t *lock,
+                                   const char         *path,
+                                   bool                exclusive,
+                                   bool                wait);
+fs_fileop_status_t os_fs_file_unlock(os_fs_filestream_t lock);
+
+fs_fileop_status_t os_fs_sync(const char *path);
 
 size_t os_fs_path_vlen(size_t num_args, va_list args);
 size_t os_fs_path_len(size_t num_args, ...);
@@ -75,9 +114,18 @@ size_t os_fs_tm_dypkgs(char **dst);
 size_t os_fs_tm_dyextract(char **dst);
 size_t os_fs_tm_dyrepo(char **dst, const char *repo_name);
 size_t os_fs_tm_dypkg(char **dst, const char *pkg_name);
+size_t os_fs_tm_dypkgdir(char **dst, const char *pkg_name);
+size_t os_fs_tm_dypkgver(char **dst, const char *pkg_name, size_t version);
 size_t os_fs_tm_dycached(char **dst, const char *item_name);
+size_t os_fs_tm_dytmpfile(char **dst, const char *name, const char *ext);
+size_t os_fs_tm_dylock(char **dst, const char *lock_name);
+size_t os_fs_tm_dyconfig(char **dst);
 size_t
 os_fs_tm_dyrecipe(char **dst, const char *repo_name, const char *pkg_name);
+size_t os_fs_tm_dyarchive(char      **dst,
+                          const char *pkg_name,
+                          const char *pkg_fmt);
+size_t os_fs_tm_dyfetched(char **dst, const char *key, const char *pkg_fmt);
 size_t os_fs_tm_dyplugins(const char **dst);
 size_t os_fs_tm_dyplugin(const char **dst, const char *plugin);
 size_t os_fs_tm_dyplugconf(const char **dst, const char *plugin);
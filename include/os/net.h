@@ -0,0 +1,87 @@
+/*************************************************************************
+| tarman                                                                 |
+| Copyright (C) 2024 Alessandro Salerno                                  |
+|                                                                        |
+| This program is free software: you can redistribute it and/or modify   |
+| it under the terms of the GNU General Public License as published by   |
+| the Free Software Foundation, either version 3 of the License, or      |
+| (at your option) any later version.                                    |
+|                                                                        |
+| This program is distributed in the hope that it will be useful,        |
+| but WITHOUT ANY WARRANTY; without even the implied warranty of         |
+| MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the          |
+| GNU General Public License for more details.                           |
+|                                                                        |
+| You should have received a copy of the GNU General Public License      |
+| along with this program.  If not, see <https://www.gnu.org/licenses/>. |
+*************************************************************************/
+
+
+#pragma once
+
+#include <stdbool.h>
+#include <stdlib.h>
+
+// Each address of a host is given this long (in milliseconds) to accept a
+// connection before the next one is tried
+#define TM_NET_CONNECT_TIMEOUT 5000
+
+#define TM_NET_EVENT_READ  1
+#define TM_NET_EVENT_WRITE 2
+#define TM_NET_EVENT_ERROR 4
+
+typedef enum {
+  TM_NET_STATUS_OK,
+  TM_NET_STATUS_AGAIN, // Would block, wait for the socket to be ready
+  TM_NET_STATUS_CLOSED,
+  TM_NET_STATUS_ERR
+} net_status_t;
+
+typedef void *os_net_sock_t;
+typedef void *os_net_poller_t;
+typedef void *os_net_attempt_t;
+
+typedef struct {
+  void        *data;
+  unsigned int events;
+} net_event_t;
+
+// Connecting does not block: the socket becomes writable once the current
+// address has either accepted or refused the connection, and
+// os_net_connect_finish then tells which. TM_NET_STATUS_AGAIN means that
+// the next address is being tried with a new socket, which replaces the
+// old one in sock. Attempts end with TM_NET_STATUS_OK or TM_NET_STATUS_ERR,
+// or with os_net_connect_abort. The last socket is always left to the caller
+bool         os_net_connect_start(os_net_attempt_t *attempt,
+                                  os_net_sock_t    *sock,
+                                  const char       *host,
+                                  const char       *port);
+net_status_t os_net_connect_finish(os_net_attempt_t attempt,
+                                   os_net_sock_t   *sock,
+                                   bool             timed_out);
+void         os_net_connect_abort(os_net_attempt_t attempt);
+// Connections accepted from the listening socket are non-blocking too.
+// A NULL host listens on all interfaces
+bool         os_net_listen(os_net_sock_t *sock,
+                           const char    *host,
+                           const char    *port);
+net_status_t os_net_accept(os_net_sock_t listener, os_net_sock_t *conn);
+net_status_t os_net_send(os_net_sock_t sock,
+                         const void   *buf,
+                         size_t        len,
+                         size_t       *sent);
+net_status_t
+     os_net_recv(os_net_sock_t sock, void *buf, size_t len, size_t *received);
+void os_net_close(os_net_sock_t sock);
+
+bool   os_net_poller_create(os_net_poller_t *poller);
+bool   os_net_poller_watch(os_net_poller_t poller,
+                           os_net_sock_t   sock,
+                           unsigned int    events,
+                           void           *data);
+void   os_net_poller_unwatch(os_net_poller_t poller, os_net_sock_t sock);
+size_t os_net_poller_wait(os_net_poller_t poller,
+                          net_event_t    *events,
+                          size_t          max_events,
+                          int             timeout_ms);
+void   os_net_poller_destroy(os_net_poller_t poller);
@@ -0,0 +1,31 @@
+/*************************************************************************
+| tarman                                                                 |
+| Copyright (C) 2024 Alessandro Salerno                                  |
+|                                                                        |
+| This program is free software: you can redistribute it and/or modify   |
+| it under the terms of the GNU General Public License as published by   |
+| the Free Software Foundation, either version 3 of the License, or      |
+| (at your option) any later version.                                    |
+|                                                                        |
+| This program is distributed in the hope that it will be useful,        |
+| but WITHOUT ANY WARRANTY; without even the implied warranty of         |
+| MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the          |
+| GNU General Public License for more details.                           |
+|                                                                        |
+| You should have received a copy of the GNU General Public License      |
+| along with this program.  If not, see <https://www.gnu.org/licenses/>. |
+*************************************************************************/
+
+#pragma once
+
+#include "os/thread.h"
+
+bool   noopt_thread_create(os_thread_t *thread, os_thread_fcn_t fcn, void *arg);
+bool   noopt_thread_join(os_thread_t thread, void **ret);
+void   noopt_thread_yield(void);
+size_t noopt_thread_hwcount(void);
+
+bool noopt_mutex_create(os_mutex_t *mutex);
+void noopt_mutex_lock(os_mutex_t mutex);
+void noopt_mutex_unlock(os_mutex_t mutex);
+void noopt_mutex_destroy(os_mutex_t mutex);
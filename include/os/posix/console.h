@@ -19,8 +19,10 @@
 #pragma once
 
 #include <stdbool.h>
+#include <stdio.h>
 
 #include "os/console.h"
 
 csz_t posix_console_get_sz(void);
 void  posix_console_set_color(color_t color, bool bold);
+FILE *posix_console_detach_stdout(void);
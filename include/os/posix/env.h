@@ -20,5 +20,7 @@
 
 #include <stdbool.h>
 
-bool posix_env_path_add(const char *executable);
-bool posix_env_path_rm(const char *executable);
+bool        posix_env_path_add(const char *executable);
+bool        posix_env_path_rm(const char *executable);
+bool        posix_env_set(const char *name, const char *value);
+const char *posix_env_home(void);
@@ -19,5 +19,36 @@
 #pragma once
 
 #include <stdarg.h>
+#include <stdbool.h>
+#include <stdio.h>
 
-int posix_vexec(const char *executable, va_list args);
+#include "os/exec.h"
+
+int  posix_vexec(const char *executable, va_list args);
+bool posix_exec_vpipe(os_proc_t  *proc,
+                      FILE      **out,
+                      const char *executable,
+                      va_list     args);
+bool posix_exec_vpipe_from(os_proc_t  *proc,
+                           FILE      **out,
+                           FILE       *in,
+                           const char *executable,
+                           va_list     args);
+bool posix_exec_vpipe_to(os_proc_t  *proc,
+                         FILE      **in,
+                         FILE       *out,
+                         const char *executable,
+                         va_list     args);
+bool posix_exec_vspawn(os_proc_t  *proc,
+                       const char *executable,
+                       va_list     args);
+bool posix_exec_fork(os_proc_t   *proc,
+                     FILE        *out,
+                     os_exec_fn_t function,
+                     int          argc,
+                     char        *argv[]);
+int  posix_exec_wait(os_proc_t proc);
+bool posix_exec_poll(os_proc_t proc, int *status);
+void posix_exec_kill(os_proc_t proc);
+bool posix_exec_exists(const char *executable);
+bool posix_exec_idle_priority(void);
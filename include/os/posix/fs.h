@@ -18,6 +18,8 @@
 
 #pragma once
 
+#include <stdio.h>
+
 #include "os/fs.h"
 
 fs_dirop_status_t posix_fs_mkdir(const char *path);
@@ -27,9 +29,33 @@ fs_dirop_status_t posix_fs_dir_open(os_fs_dirstream_t *stream,
                                     const char        *path);
 fs_dirop_status_t posix_fs_dir_close(os_fs_dirstream_t stream);
 fs_dirop_status_t posix_fs_dir_next(os_fs_dirstream_t stream, fs_dirent_t *ent);
+fs_dirop_status_t posix_fs_dir_mv(const char *dst, const char *src);
 
 fs_fileop_status_t posix_fs_file_rm(const char *path);
+fs_fileop_status_t posix_fs_file_mv(const char *dst, const char *src);
 fs_fileop_status_t posix_fs_file_gettype(fs_filetype_t *dst, const char *path);
+fs_fileop_status_t posix_fs_file_getinfo(fs_fileinfo_t *dst, const char *path);
+fs_fileop_status_t posix_fs_file_fgetinfo(fs_fileinfo_t *dst, FILE *file);
+fs_fileop_status_t posix_fs_file_create(os_fs_filestream_t *stream,
+                                        const char         *path,
+                                        unsigned int        mode);
+fs_fileop_status_t
+posix_fs_file_write(os_fs_filestream_t stream, const void *buf, size_t len);
+fs_fileop_status_t
+posix_fs_file_copy(os_fs_filestream_t stream, FILE *src, size_t len);
+fs_fileop_status_t posix_fs_file_close(os_fs_filestream_t stream);
+int                posix_fs_file_getfd(os_fs_filestream_t stream);
+fs_fileop_status_t posix_fs_file_link(const char *dst, const char *target);
+fs_fileop_status_t posix_fs_file_symlink(const char *dst, const char *target);
+fs_fileop_status_t posix_fs_file_dyreadlink(char **dst, const char *path);
+fs_fileop_status_t posix_fs_file_chmod(const char *path, unsigned int mode);
+fs_fileop_status_t posix_fs_file_lock(os_fs_filestream_t *lock,
+                                      const char         *path,
+                                      bool                exclusive,
+                                      bool                wait);
+fs_fileop_status_t posix_fs_file_unlock(os_fs_filestream_t lock);
+
+fs_fileop_status_t posix_fs_sync(const char *path);
 
 size_t posix_fs_path_vlen(size_t num_args, va_list args);
 size_t posix_fs_path_vconcat(char *dst, size_t num_args, va_list args);
@@ -41,9 +67,18 @@ size_t posix_fs_tm_dypkgs(char **dst);
 size_t posix_fs_tm_dyextract(char **dst);
 size_t posix_fs_tm_dyrepo(char **dst, const char *repo_name);
 size_t posix_fs_tm_dypkg(char **dst, const char *pkg_name);
+size_t posix_fs_tm_dypkgdir(char **dst, const char *pkg_name);
+size_t posix_fs_tm_dypkgver(char **dst, const char *pkg_name, size_t version);
 size_t posix_fs_tm_dycached(char **dst, const char *item_name);
+size_t posix_fs_tm_dytmpfile(char **dst, const char *name, const char *ext);
+size_t posix_fs_tm_dylock(char **dst, const char *lock_name);
+size_t posix_fs_tm_dyconfig(char **dst);
 size_t
 posix_fs_tm_dyrecipe(char **dst, const char *repo_name, const char *pkg_name);
+size_t posix_fs_tm_dyarchive(char      **dst,
+                             const char *pkg_name,
+                             const char *pkg_fmt);
+size_t posix_fs_tm_dyfetched(char **dst, const char *key, const char *pkg_fmt);
 size_t posix_fs_tm_dyplugins(const char **dst);
 size_t posix_fs_tm_dyplugin(const char **dst, const char *plugin);
 size_t posix_fs_tm_dyplugconf(const char **dst, const char *plugin);
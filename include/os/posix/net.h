@@ -0,0 +1,61 @@
+/*************************************************************************
+| tarman                                                                 |
+| Copyright (C) 2024 Alessandro Salerno                                  |
+|                                                                        |
+| This program is free software: you can redistribute it and/or modify   |
+| it under the terms of the GNU General Public License as published by   |
+| the Free Software Foundation, either version 3 of the License, or      |
+| (at your option) any later version.                                    |
+|                                                                        |
+| This program is distributed in the hope that it will be useful,        |
+| but WITHOUT ANY WARRANTY; without even the implied warranty of         |
+| MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the          |
+| GNU General Public License for more details.                           |
+|                                                                        |
+| You should have received a copy of the GNU General Public License      |
+| along with this program.  If not, see <https://www.gnu.org/licenses/>. |
+*************************************************************************/
+
+
+#pragma once
+
+#include <stdbool.h>
+#include <stdlib.h>
+
+#include "os/net.h"
+
+bool         posix_net_connect_start(os_net_attempt_t *attempt,
+                                     os_net_sock_t    *sock,
+                                     const char       *host,
+                                     const char       *port);
+net_status_t posix_net_connect_finish(os_net_attempt_t attempt,
+                                      os_net_sock_t   *sock,
+                                      bool             timed_out);
+void         posix_net_connect_abort(os_net_attempt_t attempt);
+bool         posix_net_listen(os_net_sock_t *sock,
+                              const char    *host,
+                              const char    *port);
+net_status_t posix_net_accept(os_net_sock_t listener, os_net_sock_t *conn);
+net_status_t posix_net_send(os_net_sock_t sock,
+                            const void   *buf,
+                            size_t        len,
+                            size_t       *sent);
+net_status_t posix_net_recv(os_net_sock_t sock,
+                            void         *buf,
+                            size_t        len,
+                            size_t       *received);
+void         posix_net_close(os_net_sock_t sock);
+int          posix_net_fd(os_net_sock_t sock);
+
+// Portable poller based on poll(2), for systems without a better one
+bool   posix_net_poller_create(os_net_poller_t *poller);
+bool   posix_net_poller_watch(os_net_poller_t poller,
+                              os_net_sock_t   sock,
+                              unsigned int    events,
+                              void           *data);
+void   posix_net_poller_unwatch(os_net_poller_t poller, os_net_sock_t sock);
+size_t posix_net_poller_wait(os_net_poller_t poller,
+                             net_event_t    *events,
+                             size_t          max_events,
+                             int             timeout_ms);
+void   posix_net_poller_destroy(os_net_poller_t poller);
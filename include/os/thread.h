@@ -0,0 +1,45 @@
+/*************************************************************************
+| tarman                                                                 |
+| Copyright (C) 2024 Alessandro Salerno                                  |
+|                                                                        |
+| This program is free software: you can redistribute it and/or modify   |
+| it under the terms of the GNU General Public License as published by   |
+| the Free Software Foundation, either version 3 of the License, or      |
+| (at your option) any later version.                                    |
+|                                                                        |
+| This program is distributed in the hope that it will be useful,        |
+| but WITHOUT ANY WARRANTY; without even the implied warranty of         |
+| MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the          |
+| GNU General Public License for more details.                           |
+|                                                                        |
+| You should have received a copy of the GNU General Public License      |
+| along with this program.  If not, see <https://www.gnu.org/licenses/>. |
+*************************************************************************/
+
+#pragma once
+
+#include <stdbool.h>
+#include <stdlib.h>
+
+typedef void *os_thread_t;
+typedef void *os_mutex_t;
+typedef void *os_cond_t;
+typedef void *(*os_thread_fcn_t)(void *arg);
+
+bool   os_thread_create(os_thread_t *thread, os_thread_fcn_t fcn, void *arg);
+bool   os_thread_join(os_thread_t thread, void **ret);
+void   os_thread_yield(void);
+void   os_thread_sleep(size_t ms);
+size_t os_thread_clock(void);
+size_t os_thread_hwcount(void);
+
+bool os_mutex_create(os_mutex_t *mutex);
+void os_mutex_lock(os_mutex_t mutex);
+void os_mutex_unlock(os_mutex_t mutex);
+void os_mutex_destroy(os_mutex_t mutex);
+
+bool os_cond_create(os_cond_t *cond);
+void os_cond_wait(os_cond_t cond, os_mutex_t mutex);
+void os_cond_signal(os_cond_t cond);
+void os_cond_broadcast(os_cond_t cond);
+void os_cond_destroy(os_cond_t cond);
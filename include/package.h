@@ -37,11 +37,35 @@ typedef struct {
 typedef struct {
   pkg_info_t  pkg_info;
   const char *package_format;
+  const char *mirrors;        // Comma-separated alternatives to URL
+  const char *archive_sha256; // Expected SHA-256 of the archive, if known
+  const char *delta_url;      // Patch URL, '{from}' is the old archive's hash
+  const char *delta_format;
+  const char *archive_etag; // Validators of the archive downloaded from URL
+  const char *archive_last_modified;
+  const char *version;
+  const char *depends; // Comma-separated list, see pkg_parse_depends
   bool        add_to_path;
   bool        add_to_desktop;
   bool        add_to_tarman;
 } recipe_t;
 
+typedef enum {
+  TM_PKG_DEP_ANY,
+  TM_PKG_DEP_EQ,
+  TM_PKG_DEP_LT,
+  TM_PKG_DEP_LE,
+  TM_PKG_DEP_GT,
+  TM_PKG_DEP_GE
+} pkg_dep_op_t;
+
+// A single entry of DEPENDS, e.g., 'node>=18'
+typedef struct {
+  char        *name;
+  pkg_dep_op_t op;
+  char        *version; // NULL if op is TM_PKG_DEP_ANY
+} pkg_dep_t;
+
 // "Runtime" recipe
 typedef struct {
   recipe_t    recipe;
@@ -61,3 +85,8 @@ bool pkg_dump_rcp(const char *file_path, recipe_t recipe);
 
 void pkg_free_pkg(pkg_info_t pkg_info);
 void pkg_free_rcp(recipe_t recipe);
+
+bool pkg_parse_depends(pkg_dep_t **deps, size_t *count, const char *depends);
+void pkg_free_depends(pkg_dep_t *deps, size_t count);
+int  pkg_cmp_versions(const char *a, const char *b);
+bool pkg_dep_satisfied(const pkg_dep_t *dep, const char *version);
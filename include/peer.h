@@ -0,0 +1,40 @@
+/*************************************************************************
+| tarman                                                                 |
+| Copyright (C) 2024 Alessandro Salerno                                  |
+|                                                                        |
+| This program is free software: you can redistribute it and/or modify   |
+| it under the terms of the GNU General Public License as published by   |
+| the Free Software Foundation, either version 3 of the License, or      |
+| (at your option) any later version.                                    |
+|                                                                        |
+| This program is distributed in the hope that it will be useful,        |
+| but WITHOUT ANY WARRANTY; without even the implied warranty of         |
+| MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the          |
+| GNU General Public License for more details.                           |
+|                                                                        |
+| You should have received a copy of the GNU General Public License      |
+| along with this program.  If not, see <https://www.gnu.org/licenses/>. |
+*************************************************************************/
+
+
+#pragma once
+
+#include <stdbool.h>
+#include <stdlib.h>
+
+// Port of 'tarman serve-cache', also used for peers given without one
+#define TM_PEER_DEFAULT_PORT "8790"
+
+// Connections are dropped after this long (in seconds) without activity
+#define TM_PEER_IDLE_TIMEOUT 30
+
+typedef struct {
+  const char *dst;
+  const char *name; // Name of the archive in the cache of the peers
+  bool        ok;
+} peer_item_t;
+
+bool peer_configured(void);
+bool peer_fetch(const char *dst, const char *name);
+void peer_fetch_many(peer_item_t *items, size_t count);
+bool peer_serve(const char *port);
@@ -36,6 +36,10 @@ typedef struct {
   const char *cfg;
 } __attribute__((aligned(16))) sdk_handover_t;
 
+// Limits from the tarman configuration are passed through the environment:
+// TARMAN_DOWNLOAD_RATE_LIMIT and TARMAN_EXTRACT_RATE_LIMIT (bytes per second,
+// 0 for no limit) and TARMAN_IDLE_PRIORITY ("true" or "false")
+
 // Run a program on the user's computer
 // Invokes tarman `os_exec` indirectly
 // Returns the exit code of the program
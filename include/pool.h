@@ -0,0 +1,52 @@
+/*************************************************************************
+| tarman                                                                 |
+| Copyright (C) 2024 Alessandro Salerno                                  |
+|                                                                        |
+| This program is free software: you can redistribute it and/or modify   |
+| it under the terms of the GNU General Public License as published by   |
+| the Free Software Foundation, either version 3 of the License, or      |
+| (at your option) any later version.                                    |
+|                                                                        |
+| This program is distributed in the hope that it will be useful,        |
+| but WITHOUT ANY WARRANTY; without even the implied warranty of         |
+| MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the          |
+| GNU General Public License for more details.                           |
+|                                                                        |
+| You should have received a copy of the GNU General Public License      |
+| along with this program.  If not, see <https://www.gnu.org/licenses/>. |
+*************************************************************************/
+
+#pragma once
+
+#include <stdbool.h>
+#include <stdlib.h>
+
+#include "os/exec.h"
+
+// Maximum number of workers used by the pool, regardless
+// of how many hardware threads the host has
+#define TM_POOL_MAX_WORKERS 64
+
+// Status passed to pool_done_t for processes that could not be started
+#define TM_POOL_NOT_STARTED -1
+
+typedef void (*pool_job_t)(size_t index, void *ctx);
+
+// Arguments of a process started by pool_run_procs, see os_exec_fork
+typedef struct {
+  int    argc;
+  char **argv;
+} pool_proc_t;
+
+// Called, in order, once process `index` has exited and its output has
+// been shown, with its exit status or TM_POOL_NOT_STARTED
+typedef void (*pool_done_t)(size_t index, int status, void *ctx);
+
+size_t pool_size(void);
+void   pool_run(size_t num_jobs, pool_job_t job, void *ctx);
+void   pool_run_io(size_t num_jobs, pool_job_t job, void *ctx);
+void   pool_run_procs(size_t             num_procs,
+                      const pool_proc_t *procs,
+                      os_exec_fn_t       function,
+                      pool_done_t        done,
+                      void              *ctx);
@@ -0,0 +1,57 @@
+/*************************************************************************
+| tarman                                                                 |
+| Copyright (C) 2024 Alessandro Salerno                                  |
+|                                                                        |
+| This program is free software: you can redistribute it and/or modify   |
+| it under the terms of the GNU General Public License as published by   |
+| the Free Software Foundation, either version 3 of the License, or      |
+| (at your option) any later version.                                    |
+|                                                                        |
+| This program is distributed in the hope that it will be useful,        |
+| but WITHOUT ANY WARRANTY; without even the implied warranty of         |
+| MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the          |
+| GNU General Public License for more details.                           |
+|                                                                        |
+| You should have received a copy of the GNU General Public License      |
+| along with this program.  If not, see <https://www.gnu.org/licenses/>. |
+*************************************************************************/
+
+#pragma once
+
+#include <stdbool.h>
+#include <stdio.h>
+
+#include "config.h"
+#include "hash.h"
+
+// Written by tarman in each repository directory when it is added
+#define TM_REPO_SOURCE_FILE ".source.tarman"
+
+// Structure of repository source files (.source.tarman)
+typedef struct {
+  const char *url;            // URL of the full repository archive
+  const char *package_format; // Format of the archive
+  const char *index_url;      // URL of the recipe index, if not the default
+  const char *mirrors;        // Comma-separated alternatives to url
+} repo_source_t;
+
+// One line of a recipe index, in the same format used by sha256sum
+// e.g., "<sha256>  <repo>/<recipe>.tarman"
+typedef struct {
+  char         *path;
+  unsigned char hash[TM_HASH_SHA256_LEN];
+} repo_index_entry_t;
+
+typedef struct {
+  repo_index_entry_t *entries;
+  size_t              count;
+} repo_index_t;
+
+cfg_parse_status_t repo_parse_source(repo_source_t *src, const char *path);
+bool               repo_dump_source(const char *path, repo_source_t src);
+void               repo_free_source(repo_source_t src);
+
+bool   repo_index_dyparse(repo_index_t *index, FILE *stream);
+void   repo_index_free(repo_index_t index);
+size_t repo_dyindex_url(char **dst, repo_source_t src);
+size_t repo_dyentry_url(char **dst, const char *index_url, const char *path);
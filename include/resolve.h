@@ -0,0 +1,44 @@
+/*************************************************************************
+| tarman                                                                 |
+| Copyright (C) 2024 Alessandro Salerno                                  |
+|                                                                        |
+| This program is free software: you can redistribute it and/or modify   |
+| it under the terms of the GNU General Public License as published by   |
+| the Free Software Foundation, either version 3 of the License, or      |
+| (at your option) any later version.                                    |
+|                                                                        |
+| This program is distributed in the hope that it will be useful,        |
+| but WITHOUT ANY WARRANTY; without even the implied warranty of         |
+| MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the          |
+| GNU General Public License for more details.                           |
+|                                                                        |
+| You should have received a copy of the GNU General Public License      |
+| along with this program.  If not, see <https://www.gnu.org/licenses/>. |
+*************************************************************************/
+
+
+#pragma once
+
+#include <stdbool.h>
+#include <stdlib.h>
+
+typedef struct {
+  char   *name;
+  char   *repo;      // Repository the recipe comes from, NULL if satisfied
+  char   *version;   // Version that will be installed, may be NULL
+  size_t *deps;      // Indices of the nodes this one depends on
+  size_t  num_deps;
+  bool    satisfied; // A suitable version is already installed
+} resolve_node_t;
+
+// Every node comes after the nodes it depends on
+typedef struct {
+  resolve_node_t *nodes;
+  size_t          count;
+} resolve_graph_t;
+
+bool resolve_dependencies(resolve_graph_t *graph,
+                          const char      *pkg_name,
+                          const char      *depends);
+bool resolve_install(const resolve_graph_t *graph);
+void resolve_free(resolve_graph_t *graph);
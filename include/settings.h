@@ -0,0 +1,42 @@
+/*************************************************************************
+| tarman                                                                 |
+| Copyright (C) 2024 Alessandro Salerno                                  |
+|                                                                        |
+| This program is free software: you can redistribute it and/or modify   |
+| it under the terms of the GNU General Public License as published by   |
+| the Free Software Foundation, either version 3 of the License, or      |
+| (at your option) any later version.                                    |
+|                                                                        |
+| This program is distributed in the hope that it will be useful,        |
+| but WITHOUT ANY WARRANTY; without even the implied warranty of         |
+| MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the          |
+| GNU General Public License for more details.                           |
+|                                                                        |
+| You should have received a copy of the GNU General Public License      |
+| along with this program.  If not, see <https://www.gnu.org/licenses/>. |
+*************************************************************************/
+
+
+#pragma once
+
+#include <stdbool.h>
+#include <stdlib.h>
+
+#include "config.h"
+
+// Environment variables through which the limits are passed to plugins.
+// Rates are in bytes per second, 0 meaning no limit
+#define TM_SETTINGS_ENV_DOWNLOAD_RATE "TARMAN_DOWNLOAD_RATE_LIMIT"
+#define TM_SETTINGS_ENV_EXTRACT_RATE  "TARMAN_EXTRACT_RATE_LIMIT"
+#define TM_SETTINGS_ENV_IDLE_PRIORITY "TARMAN_IDLE_PRIORITY"
+
+typedef struct {
+  size_t      download_rate; // Bytes per second, 0 means no limit
+  size_t      extract_rate;  // Bytes written per second, 0 means no limit
+  bool        idle_priority; // Extract at idle I/O and lowest CPU priority
+  const char *cache_peers;   // Comma-separated hosts running serve-cache
+} settings_t;
+
+cfg_parse_status_t settings_load(void);
+const settings_t  *settings_get(void);
+bool               settings_parse_rate(size_t *dst, const char *str);
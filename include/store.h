@@ -0,0 +1,39 @@
+/*************************************************************************
+| tarman                                                                 |
+| Copyright (C) 2024 Alessandro Salerno                                  |
+|                                                                        |
+| This program is free software: you can redistribute it and/or modify   |
+| it under the terms of the GNU General Public License as published by   |
+| the Free Software Foundation, either version 3 of the License, or      |
+| (at your option) any later version.                                    |
+|                                                                        |
+| This program is distributed in the hope that it will be useful,        |
+| but WITHOUT ANY WARRANTY; without even the implied warranty of         |
+| MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the          |
+| GNU General Public License for more details.                           |
+|                                                                        |
+| You should have received a copy of the GNU General Public License      |
+| along with this program.  If not, see <https://www.gnu.org/licenses/>. |
+*************************************************************************/
+
+
+#pragma once
+
+#include <stdbool.h>
+#include <stdlib.h>
+
+#include "package.h"
+
+// System-wide store shared by all users of the machine. Its layout is the
+// same as that of ~/.tarman/pkgs, but its files are read-only
+#define TM_STORE_DEFAULT "/opt/tarman"
+
+// Overrides TM_STORE_DEFAULT, an empty value disables the store
+#define TM_STORE_ENV "TARMAN_STORE"
+
+size_t store_dypath(char **dst);
+size_t store_dypkgdir(char **dst, const char *pkg_name);
+bool   store_dyactive(char **dst, const char *pkg_name);
+bool   store_find(char **dst, const char *pkg_name, recipe_t recipe);
+bool   store_link(const char *ver_path, const char *store_ver, bool log);
+void   store_adopt(recipe_t *recipe, const char *store_ver);
@@ -0,0 +1,134 @@
+/*************************************************************************
+| tarman                                                                 |
+| Copyright (C) 2024 Alessandro Salerno                                  |
+|                                                                        |
+| This program is free software: you can redistribute it and/or modify   |
+| it under the terms of the GNU General Public License as published by   |
+| the Free Software Foundation, either version 3 of the License, or      |
+| (at your option) any later version.                                    |
+|                                                                        |
+| This program is distributed in the hope that it will be useful,        |
+| but WITHOUT ANY WARRANTY; without even the implied warranty of         |
+| MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the          |
+| GNU General Public License for more details.                           |
+|                                                                        |
+| You should have received a copy of the GNU General Public License      |
+| along with this program.  If not, see <https://www.gnu.org/licenses/>. |
+*************************************************************************/
+
+#pragma once
+
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "manifest.h"
+#include "os/fs.h"
+
+#define TM_TAR_BLOCK_LEN 512
+
+// Number of leading bytes of regular files that entries expose, enough
+// to recognize file formats by their magic bytes
+#define TM_TAR_HEAD_LEN 8
+
+typedef enum {
+  TM_TAR_ENTRY_FILE,
+  TM_TAR_ENTRY_DIR,
+  TM_TAR_ENTRY_SYMLINK,
+  TM_TAR_ENTRY_HARDLINK,
+  TM_TAR_ENTRY_OTHER // Devices, FIFOs, etc.
+} tar_entry_type_t;
+
+typedef enum {
+  TM_TAR_STATUS_OK,
+  TM_TAR_STATUS_END,
+  TM_TAR_STATUS_MALFORMED,
+  TM_TAR_STATUS_IO
+} tar_status_t;
+
+typedef struct {
+  tar_entry_type_t type;
+  const char      *path; // Owned by the reader, valid until the next entry
+  const char      *link; // Target of links, NULL otherwise
+  size_t           size;
+  unsigned int     mode;
+
+  // First bytes of regular files, owned by the reader. They are still
+  // returned by tar_read and tar_copy
+  const unsigned char *head;
+  size_t               head_len;
+} tar_entry_t;
+
+// Sequential reader for ustar archives, including the GNU and pax
+// extensions used for long names and large files. Only reads forward,
+// so the stream may be a pipe
+typedef struct {
+  FILE  *stream;
+  size_t remaining; // Bytes of data left in the current entry
+  size_t padding;   // Bytes between the end of the data and the next header
+  char  *path;
+  char  *link;
+
+  unsigned char head[TM_TAR_HEAD_LEN];
+  size_t        head_len;
+  size_t        head_pos; // Bytes of head already returned to the caller
+} tar_reader_t;
+
+// Sequential writer for ustar archives, the stream may be a pipe. Names and
+// link targets that do not fit in the header are written as GNU long name
+// entries. All entries get the time at which the writer was initialized
+typedef struct {
+  FILE  *stream;
+  time_t mtime;
+} tar_writer_t;
+
+// Called for each entry once it has been extracted. `rel_path` is
+// relative to the destination
+typedef void (*tar_visit_t)(const tar_entry_t *ent,
+                            const char        *rel_path,
+                            void              *ctx);
+
+// Options for tar_extract, all of them can be left unset
+typedef struct {
+  // Files of a previous extraction and the directory they are in. If both
+  // are set, files that did not change are hard linked from it rather than
+  // written again
+  const manifest_t *manifest;
+  const char       *base;
+
+  // Lets callers learn about the contents of the archive (e.g., which
+  // files are programs) without walking the destination afterwards
+  tar_visit_t visit;
+  void       *visit_ctx;
+
+  // Bytes written to files per second, 0 means no limit
+  size_t write_rate;
+
+  // Set by tar_extract. `complete` tells whether all entries were
+  // extracted, and thus visited
+  bool   complete;
+  size_t num_unchanged;
+  size_t num_written;
+} tar_opts_t;
+
+void         tar_reader_init(tar_reader_t *reader, FILE *stream);
+void         tar_reader_free(tar_reader_t *reader);
+tar_status_t tar_next(tar_reader_t *reader, tar_entry_t *ent);
+size_t       tar_read(tar_reader_t *reader, void *buf, size_t len);
+bool         tar_copy(tar_reader_t *reader, os_fs_filestream_t out, size_t len);
+bool         tar_extract(const char *dst, FILE *stream, tar_opts_t *opts);
+
+void tar_writer_init(tar_writer_t *writer, FILE *stream);
+bool tar_write_dir(tar_writer_t *writer, const char *path, unsigned int mode);
+bool tar_write_symlink(tar_writer_t *writer,
+                       const char   *path,
+                       const char   *target);
+bool tar_write_data(tar_writer_t *writer,
+                    const char   *path,
+                    unsigned int  mode,
+                    const void   *data,
+                    size_t        len);
+bool tar_write_file(tar_writer_t *writer, const char *path, const char *src);
+bool tar_write_tree(tar_writer_t *writer, const char *path, const char *src);
+bool tar_write_end(tar_writer_t *writer);
@@ -0,0 +1,40 @@
+/*************************************************************************
+| tarman                                                                 |
+| Copyright (C) 2024 Alessandro Salerno                                  |
+|                                                                        |
+| This program is free software: you can redistribute it and/or modify   |
+| it under the terms of the GNU General Public License as published by   |
+| the Free Software Foundation, either version 3 of the License, or      |
+| (at your option) any later version.                                    |
+|                                                                        |
+| This program is distributed in the hope that it will be useful,        |
+| but WITHOUT ANY WARRANTY; without even the implied warranty of         |
+| MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the          |
+| GNU General Public License for more details.                           |
+|                                                                        |
+| You should have received a copy of the GNU General Public License      |
+| along with this program.  If not, see <https://www.gnu.org/licenses/>. |
+*************************************************************************/
+
+
+#pragma once
+
+#include <stdbool.h>
+#include <stdlib.h>
+
+// Throttled transfers wait until at least this many bytes (or the whole
+// burst, if smaller) can go through, rather than moving a few at a time
+#define TM_THROTTLE_MIN_CHUNK (16 * 1024)
+
+// Token bucket holding up to one second worth of bytes
+typedef struct {
+  size_t rate; // Bytes per second, 0 means no limit
+  size_t tokens;
+  size_t last_refill; // os_thread_clock() at the time of the last refill
+} throttle_t;
+
+void   throttle_init(throttle_t *throttle, size_t rate);
+size_t throttle_available(throttle_t *throttle);
+void   throttle_consume(throttle_t *throttle, size_t len);
+size_t throttle_delay(throttle_t *throttle);
+void   throttle_wait(throttle_t *throttle, size_t len);
@@ -0,0 +1,40 @@
+/*************************************************************************
+| tarman                                                                 |
+| Copyright (C) 2024 Alessandro Salerno                                  |
+|                                                                        |
+| This program is free software: you can redistribute it and/or modify   |
+| it under the terms of the GNU General Public License as published by   |
+| the Free Software Foundation, either version 3 of the License, or      |
+| (at your option) any later version.                                    |
+|                                                                        |
+| This program is distributed in the hope that it will be useful,        |
+| but WITHOUT ANY WARRANTY; without even the implied warranty of         |
+| MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the          |
+| GNU General Public License for more details.                           |
+|                                                                        |
+| You should have received a copy of the GNU General Public License      |
+| along with this program.  If not, see <https://www.gnu.org/licenses/>. |
+*************************************************************************/
+
+
+#pragma once
+
+#include <stdbool.h>
+
+#include "os/fs.h"
+
+// Every command holds the registry lock, shared unless it changes things
+// that other commands read without a package lock (e.g., repositories).
+// Commands that work on a single package then hold its lock as well,
+// always after the registry one
+typedef struct {
+  os_fs_filestream_t stream;
+  bool               held;
+} util_lock_t;
+
+bool util_lock_registry(util_lock_t *lock, bool exclusive, bool log);
+bool util_lock_pkg(util_lock_t *lock,
+                   const char  *pkg_name,
+                   bool         exclusive,
+                   bool         log);
+void util_lock_release(util_lock_t *lock);
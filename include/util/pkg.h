@@ -19,6 +19,7 @@
 #pragma once
 
 #include <stdbool.h>
+#include <stdlib.h>
 
 #include "package.h"
 
@@ -28,13 +29,32 @@
 #define INPUT_ON  true
 #define INPUT_OFF false
 
+// Number of versions of each package kept on disk, including the active one
+#define TM_PKG_KEPT_VERSIONS 3
+
 bool util_pkg_fetch_archive(char      **dst_file,
                             const char *pkg_name,
-                            const char *pkg_fmt,
-                            const char *url,
+                            recipe_t   *recipe,
+                            bool        log);
+bool util_pkg_fetch_update(char      **dst_file,
+                           const char *pkg_name,
+                           recipe_t   *recipe,
+                           bool        log);
+bool util_pkg_has_hash(recipe_t recipe);
+bool util_pkg_check_hash(const char *archive_path, recipe_t recipe, bool log);
+void util_pkg_dyfetched(char **dst, recipe_t recipe);
+void util_pkg_dyfetched_name(char **dst, recipe_t recipe);
+bool util_pkg_store_fetched(const char *archive_path,
+                            const char *pkg_name,
+                            recipe_t    recipe,
                             bool        log);
+void util_pkg_keep_archive(const char *archive_path,
+                           const char *pkg_name,
+                           recipe_t    recipe,
+                           bool        log);
 bool util_pkg_create_directory_from_path(const char *path, bool log, bool in);
 bool util_pkg_create_directory(char      **path,
+                               size_t     *version,
                                const char *pkg_name,
                                bool        log,
                                bool        in);
@@ -59,3 +79,15 @@ bool util_pkg_load_recipe(recipe_t   *recipe,
                           const char *repo,
                           const char *rcp_name,
                           bool        log);
+bool util_pkg_create_manifest(const char *pkg_path, bool log);
+bool util_pkg_list_versions(size_t    **versions,
+                            size_t     *count,
+                            size_t     *current,
+                            const char *pkg_name);
+bool util_pkg_create_version(char      **ver_path,
+                             size_t     *version,
+                             const char *pkg_name,
+                             bool        log);
+bool util_pkg_activate_version(const char *pkg_name,
+                               size_t      version,
+                               bool        log);
@@ -0,0 +1,50 @@
+/*************************************************************************
+| tarman                                                                 |
+| Copyright (C) 2024 Alessandro Salerno                                  |
+|                                                                        |
+| This program is free software: you can redistribute it and/or modify   |
+| it under the terms of the GNU General Public License as published by   |
+| the Free Software Foundation, either version 3 of the License, or      |
+| (at your option) any later version.                                    |
+|                                                                        |
+| This program is distributed in the hope that it will be useful,        |
+| but WITHOUT ANY WARRANTY; without even the implied warranty of         |
+| MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the          |
+| GNU General Public License for more details.                           |
+|                                                                        |
+| You should have received a copy of the GNU General Public License      |
+| along with this program.  If not, see <https://www.gnu.org/licenses/>. |
+*************************************************************************/
+
+#pragma once
+
+#include <stdbool.h>
+#include <stdlib.h>
+
+#include "os/fs.h"
+
+// Decides whether a non-directory entry is part of the results
+// `full_path` can be used to inspect the file, `rel_path` is relative to
+// the root of the walk and is what ends up in the results
+typedef bool (*walk_filter_t)(const char *full_path,
+                              const char *rel_path,
+                              fs_dirent_t ent,
+                              void       *ctx);
+
+typedef struct {
+  const char  **prune;       // Names of directories that are never entered
+  size_t        num_prune;   // Number of elements in `prune`
+  size_t        max_depth;   // Maximum directory depth, 0 means unlimited
+  size_t        max_results; // Stop after this many results, 0 means unlimited
+  walk_filter_t filter;      // NULL accepts all non-directory entries
+  void         *ctx;         // Passed to `filter`
+} walk_opts_t;
+
+bool walk_dytree(char     ***results,
+                 size_t     *count,
+                 const char *base_path,
+                 walk_opts_t opts);
+void walk_free(char **results, size_t count);
+
+// Number of directories above a relative path
+size_t walk_path_depth(const char *path);
@@ -23,21 +23,27 @@
 #include <string.h>
 
 #include "archive.h"
+#include "magic.h"
 #include "os/exec.h"
 #include "os/fs.h"
 #include "plugin/plugin.h"
+#include "pool.h"
+#include "settings.h"
+#include "tar.h"
 #include "tm-mem.h"
 
-typedef bool (*extract_handler_t)(const char *dst, const char *src);
-
 typedef struct {
-  const char       *file_type;
-  extract_handler_t handler;
+  const char    *file_type;
+  archive_comp_t compression;
 } embedded_extract_t;
 
-static embedded_extract_t extractLookup[] = {{"tar", archive_tar_extract},
-                                             {"tar.gz", archive_tar_extract},
-                                             {"tar.xz", archive_tar_extract}};
+static embedded_extract_t extractLookup[] = {
+    {"tar", TM_ARCHIVE_COMP_NONE},
+    {"tar.gz", TM_ARCHIVE_COMP_GZIP},
+    {"tar.xz", TM_ARCHIVE_COMP_XZ},
+    {"tar.zst", TM_ARCHIVE_COMP_ZSTD},
+    {"tar.zstd", TM_ARCHIVE_COMP_ZSTD},
+    {"tar.bz2", TM_ARCHIVE_COMP_BZIP2}};
 
 static int
 extcmp(const char *src, const char *ft, size_t src_tail, size_t ft_tail) {
@@ -50,22 +56,120 @@ extcmp(const char *src, const char *ft, size_t src_tail, size_t ft_tail) {
   return 0;
 }
 
+// Decompression is delegated to external tools, preferring those that can
+// work on independent blocks (BGZF members, xz blocks, zstd frames) in
+// parallel. Their output is read in order by the native tar extractor
+static bool spawn_decompressor(os_proc_t     *proc,
+                               FILE         **out,
+                               const char    *src,
+                               archive_comp_t comp) {
+  char threads[32];
+  snprintf(threads, sizeof threads, "%zu", pool_size());
+
+  switch (comp) {
+  case TM_ARCHIVE_COMP_GZIP:
+    if (os_exec_exists("bgzip")) {
+      return os_exec_pipe(
+          proc, out, "bgzip", "-d", "-c", "-@", threads, src, NULL);
+    }
+    if (os_exec_exists("pigz")) {
+      return os_exec_pipe(proc, out, "pigz", "-d", "-c", src, NULL);
+    }
+    return os_exec_exists("gzip") &&
+           os_exec_pipe(proc, out, "gzip", "-d", "-c", src, NULL);
+
+  case TM_ARCHIVE_COMP_XZ:
+    return os_exec_exists("xz") &&
+           os_exec_pipe(proc, out, "xz", "-d", "-c", "-T", threads, src, NULL);
+
+  case TM_ARCHIVE_COMP_ZSTD:
+    if (os_exec_exists("pzstd")) {
+      return os_exec_pipe(
+          proc, out, "pzstd", "-d", "-c", "-p", threads, src, NULL);
+    }
+    return os_exec_exists("zstd") &&
+           os_exec_pipe(proc, out, "zstd", "-d", "-c", src, NULL);
+
+  case TM_ARCHIVE_COMP_BZIP2:
+    if (os_exec_exists("lbzip2")) {
+      return os_exec_pipe(
+          proc, out, "lbzip2", "-d", "-c", "-n", threads, src, NULL);
+    }
+    return os_exec_exists("bzip2") &&
+           os_exec_pipe(proc, out, "bzip2", "-d", "-c", src, NULL);
+
+  default:
+    return false;
+  }
+}
+
+// Reads what is left after the end of the archive (i.e., record padding)
+// so that the decompressor can exit normally and report its own errors
+static void drain(FILE *stream) {
+  unsigned char buf[TM_TAR_BLOCK_LEN * 8];
+  while (0 != fread(buf, 1, sizeof buf, stream))
+    ;
+}
+
+static bool embedded_extract(const char    *dst,
+                             const char    *src,
+                             archive_comp_t comp,
+                             tar_opts_t    *opts) {
+  // The system's tar is still used as a fallback when the right
+  // decompressor is not available or the archive uses unsupported features
+  return archive_tar_native_extract(dst, src, comp, opts) ||
+         archive_tar_extract(dst, src);
+}
+
 bool archive_tar_extract(const char *dst, const char *src) {
   return EXIT_SUCCESS == os_exec("tar", "-xf", src, "-C", dst, NULL);
 }
 
-bool archive_extract(const char *dst, const char *src, const char *file_type) {
-  if (NULL != file_type) {
-    if (plugin_exists(file_type)) {
-      return EXIT_SUCCESS == plugin_run(file_type, dst, src);
+bool archive_tar_native_extract(const char    *dst,
+                                const char    *src,
+                                archive_comp_t comp,
+                                tar_opts_t    *opts) {
+  FILE      *stream   = NULL;
+  tar_opts_t defaults = {0};
+  os_proc_t  proc;
+  bool       ret = false;
+
+  if (NULL == opts) {
+    opts = &defaults;
+  }
+
+  opts->write_rate = settings_get()->extract_rate;
+
+  if (TM_ARCHIVE_COMP_NONE == comp) {
+    if (NULL == (stream = fopen(src, "rb"))) {
+      return false;
     }
 
-    goto search_embedded;
+    ret = tar_extract(dst, stream, opts);
+    fclose(stream);
+    return ret && TM_FS_FILEOP_STATUS_OK == os_fs_sync(dst);
   }
 
-  // If no file type has been set
-  // Try to find plugin based on file extension
-  // This loop is set up to avoid issues with multiple dots
+  if (!spawn_decompressor(&proc, &stream, src, comp)) {
+    return false;
+  }
+
+  if ((ret = tar_extract(dst, stream, opts))) {
+    drain(stream);
+  }
+
+  fclose(stream);
+
+  // Files are not flushed one by one as they are written. The whole file
+  // system is flushed once instead, when everything is in place
+  return EXIT_SUCCESS == os_exec_wait(proc) && ret &&
+         TM_FS_FILEOP_STATUS_OK == os_fs_sync(dst);
+}
+
+// Looks for a plugin based on file extension
+// This loop is set up to avoid issues with multiple dots
+// Plugins are listed once, so this does not touch the file system
+static const char *find_plugin(const char *src) {
   for (const char *cp = src; *cp; cp++) {
     const char ch   = *cp;
     const char next = *(cp + 1);
@@ -75,37 +179,139 @@ bool archive_extract(const char *dst, const char *src, const char *file_type) {
     // alongside cases in which it is used for directories
     // and finally, cases in which the plugin does not exist
     if ('.' == ch && 0 != next && isalnum(next) && plugin_exists(cp + 1)) {
-      return EXIT_SUCCESS == plugin_run(cp + 1, dst, src);
+      return cp + 1;
     }
   }
 
-search_embedded:
-  // If no plugin was found, this searches for
-  // embedded implementations
+  return NULL;
+}
+
+static const embedded_extract_t *find_embedded(const char *src,
+                                               const char *file_type) {
   for (size_t i = 0; i < sizeof extractLookup / sizeof(embedded_extract_t);
        i++) {
-    embedded_extract_t extractor = extractLookup[i];
+    const embedded_extract_t *extractor = &extractLookup[i];
 
     if (NULL != file_type) {
-      if (0 == strcmp(extractor.file_type, file_type)) {
-        return extractor.handler(dst, src);
+      if (0 == strcmp(extractor->file_type, file_type)) {
+        return extractor;
       }
       continue;
     }
 
     size_t src_len  = strlen(src);
     size_t src_tail = src_len - 1;
-    size_t ft_len   = strlen(extractor.file_type);
+    size_t ft_len   = strlen(extractor->file_type);
     size_t ft_tail  = ft_len - 1;
 
     if (src_len < ft_len) {
       continue;
     }
 
-    if (0 == extcmp(src, extractor.file_type, src_tail, ft_tail)) {
-      return extractor.handler(dst, src);
+    if (0 == extcmp(src, extractor->file_type, src_tail, ft_tail)) {
+      return extractor;
     }
   }
 
-  return false;
+  return NULL;
+}
+
+// The contents of the archive take precedence over its name, which may be
+// wrong or meaningless (e.g., for URLs without an extension). Formats with
+// no magic number (e.g., old tar archives) are still found by name
+static bool find_compression(archive_comp_t *comp,
+                             magic_archive_t magic,
+                             const char     *src,
+                             const char     *file_type) {
+  const embedded_extract_t *extractor = NULL;
+
+  switch (magic) {
+  case TM_MAGIC_ARCHIVE_TAR:
+    *comp = TM_ARCHIVE_COMP_NONE;
+    return true;
+  case TM_MAGIC_ARCHIVE_GZIP:
+    *comp = TM_ARCHIVE_COMP_GZIP;
+    return true;
+  case TM_MAGIC_ARCHIVE_XZ:
+    *comp = TM_ARCHIVE_COMP_XZ;
+    return true;
+  case TM_MAGIC_ARCHIVE_ZSTD:
+    *comp = TM_ARCHIVE_COMP_ZSTD;
+    return true;
+  case TM_MAGIC_ARCHIVE_BZIP2:
+    *comp = TM_ARCHIVE_COMP_BZIP2;
+    return true;
+  case TM_MAGIC_ARCHIVE_ZIP:
+    return false;
+  default:
+    break;
+  }
+
+  if (NULL == (extractor = find_embedded(src, file_type))) {
+    return false;
+  }
+
+  *comp = extractor->compression;
+  return true;
+}
+
+bool archive_extract(const char *dst,
+                     const char *src,
+                     const char *file_type,
+                     tar_opts_t *opts) {
+  const char     *plugin = file_type;
+  magic_archive_t magic  = TM_MAGIC_ARCHIVE_NONE;
+  archive_comp_t  comp   = TM_ARCHIVE_COMP_NONE;
+
+  // Plugins and decompressors inherit the priority
+  if (settings_get()->idle_priority) {
+    os_exec_idle_priority();
+  }
+
+  // If no file type has been set
+  // Try to find plugin based on file extension
+  if (NULL == plugin) {
+    plugin = find_plugin(src);
+  }
+
+  if (NULL != plugin && plugin_exists(plugin)) {
+    return EXIT_SUCCESS == plugin_run(plugin, dst, src);
+  }
+
+  magic = magic_archive_fdetect(src);
+
+  if (TM_MAGIC_ARCHIVE_ZIP == magic && plugin_exists("zip")) {
+    return EXIT_SUCCESS == plugin_run("zip", dst, src);
+  }
+
+  // If no plugin was found, this searches for
+  // embedded implementations
+  if (!find_compression(&comp, magic, src, file_type)) {
+    return false;
+  }
+
+  return embedded_extract(dst, src, comp, opts);
+}
+
+bool archive_update(const char *dst,
+                    const char *src,
+                    const char *file_type,
+                    tar_opts_t *opts) {
+  archive_comp_t comp = TM_ARCHIVE_COMP_NONE;
+
+  if (settings_get()->idle_priority) {
+    os_exec_idle_priority();
+  }
+
+  // Plugins can only extract into an empty directory
+  if ((NULL != file_type && plugin_exists(file_type)) ||
+      (NULL == file_type && NULL != find_plugin(src))) {
+    return false;
+  }
+
+  if (!find_compression(&comp, magic_archive_fdetect(src), src, file_type)) {
+    return false;
+  }
+
+  return archive_tar_native_extract(dst, src, comp, opts);
 }
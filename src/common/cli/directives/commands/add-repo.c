@@ -16,72 +16,51 @@
 | along with this program.  If not, see <https://www.gnu.org/licenses/>. |
 *************************************************************************/
 
-#include <stdio.h>
+#include <stdbool.h>
 #include <stdlib.h>
-#include <string.h>
 
-#include "archive.h"
 #include "cli/directives/commands.h"
 #include "cli/output.h"
-#include "download.h"
 #include "os/fs.h"
-#include "tm-mem.h"
-#include "util/misc.h"
+#include "util/lock.h"
+#include "util/pkg.h"
+#include "util/repo.h"
 
 int cli_cmd_add_repo(cli_info_t info) {
   if (NULL == info.input) {
-    cli_out_error("Must specify a package to install'");
+    cli_out_error("Must specify a repository to add");
     return EXIT_FAILURE;
   }
 
-  char       *archive_path = NULL;
-  const char *repo_url     = info.input;
-  const char *repo_fmt     = info.pkg_fmt;
-  const char *repos_path   = NULL;
-  int         ret          = EXIT_FAILURE;
+  const char *repo_url = info.input;
+  const char *repo_fmt = info.pkg_fmt;
 
   cli_out_progress("Initializing host file system");
 
   if (!os_fs_tm_init()) {
     cli_out_progress("Failed to inizialize host file system");
-    goto cleanup;
+    return EXIT_FAILURE;
   }
 
-  os_fs_tm_dyrepos((char **)&repos_path);
-
   if (NULL == repo_fmt) {
     cli_out_warning("Repository format not specified, using 'tar.gz'");
     repo_fmt = "tar.gz";
   }
 
-  util_misc_dytmpfile(&archive_path, "__downloaded_repo", repo_fmt);
-  cli_out_progress("Fetching repository from '%s'", repo_url);
-
-  if (!download(archive_path, repo_url)) {
-    cli_out_error("Unable to download package");
-    goto cleanup;
-  }
-
-  cli_out_progress("Extracting repository files");
+  util_lock_t registry = {0};
 
-  if (!archive_extract(repos_path, archive_path, NULL)) {
-    cli_out_error("Unable to extract archive. You may be missing the plugin "
-                  "for this archive type");
-    goto cleanup;
+  if (!util_lock_registry(&registry, true, LOG_ON)) {
+    return EXIT_FAILURE;
   }
 
-  cli_out_progress("Removing cache '%s'", archive_path);
+  repo_source_t src = {.url = repo_url, .package_format = repo_fmt};
+  bool          ok  = util_repo_fetch_archive(src, LOG_ON);
+  util_lock_release(&registry);
 
-  if (TM_FS_FILEOP_STATUS_OK != os_fs_file_rm(archive_path)) {
-    cli_out_warning("Unable to delete cache");
+  if (!ok) {
+    return EXIT_FAILURE;
   }
 
   cli_out_success("Repository added successfully");
-
-  ret = EXIT_SUCCESS;
-
-cleanup:
-  mem_safe_free(archive_path);
-  mem_safe_free(repos_path);
-  return ret;
+  return EXIT_SUCCESS;
 }
@@ -0,0 +1,342 @@
+/*************************************************************************
+| tarman                                                                 |
+| Copyright (C) 2024 Alessandro Salerno                                  |
+|                                                                        |
+| This program is free software: you can redistribute it and/or modify   |
+| it under the terms of the GNU General Public License as published by   |
+| the Free Software Foundation, either version 3 of the License, or      |
+| (at your option) any later version.                                    |
+|                                                                        |
+| This program is distributed in the hope that it will be useful,        |
+| but WITHOUT ANY WARRANTY; without even the implied warranty of         |
+| MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the          |
+| GNU General Public License for more details.                           |
+|                                                                        |
+| You should have received a copy of the GNU General Public License      |
+| along with this program.  If not, see <https://www.gnu.org/licenses/>. |
+*************************************************************************/
+
+
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "cli/directives/commands.h"
+#include "cli/directives/types.h"
+#include "cli/input.h"
+#include "cli/output.h"
+#include "cli/parser.h"
+#include "download.h"
+#include "os/fs.h"
+#include "pool.h"
+#include "stream.h"
+#include "tm-mem.h"
+
+typedef struct {
+  size_t     line;
+  int        argc;
+  char     **argv;
+  char      *buf;
+  cli_info_t info;
+  cli_exec_t handler;
+} batch_cmd_t;
+
+typedef struct {
+  const batch_cmd_t *cmds;
+  bool               ok;
+} batch_group_t;
+
+// Splits a line in place. Arguments are separated by blanks and may be
+// quoted, '#' starts a comment. argv[0] is reserved for the program name
+static bool tokenize(batch_cmd_t *cmd, char *line) {
+  size_t cap   = 8;
+  char  *write = line;
+  cmd->argv    = (char **)malloc(cap * sizeof(char *));
+  mem_chkoom(cmd->argv);
+  cmd->argv[0] = "tarman";
+  cmd->argc    = 1;
+
+  for (char *read = line; 0 != *read;) {
+    if (' ' == *read || '\t' == *read) {
+      read++;
+      continue;
+    }
+
+    if ('#' == *read) {
+      break;
+    }
+
+    if ((size_t)cmd->argc + 1 == cap) {
+      cap *= 2;
+      cmd->argv = (char **)realloc(cmd->argv, cap * sizeof(char *));
+      mem_chkoom(cmd->argv);
+    }
+
+    cmd->argv[cmd->argc++] = write;
+    char quote             = 0;
+
+    for (; 0 != *read; read++) {
+      if (0 == quote && (' ' == *read || '\t' == *read)) {
+        break;
+      }
+
+      if (0 == quote && ('\'' == *read || '"' == *read)) {
+        quote = *read;
+        continue;
+      }
+
+      if (0 != quote && quote == *read) {
+        quote = 0;
+        continue;
+      }
+
+      *write++ = *read;
+    }
+
+    if (0 != quote) {
+      return false;
+    }
+
+    // The separator (if any) has already been read, so the terminator can
+    // safely overwrite it
+    if (0 != *read) {
+      read++;
+    }
+
+    *write++ = 0;
+  }
+
+  cmd->argv[cmd->argc] = NULL;
+
+  // Lines copied from shell scripts may still name the program
+  if (1 < cmd->argc && 0 == strcmp("tarman", cmd->argv[1])) {
+    memmove(&cmd->argv[1], &cmd->argv[2], (cmd->argc - 1) * sizeof(char *));
+    cmd->argc--;
+  }
+
+  return true;
+}
+
+static bool parse_cmd(batch_cmd_t *cmd) {
+  char line_buf[32];
+  snprintf(line_buf, sizeof line_buf, "%zu", cmd->line);
+
+  if (!tokenize(cmd, cmd->buf)) {
+    cli_out_error("Unterminated quote on line %s", line_buf);
+    return false;
+  }
+
+  if (2 > cmd->argc) {
+    return true;
+  }
+
+  if (0 == strcmp(TARMAN_CMD_BATCH, cmd->argv[1])) {
+    cli_out_error("Command '%s' on line %s cannot be used in a batch",
+                  cmd->argv[1],
+                  line_buf);
+    return false;
+  }
+
+  if (!cli_parse(cmd->argc, cmd->argv, &cmd->info, &cmd->handler)) {
+    cli_out_error("Invalid command on line %s", line_buf);
+    return false;
+  }
+
+  return true;
+}
+
+static void free_cmds(batch_cmd_t *cmds, size_t count) {
+  for (size_t i = 0; i < count; i++) {
+    mem_safe_free(cmds[i].argv);
+    mem_safe_free(cmds[i].buf);
+    mem_safe_free(cmds[i].info.inputs);
+  }
+
+  mem_safe_free(cmds);
+}
+
+// The whole script is parsed before anything is run, so that a typo on
+// the last line does not leave the system half-provisioned
+static bool load_cmds(batch_cmd_t **dst, size_t *count, FILE *stream) {
+  size_t       cap  = 16;
+  size_t       num  = 0;
+  batch_cmd_t *cmds = (batch_cmd_t *)malloc(cap * sizeof(batch_cmd_t));
+  mem_chkoom(cmds);
+
+  for (size_t line = 1; !feof(stream); line++) {
+    char *buf = NULL;
+
+    if (0 == stream_dyreadline(stream, &buf)) {
+      continue;
+    }
+
+    if (num == cap) {
+      cap *= 2;
+      cmds = (batch_cmd_t *)realloc(cmds, cap * sizeof(batch_cmd_t));
+      mem_chkoom(cmds);
+    }
+
+    batch_cmd_t *cmd = &cmds[num++];
+    *cmd             = (batch_cmd_t){.line = line, .buf = buf};
+
+    if (!parse_cmd(cmd)) {
+      free_cmds(cmds, num);
+      return false;
+    }
+
+    // Blank and comment-only lines
+    if (2 > cmd->argc) {
+      mem_safe_free(cmd->argv);
+      mem_safe_free(cmd->buf);
+      num--;
+    }
+  }
+
+  *dst   = cmds;
+  *count = num;
+  return true;
+}
+
+// Only commands that never prompt and touch a single, named package can
+// run alongside each other: package locks keep them from conflicting
+static bool can_pipeline(const batch_cmd_t *cmd) {
+  return (cli_cmd_update == cmd->handler || cli_cmd_verify == cmd->handler) &&
+         NULL != cmd->info.input && !cmd->info.all;
+}
+
+static size_t find_group_end(const batch_cmd_t *cmds,
+                             size_t             count,
+                             size_t             start) {
+  if (!can_pipeline(&cmds[start])) {
+    return start + 1;
+  }
+
+  size_t end = start + 1;
+
+  for (; end < count && can_pipeline(&cmds[end]); end++) {
+    for (size_t i = start; i < end; i++) {
+      if (0 == strcmp(cmds[i].info.input, cmds[end].info.input)) {
+        return end;
+      }
+    }
+  }
+
+  return end;
+}
+
+static int run_inline(const batch_cmd_t *cmd) {
+  if (NULL == cmd->handler) {
+    return cli_cmd_help(cmd->info);
+  }
+
+  cli_in_set_headless(cmd->info.headless);
+  download_set_offline(cmd->info.offline);
+  return cmd->handler(cmd->info);
+}
+
+static void report_failure(const batch_cmd_t *cmd) {
+  char line_buf[32];
+  snprintf(line_buf, sizeof line_buf, "%zu", cmd->line);
+  cli_out_error("Command on line %s failed", line_buf);
+}
+
+// Commands that could not be started in their own process are run here
+static void finish_cmd(size_t index, int status, void *ctx) {
+  batch_group_t     *group = (batch_group_t *)ctx;
+  const batch_cmd_t *cmd   = &group->cmds[index];
+
+  if (TM_POOL_NOT_STARTED == status) {
+    status = run_inline(cmd);
+  }
+
+  if (EXIT_SUCCESS != status) {
+    report_failure(cmd);
+    group->ok = false;
+  }
+}
+
+// Each command runs in its own process with its output captured, so that
+// output can be shown in script order once the command is done
+static bool run_group(const batch_cmd_t *cmds, size_t count) {
+  pool_proc_t  *procs = (pool_proc_t *)malloc(count * sizeof(pool_proc_t));
+  batch_group_t group = {.cmds = cmds, .ok = true};
+  mem_chkoom(procs);
+
+  for (size_t i = 0; i < count; i++) {
+    procs[i].argc = cmds[i].argc;
+    procs[i].argv = cmds[i].argv;
+  }
+
+  pool_run_procs(count, procs, cli_run, finish_cmd, &group);
+  mem_safe_free(procs);
+  return group.ok;
+}
+
+static bool run_cmds(const batch_cmd_t *cmds, size_t count) {
+  for (size_t i = 0; i < count;) {
+    size_t end = find_group_end(cmds, count, i);
+
+    if (1 < end - i) {
+      if (!run_group(&cmds[i], end - i)) {
+        return false;
+      }
+
+      i = end;
+      continue;
+    }
+
+    if (EXIT_SUCCESS != run_inline(&cmds[i])) {
+      report_failure(&cmds[i]);
+      return false;
+    }
+
+    i++;
+  }
+
+  return true;
+}
+
+int cli_cmd_batch(cli_info_t info) {
+  FILE        *script = stdin;
+  batch_cmd_t *cmds   = NULL;
+  size_t       count  = 0;
+  int          ret    = EXIT_FAILURE;
+
+  if (NULL != info.input) {
+    script = fopen(info.input, "r");
+
+    if (NULL == script) {
+      cli_out_error("Unable to open batch script '%s'", info.input);
+      return EXIT_FAILURE;
+    }
+  }
+
+  bool loaded = load_cmds(&cmds, &count, script);
+
+  if (stdin != script) {
+    fclose(script);
+  }
+
+  if (!loaded) {
+    return EXIT_FAILURE;
+  }
+
+  if (!os_fs_tm_init()) {
+    cli_out_error("Failed to inizialize host file system");
+    goto cleanup;
+  }
+
+  if (!run_cmds(cmds, count)) {
+    goto cleanup;
+  }
+
+  char count_buf[32];
+  snprintf(count_buf, sizeof count_buf, "%zu", count);
+  cli_out_success("Batch completed, %s command(s) run", count_buf);
+  ret = EXIT_SUCCESS;
+
+cleanup:
+  free_cmds(cmds, count);
+  return ret;
+}
@@ -0,0 +1,633 @@
+/*************************************************************************
+| tarman                                                                 |
+| Copyright (C) 2024 Alessandro Salerno                                  |
+|                                                                        |
+| This program is free software: you can redistribute it and/or modify   |
+| it under the terms of the GNU General Public License as published by   |
+| the Free Software Foundation, either version 3 of the License, or      |
+| (at your option) any later version.                                    |
+|                                                                        |
+| This program is distributed in the hope that it will be useful,        |
+| but WITHOUT ANY WARRANTY; without even the implied warranty of         |
+| MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the          |
+| GNU General Public License for more details.                           |
+|                                                                        |
+| You should have received a copy of the GNU General Public License      |
+| along with this program.  If not, see <https://www.gnu.org/licenses/>. |
+*************************************************************************/
+
+
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "cli/directives/commands.h"
+#include "cli/directives/types.h"
+#include "cli/output.h"
+#include "config.h"
+#include "manifest.h"
+#include "os/console.h"
+#include "os/exec.h"
+#include "os/fs.h"
+#include "package.h"
+#include "pool.h"
+#include "settings.h"
+#include "tar.h"
+#include "tm-mem.h"
+#include "util/lock.h"
+#include "util/pkg.h"
+
+// A bundle is a compressed tar stream. Its first entry is the index, which
+// lists the packages it contains, followed by the active version of each of
+// them under pkgs/<pkg name>, recipe artifact and manifest included
+#define BUNDLE_INDEX_FILE "index.tarman"
+#define BUNDLE_FORMAT     "1"
+#define BUNDLE_PKGS_DIR   "pkgs"
+
+typedef struct {
+  char **names;
+  size_t count;
+  size_t cap;
+} bundle_list_t;
+
+typedef struct {
+  bool           format_set;
+  bool           bad_name;
+  bundle_list_t *pkgs;
+} bundle_index_t;
+
+typedef struct {
+  const char   *staging;
+  bundle_list_t list;
+  bool         *ok;
+} import_ctx_t;
+
+static bool has_pkg(const bundle_list_t *list, const char *name) {
+  for (size_t i = 0; i < list->count; i++) {
+    if (0 == strcmp(list->names[i], name)) {
+      return true;
+    }
+  }
+
+  return false;
+}
+
+static void add_pkg(bundle_list_t *list, const char *name) {
+  if (list->count == list->cap) {
+    list->cap   = (0 == list->cap) ? 8 : list->cap * 2;
+    list->names = (char **)realloc(list->names, list->cap * sizeof(char *));
+    mem_chkoom(list->names);
+  }
+
+  char *copy = (char *)malloc(strlen(name) + 1);
+  mem_chkoom(copy);
+  strcpy(copy, name);
+  list->names[list->count++] = copy;
+}
+
+static void free_list(bundle_list_t list) {
+  for (size_t i = 0; i < list.count; i++) {
+    mem_safe_free(list.names[i]);
+  }
+
+  mem_safe_free(list.names);
+}
+
+// Names end up in paths, so they must not be able to escape the package
+// directory
+static bool valid_name(const char *name) {
+  return '\0' != name[0] && NULL == strchr(name, '/') &&
+         NULL == strchr(name, '\\') && 0 != strcmp(name, ".") &&
+         0 != strcmp(name, "..");
+}
+
+static bool is_installed(const char *name) {
+  char         *pkg_path = NULL;
+  fs_filetype_t type;
+
+  os_fs_tm_dypkg(&pkg_path, name);
+  bool ret = TM_FS_FILEOP_STATUS_OK == os_fs_file_gettype(&type, pkg_path) &&
+             TM_FS_FILETYPE_DIR == type;
+  mem_safe_free(pkg_path);
+  return ret;
+}
+
+static bool parse_artifact(recipe_t *recipe, const char *pkg_path) {
+  char *artifact_path = NULL;
+  os_fs_path_dyconcat(&artifact_path, 2, pkg_path, "recipe.tarman");
+
+  bool ret = TM_CFG_PARSE_STATUS_OK == pkg_parse_tmrcp(recipe, artifact_path);
+  mem_safe_free(artifact_path);
+  return ret;
+}
+
+// Installed dependencies are exported too, otherwise the bundle could not
+// be imported on a machine that does not have them
+static bool collect_pkg(bundle_list_t *list, const char *name) {
+  char      *pkg_path = NULL;
+  recipe_t   recipe   = {0};
+  pkg_dep_t *deps     = NULL;
+  size_t     num_deps = 0;
+  bool       ret      = true;
+
+  if (has_pkg(list, name)) {
+    return true;
+  }
+
+  if (!valid_name(name) || !is_installed(name)) {
+    cli_out_error("Package '%s' is not installed", name);
+    return false;
+  }
+
+  add_pkg(list, name);
+  os_fs_tm_dypkg(&pkg_path, name);
+
+  if (!parse_artifact(&recipe, pkg_path) || NULL == recipe.depends) {
+    goto cleanup;
+  }
+
+  if (!pkg_parse_depends(&deps, &num_deps, recipe.depends)) {
+    cli_out_warning("Unable to parse dependencies of package '%s'", name);
+    goto cleanup;
+  }
+
+  for (size_t i = 0; i < num_deps && ret; i++) {
+    if (!is_installed(deps[i].name)) {
+      cli_out_warning("Dependency '%s' of package '%s' is not installed and "
+                      "will not be exported",
+                      deps[i].name,
+                      name);
+      continue;
+    }
+
+    ret = collect_pkg(list, deps[i].name);
+  }
+
+cleanup:
+  mem_safe_free(pkg_path);
+  pkg_free_depends(deps, num_deps);
+  pkg_free_rcp(recipe);
+  return ret;
+}
+
+static bool collect_all(bundle_list_t *list) {
+  char             *pkgs_path = NULL;
+  os_fs_dirstream_t stream;
+  fs_dirent_t       ent;
+
+  os_fs_tm_dypkgs(&pkgs_path);
+
+  if (TM_FS_DIROP_STATUS_OK != os_fs_dir_open(&stream, pkgs_path)) {
+    cli_out_error("Unable to access package directory '%s'", pkgs_path);
+    mem_safe_free(pkgs_path);
+    return false;
+  }
+
+  while (TM_FS_DIROP_STATUS_OK == os_fs_dir_next(stream, &ent)) {
+    if (TM_FS_FILETYPE_DIR == ent.file_type && is_installed(ent.name) &&
+        !has_pkg(list, ent.name)) {
+      add_pkg(list, ent.name);
+    }
+  }
+
+  os_fs_dir_close(stream);
+  mem_safe_free(pkgs_path);
+  return true;
+}
+
+static bool write_index(tar_writer_t *writer, bundle_list_t list) {
+  const char *header = "FORMAT=" BUNDLE_FORMAT "\n";
+  size_t      len    = strlen(header);
+
+  for (size_t i = 0; i < list.count; i++) {
+    len += strlen("PACKAGE=\n") + strlen(list.names[i]);
+  }
+
+  char *index = (char *)malloc(len + 1);
+  mem_chkoom(index);
+  strcpy(index, header);
+
+  for (size_t i = 0; i < list.count; i++) {
+    strcat(index, "PACKAGE=");
+    strcat(index, list.names[i]);
+    strcat(index, "\n");
+  }
+
+  bool ret = tar_write_data(writer, BUNDLE_INDEX_FILE, 0644, index, len);
+  mem_safe_free(index);
+  return ret;
+}
+
+static bool export_pkg(tar_writer_t *writer, const char *name) {
+  char       *pkg_path = NULL;
+  char       *dst_path = NULL;
+  util_lock_t pkg_lock = {0};
+
+  if (!util_lock_pkg(&pkg_lock, name, false, LOG_ON)) {
+    return false;
+  }
+
+  cli_out_progress("Exporting package '%s'", name);
+  os_fs_tm_dypkg(&pkg_path, name);
+  os_fs_path_dyconcat(&dst_path, 2, BUNDLE_PKGS_DIR, name);
+
+  bool ret = tar_write_tree(writer, dst_path, pkg_path);
+
+  if (!ret) {
+    cli_out_error("Unable to export package '%s'", name);
+  }
+
+  mem_safe_free(pkg_path);
+  mem_safe_free(dst_path);
+  util_lock_release(&pkg_lock);
+  return ret;
+}
+
+static bool spawn_compressor(os_proc_t *proc, FILE **in, FILE *out) {
+  if (os_exec_exists("pigz")) {
+    return os_exec_pipe_to(proc, in, out, "pigz", "-c", NULL);
+  }
+
+  return os_exec_exists("gzip") &&
+         os_exec_pipe_to(proc, in, out, "gzip", "-c", NULL);
+}
+
+static bool spawn_decompressor(os_proc_t *proc, FILE **out, FILE *in) {
+  if (os_exec_exists("pigz")) {
+    return os_exec_pipe_from(proc, out, in, "pigz", "-d", "-c", NULL);
+  }
+
+  return os_exec_exists("gzip") &&
+         os_exec_pipe_from(proc, out, in, "gzip", "-d", "-c", NULL);
+}
+
+// Writing to standard output keeps messages out of the bundle by sending
+// them to standard error instead
+static int export_bundle(cli_info_t info, const char *bundle_path) {
+  bundle_list_t list   = {0};
+  FILE         *out    = NULL;
+  FILE         *stream = NULL;
+  os_proc_t     proc;
+  tar_writer_t  writer;
+  bool          ok  = true;
+  int           ret = EXIT_FAILURE;
+
+  if (info.all) {
+    ok = collect_all(&list);
+  }
+
+  for (size_t i = 2; i < info.num_inputs && ok; i++) {
+    ok = collect_pkg(&list, info.inputs[i]);
+  }
+
+  if (!ok) {
+    goto cleanup;
+  }
+
+  if (0 == list.count) {
+    cli_out_error("There are no packages to export");
+    goto cleanup;
+  }
+
+  out = (0 == strcmp(bundle_path, "-")) ? os_console_detach_stdout()
+                                        : fopen(bundle_path, "wb");
+
+  if (NULL == out) {
+    cli_out_error("Unable to open bundle '%s' for writing", bundle_path);
+    goto cleanup;
+  }
+
+  if (!spawn_compressor(&proc, &stream, out)) {
+    cli_out_error("Unable to start compressor, install 'gzip' or 'pigz'");
+    goto cleanup;
+  }
+
+  tar_writer_init(&writer, stream);
+  ok = write_index(&writer, list);
+
+  for (size_t i = 0; i < list.count && ok; i++) {
+    ok = export_pkg(&writer, list.names[i]);
+  }
+
+  ok = ok && tar_write_end(&writer);
+  fclose(stream);
+
+  if (EXIT_SUCCESS != os_exec_wait(proc) || !ok) {
+    cli_out_error("Unable to write bundle '%s'", bundle_path);
+    goto cleanup;
+  }
+
+  char num_buf[32];
+  snprintf(num_buf, sizeof num_buf, "%zu", list.count);
+  cli_out_success("Exported %s package(s) to '%s'", num_buf, bundle_path);
+  ret = EXIT_SUCCESS;
+
+cleanup:
+  if (NULL != out) {
+    fclose(out);
+  }
+
+  free_list(list);
+  return ret;
+}
+
+static cfg_parse_status_t
+index_translator(const char *key, const char *value, bundle_index_t *index) {
+  const char *format = NULL;
+  const char *pkg    = NULL;
+
+  cfg_prop_match_t match =
+      cfg_eval_prop_matches(2,
+                            cfg_eval_prop("FORMAT", key, value, &format, 0),
+                            cfg_eval_prop("PACKAGE", key, value, &pkg, 0));
+
+  if (TM_CFG_PROP_MATCH_ERR == match) {
+    return TM_CFG_PARSE_STATUS_INVVAL;
+  }
+
+  if (NULL != format) {
+    index->format_set = 0 == strcmp(format, BUNDLE_FORMAT);
+  }
+
+  if (NULL != pkg && !valid_name(pkg)) {
+    index->bad_name = true;
+  } else if (NULL != pkg && !has_pkg(index->pkgs, pkg)) {
+    add_pkg(index->pkgs, pkg);
+  }
+
+  mem_safe_free(format);
+  mem_safe_free(pkg);
+  return TM_CFG_PARSE_STATUS_OK;
+}
+
+static bool read_index(bundle_list_t *list, const char *staging) {
+  char          *index_path = NULL;
+  bundle_index_t index      = {.pkgs = list};
+  bool           ret        = false;
+
+  os_fs_path_dyconcat(&index_path, 2, staging, BUNDLE_INDEX_FILE);
+  FILE *fp = fopen(index_path, "r");
+
+  if (NULL != fp) {
+    ret = TM_CFG_PARSE_STATUS_OK ==
+          cfg_parse(fp, (cfg_translator_t)index_translator, &index);
+    fclose(fp);
+  }
+
+  if (!ret || !index.format_set || index.bad_name) {
+    cli_out_error("The bundle has no valid index, it may have been created "
+                  "by a newer version of tarman");
+    ret = false;
+  }
+
+  mem_safe_free(index_path);
+  return ret;
+}
+
+static void drain(FILE *stream) {
+  unsigned char buf[TM_TAR_BLOCK_LEN * 8];
+  while (0 != fread(buf, 1, sizeof buf, stream))
+    ;
+}
+
+static bool unpack_bundle(const char *staging, FILE *in) {
+  FILE      *stream = NULL;
+  tar_opts_t opts   = {0};
+  os_proc_t  proc;
+
+  if (!spawn_decompressor(&proc, &stream, in)) {
+    cli_out_error("Unable to start decompressor, install 'gzip' or 'pigz'");
+    return false;
+  }
+
+  opts.write_rate = settings_get()->extract_rate;
+  bool ret        = tar_extract(staging, stream, &opts);
+
+  if (ret) {
+    drain(stream);
+  }
+
+  fclose(stream);
+  return EXIT_SUCCESS == os_exec_wait(proc) && ret &&
+         TM_FS_FILEOP_STATUS_OK == os_fs_sync(staging);
+}
+
+// Packages whose files do not match their own manifest were damaged on the
+// way and are not installed
+static bool check_staged(const char *src, bool *has_manifest) {
+  char              *manifest_path = NULL;
+  manifest_t         manifest      = {0};
+  manifest_status_t *statuses      = NULL;
+  bool               ret           = true;
+
+  os_fs_path_dyconcat(&manifest_path, 2, src, TM_MANIFEST_FILE);
+  *has_manifest = manifest_dyload(&manifest, manifest_path);
+
+  if (*has_manifest) {
+    statuses = (manifest_status_t *)malloc((manifest.count + 1) *
+                                           sizeof(manifest_status_t));
+    mem_chkoom(statuses);
+    manifest_check(statuses, manifest, src);
+
+    for (size_t i = 0; i < manifest.count && ret; i++) {
+      ret = TM_MANIFEST_STATUS_OK == statuses[i];
+    }
+  }
+
+  mem_safe_free(manifest_path);
+  mem_safe_free(statuses);
+  manifest_free(manifest);
+  return ret;
+}
+
+// Runs on the pool, so nothing is printed here
+static void import_job(size_t index, void *ctx) {
+  import_ctx_t *import       = (import_ctx_t *)ctx;
+  const char   *name         = import->list.names[index];
+  char         *src          = NULL;
+  char         *ver_path     = NULL;
+  size_t        version      = 0;
+  bool          has_manifest = false;
+  util_lock_t   pkg_lock     = {0};
+
+  import->ok[index] = false;
+  os_fs_path_dyconcat(&src, 3, import->staging, BUNDLE_PKGS_DIR, name);
+
+  if (!check_staged(src, &has_manifest) ||
+      !util_lock_pkg(&pkg_lock, name, true, LOG_QUIET)) {
+    goto cleanup;
+  }
+
+  if (!util_pkg_create_version(&ver_path, &version, name, LOG_QUIET)) {
+    goto cleanup;
+  }
+
+  // The staging directory is in the tarman directory, so this is a rename
+  if (TM_FS_DIROP_STATUS_OK != os_fs_dir_mv(ver_path, src)) {
+    os_fs_dir_rm(ver_path);
+    goto cleanup;
+  }
+
+  if (!has_manifest) {
+    util_pkg_create_manifest(ver_path, LOG_QUIET);
+  }
+
+  import->ok[index] = util_pkg_activate_version(name, version, LOG_QUIET);
+
+cleanup:
+  mem_safe_free(src);
+  mem_safe_free(ver_path);
+  util_lock_release(&pkg_lock);
+}
+
+static void add_integrations(const char *name) {
+  char    *pkg_path       = NULL;
+  char    *exec_full_path = NULL;
+  recipe_t recipe         = {0};
+
+  os_fs_tm_dypkg(&pkg_path, name);
+
+  if (!parse_artifact(&recipe, pkg_path) ||
+      NULL == recipe.pkg_info.executable_path) {
+    goto cleanup;
+  }
+
+  os_fs_path_dyconcat(
+      &exec_full_path, 2, pkg_path, recipe.pkg_info.executable_path);
+
+  if (recipe.add_to_path) {
+    util_pkg_add_to_path(exec_full_path, LOG_ON);
+  }
+
+  if (recipe.add_to_desktop) {
+    util_pkg_add_to_desktop(pkg_path,
+                            recipe.pkg_info.application_name,
+                            exec_full_path,
+                            recipe.pkg_info.working_directory,
+                            recipe.pkg_info.icon_path,
+                            LOG_ON);
+  }
+
+cleanup:
+  mem_safe_free(pkg_path);
+  mem_safe_free(exec_full_path);
+  pkg_free_rcp(recipe);
+}
+
+// The stream can only be read once and in order, so the bundle is unpacked
+// first. Packages are then installed in parallel
+static int import_bundle(const char *bundle_path) {
+  import_ctx_t ctx     = {0};
+  char        *staging = NULL;
+  FILE        *in      = NULL;
+  size_t       failed  = 0;
+  int          ret     = EXIT_FAILURE;
+
+  in = (0 == strcmp(bundle_path, "-")) ? stdin : fopen(bundle_path, "rb");
+
+  if (NULL == in) {
+    cli_out_error("Unable to open bundle '%s'", bundle_path);
+    return EXIT_FAILURE;
+  }
+
+  os_fs_tm_dytmpfile(&staging, "bundle", "d");
+  os_fs_file_rm(staging);
+
+  if (TM_FS_DIROP_STATUS_OK != os_fs_mkdir(staging)) {
+    cli_out_error("Unable to create directory in '%s'", staging);
+    goto cleanup;
+  }
+
+  cli_out_progress("Unpacking bundle '%s' to '%s'", bundle_path, staging);
+
+  if (!unpack_bundle(staging, in)) {
+    cli_out_error("Unable to unpack bundle '%s'", bundle_path);
+    goto cleanup;
+  }
+
+  if (!read_index(&ctx.list, staging)) {
+    goto cleanup;
+  }
+
+  char num_buf[32];
+  snprintf(num_buf, sizeof num_buf, "%zu", ctx.list.count);
+  cli_out_progress("Installing %s package(s)", num_buf);
+
+  ctx.staging = staging;
+  ctx.ok      = (bool *)malloc((ctx.list.count + 1) * sizeof(bool));
+  mem_chkoom(ctx.ok);
+  pool_run(ctx.list.count, import_job, &ctx);
+
+  // PATH and desktop entries are shared by all packages
+  for (size_t i = 0; i < ctx.list.count; i++) {
+    const char *name = ctx.list.names[i];
+
+    if (!ctx.ok[i]) {
+      cli_out_error("Unable to install package '%s' from the bundle", name);
+      failed++;
+      continue;
+    }
+
+    add_integrations(name);
+    cli_out_success("Package '%s' installed successfully", name);
+  }
+
+  if (0 != failed) {
+    snprintf(num_buf, sizeof num_buf, "%zu", failed);
+    cli_out_error("Unable to install %s package(s)", num_buf);
+    goto cleanup;
+  }
+
+  ret = EXIT_SUCCESS;
+
+cleanup:
+  if (stdin != in) {
+    fclose(in);
+  }
+
+  os_fs_dir_rm(staging);
+  mem_safe_free(staging);
+  mem_safe_free(ctx.ok);
+  free_list(ctx.list);
+  return ret;
+}
+
+int cli_cmd_bundle(cli_info_t info) {
+  if (2 > info.num_inputs ||
+      (0 != strcmp(info.inputs[0], "export") &&
+       0 != strcmp(info.inputs[0], "import"))) {
+    cli_out_error("Use 'tarman bundle export <file> <pkg name>...' or "
+                  "'tarman bundle import <file>', '-' stands for standard "
+                  "output or input");
+    return EXIT_FAILURE;
+  }
+
+  bool is_export = 0 == strcmp(info.inputs[0], "export");
+
+  if (is_export && 2 == info.num_inputs && !info.all) {
+    cli_out_error("You must specify the packages to export or use '--all'");
+    return EXIT_FAILURE;
+  }
+
+  if (!is_export && 2 < info.num_inputs) {
+    cli_out_error("Only one bundle can be imported at a time");
+    return EXIT_FAILURE;
+  }
+
+  if (!os_fs_tm_init()) {
+    cli_out_error("Failed to inizialize host file system");
+    return EXIT_FAILURE;
+  }
+
+  util_lock_t registry = {0};
+
+  if (!util_lock_registry(&registry, false, LOG_ON)) {
+    return EXIT_FAILURE;
+  }
+
+  int ret = is_export ? export_bundle(info, info.inputs[1])
+                      : import_bundle(info.inputs[1]);
+  util_lock_release(&registry);
+  return ret;
+}
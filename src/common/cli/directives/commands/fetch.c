@@ -0,0 +1,344 @@
+/*************************************************************************
+| tarman                                                                 |
+| Copyright (C) 2024 Alessandro Salerno                                  |
+|                                                                        |
+| This program is free software: you can redistribute it and/or modify   |
+| it under the terms of the GNU General Public License as published by   |
+| the Free Software Foundation, either version 3 of the License, or      |
+| (at your option) any later version.                                    |
+|                                                                        |
+| This program is distributed in the hope that it will be useful,        |
+| but WITHOUT ANY WARRANTY; without even the implied warranty of         |
+| MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the          |
+| GNU General Public License for more details.                           |
+|                                                                        |
+| You should have received a copy of the GNU General Public License      |
+| along with this program.  If not, see <https://www.gnu.org/licenses/>. |
+*************************************************************************/
+
+
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "cli/directives/commands.h"
+#include "cli/directives/types.h"
+#include "cli/output.h"
+#include "download.h"
+#include "mirror.h"
+#include "os/fs.h"
+#include "package.h"
+#include "peer.h"
+#include "resolve.h"
+#include "tm-mem.h"
+#include "util/misc.h"
+#include "util/pkg.h"
+#include "util/repo.h"
+
+typedef struct {
+  char    *name;
+  char    *repo;
+  recipe_t recipe;
+  char    *tmp_path;
+  bool     ok;
+} fetch_pkg_t;
+
+typedef struct {
+  fetch_pkg_t *pkgs;
+  size_t       count;
+  size_t       cap;
+} fetch_list_t;
+
+static char *dystrcpy(const char *src) {
+  char *dst = (char *)malloc(strlen(src) + 1);
+  mem_chkoom(dst);
+  strcpy(dst, src);
+  return dst;
+}
+
+static bool has_pkg(const fetch_list_t *list, const char *name) {
+  for (size_t i = 0; i < list->count; i++) {
+    if (0 == strcmp(list->pkgs[i].name, name)) {
+      return true;
+    }
+  }
+
+  return false;
+}
+
+// Takes ownership of repo
+static bool
+add_pkg(fetch_list_t *list, const char *name, char *repo, bool log) {
+  char    *rcp_path = NULL;
+  recipe_t recipe   = {0};
+
+  os_fs_tm_dyrecipe(&rcp_path, repo, name);
+
+  if (TM_CFG_PARSE_STATUS_OK != pkg_parse_tmrcp(&recipe, rcp_path)) {
+    if (log) {
+      cli_out_error("Unable to read recipe '%s'", rcp_path);
+    }
+    mem_safe_free(rcp_path);
+    mem_safe_free(repo);
+    return false;
+  }
+
+  if (list->count == list->cap) {
+    list->cap  = (0 == list->cap) ? 8 : list->cap * 2;
+    list->pkgs = (fetch_pkg_t *)realloc(list->pkgs,
+                                        list->cap * sizeof(fetch_pkg_t));
+    mem_chkoom(list->pkgs);
+  }
+
+  list->pkgs[list->count++] = (fetch_pkg_t){
+      .name = dystrcpy(name), .repo = repo, .recipe = recipe};
+  mem_safe_free(rcp_path);
+  return true;
+}
+
+// Dependencies that are not installed yet are fetched too, otherwise an
+// offline install of the package would stop at them
+static bool collect_pkg(fetch_list_t *list, const char *name) {
+  char           *repo  = NULL;
+  resolve_graph_t graph = {0};
+
+  if (has_pkg(list, name)) {
+    return true;
+  }
+
+  if (!util_repo_find_recipe(&repo, name)) {
+    cli_out_error("Package '%s' not found in local repositories", name);
+    return false;
+  }
+
+  if (!add_pkg(list, name, repo, LOG_ON)) {
+    return false;
+  }
+
+  const char *depends = list->pkgs[list->count - 1].recipe.depends;
+
+  if (NULL == depends) {
+    return true;
+  }
+
+  if (!resolve_dependencies(&graph, name, depends)) {
+    return false;
+  }
+
+  bool ret = true;
+
+  for (size_t i = 0; i < graph.count && ret; i++) {
+    resolve_node_t *node = &graph.nodes[i];
+
+    if (node->satisfied || has_pkg(list, node->name)) {
+      continue;
+    }
+
+    ret        = add_pkg(list, node->name, node->repo, LOG_ON);
+    node->repo = NULL;
+  }
+
+  resolve_free(&graph);
+  return ret;
+}
+
+// Archives named after their expected hash never change, those named after
+// their URL are downloaded again in case the server has a newer one
+static bool is_fetched(const fetch_pkg_t *pkg) {
+  char         *fetched_path = NULL;
+  fs_filetype_t type;
+
+  if (NULL == pkg->recipe.archive_sha256) {
+    return false;
+  }
+
+  util_pkg_dyfetched(&fetched_path, pkg->recipe);
+  bool ret =
+      TM_FS_FILEOP_STATUS_OK == os_fs_file_gettype(&type, fetched_path);
+  mem_safe_free(fetched_path);
+  return ret;
+}
+
+// Cache peers are asked first, for the archives that have a known hash. The
+// others, and those the peers did not have or had wrong, are then downloaded
+// together, and mirrors are only raced for those that could not be
+// downloaded from their primary URL
+static void download_pkgs(fetch_pkg_t **pending, size_t count) {
+  peer_item_t *from_peers =
+      (peer_item_t *)malloc((count + 1) * sizeof(peer_item_t));
+  download_item_t *items =
+      (download_item_t *)malloc((count + 1) * sizeof(download_item_t));
+  size_t num_peers = 0;
+  size_t num_items = 0;
+  mem_chkoom(from_peers);
+  mem_chkoom(items);
+
+  for (size_t i = 0; i < count; i++) {
+    fetch_pkg_t *pkg  = pending[i];
+    char        *name = NULL;
+    util_misc_dytmpfile(&pkg->tmp_path, pkg->name, pkg->recipe.package_format);
+
+    if (!util_pkg_has_hash(pkg->recipe)) {
+      continue;
+    }
+
+    util_pkg_dyfetched_name(&name, pkg->recipe);
+    from_peers[num_peers] = (peer_item_t){.dst = pkg->tmp_path, .name = name};
+    num_peers++;
+  }
+
+  peer_fetch_many(from_peers, num_peers);
+
+  for (size_t i = 0, j = 0; i < count; i++) {
+    fetch_pkg_t *pkg = pending[i];
+    pkg->ok          = false;
+
+    if (j < num_peers && pkg->tmp_path == from_peers[j].dst) {
+      pkg->ok = from_peers[j].ok &&
+                util_pkg_check_hash(pkg->tmp_path, pkg->recipe, LOG_QUIET);
+
+      if (from_peers[j].ok && !pkg->ok) {
+        cli_out_warning("Archive of package '%s' from cache peers does not "
+                        "match ARCHIVE_SHA256",
+                        pkg->name);
+      }
+
+      mem_safe_free(from_peers[j].name);
+      j++;
+    }
+
+    if (pkg->ok) {
+      cli_out_progress("Downloaded package '%s' from cache peers", pkg->name);
+      continue;
+    }
+
+    items[num_items] = (download_item_t){.dst = pkg->tmp_path,
+                                         .url = pkg->recipe.pkg_info.url};
+    num_items++;
+  }
+
+  download_many(items, num_items);
+
+  for (size_t i = 0, j = 0; i < count; i++) {
+    fetch_pkg_t    *pkg     = pending[i];
+    mirror_list_t   mirrors = {0};
+    download_meta_t meta    = {0};
+    size_t          used    = 0;
+
+    if (pkg->ok) {
+      continue;
+    }
+
+    pkg->ok = items[j].ok;
+    j++;
+
+    if (pkg->ok || NULL == pkg->recipe.mirrors) {
+      continue;
+    }
+
+    mirror_parse_list(&mirrors, pkg->recipe.pkg_info.url, pkg->recipe.mirrors);
+    pkg->ok = mirror_download(pkg->tmp_path, mirrors, &used, &meta, LOG_ON);
+    download_free_meta(meta);
+    mirror_free_list(mirrors);
+  }
+
+  mem_safe_free(from_peers);
+  mem_safe_free(items);
+}
+
+int cli_cmd_fetch(cli_info_t info) {
+  fetch_list_t  list        = {0};
+  fetch_pkg_t **pending     = NULL;
+  size_t        num_pending = 0;
+  size_t        num_failed  = 0;
+  int           ret         = EXIT_FAILURE;
+
+  if (0 == info.num_inputs) {
+    cli_out_error("Must specify at least one package to fetch");
+    return EXIT_FAILURE;
+  }
+
+  if (download_offline()) {
+    cli_out_error("Packages cannot be fetched while offline");
+    return EXIT_FAILURE;
+  }
+
+  if (!os_fs_tm_init()) {
+    cli_out_error("Failed to inizialize host file system");
+    return EXIT_FAILURE;
+  }
+
+  for (size_t i = 0; i < info.num_inputs; i++) {
+    if (!collect_pkg(&list, info.inputs[i])) {
+      goto cleanup;
+    }
+  }
+
+  pending = (fetch_pkg_t **)malloc((list.count + 1) * sizeof(fetch_pkg_t *));
+  mem_chkoom(pending);
+
+  for (size_t i = 0; i < list.count; i++) {
+    fetch_pkg_t *pkg = &list.pkgs[i];
+
+    if (NULL == pkg->recipe.pkg_info.url ||
+        NULL == pkg->recipe.package_format) {
+      cli_out_error("Recipe of package '%s' has no URL or package format",
+                    pkg->name);
+      num_failed++;
+    } else if (is_fetched(pkg)) {
+      cli_out_progress("Package '%s' has already been fetched", pkg->name);
+    } else {
+      pending[num_pending] = pkg;
+      num_pending++;
+    }
+  }
+
+  char num_buf[32];
+  snprintf(num_buf, sizeof num_buf, "%zu", num_pending);
+
+  if (0 != num_pending) {
+    cli_out_progress("Downloading %s archive(s)", num_buf);
+  }
+
+  download_pkgs(pending, num_pending);
+
+  for (size_t i = 0; i < num_pending; i++) {
+    fetch_pkg_t *pkg = pending[i];
+
+    if (!pkg->ok) {
+      cli_out_error("Unable to download package '%s' from '%s'",
+                    pkg->name,
+                    pkg->recipe.pkg_info.url);
+    } else if (util_pkg_store_fetched(
+                   pkg->tmp_path, pkg->name, pkg->recipe, LOG_ON)) {
+      cli_out_progress("Fetched package '%s'", pkg->name);
+      continue;
+    }
+
+    os_fs_file_rm(pkg->tmp_path);
+    num_failed++;
+  }
+
+  if (0 != num_failed) {
+    snprintf(num_buf, sizeof num_buf, "%zu", num_failed);
+    cli_out_error("Unable to fetch %s package(s)", num_buf);
+    goto cleanup;
+  }
+
+  cli_out_success("All packages fetched, they can be installed with "
+                  "'tarman install -r <pkg name> --offline'");
+  ret = EXIT_SUCCESS;
+
+cleanup:
+  for (size_t i = 0; i < list.count; i++) {
+    mem_safe_free(list.pkgs[i].name);
+    mem_safe_free(list.pkgs[i].repo);
+    mem_safe_free(list.pkgs[i].tmp_path);
+    pkg_free_rcp(list.pkgs[i].recipe);
+  }
+
+  mem_safe_free(list.pkgs);
+  mem_safe_free(pending);
+  return ret;
+}
@@ -29,11 +29,47 @@
 #include "cli/output.h"
 #include "config.h"
 #include "download.h"
+#include "infer.h"
+#include "magic.h"
 #include "os/fs.h"
+#include "os/thread.h"
 #include "package.h"
+#include "resolve.h"
+#include "store.h"
 #include "tm-mem.h"
+#include "util/lock.h"
 #include "util/misc.h"
 #include "util/pkg.h"
+#include "walk.h"
+
+// Limits for executable inference, packages like SDKs can
+// contain tens of thousands of files
+#define EXEC_MAX_DEPTH   8
+#define EXEC_MAX_RESULTS 32
+
+// Candidates listed when none is good enough in headless mode
+#define EXEC_MAX_REPORTED 5
+
+static const char *ExecPrunedDirs[] = {"share", "doc", "include"};
+
+// What the archive entries revealed about the package while it was being
+// extracted. Only used if the whole archive went through the native
+// extractor (see tar_opts_t), the package directory is walked otherwise
+typedef struct {
+  bool          complete;
+  infer_exec_t *execs;
+  size_t        num_execs;
+  char        **top_dirs;
+  size_t        num_top_dirs;
+  size_t        top_dirs_cap;
+} pkg_contents_t;
+
+typedef struct {
+  const char *dst;
+  const char *src;
+  tar_opts_t *opts;
+  bool        ok;
+} extract_job_t;
 
 static const char *
 override_if_src_set(const char *dst, const char *src, bool copy) {
@@ -82,14 +118,6 @@ static void override_recipe(rt_recipe_t *recipe, cli_info_t cli_info) {
   rcp->add_to_tarman  = cli_info.add_tarman;
 }
 
-static void remove_pkg_cache(const char *archive_path) {
-  cli_out_progress("Removing cache '%s'", archive_path);
-
-  if (TM_FS_FILEOP_STATUS_OK != os_fs_file_rm(archive_path)) {
-    cli_out_warning("Unable to delete cache");
-  }
-}
-
 static bool gen_repos_list(char     ***repos_list,
                            size_t     *repos_count,
                            const char *pkg_name,
@@ -178,7 +206,11 @@ static size_t user_choose(char      **options,
       "Enter the desired option number", range_min, options_count);
 }
 
-static bool find_repository(rt_recipe_t *recipe) {
+static int cmp_names(const void *a, const void *b) {
+  return strcmp(*(const char **)a, *(const char **)b);
+}
+
+static bool find_repository(rt_recipe_t *recipe, bool headless) {
   const char *repos_path = NULL;
   os_fs_tm_dyrepos((char **)&repos_path);
 
@@ -196,12 +228,18 @@ static bool find_repository(rt_recipe_t *recipe) {
     goto cleanup;
   }
 
-  unsigned long user_choice = user_choose(
-      repos,
-      repos_count,
-      false,
-      "Multiple repositories found for package '%s', choose between",
-      recipe->pkg_name);
+  // Same order as util_repo_find_recipe, so that headless installs (e.g.,
+  // of dependencies) use the same repository the resolver looked at
+  qsort(repos, repos_count, sizeof(char *), cmp_names);
+
+  unsigned long user_choice =
+      headless ? 1
+               : user_choose(repos,
+                             repos_count,
+                             false,
+                             "Multiple repositories found for package '%s', "
+                             "choose between",
+                             recipe->pkg_name);
 
   recipe->recipe.pkg_info.from_repoistory = repos[user_choice - 1];
 
@@ -225,9 +263,28 @@ cleanup:
   return ret;
 }
 
-static bool infer_app_name(rt_recipe_t *recipe, const char *pkg_path) {
-  cli_out_progress("Inferring application name");
+static void add_app_name(char     ***names,
+                         size_t     *count,
+                         size_t     *buf_sz,
+                         const char *name) {
+  if (0 == strcmp(name, (*names)[0])) {
+    return;
+  }
+
+  if (*buf_sz - 1 == *count) {
+    *buf_sz *= 2;
+    *names = (char **)realloc(*names, *buf_sz * sizeof(char *));
+    mem_chkoom(*names);
+  }
+
+  (*names)[*count] = (char *)override_if_src_set(NULL, name, true);
+  (*count)++;
+}
 
+static bool list_top_dirs(char     ***names,
+                          size_t     *count,
+                          size_t     *buf_sz,
+                          const char *pkg_path) {
   os_fs_dirstream_t stream;
   fs_dirop_status_t open_status = os_fs_dir_open(&stream, pkg_path);
 
@@ -237,32 +294,49 @@ static bool infer_app_name(rt_recipe_t *recipe, const char *pkg_path) {
   }
 
   fs_dirent_t ent;
-  size_t      names_buf_sz = 16;
-  char      **names        = (char **)malloc(names_buf_sz * sizeof(char *));
-  size_t      count        = 1; // Count is one because there's a default value
-  mem_chkoom(names);
-
-  names[0]    = (char *)override_if_src_set(names[0], recipe->pkg_name, true);
-  names[0][0] = toupper(names[0][0]);
 
   while (TM_FS_DIROP_STATUS_OK == os_fs_dir_next(stream, &ent)) {
     if (TM_FS_FILETYPE_DIR == ent.file_type) {
-      if (0 == strcmp(ent.name, names[0])) {
-        continue;
-      }
-
-      if (names_buf_sz - 1 == count) {
-        names_buf_sz *= 2;
-        names = (char **)realloc(names, names_buf_sz * sizeof(char *));
-        mem_chkoom(names);
-      }
-
-      names[count] = (char *)override_if_src_set(names[count], ent.name, true);
-      count++;
+      add_app_name(names, count, buf_sz, ent.name);
     }
   }
 
   os_fs_dir_close(stream);
+  return true;
+}
+
+static bool infer_app_name(rt_recipe_t          *recipe,
+                           const pkg_contents_t *contents,
+                           const char           *pkg_path,
+                           bool                  headless) {
+  cli_out_progress("Inferring application name");
+
+  // Directory names are only offered as alternatives, the default is the
+  // package name
+  if (headless) {
+    char *name = (char *)override_if_src_set(NULL, recipe->pkg_name, true);
+    name[0]    = toupper(name[0]);
+    recipe->recipe.pkg_info.application_name = name;
+    cli_out_progress("Using application name '%s'", name);
+    return true;
+  }
+
+  size_t names_buf_sz = 16;
+  char **names        = (char **)malloc(names_buf_sz * sizeof(char *));
+  size_t count        = 1; // Count is one because there's a default value
+  mem_chkoom(names);
+
+  names[0]    = (char *)override_if_src_set(names[0], recipe->pkg_name, true);
+  names[0][0] = toupper(names[0][0]);
+
+  if (contents->complete) {
+    for (size_t i = 0; i < contents->num_top_dirs; i++) {
+      add_app_name(&names, &count, &names_buf_sz, contents->top_dirs[i]);
+    }
+  } else if (!list_top_dirs(&names, &count, &names_buf_sz, pkg_path)) {
+    walk_free(names, count);
+    return false;
+  }
 
   unsigned long user_choice =
       user_choose(names, count, true, "Choose an application name");
@@ -284,97 +358,255 @@ static bool infer_app_name(rt_recipe_t *recipe, const char *pkg_path) {
   return true;
 }
 
-static bool find_executables(char     ***execs,
-                             size_t     *count,
-                             size_t     *bufsz,
-                             const char *base_path,
-                             const char *subdir) {
-  char *dir_path = (char *)base_path;
+static bool is_shared_library(const char *name) {
+  const char *ext = strrchr(name, '.');
 
-  if (NULL != subdir) {
-    os_fs_path_dyconcat(&dir_path, 2, base_path, subdir);
+  if (NULL != strstr(name, ".so.")) {
+    return true;
   }
 
-  os_fs_dirstream_t stream;
-  fs_dirop_status_t open_status = os_fs_dir_open(&stream, dir_path);
-  bool              ret         = false;
+  return NULL != ext && (0 == strcmp(ext, ".so") || 0 == strcmp(ext, ".dylib"));
+}
 
-  if (TM_FS_DIROP_STATUS_OK != open_status) {
-    cli_out_error("Unable to visit subdirectory '%s'", dir_path);
-    goto cleanup;
+static bool is_exec_candidate(const char *full_path,
+                              const char *rel_path,
+                              fs_dirent_t ent,
+                              void       *ctx) {
+  (void)rel_path;
+  (void)ctx;
+
+  // The executable bit alone lets through shared libraries, data files
+  // extracted with sloppy permissions and so on. Only actual programs
+  // (binaries and scripts) are offered to the user
+  return TM_FS_FILETYPE_EXEC == ent.file_type && !is_shared_library(ent.name) &&
+         TM_MAGIC_EXEC_NONE != magic_exec_fdetect(full_path);
+}
+
+static bool find_executables(infer_exec_t **execs,
+                             size_t        *count,
+                             const char    *base_path) {
+  char **paths     = NULL;
+  size_t num_paths = 0;
+
+  walk_opts_t opts = {.prune       = ExecPrunedDirs,
+                      .num_prune   = sizeof ExecPrunedDirs / sizeof(char *),
+                      .max_depth   = EXEC_MAX_DEPTH,
+                      .max_results = EXEC_MAX_RESULTS,
+                      .filter      = is_exec_candidate,
+                      .ctx         = NULL};
+
+  if (!walk_dytree(&paths, &num_paths, base_path, opts)) {
+    cli_out_error("Unable to visit package directory '%s'", base_path);
+    return false;
   }
 
-  fs_dirent_t ent;
+  infer_exec_t *found = (infer_exec_t *)malloc((num_paths + 1) *
+                                               sizeof(infer_exec_t));
+  mem_chkoom(found);
 
-  while (TM_FS_DIROP_STATUS_OK == os_fs_dir_next(stream, &ent)) {
-    if (TM_FS_FILETYPE_DIR == ent.file_type) {
-      char *sub_subdir = NULL;
+  for (size_t i = 0; i < num_paths; i++) {
+    char         *full_path = NULL;
+    fs_fileinfo_t info      = {0};
+    os_fs_path_dyconcat(&full_path, 2, base_path, paths[i]);
+    os_fs_file_getinfo(&info, full_path);
 
-      if (NULL == subdir) {
-        if (!find_executables(execs, count, bufsz, base_path, ent.name)) {
-          goto close;
-        }
-        continue;
-      }
+    found[i] = (infer_exec_t){.path  = paths[i],
+                              .magic = magic_exec_fdetect(full_path),
+                              .size  = info.size};
+    mem_safe_free(full_path);
+  }
 
-      os_fs_path_dyconcat(&sub_subdir, 2, subdir, ent.name);
+  // The paths are now owned by the candidates
+  mem_safe_free(paths);
+  *execs = found;
+  *count = num_paths;
+  return true;
+}
 
-      if (!find_executables(execs, count, bufsz, base_path, sub_subdir)) {
-        mem_safe_free(sub_subdir);
-        goto close;
-      }
+static bool is_pruned(const char *rel_path) {
+  size_t depth = 0;
+
+  for (const char *comp = rel_path; NULL != comp; depth++) {
+    const char *end = strchr(comp, '/');
 
-      mem_safe_free(sub_subdir);
+    // The last component is the file itself
+    if (NULL == end) {
+      break;
     }
 
-    else if (TM_FS_FILETYPE_EXEC == ent.file_type) {
-      if (*bufsz - 1 == *count) {
-        *bufsz *= 2;
-        *execs = (char **)realloc(*execs, *bufsz * sizeof(char *));
-        mem_chkoom(*execs);
+    for (size_t i = 0; i < sizeof ExecPrunedDirs / sizeof(char *); i++) {
+      if (strlen(ExecPrunedDirs[i]) == (size_t)(end - comp) &&
+          0 == strncmp(ExecPrunedDirs[i], comp, end - comp)) {
+        return true;
       }
+    }
+
+    comp = end + 1;
+  }
 
-      char *exec_path = NULL;
-      os_fs_path_dyconcat(&exec_path, 2, subdir, ent.name);
+  return EXEC_MAX_DEPTH < depth;
+}
+
+static void collect_top_dir(pkg_contents_t *contents, const char *rel_path) {
+  const char *end = strchr(rel_path, '/');
+  size_t      len = (NULL == end) ? strlen(rel_path) : (size_t)(end - rel_path);
 
-      (*execs)[*count] = exec_path;
-      (*count)++;
+  for (size_t i = 0; i < contents->num_top_dirs; i++) {
+    if (strlen(contents->top_dirs[i]) == len &&
+        0 == strncmp(contents->top_dirs[i], rel_path, len)) {
+      return;
     }
   }
 
-  ret = true;
+  if (contents->num_top_dirs == contents->top_dirs_cap) {
+    contents->top_dirs_cap = (0 == contents->top_dirs_cap)
+                                 ? 16
+                                 : contents->top_dirs_cap * 2;
+    contents->top_dirs     = (char **)realloc(
+        contents->top_dirs, contents->top_dirs_cap * sizeof(char *));
+    mem_chkoom(contents->top_dirs);
+  }
 
-close:
-  os_fs_dir_close(stream);
-cleanup:
-  if (NULL != subdir) {
-    mem_safe_free(dir_path);
+  char *name = (char *)malloc(len + 1);
+  mem_chkoom(name);
+  memcpy(name, rel_path, len);
+  name[len]                                    = 0;
+  contents->top_dirs[contents->num_top_dirs++] = name;
+}
+
+// Same rules as is_exec_candidate and find_executables, applied to the
+// archive entries as they are extracted. Once the limit is reached,
+// shallower candidates replace deeper ones, as the walk would prefer them
+static void collect_exec(pkg_contents_t    *contents,
+                         const tar_entry_t *ent,
+                         const char        *rel_path) {
+  const char  *slash = strrchr(rel_path, '/');
+  const char  *name  = (NULL == slash) ? rel_path : slash + 1;
+  magic_exec_t magic = magic_exec_detect(ent->head, ent->head_len);
+
+  if (0 == (ent->mode & 0111) || is_shared_library(name) ||
+      TM_MAGIC_EXEC_NONE == magic || is_pruned(rel_path)) {
+    return;
   }
 
-  return ret;
+  size_t slot = contents->num_execs;
+
+  if (EXEC_MAX_RESULTS == slot) {
+    size_t depth = walk_path_depth(rel_path);
+
+    for (size_t i = 0; i < contents->num_execs; i++) {
+      if (walk_path_depth(contents->execs[i].path) > depth) {
+        slot  = i;
+        depth = walk_path_depth(contents->execs[i].path);
+      }
+    }
+
+    if (EXEC_MAX_RESULTS == slot) {
+      return;
+    }
+
+    mem_safe_free(contents->execs[slot].path);
+  } else {
+    contents->num_execs++;
+  }
+
+  contents->execs[slot] = (infer_exec_t){
+      .path  = (char *)override_if_src_set(NULL, rel_path, true),
+      .magic = magic,
+      .size  = ent->size};
+}
+
+static void collect_entry(const tar_entry_t *ent,
+                          const char        *rel_path,
+                          void              *ctx) {
+  pkg_contents_t *contents = (pkg_contents_t *)ctx;
+
+  if (TM_TAR_ENTRY_DIR == ent->type || NULL != strchr(rel_path, '/')) {
+    collect_top_dir(contents, rel_path);
+  }
+
+  if (TM_TAR_ENTRY_FILE == ent->type) {
+    collect_exec(contents, ent, rel_path);
+  }
 }
 
-static bool infer_exec(rt_recipe_t *recipe, const char *pkg_path) {
-  bool          ret          = false;
-  size_t        execs_buf_sz = 16;
-  char        **execs        = (char **)malloc(execs_buf_sz * sizeof(char *));
-  size_t        count        = 0;
-  unsigned long user_choice  = 0;
-  mem_chkoom(execs);
-
-  if (find_executables(&execs, &count, &execs_buf_sz, pkg_path, NULL)) {
-    user_choice = user_choose(execs, count, true, "Choose an executable");
-    recipe->recipe.pkg_info.executable_path = execs[user_choice - 1];
+static void free_contents(pkg_contents_t *contents) {
+  infer_exec_free(contents->execs, contents->num_execs);
+  walk_free(contents->top_dirs, contents->num_top_dirs);
+  *contents = (pkg_contents_t){0};
+}
+
+static void report_candidates(const infer_exec_t *execs, size_t count) {
+  for (size_t i = 0; i < count && EXEC_MAX_REPORTED > i; i++) {
+    char score_buf[32];
+    snprintf(score_buf, sizeof score_buf, "%d", execs[i].score);
+    cli_out_warning("Candidate '%s' (score %s)", execs[i].path, score_buf);
+  }
+}
+
+static bool infer_exec(rt_recipe_t    *recipe,
+                       pkg_contents_t *contents,
+                       const char     *pkg_path,
+                       bool            headless) {
+  infer_exec_t *execs       = NULL;
+  size_t        count       = 0;
+  unsigned long user_choice = 0;
+  bool          ret         = false;
+
+  if (contents->complete) {
+    execs               = contents->execs;
+    count               = contents->num_execs;
+    contents->execs     = NULL;
+    contents->num_execs = 0;
+  } else {
+    cli_out_progress("Looking for executables in '%s'", pkg_path);
+
+    if (!find_executables(&execs, &count, pkg_path)) {
+      return false;
+    }
+  }
+
+  infer_exec_rank(execs, count, recipe->pkg_name);
+
+  if (headless) {
+    if (!infer_exec_confident(execs, count)) {
+      report_candidates(execs, count);
+      cli_out_error("Unable to choose an executable with confidence. Use '-x' "
+                    "to specify it");
+      goto cleanup;
+    }
+
+    cli_out_progress("Using executable '%s'", execs[0].path);
+    recipe->recipe.pkg_info.executable_path = execs[0].path;
+    execs[0].path                           = NULL;
     ret                                     = true;
+    goto cleanup;
   }
 
+  // Options are shown best first
+  char **options = (char **)malloc((count + 1) * sizeof(char *));
+  mem_chkoom(options);
+
   for (size_t i = 0; i < count; i++) {
-    if (i != user_choice - 1) {
-      mem_safe_free(execs[i]);
-    }
+    options[i] = execs[i].path;
   }
 
-  mem_safe_free(execs);
+  user_choice = user_choose(options, count, true, "Choose an executable");
+  mem_safe_free(options);
+
+  if (0 == user_choice) {
+    while (0 == cli_in_dystr("Enter relative path to executable",
+                             (char **)&recipe->recipe.pkg_info.executable_path))
+      ;
+  } else {
+    recipe->recipe.pkg_info.executable_path = execs[user_choice - 1].path;
+    execs[user_choice - 1].path             = NULL;
+  }
+
+  ret = true;
+
+cleanup:
+  infer_exec_free(execs, count);
   return ret;
 }
 
@@ -386,31 +618,42 @@ static void infer_working_dir(rt_recipe_t *recipe) {
   recipe->recipe.pkg_info.working_directory = parent;
 }
 
-static bool infer_additional_info(rt_recipe_t *recipe,
-                                  cli_info_t   cli_info,
-                                  const char  *pkg_path) {
+// These questions do not depend on the contents of the package, so they
+// are asked while it is being extracted
+static void ask_integrations(rt_recipe_t *recipe, cli_info_t cli_info) {
   if (recipe->is_remote) {
-    return true;
+    return;
   }
 
   if (!recipe->recipe.add_to_path && !cli_info.add_path) {
     recipe->recipe.add_to_path =
-        cli_in_bool("Do you want to add this package to PATH?");
+        cli_in_bool("Do you want to add this package to PATH?", true);
   }
 
-  if (NULL == recipe->recipe.pkg_info.executable_path &&
-      !infer_exec(recipe, pkg_path)) {
-    return false;
+  // Unattended installs are usually meant for machines where nobody looks
+  // at the desktop, so it takes '-d' to add the app there
+  if (!recipe->recipe.add_to_desktop && !cli_info.add_desktop) {
+    recipe->recipe.add_to_desktop = cli_in_bool(
+        "Do you want to add this package as an app?", !cli_info.headless);
   }
+}
 
-  if (!recipe->recipe.add_to_desktop && !cli_info.add_desktop) {
-    recipe->recipe.add_to_desktop =
-        cli_in_bool("Do you want to add this package as an app?");
+static bool infer_additional_info(rt_recipe_t    *recipe,
+                                  cli_info_t      cli_info,
+                                  pkg_contents_t *contents,
+                                  const char     *pkg_path) {
+  if (recipe->is_remote) {
+    return true;
+  }
+
+  if (NULL == recipe->recipe.pkg_info.executable_path &&
+      !infer_exec(recipe, contents, pkg_path, cli_info.headless)) {
+    return false;
   }
 
   if (recipe->recipe.add_to_desktop &&
       NULL == recipe->recipe.pkg_info.application_name &&
-      !infer_app_name(recipe, pkg_path)) {
+      !infer_app_name(recipe, contents, pkg_path, cli_info.headless)) {
     return false;
   }
 
@@ -423,6 +666,56 @@ static bool infer_additional_info(rt_recipe_t *recipe,
   return true;
 }
 
+static bool install_dependencies(const char *pkg_name, const char *depends) {
+  resolve_graph_t graph;
+  cli_out_progress("Resolving dependencies of package '%s'", pkg_name);
+
+  if (!resolve_dependencies(&graph, pkg_name, depends)) {
+    return false;
+  }
+
+  bool ret = resolve_install(&graph);
+  resolve_free(&graph);
+  return ret;
+}
+
+static void *extract_worker(void *arg) {
+  extract_job_t *job = (extract_job_t *)arg;
+  job->ok            = archive_extract(job->dst, job->src, NULL, job->opts);
+  return NULL;
+}
+
+static bool extract_package(rt_recipe_t *recipe,
+                            cli_info_t   cli_info,
+                            const char  *ver_path,
+                            const char  *archive_path,
+                            tar_opts_t  *opts) {
+  extract_job_t job = {.dst = ver_path, .src = archive_path, .opts = opts};
+  os_thread_t   extractor;
+
+  cli_out_progress("Extracting archive '%s' to '%s'", archive_path, ver_path);
+  bool threaded = os_thread_create(&extractor, extract_worker, &job);
+
+  if (!threaded) {
+    extract_worker(&job);
+  }
+
+  // The user answers while the archive is being extracted, rather than
+  // waiting for it first
+  ask_integrations(recipe, cli_info);
+
+  if (threaded) {
+    os_thread_join(extractor, NULL);
+  }
+
+  if (!job.ok) {
+    cli_out_error("Unable to extract archive. You may be missing the plugin "
+                  "for this archive type");
+  }
+
+  return job.ok;
+}
+
 int cli_cmd_install(cli_info_t info) {
   if (NULL == info.input) {
     cli_out_error("Must specify a package to install'");
@@ -437,7 +730,19 @@ int cli_cmd_install(cli_info_t info) {
   char       *pkg_path     = NULL;
   char       *archive_path = NULL;
   char       *pkg_rcp_path = NULL;
+  char       *ver_path     = NULL;
+  char       *store_ver    = NULL;
+  size_t      version      = 0;
   const char *exec_path    = NULL;
+  util_lock_t registry     = {0};
+  util_lock_t pkg_lock     = {0};
+
+  // Executables and top-level directories are noted during extraction
+  pkg_contents_t contents = {0};
+  tar_opts_t     opts     = {.visit = collect_entry, .visit_ctx = &contents};
+  contents.execs =
+      (infer_exec_t *)malloc(EXEC_MAX_RESULTS * sizeof(infer_exec_t));
+  mem_chkoom(contents.execs);
 
   cli_out_progress("Initializing host file system");
 
@@ -446,6 +751,10 @@ int cli_cmd_install(cli_info_t info) {
     goto cleanup;
   }
 
+  if (!util_lock_registry(&registry, false, LOG_ON)) {
+    goto cleanup;
+  }
+
   cli_out_progress("Initiating installation process");
 
   override_recipe(&recipe, info);
@@ -462,7 +771,12 @@ int cli_cmd_install(cli_info_t info) {
     recipe.is_remote = true;
     recipe.pkg_name  = override_if_src_set(recipe.pkg_name, info.input, true);
 
-    if (!find_repository(&recipe)) {
+    if (!find_repository(&recipe, info.headless)) {
+      goto cleanup;
+    }
+
+    if (NULL != recipe.recipe.depends &&
+        !install_dependencies(recipe.pkg_name, recipe.recipe.depends)) {
       goto cleanup;
     }
 
@@ -471,15 +785,24 @@ int cli_cmd_install(cli_info_t info) {
       goto cleanup;
     }
 
-    if (!util_pkg_fetch_archive(&archive_path,
-                                recipe.pkg_name,
-                                recipe.recipe.package_format,
-                                recipe.recipe.pkg_info.url,
-                                LOG_ON)) {
+    // Packages published by the administrator need not be downloaded
+    if (store_find(&store_ver, recipe.pkg_name, recipe.recipe)) {
+      cli_out_progress("Using package '%s' from the system store '%s'",
+                       recipe.pkg_name,
+                       store_ver);
+    } else if (!util_pkg_fetch_archive(&archive_path,
+                                       recipe.pkg_name,
+                                       &recipe.recipe,
+                                       LOG_ON)) {
       goto cleanup;
     }
   }
 
+  if (NULL == recipe.pkg_name && info.headless) {
+    cli_out_error("Must specify a package name with '-n' in headless mode");
+    goto cleanup;
+  }
+
   // Ask user to enter the package name
   while (NULL == recipe.pkg_name &&
          0 == cli_in_dystr("Enter package name", (char **)&recipe.pkg_name))
@@ -490,44 +813,62 @@ int cli_cmd_install(cli_info_t info) {
     recipe.recipe.pkg_info.url =
         override_if_src_set(recipe.recipe.pkg_info.url, info.input, true);
 
-    if (!util_pkg_fetch_archive(&archive_path,
-                                recipe.pkg_name,
-                                recipe.recipe.package_format,
-                                recipe.recipe.pkg_info.url,
-                                LOG_ON)) {
+    if (!util_pkg_fetch_archive(
+            &archive_path, recipe.pkg_name, &recipe.recipe, LOG_ON)) {
       goto cleanup;
     }
   }
 
-  if (NULL == archive_path) {
+  if (NULL == archive_path && NULL == store_ver) {
     archive_path = (char *)override_if_src_set(archive_path, info.input, true);
   }
 
+  if (!util_lock_pkg(&pkg_lock, recipe.pkg_name, true, LOG_ON)) {
+    goto cleanup;
+  }
+
   if (!util_pkg_create_directory(
-          &pkg_path, recipe.pkg_name, LOG_ON, INPUT_ON)) {
+          &ver_path, &version, recipe.pkg_name, LOG_ON, !info.yes)) {
     goto cleanup;
   }
 
-  cli_out_progress("Extracting archive '%s' to '%s'", archive_path, pkg_path);
+  if (NULL != store_ver) {
+    if (!store_link(ver_path, store_ver, LOG_ON)) {
+      goto cleanup;
+    }
 
-  if (!archive_extract(pkg_path, archive_path, NULL)) {
-    cli_out_error("Unable to extract archive. You may be missing the plugin "
-                  "for this archive type");
+    store_adopt(&recipe.recipe, store_ver);
+    ask_integrations(&recipe, info);
+  } else if (!extract_package(&recipe, info, ver_path, archive_path, &opts)) {
     goto cleanup;
   }
 
   if (!recipe.is_remote) {
-    util_pkg_load_config(&recipe.recipe.pkg_info, pkg_path, LOG_ON);
+    util_pkg_load_config(&recipe.recipe.pkg_info, ver_path, LOG_ON);
   }
 
-  if (!infer_additional_info(&recipe, info, pkg_path)) {
+  contents.complete = opts.complete;
+
+  if (!infer_additional_info(&recipe, info, &contents, ver_path)) {
     goto cleanup;
   }
 
-  os_fs_path_dyconcat(&pkg_rcp_path, 2, pkg_path, "recipe.tarman");
+  os_fs_path_dyconcat(&pkg_rcp_path, 2, ver_path, "recipe.tarman");
   cli_out_progress("Creating recipe artifact in '%s'", pkg_rcp_path);
   pkg_dump_rcp(pkg_rcp_path, recipe.recipe);
 
+  // Packages from the store are linked to its manifest
+  if (NULL == store_ver) {
+    util_pkg_create_manifest(ver_path, LOG_ON);
+  }
+
+  if (!util_pkg_activate_version(recipe.pkg_name, version, LOG_ON)) {
+    goto cleanup;
+  }
+
+  // PATH and desktop entries go through the link to the active version
+  os_fs_tm_dypkg(&pkg_path, recipe.pkg_name);
+
   if (NULL != recipe.recipe.pkg_info.executable_path) {
     os_fs_path_dyconcat((char **)&exec_path,
                         2,
@@ -549,18 +890,43 @@ int cli_cmd_install(cli_info_t info) {
   }
 
   if ((info.from_url || info.from_repo) && NULL != archive_path) {
-    remove_pkg_cache(archive_path);
+    util_pkg_keep_archive(
+        archive_path, recipe.pkg_name, recipe.recipe, LOG_ON);
   }
 
   cli_out_success("Package '%s' installed successfully", recipe.pkg_name);
   ret = EXIT_SUCCESS;
 
 cleanup:
+  // A version that was never activated is of no use. If it was the first
+  // one, the package was not installed before and nothing is left of it
+  if (EXIT_SUCCESS != ret && 0 != version) {
+    os_fs_dir_rm(ver_path);
+
+    if (1 == version) {
+      mem_safe_free(pkg_path);
+      os_fs_tm_dypkgdir(&pkg_path, recipe.pkg_name);
+      os_fs_dir_rm(pkg_path);
+    }
+  }
+
+  // Downloaded archives are temporary files of this run, while local ones
+  // belong to the user
+  if (EXIT_SUCCESS != ret && (info.from_url || info.from_repo) &&
+      NULL != archive_path) {
+    os_fs_file_rm(archive_path);
+  }
+
   mem_safe_free(archive_path);
   mem_safe_free(pkg_path);
   mem_safe_free(exec_path);
   mem_safe_free(pkg_rcp_path);
+  mem_safe_free(ver_path);
+  mem_safe_free(store_ver);
   mem_safe_free(recipe.pkg_name);
   pkg_free_rcp(recipe.recipe);
+  free_contents(&contents);
+  util_lock_release(&pkg_lock);
+  util_lock_release(&registry);
   return ret;
 }
@@ -0,0 +1,302 @@
+/*************************************************************************
+| tarman                                                                 |
+| Copyright (C) 2024 Alessandro Salerno                                  |
+|                                                                        |
+| This program is free software: you can redistribute it and/or modify   |
+| it under the terms of the GNU General Public License as published by   |
+| the Free Software Foundation, either version 3 of the License, or      |
+| (at your option) any later version.                                    |
+|                                                                        |
+| This program is distributed in the hope that it will be useful,        |
+| but WITHOUT ANY WARRANTY; without even the implied warranty of         |
+| MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the          |
+| GNU General Public License for more details.                           |
+|                                                                        |
+| You should have received a copy of the GNU General Public License      |
+| along with this program.  If not, see <https://www.gnu.org/licenses/>. |
+*************************************************************************/
+
+
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "cli/directives/commands.h"
+#include "cli/output.h"
+#include "download.h"
+#include "os/fs.h"
+#include "package.h"
+#include "pool.h"
+#include "tm-mem.h"
+#include "util/lock.h"
+#include "util/pkg.h"
+
+#define NO_VALUE "-"
+
+typedef enum {
+  OUTDATED_STATUS_CURRENT,
+  OUTDATED_STATUS_OUTDATED,
+  OUTDATED_STATUS_UNKNOWN,
+  OUTDATED_STATUS_UNREACHABLE,
+  OUTDATED_STATUS_LOCAL
+} outdated_status_t;
+
+static const char *StatusNames[] = {
+    "up to date", "outdated", "unknown", "unreachable", "local"};
+
+typedef struct {
+  char             *name;
+  recipe_t          installed;
+  char             *available; // Version in the repository, if any
+  bool              check_url; // Must ask the server
+  outdated_status_t status;
+} outdated_pkg_t;
+
+static int cmp_pkgs(const void *a, const void *b) {
+  return strcmp(((const outdated_pkg_t *)a)->name,
+                ((const outdated_pkg_t *)b)->name);
+}
+
+static bool differ(const char *a, const char *b) {
+  return NULL != a && NULL != b && 0 != strcmp(a, b);
+}
+
+// Repository packages are compared against the local copy of their recipe,
+// so they do not need any network access
+static void compare_repo(outdated_pkg_t *pkg) {
+  char    *rcp_path = NULL;
+  recipe_t latest   = {0};
+
+  os_fs_tm_dyrecipe(
+      &rcp_path, pkg->installed.pkg_info.from_repoistory, pkg->name);
+
+  if (TM_CFG_PARSE_STATUS_OK != pkg_parse_tmrcp(&latest, rcp_path)) {
+    pkg->status = OUTDATED_STATUS_UNKNOWN;
+    mem_safe_free(rcp_path);
+    return;
+  }
+
+  const char *version = pkg->installed.version;
+  const char *hash    = pkg->installed.archive_sha256;
+
+  if (NULL != version && NULL != latest.version) {
+    pkg->status = (0 > pkg_cmp_versions(version, latest.version))
+                      ? OUTDATED_STATUS_OUTDATED
+                      : OUTDATED_STATUS_CURRENT;
+  } else if (NULL != hash && NULL != latest.archive_sha256) {
+    pkg->status = differ(hash, latest.archive_sha256)
+                      ? OUTDATED_STATUS_OUTDATED
+                      : OUTDATED_STATUS_CURRENT;
+  } else if (differ(pkg->installed.pkg_info.url, latest.pkg_info.url)) {
+    pkg->status = OUTDATED_STATUS_OUTDATED;
+  } else {
+    // The recipe does not say anything about releases, so the
+    // archive itself is checked as if it had been installed from URL
+    pkg->check_url = NULL != pkg->installed.pkg_info.url;
+  }
+
+  pkg->available = (char *)latest.version;
+  latest.version = NULL;
+  mem_safe_free(rcp_path);
+  pkg_free_rcp(latest);
+}
+
+static void load_pkg(outdated_pkg_t *pkg) {
+  char *pkg_path      = NULL;
+  char *artifact_path = NULL;
+
+  pkg->status = OUTDATED_STATUS_UNKNOWN;
+  os_fs_tm_dypkg(&pkg_path, pkg->name);
+  os_fs_path_dyconcat(&artifact_path, 2, pkg_path, "recipe.tarman");
+
+  if (TM_CFG_PARSE_STATUS_OK !=
+      pkg_parse_tmrcp(&pkg->installed, artifact_path)) {
+    pkg->installed = (recipe_t){0};
+    goto cleanup;
+  }
+
+  if (NULL != pkg->installed.pkg_info.from_repoistory) {
+    compare_repo(pkg);
+  } else if (NULL != pkg->installed.pkg_info.url) {
+    pkg->check_url = true;
+  } else {
+    pkg->status = OUTDATED_STATUS_LOCAL;
+  }
+
+cleanup:
+  mem_safe_free(pkg_path);
+  mem_safe_free(artifact_path);
+}
+
+static void check_job(size_t index, void *ctx) {
+  outdated_pkg_t **pending = (outdated_pkg_t **)ctx;
+  outdated_pkg_t  *pkg     = pending[index];
+  download_meta_t  meta    = {
+          .etag          = (char *)pkg->installed.archive_etag,
+          .last_modified = (char *)pkg->installed.archive_last_modified};
+
+  switch (download_check(pkg->installed.pkg_info.url, meta)) {
+  case TM_DOWNLOAD_CHECK_CURRENT:
+    pkg->status = OUTDATED_STATUS_CURRENT;
+    break;
+
+  case TM_DOWNLOAD_CHECK_CHANGED:
+    pkg->status = OUTDATED_STATUS_OUTDATED;
+    break;
+
+  case TM_DOWNLOAD_CHECK_ERROR:
+    pkg->status = OUTDATED_STATUS_UNREACHABLE;
+    break;
+
+  default:
+    pkg->status = OUTDATED_STATUS_UNKNOWN;
+    break;
+  }
+}
+
+static bool collect_pkgs(outdated_pkg_t **pkgs, size_t *count) {
+  char             *pkgs_path = NULL;
+  size_t            cap       = 0;
+  os_fs_dirstream_t stream;
+  fs_dirent_t       ent;
+
+  os_fs_tm_dypkgs(&pkgs_path);
+
+  if (TM_FS_DIROP_STATUS_OK != os_fs_dir_open(&stream, pkgs_path)) {
+    cli_out_error("Unable to access package directory '%s'", pkgs_path);
+    mem_safe_free(pkgs_path);
+    return false;
+  }
+
+  while (TM_FS_DIROP_STATUS_OK == os_fs_dir_next(stream, &ent)) {
+    if (TM_FS_FILETYPE_DIR != ent.file_type) {
+      continue;
+    }
+
+    if (*count == cap) {
+      cap   = (0 == cap) ? 32 : cap * 2;
+      *pkgs = (outdated_pkg_t *)realloc(*pkgs, cap * sizeof(outdated_pkg_t));
+      mem_chkoom(*pkgs);
+    }
+
+    outdated_pkg_t *pkg = &(*pkgs)[*count];
+    *pkg                = (outdated_pkg_t){0};
+    pkg->name           = (char *)malloc(strlen(ent.name) + 1);
+    mem_chkoom(pkg->name);
+    strcpy(pkg->name, ent.name);
+    (*count)++;
+  }
+
+  os_fs_dir_close(stream);
+  mem_safe_free(pkgs_path);
+  return true;
+}
+
+static const char *or_none(const char *value) {
+  return (NULL != value) ? value : NO_VALUE;
+}
+
+static void print_cell(const char *value, size_t width) {
+  printf("%s", value);
+  cli_out_space(width - strlen(value) + 3);
+}
+
+static void print_table(const outdated_pkg_t *pkgs, size_t count) {
+  size_t name_w  = strlen("Package");
+  size_t inst_w  = strlen("Installed");
+  size_t avail_w = strlen("Available");
+
+  for (size_t i = 0; i < count; i++) {
+    size_t name_len  = strlen(pkgs[i].name);
+    size_t inst_len  = strlen(or_none(pkgs[i].installed.version));
+    size_t avail_len = strlen(or_none(pkgs[i].available));
+
+    name_w  = (name_len > name_w) ? name_len : name_w;
+    inst_w  = (inst_len > inst_w) ? inst_len : inst_w;
+    avail_w = (avail_len > avail_w) ? avail_len : avail_w;
+  }
+
+  print_cell("Package", name_w);
+  print_cell("Installed", inst_w);
+  print_cell("Available", avail_w);
+  printf("Status");
+  cli_out_newline();
+
+  for (size_t i = 0; i < count; i++) {
+    print_cell(pkgs[i].name, name_w);
+    print_cell(or_none(pkgs[i].installed.version), inst_w);
+    print_cell(or_none(pkgs[i].available), avail_w);
+    printf("%s", StatusNames[pkgs[i].status]);
+    cli_out_newline();
+  }
+}
+
+int cli_cmd_outdated(cli_info_t info) {
+  (void)info;
+
+  if (!os_fs_tm_init()) {
+    cli_out_error("Failed to inizialize host file system");
+    return EXIT_FAILURE;
+  }
+
+  outdated_pkg_t  *pkgs        = NULL;
+  outdated_pkg_t **pending     = NULL;
+  size_t           count       = 0;
+  size_t           num_pending = 0;
+  size_t           num_old     = 0;
+  int              ret         = EXIT_FAILURE;
+  util_lock_t      registry    = {0};
+
+  if (!util_lock_registry(&registry, false, LOG_ON) ||
+      !collect_pkgs(&pkgs, &count)) {
+    goto cleanup;
+  }
+
+  qsort(pkgs, count, sizeof(outdated_pkg_t), cmp_pkgs);
+  pending = (outdated_pkg_t **)malloc((count + 1) * sizeof(outdated_pkg_t *));
+  mem_chkoom(pending);
+
+  for (size_t i = 0; i < count; i++) {
+    load_pkg(&pkgs[i]);
+
+    if (pkgs[i].check_url) {
+      pending[num_pending] = &pkgs[i];
+      num_pending++;
+    }
+  }
+
+  pool_run_io(num_pending, check_job, pending);
+  print_table(pkgs, count);
+
+  for (size_t i = 0; i < count; i++) {
+    if (OUTDATED_STATUS_OUTDATED == pkgs[i].status) {
+      num_old++;
+    }
+  }
+
+  char num_buf[32];
+  snprintf(num_buf, sizeof num_buf, "%zu", num_old);
+
+  if (0 != num_old) {
+    cli_out_warning("%s package(s) can be updated with 'tarman update <pkg "
+                    "name>'",
+                    num_buf);
+  } else {
+    cli_out_success("No outdated packages found");
+  }
+
+  ret = EXIT_SUCCESS;
+
+cleanup:
+  for (size_t i = 0; i < count; i++) {
+    mem_safe_free(pkgs[i].name);
+    mem_safe_free(pkgs[i].available);
+    pkg_free_rcp(pkgs[i].installed);
+  }
+
+  mem_safe_free(pkgs);
+  mem_safe_free(pending);
+  util_lock_release(&registry);
+  return ret;
+}
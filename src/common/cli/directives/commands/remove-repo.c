@@ -26,11 +26,14 @@
 #include "os/fs.h"
 #include "package.h"
 #include "tm-mem.h"
+#include "util/lock.h"
+#include "util/pkg.h"
 
 int cli_cmd_remove_repo(cli_info_t info) {
   int         ret       = EXIT_FAILURE;
   const char *repo_name = info.input;
   char       *repo_path = NULL;
+  util_lock_t registry  = {0};
 
   if (NULL == repo_name) {
     cli_out_error(
@@ -70,7 +73,11 @@ int cli_cmd_remove_repo(cli_info_t info) {
     goto cleanup;
   }
 
-  if (!cli_in_bool("Proceed with removal?")) {
+  if (!info.yes && !cli_in_bool("Proceed with removal?", false)) {
+    goto cleanup;
+  }
+
+  if (!util_lock_registry(&registry, true, LOG_ON)) {
     goto cleanup;
   }
 
@@ -86,5 +93,6 @@ int cli_cmd_remove_repo(cli_info_t info) {
 
 cleanup:
   mem_safe_free(repo_path);
+  util_lock_release(&registry);
   return ret;
 }
@@ -26,13 +26,18 @@
 #include "os/fs.h"
 #include "package.h"
 #include "tm-mem.h"
+#include "util/lock.h"
+#include "util/pkg.h"
 
 int cli_cmd_remove(cli_info_t info) {
   int         ret             = EXIT_FAILURE;
   const char *pkg_name        = info.input;
   char       *pkg_path        = NULL;
+  char       *pkg_dir         = NULL;
   char       *artifact_path   = NULL;
   recipe_t    recipe_artifact = {0};
+  util_lock_t registry        = {0};
+  util_lock_t pkg_lock        = {0};
 
   if (NULL == pkg_name) {
     cli_out_error("You must specify a package name for it to be removed. Use "
@@ -48,6 +53,7 @@ int cli_cmd_remove(cli_info_t info) {
   }
 
   os_fs_tm_dypkg(&pkg_path, pkg_name);
+  os_fs_tm_dypkgdir(&pkg_dir, pkg_name);
 
   os_fs_dirstream_t dir_stream;
 
@@ -72,7 +78,12 @@ int cli_cmd_remove(cli_info_t info) {
     goto cleanup;
   }
 
-  if (!cli_in_bool("Proceed with removal?")) {
+  if (!info.yes && !cli_in_bool("Proceed with removal?", false)) {
+    goto cleanup;
+  }
+
+  if (!util_lock_registry(&registry, false, LOG_ON) ||
+      !util_lock_pkg(&pkg_lock, pkg_name, true, LOG_ON)) {
     goto cleanup;
   }
 
@@ -95,20 +106,29 @@ int cli_cmd_remove(cli_info_t info) {
       }
     }
 
+    if (NULL != recipe_artifact.package_format) {
+      char *kept_path = NULL;
+      os_fs_tm_dyarchive(&kept_path, pkg_name, recipe_artifact.package_format);
+
+      // Only present if the package supports delta updates
+      os_fs_file_rm(kept_path);
+      mem_safe_free(kept_path);
+    }
+
     // TODO: Remove tarman plugin
   } else {
     cli_out_warning("Removing package without metadata (recipe artifact), some "
                     "files may persist");
   }
 
-  cli_out_progress("Removing package directory '%s'", pkg_path);
+  cli_out_progress("Removing package directory '%s'", pkg_dir);
 
-  if (TM_FS_DIROP_STATUS_OK != os_fs_dir_rm(pkg_path)) {
+  if (TM_FS_DIROP_STATUS_OK != os_fs_dir_rm(pkg_dir)) {
     cli_out_error("Unable to remove package directory '%s'. The package may "
                   "now be fully or partially as a result. You can attempt "
                   "manual removal of the package by deleting the package "
                   "directory and all PATH or Desktop references that may exist",
-                  pkg_path);
+                  pkg_dir);
     goto cleanup;
   }
 
@@ -117,7 +137,10 @@ int cli_cmd_remove(cli_info_t info) {
 
 cleanup:
   mem_safe_free(pkg_path);
+  mem_safe_free(pkg_dir);
   mem_safe_free(artifact_path);
   pkg_free_rcp(recipe_artifact);
+  util_lock_release(&pkg_lock);
+  util_lock_release(&registry);
   return ret;
 }
@@ -0,0 +1,154 @@
+/*************************************************************************
+| tarman                                                                 |
+| Copyright (C) 2024 Alessandro Salerno                                  |
+|                                                                        |
+| This program is free software: you can redistribute it and/or modify   |
+| it under the terms of the GNU General Public License as published by   |
+| the Free Software Foundation, either version 3 of the License, or      |
+| (at your option) any later version.                                    |
+|                                                                        |
+| This program is distributed in the hope that it will be useful,        |
+| but WITHOUT ANY WARRANTY; without even the implied warranty of         |
+| MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the          |
+| GNU General Public License for more details.                           |
+|                                                                        |
+| You should have received a copy of the GNU General Public License      |
+| along with this program.  If not, see <https://www.gnu.org/licenses/>. |
+*************************************************************************/
+
+
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "cli/directives/commands.h"
+#include "cli/directives/types.h"
+#include "cli/output.h"
+#include "config.h"
+#include "os/env.h"
+#include "os/fs.h"
+#include "package.h"
+#include "tm-mem.h"
+#include "util/lock.h"
+#include "util/pkg.h"
+
+static bool parse_artifact(recipe_t *recipe, const char *pkg_path) {
+  char *artifact_path = NULL;
+  os_fs_path_dyconcat(&artifact_path, 2, pkg_path, "recipe.tarman");
+
+  bool ret = TM_CFG_PARSE_STATUS_OK == pkg_parse_tmrcp(recipe, artifact_path);
+  mem_safe_free(artifact_path);
+  return ret;
+}
+
+// PATH and desktop entries point through the link to the active version, so
+// they only need to be replaced if the versions do not agree on them
+static void switch_integrations(recipe_t    from,
+                                recipe_t    to,
+                                const char *pkg_path) {
+  if (from.add_to_path) {
+    os_env_path_rm(from.pkg_info.executable_path);
+  }
+
+  if (from.add_to_desktop) {
+    os_env_desktop_rm(from.pkg_info.application_name);
+  }
+
+  if (NULL == to.pkg_info.executable_path) {
+    return;
+  }
+
+  char *exec_full_path = NULL;
+  os_fs_path_dyconcat(
+      &exec_full_path, 2, pkg_path, to.pkg_info.executable_path);
+
+  if (to.add_to_path) {
+    util_pkg_add_to_path(exec_full_path, LOG_ON);
+  }
+
+  if (to.add_to_desktop) {
+    util_pkg_add_to_desktop(pkg_path,
+                            to.pkg_info.application_name,
+                            exec_full_path,
+                            to.pkg_info.working_directory,
+                            to.pkg_info.icon_path,
+                            LOG_ON);
+  }
+
+  mem_safe_free(exec_full_path);
+}
+
+int cli_cmd_rollback(cli_info_t info) {
+  int         ret         = EXIT_FAILURE;
+  const char *pkg_name    = info.input;
+  char       *pkg_path    = NULL;
+  size_t     *versions    = NULL;
+  size_t      count       = 0;
+  size_t      current     = 0;
+  size_t      previous    = 0;
+  recipe_t    from_recipe = {0};
+  recipe_t    to_recipe   = {0};
+  util_lock_t registry    = {0};
+  util_lock_t pkg_lock    = {0};
+
+  if (NULL == pkg_name) {
+    cli_out_error("You must specify a package name for it to be rolled back. "
+                  "Use 'tarman rollback <pkg name>'");
+    return ret;
+  }
+
+  if (!os_fs_tm_init()) {
+    cli_out_error("Failed to inizialize host file system");
+    return ret;
+  }
+
+  if (!util_lock_registry(&registry, false, LOG_ON) ||
+      !util_lock_pkg(&pkg_lock, pkg_name, true, LOG_ON)) {
+    goto cleanup;
+  }
+
+  if (!util_pkg_list_versions(&versions, &count, &current, pkg_name)) {
+    cli_out_error("The package '%s' is not installed on this system",
+                  pkg_name);
+    goto cleanup;
+  }
+
+  for (size_t i = 0; i < count && versions[i] < current; i++) {
+    previous = versions[i];
+  }
+
+  if (0 == previous) {
+    cli_out_error("No previous version of package '%s' is available",
+                  pkg_name);
+    goto cleanup;
+  }
+
+  os_fs_tm_dypkg(&pkg_path, pkg_name);
+  bool has_from = parse_artifact(&from_recipe, pkg_path);
+
+  if (!util_pkg_activate_version(pkg_name, previous, LOG_ON)) {
+    goto cleanup;
+  }
+
+  if (has_from && parse_artifact(&to_recipe, pkg_path)) {
+    switch_integrations(from_recipe, to_recipe, pkg_path);
+  } else {
+    cli_out_warning("Missing package metadata (recipe artifact), PATH and "
+                    "desktop entries have not been updated");
+  }
+
+  char version_str[32];
+  snprintf(version_str, sizeof version_str, "%zu", previous);
+  cli_out_success(
+      "Package '%s' rolled back to version %s", pkg_name, version_str);
+  ret = EXIT_SUCCESS;
+
+cleanup:
+  mem_safe_free(pkg_path);
+  mem_safe_free(versions);
+  pkg_free_rcp(from_recipe);
+  pkg_free_rcp(to_recipe);
+  util_lock_release(&pkg_lock);
+  util_lock_release(&registry);
+  return ret;
+}
@@ -0,0 +1,44 @@
+/*************************************************************************
+| tarman                                                                 |
+| Copyright (C) 2024 Alessandro Salerno                                  |
+|                                                                        |
+| This program is free software: you can redistribute it and/or modify   |
+| it under the terms of the GNU General Public License as published by   |
+| the Free Software Foundation, either version 3 of the License, or      |
+| (at your option) any later version.                                    |
+|                                                                        |
+| This program is distributed in the hope that it will be useful,        |
+| but WITHOUT ANY WARRANTY; without even the implied warranty of         |
+| MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the          |
+| GNU General Public License for more details.                           |
+|                                                                        |
+| You should have received a copy of the GNU General Public License      |
+| along with this program.  If not, see <https://www.gnu.org/licenses/>. |
+*************************************************************************/
+
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "cli/directives/commands.h"
+#include "cli/directives/types.h"
+#include "cli/output.h"
+#include "os/fs.h"
+#include "peer.h"
+
+int cli_cmd_serve_cache(cli_info_t info) {
+  const char *port = (NULL != info.input) ? info.input : TM_PEER_DEFAULT_PORT;
+
+  if (0 == port[0] || strlen(port) != strspn(port, "0123456789")) {
+    cli_out_error("Invalid port '%s'. Use 'tarman serve-cache [<port>]'",
+                  port);
+    return EXIT_FAILURE;
+  }
+
+  if (!os_fs_tm_init()) {
+    cli_out_error("Failed to inizialize host file system");
+    return EXIT_FAILURE;
+  }
+
+  return peer_serve(port) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,441 @@
+/*************************************************************************
+| tarman                                                                 |
+| Copyright (C) 2024 Alessandro Salerno                                  |
+|                                                                        |
+| This program is free software: you can redistribute it and/or modify   |
+| it under the terms of the GNU General Public License as published by   |
+| the Free Software Foundation, either version 3 of the License, or      |
+| (at your option) any later version.                                    |
+|                                                                        |
+| This program is distributed in the hope that it will be useful,        |
+| but WITHOUT ANY WARRANTY; without even the implied warranty of         |
+| MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the          |
+| GNU General Public License for more details.                           |
+|                                                                        |
+| You should have received a copy of the GNU General Public License      |
+| along with this program.  If not, see <https://www.gnu.org/licenses/>. |
+*************************************************************************/
+
+
+#include <ctype.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "cli/directives/commands.h"
+#include "cli/directives/types.h"
+#include "cli/output.h"
+#include "manifest.h"
+#include "os/fs.h"
+#include "package.h"
+#include "store.h"
+#include "tm-mem.h"
+#include "util/lock.h"
+#include "util/pkg.h"
+
+// Everything in the store can be read by all users, but not changed
+#define STORE_DIR_MODE  0755
+#define STORE_FILE_MODE 0444
+#define STORE_EXEC_MODE 0555
+
+static bool valid_name(const char *name) {
+  return '\0' != name[0] && NULL == strchr(name, '/') &&
+         NULL == strchr(name, '\\') && 0 != strcmp(name, ".") &&
+         0 != strcmp(name, "..");
+}
+
+static bool make_dir(const char *path) {
+  switch (os_fs_mkdir(path)) {
+  case TM_FS_DIROP_STATUS_OK:
+    return TM_FS_FILEOP_STATUS_OK == os_fs_file_chmod(path, STORE_DIR_MODE);
+
+  case TM_FS_DIROP_STATUS_EXIST:
+    return true;
+
+  default:
+    return false;
+  }
+}
+
+static bool copy_file(const char *dst, const char *src) {
+  fs_fileinfo_t      info;
+  os_fs_filestream_t out;
+  FILE              *in  = NULL;
+  bool               ret = false;
+
+  if (TM_FS_FILEOP_STATUS_OK != os_fs_file_getinfo(&info, src) ||
+      NULL == (in = fopen(src, "rb"))) {
+    goto cleanup;
+  }
+
+  unsigned int mode = (0100 & info.mode) ? STORE_EXEC_MODE : STORE_FILE_MODE;
+
+  if (TM_FS_FILEOP_STATUS_OK != os_fs_file_create(&out, dst, mode)) {
+    goto cleanup;
+  }
+
+  ret = TM_FS_FILEOP_STATUS_OK == os_fs_file_copy(out, in, info.size);
+  ret = TM_FS_FILEOP_STATUS_OK == os_fs_file_close(out) && ret;
+
+  // The mode given at creation is subject to the umask
+  ret = ret && TM_FS_FILEOP_STATUS_OK == os_fs_file_chmod(dst, mode);
+
+cleanup:
+  if (NULL != in) {
+    fclose(in);
+  }
+
+  return ret;
+}
+
+// Symbolic links are copied as such, and never followed
+static bool copy_tree(const char *dst, const char *src) {
+  os_fs_dirstream_t stream;
+  fs_dirent_t       ent;
+  fs_dirop_status_t status;
+  bool              ret = true;
+
+  if (!make_dir(dst) ||
+      TM_FS_DIROP_STATUS_OK != os_fs_dir_open(&stream, src)) {
+    return false;
+  }
+
+  while (ret &&
+         TM_FS_DIROP_STATUS_OK == (status = os_fs_dir_next(stream, &ent))) {
+    char *src_path = NULL;
+    char *dst_path = NULL;
+    char *target   = NULL;
+    os_fs_path_dyconcat(&src_path, 2, src, ent.name);
+    os_fs_path_dyconcat(&dst_path, 2, dst, ent.name);
+
+    if (TM_FS_FILEOP_STATUS_OK == os_fs_file_dyreadlink(&target, src_path)) {
+      ret = TM_FS_FILEOP_STATUS_OK == os_fs_file_symlink(dst_path, target);
+    } else if (TM_FS_FILETYPE_DIR == ent.file_type) {
+      ret = copy_tree(dst_path, src_path);
+    } else if (TM_FS_FILETYPE_REGULAR == ent.file_type ||
+               TM_FS_FILETYPE_EXEC == ent.file_type) {
+      ret = copy_file(dst_path, src_path);
+    }
+
+    mem_safe_free(src_path);
+    mem_safe_free(dst_path);
+    mem_safe_free(target);
+  }
+
+  os_fs_dir_close(stream);
+  return ret && TM_FS_DIROP_STATUS_END == status;
+}
+
+static size_t next_version(const char *pkg_dir) {
+  os_fs_dirstream_t stream;
+  fs_dirent_t       ent;
+  size_t            next = 1;
+
+  if (TM_FS_DIROP_STATUS_OK != os_fs_dir_open(&stream, pkg_dir)) {
+    return next;
+  }
+
+  while (TM_FS_DIROP_STATUS_OK == os_fs_dir_next(stream, &ent)) {
+    char         *end = NULL;
+    unsigned long num = 0;
+
+    if (TM_FS_FILETYPE_DIR != ent.file_type ||
+        !isdigit((unsigned char)ent.name[0])) {
+      continue;
+    }
+
+    num = strtoul(ent.name, &end, 10);
+
+    if (0 == *end && num >= next) {
+      next = (size_t)num + 1;
+    }
+  }
+
+  os_fs_dir_close(stream);
+  return next;
+}
+
+// Same as util_pkg_activate_version, but for the store
+static bool activate(const char *pkg_dir, size_t version) {
+  char *link_path = NULL;
+  char *tmp_path  = NULL;
+  char  target[32];
+
+  snprintf(target, sizeof target, "%zu", version);
+  os_fs_path_dyconcat(&link_path, 2, pkg_dir, TM_FS_PKG_CURRENT);
+  os_fs_path_dyconcat(&tmp_path, 2, pkg_dir, TM_FS_PKG_CURRENT ".new");
+
+  bool ret = TM_FS_FILEOP_STATUS_OK == os_fs_file_symlink(tmp_path, target) &&
+             TM_FS_FILEOP_STATUS_OK == os_fs_file_mv(link_path, tmp_path);
+
+  if (!ret) {
+    os_fs_file_rm(tmp_path);
+  }
+
+  mem_safe_free(link_path);
+  mem_safe_free(tmp_path);
+  return ret;
+}
+
+static bool make_pkg_dir(char **pkg_dir, const char *name) {
+  char *store     = NULL;
+  char *pkgs_path = NULL;
+
+  store_dypath(&store);
+  store_dypkgdir(pkg_dir, name);
+  os_fs_path_dyconcat(&pkgs_path, 2, store, "pkgs");
+
+  bool ret = make_dir(store) && make_dir(pkgs_path) && make_dir(*pkg_dir);
+
+  if (!ret) {
+    cli_out_error("Unable to create directory in '%s'", *pkg_dir);
+  }
+
+  mem_safe_free(store);
+  mem_safe_free(pkgs_path);
+  return ret;
+}
+
+// The active version of the caller's package is copied to a new version in
+// the store, which becomes the one new installs link to. Older versions are
+// kept, as users may still be linked to them
+static bool publish_pkg(const char *name) {
+  char       *pkg_path      = NULL;
+  char       *artifact_path = NULL;
+  char       *pkg_dir       = NULL;
+  char       *ver_path      = NULL;
+  char       *manifest_path = NULL;
+  char       *store_ver     = NULL;
+  recipe_t    recipe        = {0};
+  util_lock_t pkg_lock      = {0};
+  bool        ret           = false;
+  char        ver_name[32];
+
+  if (!valid_name(name) || !util_lock_pkg(&pkg_lock, name, false, LOG_ON)) {
+    return false;
+  }
+
+  os_fs_tm_dypkg(&pkg_path, name);
+  os_fs_path_dyconcat(&artifact_path, 2, pkg_path, "recipe.tarman");
+
+  if (TM_CFG_PARSE_STATUS_OK != pkg_parse_tmrcp(&recipe, artifact_path)) {
+    cli_out_error("Package '%s' is not installed", name);
+    goto cleanup;
+  }
+
+  if (store_find(&store_ver, name, recipe)) {
+    cli_out_success("Package '%s' is already in the store", name);
+    ret = true;
+    goto cleanup;
+  }
+
+  if (!make_pkg_dir(&pkg_dir, name)) {
+    goto cleanup;
+  }
+
+  size_t version = next_version(pkg_dir);
+  snprintf(ver_name, sizeof ver_name, "%zu", version);
+  os_fs_path_dyconcat(&ver_path, 2, pkg_dir, ver_name);
+  os_fs_path_dyconcat(&manifest_path, 2, ver_path, TM_MANIFEST_FILE);
+  cli_out_progress("Copying package '%s' to '%s'", name, ver_path);
+
+  // Modes change on the way, so the manifest is created again
+  if (!copy_tree(ver_path, pkg_path)) {
+    cli_out_error("Unable to copy package '%s' to '%s'", name, ver_path);
+    os_fs_dir_rm(ver_path);
+    goto cleanup;
+  }
+
+  os_fs_file_rm(manifest_path);
+
+  if (!util_pkg_create_manifest(ver_path, LOG_ON) ||
+      TM_FS_FILEOP_STATUS_OK !=
+          os_fs_file_chmod(manifest_path, STORE_FILE_MODE) ||
+      !activate(pkg_dir, version)) {
+    cli_out_error("Unable to publish package '%s'", name);
+    os_fs_dir_rm(ver_path);
+    goto cleanup;
+  }
+
+  cli_out_success("Package '%s' published as version %s", name, ver_name);
+  ret = true;
+
+cleanup:
+  mem_safe_free(pkg_path);
+  mem_safe_free(artifact_path);
+  mem_safe_free(pkg_dir);
+  mem_safe_free(ver_path);
+  mem_safe_free(manifest_path);
+  mem_safe_free(store_ver);
+  pkg_free_rcp(recipe);
+  util_lock_release(&pkg_lock);
+  return ret;
+}
+
+// Users linked to the package keep a dangling link until they update or
+// reinstall it, which falls back to a private copy
+static bool remove_pkg(const char *name) {
+  char         *pkg_dir = NULL;
+  fs_filetype_t type;
+  bool          ret = false;
+
+  if (!valid_name(name)) {
+    return false;
+  }
+
+  store_dypkgdir(&pkg_dir, name);
+
+  if (TM_FS_FILEOP_STATUS_OK != os_fs_file_gettype(&type, pkg_dir) ||
+      TM_FS_FILETYPE_DIR != type) {
+    cli_out_error("Package '%s' is not in the store", name);
+    goto cleanup;
+  }
+
+  cli_out_progress("Removing store directory '%s'", pkg_dir);
+
+  if (TM_FS_DIROP_STATUS_OK != os_fs_dir_rm(pkg_dir)) {
+    cli_out_error("Unable to remove store directory '%s'", pkg_dir);
+    goto cleanup;
+  }
+
+  cli_out_success("Package '%s' removed from the store", name);
+  ret = true;
+
+cleanup:
+  mem_safe_free(pkg_dir);
+  return ret;
+}
+
+static int list_store(const char *store) {
+  char             *pkgs_path = NULL;
+  os_fs_dirstream_t stream;
+  fs_dirent_t       ent;
+
+  os_fs_path_dyconcat(&pkgs_path, 2, store, "pkgs");
+
+  if (TM_FS_DIROP_STATUS_OK != os_fs_dir_open(&stream, pkgs_path)) {
+    cli_out_error("Unable to access store directory '%s'", pkgs_path);
+    mem_safe_free(pkgs_path);
+    return EXIT_FAILURE;
+  }
+
+  while (TM_FS_DIROP_STATUS_OK == os_fs_dir_next(stream, &ent)) {
+    char    *ver_path      = NULL;
+    char    *artifact_path = NULL;
+    recipe_t recipe        = {0};
+
+    if (TM_FS_FILETYPE_DIR != ent.file_type ||
+        !store_dyactive(&ver_path, ent.name)) {
+      continue;
+    }
+
+    os_fs_path_dyconcat(&artifact_path, 2, ver_path, "recipe.tarman");
+    pkg_parse_tmrcp(&recipe, artifact_path);
+    printf(" --- %s", ent.name);
+
+    if (NULL != recipe.version) {
+      printf(" %s", recipe.version);
+    }
+
+    cli_out_newline();
+    mem_safe_free(ver_path);
+    mem_safe_free(artifact_path);
+    pkg_free_rcp(recipe);
+  }
+
+  os_fs_dir_close(stream);
+  mem_safe_free(pkgs_path);
+  return EXIT_SUCCESS;
+}
+
+static bool publish_all(size_t *failed) {
+  char             *pkgs_path = NULL;
+  os_fs_dirstream_t stream;
+  fs_dirent_t       ent;
+
+  os_fs_tm_dypkgs(&pkgs_path);
+
+  if (TM_FS_DIROP_STATUS_OK != os_fs_dir_open(&stream, pkgs_path)) {
+    cli_out_error("Unable to access package directory '%s'", pkgs_path);
+    mem_safe_free(pkgs_path);
+    return false;
+  }
+
+  while (TM_FS_DIROP_STATUS_OK == os_fs_dir_next(stream, &ent)) {
+    if (TM_FS_FILETYPE_DIR == ent.file_type && !publish_pkg(ent.name)) {
+      (*failed)++;
+    }
+  }
+
+  os_fs_dir_close(stream);
+  mem_safe_free(pkgs_path);
+  return true;
+}
+
+int cli_cmd_store(cli_info_t info) {
+  const char *action     = (0 < info.num_inputs) ? info.inputs[0] : "";
+  bool        is_publish = 0 == strcmp(action, "publish");
+  bool        is_remove  = 0 == strcmp(action, "remove");
+  char       *store      = NULL;
+  util_lock_t registry   = {0};
+  size_t      failed     = 0;
+  int         ret        = EXIT_FAILURE;
+
+  if (!is_publish && !is_remove && 0 != strcmp(action, "list")) {
+    cli_out_error("Use 'tarman store publish <pkg name>...', 'tarman store "
+                  "remove <pkg name>...' or 'tarman store list'");
+    return EXIT_FAILURE;
+  }
+
+  if (0 == store_dypath(&store)) {
+    cli_out_error("The system store is disabled, '%s' is empty", TM_STORE_ENV);
+    return EXIT_FAILURE;
+  }
+
+  if (!is_publish && !is_remove) {
+    ret = list_store(store);
+    goto cleanup;
+  }
+
+  if (1 == info.num_inputs && !(is_publish && info.all)) {
+    cli_out_error("You must specify the packages to %s%s",
+                  action,
+                  is_publish ? " or use '--all'" : "");
+    goto cleanup;
+  }
+
+  if (!os_fs_tm_init()) {
+    cli_out_error("Failed to inizialize host file system");
+    goto cleanup;
+  }
+
+  if (!util_lock_registry(&registry, false, LOG_ON)) {
+    goto cleanup;
+  }
+
+  if (is_publish && info.all && !publish_all(&failed)) {
+    goto cleanup;
+  }
+
+  for (size_t i = 1; i < info.num_inputs; i++) {
+    if (!(is_publish ? publish_pkg(info.inputs[i])
+                     : remove_pkg(info.inputs[i]))) {
+      failed++;
+    }
+  }
+
+  if (0 != failed) {
+    char num_buf[32];
+    snprintf(num_buf, sizeof num_buf, "%zu", failed);
+    cli_out_error("Unable to %s %s package(s)", action, num_buf);
+    goto cleanup;
+  }
+
+  ret = EXIT_SUCCESS;
+
+cleanup:
+  mem_safe_free(store);
+  util_lock_release(&registry);
+  return ret;
+}
@@ -0,0 +1,76 @@
+/*************************************************************************
+| tarman                                                                 |
+| Copyright (C) 2024 Alessandro Salerno                                  |
+|                                                                        |
+| This program is free software: you can redistribute it and/or modify   |
+| it under the terms of the GNU General Public License as published by   |
+| the Free Software Foundation, either version 3 of the License, or      |
+| (at your option) any later version.                                    |
+|                                                                        |
+| This program is distributed in the hope that it will be useful,        |
+| but WITHOUT ANY WARRANTY; without even the implied warranty of         |
+| MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the          |
+| GNU General Public License for more details.                           |
+|                                                                        |
+| You should have received a copy of the GNU General Public License      |
+| along with this program.  If not, see <https://www.gnu.org/licenses/>. |
+*************************************************************************/
+
+#include <stdbool.h>
+#include <stdlib.h>
+
+#include "cli/directives/commands.h"
+#include "cli/directives/types.h"
+#include "cli/output.h"
+#include "os/fs.h"
+#include "tm-mem.h"
+#include "util/lock.h"
+#include "util/pkg.h"
+#include "util/repo.h"
+
+static bool update_all(void) {
+  char             *repos_path = NULL;
+  bool              ret        = true;
+  os_fs_dirstream_t stream;
+  fs_dirent_t       ent;
+
+  os_fs_tm_dyrepos(&repos_path);
+
+  if (TM_FS_DIROP_STATUS_OK != os_fs_dir_open(&stream, repos_path)) {
+    cli_out_error("Unable to access repository directory '%s'", repos_path);
+    mem_safe_free(repos_path);
+    return false;
+  }
+
+  while (TM_FS_DIROP_STATUS_OK == os_fs_dir_next(stream, &ent)) {
+    if (TM_FS_FILETYPE_DIR == ent.file_type &&
+        !util_repo_sync(ent.name, LOG_ON)) {
+      ret = false;
+    }
+  }
+
+  os_fs_dir_close(stream);
+  mem_safe_free(repos_path);
+  return ret;
+}
+
+int cli_cmd_update_repo(cli_info_t info) {
+  cli_out_progress("Initializing host file system");
+
+  if (!os_fs_tm_init()) {
+    cli_out_error("Failed to inizialize host file system");
+    return EXIT_FAILURE;
+  }
+
+  util_lock_t registry = {0};
+  bool        ok       = false;
+
+  if (!util_lock_registry(&registry, true, LOG_ON)) {
+    return EXIT_FAILURE;
+  }
+
+  ok = (NULL == info.input) ? update_all()
+                            : util_repo_sync(info.input, LOG_ON);
+  util_lock_release(&registry);
+  return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
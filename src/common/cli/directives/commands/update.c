@@ -16,6 +16,8 @@
 | along with this program.  If not, see <https://www.gnu.org/licenses/>. |
 *************************************************************************/
 
+#include <stdbool.h>
+#include <stdio.h>
 #include <stdlib.h>
 
 #include "archive.h"
@@ -24,12 +26,56 @@
 #include "cli/output.h"
 #include "config.h"
 #include "download.h"
+#include "manifest.h"
 #include "os/fs.h"
 #include "package.h"
+#include "store.h"
 #include "tm-mem.h"
+#include "util/lock.h"
 #include "util/misc.h"
 #include "util/pkg.h"
 
+// Files that did not change since the previous version are hard linked from
+// it. Returns false if the package has to be extracted from scratch
+static bool extract_from_previous(const char *ver_path,
+                                  const char *prev_path,
+                                  const char *archive_path,
+                                  recipe_t    recipe) {
+  char      *manifest_path = NULL;
+  manifest_t manifest      = {0};
+  tar_opts_t opts          = {0};
+  bool       ret           = false;
+
+  os_fs_path_dyconcat(&manifest_path, 2, prev_path, TM_MANIFEST_FILE);
+
+  if (!manifest_dyload(&manifest, manifest_path)) {
+    goto cleanup;
+  }
+
+  cli_out_progress("Extracting archive '%s' to '%s' against previous version",
+                   archive_path,
+                   ver_path);
+  opts.manifest = &manifest;
+  opts.base     = prev_path;
+
+  if (!(ret = archive_update(
+            ver_path, archive_path, recipe.package_format, &opts))) {
+    cli_out_warning("Unable to reuse files from the previous version, the "
+                    "archive will be extracted in full");
+    goto cleanup;
+  }
+
+  char unchanged[32], written[32];
+  snprintf(unchanged, sizeof unchanged, "%zu", opts.num_unchanged);
+  snprintf(written, sizeof written, "%zu", opts.num_written);
+  cli_out_progress("Files: %s unchanged, %s written", unchanged, written);
+
+cleanup:
+  mem_safe_free(manifest_path);
+  manifest_free(manifest);
+  return ret;
+}
+
 int cli_cmd_update(cli_info_t info) {
   int         ret              = EXIT_FAILURE;
   const char *pkg_name         = info.input;
@@ -37,7 +83,12 @@ int cli_cmd_update(cli_info_t info) {
   char       *tmp_archive_path = NULL;
   char       *artifact_path    = NULL;
   char       *pkg_rcp_path     = NULL;
+  char       *ver_path         = NULL;
+  char       *store_ver        = NULL;
+  size_t      version          = 0;
   recipe_t    recipe_artifact  = {0};
+  util_lock_t registry         = {0};
+  util_lock_t pkg_lock         = {0};
 
   if (NULL == pkg_name) {
     cli_out_error("You must specify a package name for it to be removed. Use "
@@ -52,6 +103,11 @@ int cli_cmd_update(cli_info_t info) {
     return ret;
   }
 
+  if (!util_lock_registry(&registry, false, LOG_ON) ||
+      !util_lock_pkg(&pkg_lock, pkg_name, true, LOG_ON)) {
+    goto cleanup;
+  }
+
   os_fs_tm_dypkg(&pkg_path, pkg_name);
 
   os_fs_path_dyconcat(&artifact_path, 2, pkg_path, "recipe.tarman");
@@ -72,6 +128,14 @@ int cli_cmd_update(cli_info_t info) {
                             LOG_ON)) {
     cli_out_warning("Updating using package metadata (recipe artifact) instead "
                     "of repository recipe");
+
+    // These describe the archive that is currently installed
+    mem_safe_free(recipe_artifact.archive_sha256);
+    mem_safe_free(recipe_artifact.delta_url);
+    mem_safe_free(recipe_artifact.delta_format);
+    recipe_artifact.archive_sha256 = NULL;
+    recipe_artifact.delta_url      = NULL;
+    recipe_artifact.delta_format   = NULL;
   }
 
   if (NULL == recipe_artifact.pkg_info.url ||
@@ -82,39 +146,62 @@ int cli_cmd_update(cli_info_t info) {
     goto cleanup;
   }
 
-  if (!util_pkg_fetch_archive(&tmp_archive_path,
-                              pkg_name,
-                              recipe_artifact.package_format,
-                              recipe_artifact.pkg_info.url,
-                              LOG_ON)) {
+  if (store_find(&store_ver, pkg_name, recipe_artifact)) {
+    cli_out_progress("Using package '%s' from the system store '%s'",
+                     pkg_name,
+                     store_ver);
+  } else if (!util_pkg_fetch_update(
+                 &tmp_archive_path, pkg_name, &recipe_artifact, LOG_ON)) {
     goto cleanup;
   }
 
-  cli_out_progress("Removing old package directory '%s'", pkg_path);
-
-  if (TM_FS_DIROP_STATUS_OK != os_fs_dir_rm(pkg_path)) {
-    cli_out_error("Unable to remove package directory '%s'", pkg_path);
+  if (!util_pkg_create_version(&ver_path, &version, pkg_name, LOG_ON)) {
     goto cleanup;
   }
 
-  if (!util_pkg_create_directory_from_path(pkg_path, LOG_ON, INPUT_OFF)) {
-    goto cleanup;
-  }
+  // The package may have just been moved to its first version
+  mem_safe_free(pkg_path);
+  os_fs_tm_dypkg(&pkg_path, pkg_name);
 
-  cli_out_progress(
-      "Extracting archive '%s' to '%s'", tmp_archive_path, pkg_path);
+  if (NULL != store_ver) {
+    if (!store_link(ver_path, store_ver, LOG_ON)) {
+      os_fs_dir_rm(ver_path);
+      goto cleanup;
+    }
+  } else if (!extract_from_previous(
+                 ver_path, pkg_path, tmp_archive_path, recipe_artifact)) {
+    if (TM_FS_DIROP_STATUS_OK != os_fs_dir_rm(ver_path) ||
+        !util_pkg_create_directory_from_path(ver_path, LOG_QUIET, INPUT_OFF)) {
+      cli_out_error("Unable to clear package directory '%s'", ver_path);
+      goto cleanup;
+    }
 
-  if (!archive_extract(
-          pkg_path, tmp_archive_path, recipe_artifact.package_format)) {
-    cli_out_error("Unable to extract archive, package has been removed but not "
-                  "reinstalled, sorry");
-    goto cleanup;
+    cli_out_progress(
+        "Extracting archive '%s' to '%s'", tmp_archive_path, ver_path);
+
+    if (!archive_extract(ver_path,
+                         tmp_archive_path,
+                         recipe_artifact.package_format,
+                         NULL)) {
+      cli_out_error("Unable to extract archive, the previous version of the "
+                    "package is still in use");
+      os_fs_dir_rm(ver_path);
+      goto cleanup;
+    }
   }
 
-  os_fs_path_dyconcat(&pkg_rcp_path, 2, pkg_path, "recipe.tarman");
+  os_fs_path_dyconcat(&pkg_rcp_path, 2, ver_path, "recipe.tarman");
   cli_out_progress("Creating recipe artifact in '%s'", pkg_rcp_path);
   pkg_dump_rcp(pkg_rcp_path, recipe_artifact);
 
+  if (NULL == store_ver) {
+    util_pkg_create_manifest(ver_path, LOG_ON);
+  }
+
+  if (!util_pkg_activate_version(pkg_name, version, LOG_ON)) {
+    goto cleanup;
+  }
+
   if (NULL != recipe_artifact.pkg_info.executable_path) {
     char *exec_full_path = NULL;
     os_fs_path_dyconcat(
@@ -136,20 +223,27 @@ int cli_cmd_update(cli_info_t info) {
     mem_safe_free(exec_full_path);
   }
 
-  cli_out_progress("Removing cache '%s'", tmp_archive_path);
-
-  if (TM_FS_FILEOP_STATUS_OK != os_fs_file_rm(tmp_archive_path)) {
-    cli_out_warning("Unable to remove cache");
+  if (NULL != tmp_archive_path) {
+    util_pkg_keep_archive(tmp_archive_path, pkg_name, recipe_artifact, LOG_ON);
   }
 
-  cli_out_success("Package '%s' updated successfully", tmp_archive_path);
+  cli_out_success("Package '%s' updated successfully", pkg_name);
   ret = EXIT_SUCCESS;
 
 cleanup:
+  // Kept or removed above on success
+  if (EXIT_SUCCESS != ret && NULL != tmp_archive_path) {
+    os_fs_file_rm(tmp_archive_path);
+  }
+
   mem_safe_free(pkg_path);
   mem_safe_free(tmp_archive_path);
   mem_safe_free(artifact_path);
   mem_safe_free(pkg_rcp_path);
+  mem_safe_free(ver_path);
+  mem_safe_free(store_ver);
   pkg_free_rcp(recipe_artifact);
+  util_lock_release(&pkg_lock);
+  util_lock_release(&registry);
   return ret;
 }
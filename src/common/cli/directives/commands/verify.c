@@ -0,0 +1,155 @@
+/*************************************************************************
+| tarman                                                                 |
+| Copyright (C) 2024 Alessandro Salerno                                  |
+|                                                                        |
+| This program is free software: you can redistribute it and/or modify   |
+| it under the terms of the GNU General Public License as published by   |
+| the Free Software Foundation, either version 3 of the License, or      |
+| (at your option) any later version.                                    |
+|                                                                        |
+| This program is distributed in the hope that it will be useful,        |
+| but WITHOUT ANY WARRANTY; without even the implied warranty of         |
+| MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the          |
+| GNU General Public License for more details.                           |
+|                                                                        |
+| You should have received a copy of the GNU General Public License      |
+| along with this program.  If not, see <https://www.gnu.org/licenses/>. |
+*************************************************************************/
+
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "cli/directives/commands.h"
+#include "cli/directives/types.h"
+#include "cli/output.h"
+#include "manifest.h"
+#include "os/fs.h"
+#include "tm-mem.h"
+#include "util/lock.h"
+#include "util/pkg.h"
+
+static bool verify_pkg(const char *pkg_name) {
+  char              *pkg_path      = NULL;
+  char              *manifest_path = NULL;
+  manifest_t         manifest      = {0};
+  manifest_status_t *statuses      = NULL;
+  size_t             num_bad       = 0;
+  bool               ret           = false;
+  util_lock_t        pkg_lock      = {0};
+
+  if (!util_lock_pkg(&pkg_lock, pkg_name, false, LOG_ON)) {
+    return false;
+  }
+
+  os_fs_tm_dypkg(&pkg_path, pkg_name);
+  os_fs_path_dyconcat(&manifest_path, 2, pkg_path, TM_MANIFEST_FILE);
+  cli_out_progress("Verifying package '%s'", pkg_name);
+
+  if (!manifest_dyload(&manifest, manifest_path)) {
+    cli_out_error("Package '%s' is not installed or has no valid file "
+                  "manifest. Reinstall or update it to create one",
+                  pkg_name);
+    goto cleanup;
+  }
+
+  statuses = (manifest_status_t *)malloc((manifest.count + 1) *
+                                         sizeof(manifest_status_t));
+  mem_chkoom(statuses);
+  manifest_check(statuses, manifest, pkg_path);
+
+  for (size_t i = 0; i < manifest.count; i++) {
+    const char *path = manifest.entries[i].path;
+
+    switch (statuses[i]) {
+    case TM_MANIFEST_STATUS_MISSING:
+      cli_out_warning("Missing file '%s'", path);
+      break;
+
+    case TM_MANIFEST_STATUS_MODIFIED:
+      cli_out_warning("Modified file '%s'", path);
+      break;
+
+    case TM_MANIFEST_STATUS_MODE:
+      cli_out_warning("Changed permissions on file '%s'", path);
+      break;
+
+    default:
+      continue;
+    }
+
+    num_bad++;
+  }
+
+  char count_buf[32];
+
+  if (0 != num_bad) {
+    snprintf(count_buf, sizeof count_buf, "%zu", num_bad);
+    cli_out_error("Package '%s' failed verification, %s file(s) differ from "
+                  "the manifest",
+                  pkg_name,
+                  count_buf);
+    goto cleanup;
+  }
+
+  snprintf(count_buf, sizeof count_buf, "%zu", manifest.count);
+  cli_out_success("Package '%s' is intact (%s files)", pkg_name, count_buf);
+  ret = true;
+
+cleanup:
+  mem_safe_free(pkg_path);
+  mem_safe_free(manifest_path);
+  mem_safe_free(statuses);
+  manifest_free(manifest);
+  util_lock_release(&pkg_lock);
+  return ret;
+}
+
+static bool verify_all(void) {
+  char             *pkgs_path = NULL;
+  bool              ret       = true;
+  os_fs_dirstream_t stream;
+  fs_dirent_t       ent;
+
+  os_fs_tm_dypkgs(&pkgs_path);
+
+  if (TM_FS_DIROP_STATUS_OK != os_fs_dir_open(&stream, pkgs_path)) {
+    cli_out_error("Unable to access package directory '%s'", pkgs_path);
+    mem_safe_free(pkgs_path);
+    return false;
+  }
+
+  while (TM_FS_DIROP_STATUS_OK == os_fs_dir_next(stream, &ent)) {
+    if (TM_FS_FILETYPE_DIR == ent.file_type && !verify_pkg(ent.name)) {
+      ret = false;
+    }
+  }
+
+  os_fs_dir_close(stream);
+  mem_safe_free(pkgs_path);
+  return ret;
+}
+
+int cli_cmd_verify(cli_info_t info) {
+  if (NULL == info.input && !info.all) {
+    cli_out_error("You must specify a package name or use '--all'. Use "
+                  "'tarman verify <pkg name>' or 'tarman verify --all'");
+    return EXIT_FAILURE;
+  }
+
+  if (!os_fs_tm_init()) {
+    cli_out_error("Failed to inizialize host file system");
+    return EXIT_FAILURE;
+  }
+
+  util_lock_t registry = {0};
+  bool        ok       = false;
+
+  if (!util_lock_registry(&registry, false, LOG_ON)) {
+    return EXIT_FAILURE;
+  }
+
+  ok = (info.all) ? verify_all() : verify_pkg(info.input);
+  util_lock_release(&registry);
+  return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -26,35 +26,55 @@
 #include "cli/directives/types.h"
 
 static cli_drt_desc_t commands[] = {
-    {NULL, TARMAN_CMD_HELP, NULL, false, cli_cmd_help, "Show this menu"},
+    {NULL, TARMAN_CMD_HELP, NULL, false, cli_cmd_help, "Show this menu", false},
 
     {NULL,
      TARMAN_CMD_INSTALL,
      NULL,
      false,
      cli_cmd_install,
-     "Install a package"},
+     "Install a package",
+     false},
+
+    {NULL,
+     TARMAN_CMD_FETCH,
+     NULL,
+     false,
+     cli_cmd_fetch,
+     "Download the archives of packages now, to install them later",
+     true},
 
     {NULL,
      TARMAN_CMD_LIST,
      NULL,
      false,
      cli_cmd_list,
-     "List all installed packages"},
+     "List all installed packages",
+     false},
 
     {NULL,
      TARMAN_CMD_REMOVE,
      NULL,
      false,
      cli_cmd_remove,
-     "Remove an installed package"},
+     "Remove an installed package",
+     false},
 
     {NULL,
      TARMAN_CMD_UPDATE,
      NULL,
      false,
      cli_cmd_update,
-     "Update an installed package"},
+     "Update an installed package",
+     false},
+
+    {NULL,
+     TARMAN_CMD_ROLLBACK,
+     NULL,
+     false,
+     cli_cmd_rollback,
+     "Go back to the previous version of an installed package",
+     false},
 
     // {NULL,
     //  TARMAN_CMD_UPDATE_ALL,
@@ -68,14 +88,24 @@ static cli_drt_desc_t commands[] = {
      NULL,
      false,
      cli_cmd_add_repo,
-     "Add a remote repository to the local database"},
+     "Add a remote repository to the local database",
+     false},
 
     {NULL,
      TARMAN_CMD_REMOVE_REPO,
      NULL,
      false,
      cli_cmd_remove_repo,
-     "Remove a local repository"},
+     "Remove a local repository",
+     false},
+
+    {NULL,
+     TARMAN_CMD_UPDATE_REPO,
+     NULL,
+     false,
+     cli_cmd_update_repo,
+     "Update one or all local repositories from their source",
+     false},
 
     // {NULL,
     //  TARMAN_CMD_LIST_REPOS,
@@ -84,12 +114,61 @@ static cli_drt_desc_t commands[] = {
     //  cli_cmd_list_repos,
     //  "List all local repositories"},
 
+    {NULL,
+     TARMAN_CMD_VERIFY,
+     NULL,
+     false,
+     cli_cmd_verify,
+     "Check installed package files against their manifest",
+     false},
+
+    {NULL,
+     TARMAN_CMD_OUTDATED,
+     NULL,
+     false,
+     cli_cmd_outdated,
+     "List installed packages that have a newer version available",
+     false},
+
+    {NULL,
+     TARMAN_CMD_BATCH,
+     NULL,
+     false,
+     cli_cmd_batch,
+     "Run the commands listed in a file (or stdin) in one process",
+     false},
+
+    {NULL,
+     TARMAN_CMD_BUNDLE,
+     NULL,
+     false,
+     cli_cmd_bundle,
+     "Export installed packages to a single file, or install such a file",
+     true},
+
+    {NULL,
+     TARMAN_CMD_SERVE_CACHE,
+     NULL,
+     false,
+     cli_cmd_serve_cache,
+     "Share fetched archives with other machines over HTTP (read-only)",
+     false},
+
+    {NULL,
+     TARMAN_CMD_STORE,
+     NULL,
+     false,
+     cli_cmd_store,
+     "Share installed packages with all users through the system store",
+     true},
+
     {NULL,
      TARMAN_CMD_VERSION,
      NULL,
      false,
      cli_cmd_version,
-     "Show version information"},
+     "Show version information",
+     false},
 };
 // {NULL, TARMAN_CMD_TEST, NULL, false, cli_cmd_test, "Test tarman"}};
 
@@ -99,35 +178,40 @@ static cli_drt_desc_t options[] = {
      cli_opt_from_url,
      false,
      NULL,
-     "[Install] Use URL as package input and perform download"},
+     "[Install] Use URL as package input and perform download",
+     false},
 
     {TARMAN_SOPT_FROM_REPO,
      TARMAN_FOPT_FROM_REPO,
      cli_opt_from_repo,
      false,
      NULL,
-     "[Install] use package name as input and perform local repository lookup"},
+     "[Install] use package name as input and perform local repository lookup",
+     false},
 
     {TARMAN_SOPT_PKG_NAME,
      TARMAN_FOPT_PKG_NAME,
      cli_opt_pkg_name,
      true,
      NULL,
-     "[Install] Specify package name"},
+     "[Install] Specify package name",
+     false},
 
     {TARMAN_SOPT_APP_NAME,
      TARMAN_FOPT_APP_NAME,
      cli_opt_app_name,
      true,
      NULL,
-     "[Install] Specify application name"},
+     "[Install] Specify application name",
+     false},
 
     {TARMAN_SOPT_EXEC,
      TARMAN_FOPT_EXEC,
      cli_opt_exec,
      true,
      NULL,
-     "[Install] Specify relative path to executable"},
+     "[Install] Specify relative path to executable",
+     false},
 
     {TARMAN_SOPT_WRK_DIR,
      TARMAN_FOPT_WRK_DIR,
@@ -135,42 +219,80 @@ static cli_drt_desc_t options[] = {
      true,
      NULL,
      "[Install] Specify a relative directory to use as WD for the desktop "
-     "application"},
+     "application",
+     false},
 
     {TARMAN_SOPT_ICON,
      TARMAN_FOPT_ICON,
      cli_opt_icon,
      true,
      NULL,
-     "[Install] Specify realtive path to icon file for desktop application"},
+     "[Install] Specify realtive path to icon file for desktop application",
+     false},
 
     {TARMAN_SOPT_ADD_PATH,
      TARMAN_FOPT_ADD_PATH,
      cli_opt_add_path,
      false,
      NULL,
-     "[Install] Add package executable to PATH"},
+     "[Install] Add package executable to PATH",
+     false},
 
     {TARMAN_SOPT_ADD_DESKTOP,
      TARMAN_FOPT_ADD_DESKTOP,
      cli_opt_add_desktop,
      false,
      NULL,
-     "[Install] Add package as desktop application"},
+     "[Install] Add package as desktop application",
+     false},
 
     {TARMAN_SOPT_ADD_TARMAN,
      TARMAN_FOPT_ADD_TARMAN,
      cli_opt_add_tarman,
      false,
      NULL,
-     "[Install] Add package to tarman plugins"},
+     "[Install] Add package to tarman plugins",
+     false},
+
+    {TARMAN_SOPT_YES,
+     TARMAN_FOPT_YES,
+     cli_opt_yes,
+     false,
+     NULL,
+     "[Install/Remove] Reinstall or remove without asking for confirmation",
+     false},
+
+    {NULL,
+     TARMAN_FOPT_ALL,
+     cli_opt_all,
+     false,
+     NULL,
+     "[Verify/Bundle/Store] Apply to all installed packages",
+     false},
+
+    {NULL,
+     TARMAN_FOPT_HEADLESS,
+     cli_opt_headless,
+     false,
+     NULL,
+     "Never prompt: infer missing information and assume default answers",
+     false},
+
+    {NULL,
+     TARMAN_FOPT_OFFLINE,
+     cli_opt_offline,
+     false,
+     NULL,
+     "[Install/Update] Only use recipes and archives already on this machine",
+     false},
 
     {TARMAN_SOPT_PKG_FMT,
      TARMAN_FOPT_PKG_FMT,
      cli_opt_pkg_fmt,
      true,
      NULL,
-     "Specify archive format (e.g., tar.gz, tar.xz, zip)"},
+     "Specify archive format (e.g., tar.gz, tar.xz, zip)",
+     false},
 };
 
 static bool find_desc(cli_drt_desc_t  descriptors[],
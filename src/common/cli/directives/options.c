@@ -107,3 +107,27 @@ bool cli_opt_add_tarman(cli_info_t *info, const char *next) {
   info->add_tarman = true;
   return true;
 }
+
+bool cli_opt_yes(cli_info_t *info, const char *next) {
+  (void)next;
+  info->yes = true;
+  return true;
+}
+
+bool cli_opt_all(cli_info_t *info, const char *next) {
+  (void)next;
+  info->all = true;
+  return true;
+}
+
+bool cli_opt_headless(cli_info_t *info, const char *next) {
+  (void)next;
+  info->headless = true;
+  return true;
+}
+
+bool cli_opt_offline(cli_info_t *info, const char *next) {
+  (void)next;
+  info->offline = true;
+  return true;
+}
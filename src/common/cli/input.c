@@ -26,6 +26,10 @@
 #include "cli/output.h"
 #include "stream.h"
 
+// When set, yes/no questions are not asked and their default answer
+// is assumed
+static bool headless = false;
+
 static void clear_input_stream(void) {
   char ch = 0;
   while (32 < (ch = getchar()) && !feof(stdin))
@@ -72,14 +76,30 @@ int cli_in_int(const char *msg, int range_min, int range_max) {
   }
 }
 
-bool cli_in_bool(const char *msg) {
+void cli_in_set_headless(bool value) {
+  headless = value;
+}
+
+bool cli_in_bool(const char *msg, bool dflt) {
+  if (headless) {
+    cli_out_progress(dflt ? "%s Yes" : "%s No", msg);
+    return dflt;
+  }
+
   while (true) {
     char input = 0;
 
     cli_out_newline();
-    cli_out_prompt("%s [Y/n]:", msg);
+    cli_out_prompt(dflt ? "%s [Y/n]:" : "%s [y/N]:", msg);
 
     if (1 != scanf("%c", &input)) {
+      // Without input (e.g., in a batch script) there is no one to
+      // answer, so the safe choice is assumed
+      if (feof(stdin)) {
+        cli_out_newline();
+        return false;
+      }
+
       clear_input_stream();
       cli_out_error("I/O Error: invalid input");
       continue;
@@ -87,7 +107,7 @@ bool cli_in_bool(const char *msg) {
 
     if ('\n' == input) {
       cli_out_newline();
-      return true;
+      return dflt;
     }
 
     clear_input_stream();
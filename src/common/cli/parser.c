@@ -19,9 +19,26 @@
 #include <stdio.h>
 #include <stdlib.h>
 
+#include "cli/directives/commands.h"
 #include "cli/directives/lookup.h"
+#include "cli/input.h"
 #include "cli/output.h"
 #include "cli/parser.h"
+#include "config.h"
+#include "download.h"
+#include "os/fs.h"
+#include "settings.h"
+#include "tm-mem.h"
+
+// There cannot be more inputs than arguments
+static void push_input(cli_info_t *cli_info, const char *input, int argc) {
+  if (NULL == cli_info->inputs) {
+    cli_info->inputs = (const char **)malloc((size_t)argc * sizeof(char *));
+    mem_chkoom(cli_info->inputs);
+  }
+
+  cli_info->inputs[cli_info->num_inputs++] = input;
+}
 
 bool cli_parse(int         argc,
                char       *argv[],
@@ -54,19 +71,27 @@ bool cli_parse(int         argc,
 
     // If no mathcing option was found
     // This argument is treated as the input file
+    // A lone dash is an input too, it stands for a standard stream
     if (!cli_lkup_option(argument, &opt_desc)) {
-      if ('-' == argument[0]) {
+      if ('-' == argument[0] && '\0' != argument[1]) {
         cli_out_error("Unrecognized option '%s'. Try 'tarman help' for help",
                       argument);
         return false;
       }
 
-      if (NULL != cli_info->input) {
+      if (NULL != cli_info->input && !cmd_desc.many_inputs) {
         cli_out_error("Too many inputs");
         return false;
       }
 
-      cli_info->input = argument;
+      if (cmd_desc.many_inputs) {
+        push_input(cli_info, argument, argc);
+      }
+
+      if (NULL == cli_info->input) {
+        cli_info->input = argument;
+      }
+
       continue;
     }
 
@@ -84,3 +109,37 @@ bool cli_parse(int         argc,
 
   return true;
 }
+
+int cli_run(int argc, char *argv[]) {
+  cli_info_t cli_info        = {0};
+  cli_exec_t command_handler = NULL;
+  int        ret             = EXIT_FAILURE;
+
+  if (!cli_parse(argc, argv, &cli_info, &command_handler)) {
+    goto cleanup;
+  }
+
+  if (NULL == command_handler) {
+    ret = cli_cmd_help(cli_info);
+    goto cleanup;
+  }
+
+  cfg_parse_status_t status = settings_load();
+
+  if (TM_CFG_PARSE_STATUS_OK != status &&
+      TM_CFG_PARSE_STATUS_NOFILE != status) {
+    char *cfg_path = NULL;
+    os_fs_tm_dyconfig(&cfg_path);
+    cli_out_error("Unable to parse configuration file '%s'", cfg_path);
+    mem_safe_free(cfg_path);
+    goto cleanup;
+  }
+
+  cli_in_set_headless(cli_info.headless);
+  download_set_offline(cli_info.offline);
+  ret = command_handler(cli_info);
+
+cleanup:
+  mem_safe_free(cli_info.inputs);
+  return ret;
+}
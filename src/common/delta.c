@@ -0,0 +1,89 @@
+/*************************************************************************
+| tarman                                                                 |
+| Copyright (C) 2024 Alessandro Salerno                                  |
+|                                                                        |
+| This program is free software: you can redistribute it and/or modify   |
+| it under the terms of the GNU General Public License as published by   |
+| the Free Software Foundation, either version 3 of the License, or      |
+| (at your option) any later version.                                    |
+|                                                                        |
+| This program is distributed in the hope that it will be useful,        |
+| but WITHOUT ANY WARRANTY; without even the implied warranty of         |
+| MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the          |
+| GNU General Public License for more details.                           |
+|                                                                        |
+| You should have received a copy of the GNU General Public License      |
+| along with this program.  If not, see <https://www.gnu.org/licenses/>. |
+*************************************************************************/
+
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "delta.h"
+#include "os/exec.h"
+#include "tm-mem.h"
+
+#define PATCH_FROM_OPT "--patch-from="
+
+size_t delta_dyurl(char **dst, const char *url_template, const char *from_hash) {
+  const char *placeholder = strstr(url_template, TM_DELTA_FROM_PLACEHOLDER);
+  size_t      tmpl_len    = strlen(url_template);
+
+  // Templates without placeholder are used as they are
+  if (NULL == placeholder) {
+    char *url = (char *)malloc(tmpl_len + 1);
+    mem_chkoom(url);
+    strcpy(url, url_template);
+    *dst = url;
+    return tmpl_len;
+  }
+
+  size_t prefix_len = placeholder - url_template;
+  size_t ph_len     = strlen(TM_DELTA_FROM_PLACEHOLDER);
+  size_t bufsz      = tmpl_len - ph_len + strlen(from_hash) + 1;
+  char  *url        = (char *)malloc(bufsz * sizeof(char));
+  mem_chkoom(url);
+  snprintf(url,
+           bufsz,
+           "%.*s%s%s",
+           (int)prefix_len,
+           url_template,
+           from_hash,
+           placeholder + ph_len);
+
+  *dst = url;
+  return bufsz - 1;
+}
+
+bool delta_apply(const char *dst,
+                 const char *base,
+                 const char *patch,
+                 const char *format) {
+  if (NULL != format && 0 == strcmp(format, "bsdiff")) {
+    return EXIT_SUCCESS == os_exec("bspatch", base, dst, patch, NULL);
+  }
+
+  // zstd is the default
+  size_t bufsz    = strlen(PATCH_FROM_OPT) + strlen(base) + 1;
+  char  *base_opt = (char *)malloc(bufsz * sizeof(char));
+  mem_chkoom(base_opt);
+  snprintf(base_opt, bufsz, "%s%s", PATCH_FROM_OPT, base);
+
+  // Patches against large archives need a long window, which
+  // zstd refuses to decode unless it is explicitly allowed
+  bool ret = EXIT_SUCCESS == os_exec("zstd",
+                                     "-d",
+                                     "-f",
+                                     "-q",
+                                     "--long=31",
+                                     base_opt,
+                                     patch,
+                                     "-o",
+                                     dst,
+                                     NULL);
+
+  mem_safe_free(base_opt);
+  return ret;
+}
@@ -16,16 +16,335 @@
 | along with this program.  If not, see <https://www.gnu.org/licenses/>. |
 *************************************************************************/
 
+
 #include "download.h"
+#include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 
+#include "http.h"
 #include "os/exec.h"
 #include "plugin/plugin.h"
+#include "pool.h"
+#include "settings.h"
+#include "stream.h"
+#include "tm-mem.h"
+
+// Keeps a single unresponsive server from stalling checks
+#define TM_DOWNLOAD_CHECK_TIMEOUT "10"
+
+#define RATE_BUF_LEN 32
+
+typedef struct {
+  download_item_t **items;
+  size_t            rate; // Share of the rate limit given to each transfer
+} curl_ctx_t;
+
+// Set with '--offline', every transfer fails without touching the network
+static bool Offline = false;
+
+static char *dystrcat(const char *prefix, const char *suffix) {
+  size_t prefix_len = strlen(prefix);
+  char  *str = (char *)malloc(prefix_len + strlen(suffix) + 1);
+  mem_chkoom(str);
+  strcpy(str, prefix);
+  strcpy(&str[prefix_len], suffix);
+  return str;
+}
+
+// Returns the status code of the last response. Redirects produce one block
+// of headers per response, and only the last one describes the resource
+int download_parse_headers(FILE *stream, download_meta_t *meta) {
+  int status = 0;
+
+  while (!feof(stream)) {
+    char       *line  = NULL;
+    const char *value = NULL;
+
+    // Blank lines separate responses
+    if (0 == stream_dyreadline(stream, &line)) {
+      continue;
+    }
+
+    if (0 == strncmp(line, "HTTP/", 5)) {
+      const char *code = strchr(line, ' ');
+      status           = (NULL != code) ? atoi(code) : 0;
+      download_free_meta(*meta);
+      meta->etag          = NULL;
+      meta->last_modified = NULL;
+    } else if (NULL != (value = http_header_value(line, "etag"))) {
+      mem_safe_free(meta->etag);
+      meta->etag = dystrcat(value, "");
+    } else if (NULL != (value = http_header_value(line, "last-modified"))) {
+      mem_safe_free(meta->last_modified);
+      meta->last_modified = dystrcat(value, "");
+    }
+
+    mem_safe_free(line);
+  }
+
+  return status;
+}
+
+// A limit of 0 lets curl go as fast as it can
+static bool curl_download(const char *dst, const char *url, size_t rate) {
+  char limit[RATE_BUF_LEN];
+  snprintf(limit, sizeof limit, "%zu", rate);
+  return EXIT_SUCCESS ==
+         os_exec("curl", "-L", "--limit-rate", limit, url, "-o", dst, NULL);
+}
+
+static void curl_job(size_t index, void *ctx) {
+  curl_ctx_t      *curl = (curl_ctx_t *)ctx;
+  download_item_t *item = curl->items[index];
+
+  if (plugin_exists("download-plugin")) {
+    item->ok = download(item->dst, item->url);
+    return;
+  }
+
+  item->ok = curl_download(item->dst, item->url, curl->rate);
+}
+
+// Plain HTTP is handled in-process, everything else (HTTPS, and redirects
+// to it) is left to curl. Returns false if curl is needed
+static bool try_http(const char      *dst,
+                     const char      *url,
+                     download_meta_t *meta,
+                     bool            *ok) {
+  if (!http_supports(url)) {
+    return false;
+  }
+
+  http_transfer_t transfer = {.url = url, .dst = dst};
+  http_fetch_all(&transfer, 1);
+
+  if (TM_HTTP_RESULT_UNSUPPORTED == transfer.result) {
+    return false;
+  }
+
+  *ok = TM_HTTP_RESULT_OK == transfer.result;
+
+  if (NULL != meta) {
+    *meta = transfer.meta;
+  } else {
+    download_free_meta(transfer.meta);
+  }
+
+  return true;
+}
+
+void download_set_offline(bool offline) {
+  Offline = offline;
+}
+
+bool download_offline(void) {
+  return Offline;
+}
 
 bool download(const char *dst, const char *url) {
+  bool ok = false;
+
+  if (Offline) {
+    return false;
+  }
+
   if (plugin_exists("download-plugin")) {
     return EXIT_SUCCESS == plugin_run("download-plugin", dst, url);
   }
 
-  return EXIT_SUCCESS == os_exec("curl", "-L", url, "-o", dst, NULL);
+  if (try_http(dst, url, NULL, &ok)) {
+    return ok;
+  }
+
+  return curl_download(dst, url, settings_get()->download_rate);
+}
+
+// Plain HTTP transfers share one event loop and reuse connections to the
+// same server, the rest are downloaded in parallel by separate processes
+void download_many(download_item_t *items, size_t count) {
+  if (Offline) {
+    for (size_t i = 0; i < count; i++) {
+      items[i].ok = false;
+    }
+    return;
+  }
+
+  http_transfer_t  *transfers = (http_transfer_t *)malloc(
+      (count + 1) * sizeof(http_transfer_t));
+  download_item_t **owners = (download_item_t **)malloc(
+      (count + 1) * sizeof(download_item_t *));
+  download_item_t **rest = (download_item_t **)malloc(
+      (count + 1) * sizeof(download_item_t *));
+  size_t num_transfers = 0;
+  size_t num_rest      = 0;
+  bool   use_http      = !plugin_exists("download-plugin");
+  mem_chkoom(transfers);
+  mem_chkoom(owners);
+  mem_chkoom(rest);
+
+  for (size_t i = 0; i < count; i++) {
+    if (use_http && http_supports(items[i].url)) {
+      transfers[num_transfers] =
+          (http_transfer_t){.url = items[i].url, .dst = items[i].dst};
+      owners[num_transfers] = &items[i];
+      num_transfers++;
+    } else {
+      rest[num_rest] = &items[i];
+      num_rest++;
+    }
+  }
+
+  http_fetch_all(transfers, num_transfers);
+
+  for (size_t i = 0; i < num_transfers; i++) {
+    download_free_meta(transfers[i].meta);
+    owners[i]->ok = TM_HTTP_RESULT_OK == transfers[i].result;
+
+    if (TM_HTTP_RESULT_UNSUPPORTED == transfers[i].result) {
+      rest[num_rest] = owners[i];
+      num_rest++;
+    }
+  }
+
+  // The rate limit applies to all transfers together
+  curl_ctx_t curl  = {.items = rest, .rate = settings_get()->download_rate};
+  size_t     slots = (num_rest < pool_size()) ? num_rest : pool_size();
+
+  if (0 != curl.rate && 1 < slots) {
+    curl.rate = (curl.rate > slots) ? curl.rate / slots : 1;
+  }
+
+  pool_run(num_rest, curl_job, &curl);
+
+  mem_safe_free(transfers);
+  mem_safe_free(owners);
+  mem_safe_free(rest);
+}
+
+bool download_meta(const char *dst, const char *url, download_meta_t *meta) {
+  meta->etag          = NULL;
+  meta->last_modified = NULL;
+
+  bool ok = false;
+
+  if (Offline) {
+    return false;
+  }
+
+  // Plugins only report success, so there is nothing to collect
+  if (plugin_exists("download-plugin")) {
+    return download(dst, url);
+  }
+
+  if (try_http(dst, url, meta, &ok)) {
+    return ok;
+  }
+
+  os_proc_t proc;
+  FILE     *headers = NULL;
+  char      limit[RATE_BUF_LEN];
+  snprintf(limit, sizeof limit, "%zu", settings_get()->download_rate);
+
+  if (!os_exec_pipe(&proc,
+                    &headers,
+                    "curl",
+                    "-L",
+                    "--limit-rate",
+                    limit,
+                    "-D",
+                    "-",
+                    url,
+                    "-o",
+                    dst,
+                    NULL)) {
+    return false;
+  }
+
+  download_parse_headers(headers, meta);
+  fclose(headers);
+
+  if (EXIT_SUCCESS != os_exec_wait(proc)) {
+    download_free_meta(*meta);
+    meta->etag          = NULL;
+    meta->last_modified = NULL;
+    return false;
+  }
+
+  return true;
+}
+
+// Issues a conditional HEAD request with the validators of the last download.
+// Servers that ignore the conditions are caught by comparing the validators
+download_check_t download_check(const char *url, download_meta_t meta) {
+  if (Offline) {
+    return TM_DOWNLOAD_CHECK_ERROR;
+  }
+
+  if ((NULL == meta.etag && NULL == meta.last_modified) ||
+      !os_exec_exists("curl")) {
+    return TM_DOWNLOAD_CHECK_UNKNOWN;
+  }
+
+  // A header with no value after the colon is not sent by curl at all
+  char *if_none_match =
+      dystrcat("If-None-Match: ", (NULL != meta.etag) ? meta.etag : "");
+  char *if_modified_since = dystrcat(
+      "If-Modified-Since: ",
+      (NULL != meta.last_modified) ? meta.last_modified : "");
+
+  os_proc_t        proc;
+  FILE            *headers = NULL;
+  download_meta_t  remote  = {0};
+  download_check_t ret     = TM_DOWNLOAD_CHECK_ERROR;
+
+  if (!os_exec_pipe(&proc,
+                    &headers,
+                    "curl",
+                    "-s",
+                    "-I",
+                    "-L",
+                    "--max-time",
+                    TM_DOWNLOAD_CHECK_TIMEOUT,
+                    "-H",
+                    if_none_match,
+                    "-H",
+                    if_modified_since,
+                    url,
+                    NULL)) {
+    goto cleanup;
+  }
+
+  int status = download_parse_headers(headers, &remote);
+  fclose(headers);
+
+  if (EXIT_SUCCESS != os_exec_wait(proc)) {
+    goto cleanup;
+  }
+
+  if (304 == status) {
+    ret = TM_DOWNLOAD_CHECK_CURRENT;
+  } else if (200 > status || 300 <= status) {
+    ret = TM_DOWNLOAD_CHECK_ERROR;
+  } else if (NULL != meta.etag && NULL != remote.etag) {
+    ret = (0 == strcmp(meta.etag, remote.etag)) ? TM_DOWNLOAD_CHECK_CURRENT
+                                                : TM_DOWNLOAD_CHECK_CHANGED;
+  } else if (NULL != meta.last_modified && NULL != remote.last_modified) {
+    ret = (0 == strcmp(meta.last_modified, remote.last_modified))
+              ? TM_DOWNLOAD_CHECK_CURRENT
+              : TM_DOWNLOAD_CHECK_CHANGED;
+  } else {
+    ret = TM_DOWNLOAD_CHECK_UNKNOWN;
+  }
+
+cleanup:
+  mem_safe_free(if_none_match);
+  mem_safe_free(if_modified_since);
+  download_free_meta(remote);
+  return ret;
+}
+
+void download_free_meta(download_meta_t meta) {
+  mem_safe_free(meta.etag);
+  mem_safe_free(meta.last_modified);
 }
@@ -0,0 +1,256 @@
+/*************************************************************************
+| tarman                                                                 |
+| Copyright (C) 2024 Alessandro Salerno                                  |
+|                                                                        |
+| This program is free software: you can redistribute it and/or modify   |
+| it under the terms of the GNU General Public License as published by   |
+| the Free Software Foundation, either version 3 of the License, or      |
+| (at your option) any later version.                                    |
+|                                                                        |
+| This program is distributed in the hope that it will be useful,        |
+| but WITHOUT ANY WARRANTY; without even the implied warranty of         |
+| MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the          |
+| GNU General Public License for more details.                           |
+|                                                                        |
+| You should have received a copy of the GNU General Public License      |
+| along with this program.  If not, see <https://www.gnu.org/licenses/>. |
+*************************************************************************/
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "hash.h"
+#include "tm-mem.h"
+
+// Files are hashed with large sequential reads, this keeps the number of
+// syscalls low and lets the kernel read ahead
+#define HASH_READ_BUFSZ (1024 * 1024)
+
+#define ROTR(x, n) (((x) >> (n)) | ((x) << (32 - (n))))
+
+static const uint32_t K[64] = {
+    0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1,
+    0x923f82a4, 0xab1c5ed5, 0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3,
+    0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174, 0xe49b69c1, 0xefbe4786,
+    0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+    0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147,
+    0x06ca6351, 0x14292967, 0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13,
+    0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85, 0xa2bfe8a1, 0xa81a664b,
+    0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+    0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a,
+    0x5b9cca4f, 0x682e6ff3, 0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208,
+    0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2};
+
+static void transform(hash_sha256_t *ctx, const unsigned char *block) {
+  uint32_t w[64];
+
+  for (size_t i = 0; i < 16; i++) {
+    w[i] = (uint32_t)block[i * 4] << 24 | (uint32_t)block[i * 4 + 1] << 16 |
+           (uint32_t)block[i * 4 + 2] << 8 | (uint32_t)block[i * 4 + 3];
+  }
+
+  for (size_t i = 16; i < 64; i++) {
+    uint32_t s0 = ROTR(w[i - 15], 7) ^ ROTR(w[i - 15], 18) ^ (w[i - 15] >> 3);
+    uint32_t s1 = ROTR(w[i - 2], 17) ^ ROTR(w[i - 2], 19) ^ (w[i - 2] >> 10);
+    w[i]        = w[i - 16] + s0 + w[i - 7] + s1;
+  }
+
+  uint32_t a = ctx->state[0];
+  uint32_t b = ctx->state[1];
+  uint32_t c = ctx->state[2];
+  uint32_t d = ctx->state[3];
+  uint32_t e = ctx->state[4];
+  uint32_t f = ctx->state[5];
+  uint32_t g = ctx->state[6];
+  uint32_t h = ctx->state[7];
+
+  for (size_t i = 0; i < 64; i++) {
+    uint32_t s1    = ROTR(e, 6) ^ ROTR(e, 11) ^ ROTR(e, 25);
+    uint32_t ch    = (e & f) ^ (~e & g);
+    uint32_t temp1 = h + s1 + ch + K[i] + w[i];
+    uint32_t s0    = ROTR(a, 2) ^ ROTR(a, 13) ^ ROTR(a, 22);
+    uint32_t maj   = (a & b) ^ (a & c) ^ (b & c);
+    uint32_t temp2 = s0 + maj;
+
+    h = g;
+    g = f;
+    f = e;
+    e = d + temp1;
+    d = c;
+    c = b;
+    b = a;
+    a = temp1 + temp2;
+  }
+
+  ctx->state[0] += a;
+  ctx->state[1] += b;
+  ctx->state[2] += c;
+  ctx->state[3] += d;
+  ctx->state[4] += e;
+  ctx->state[5] += f;
+  ctx->state[6] += g;
+  ctx->state[7] += h;
+}
+
+void hash_sha256_init(hash_sha256_t *ctx) {
+  static const uint32_t initial[8] = {0x6a09e667,
+                                      0xbb67ae85,
+                                      0x3c6ef372,
+                                      0xa54ff53a,
+                                      0x510e527f,
+                                      0x9b05688c,
+                                      0x1f83d9ab,
+                                      0x5be0cd19};
+
+  memcpy(ctx->state, initial, sizeof initial);
+  ctx->len       = 0;
+  ctx->block_len = 0;
+}
+
+void hash_sha256_update(hash_sha256_t *ctx, const void *data, size_t len) {
+  const unsigned char *bytes = (const unsigned char *)data;
+  ctx->len += len;
+
+  // Fill up a partially filled block first
+  if (0 < ctx->block_len) {
+    size_t take = sizeof ctx->block - ctx->block_len;
+
+    if (take > len) {
+      take = len;
+    }
+
+    memcpy(&ctx->block[ctx->block_len], bytes, take);
+    ctx->block_len += take;
+    bytes += take;
+    len -= take;
+
+    if (sizeof ctx->block != ctx->block_len) {
+      return;
+    }
+
+    transform(ctx, ctx->block);
+    ctx->block_len = 0;
+  }
+
+  // Hash full blocks directly from the input
+  for (; len >= sizeof ctx->block;
+       bytes += sizeof ctx->block, len -= sizeof ctx->block) {
+    transform(ctx, bytes);
+  }
+
+  memcpy(ctx->block, bytes, len);
+  ctx->block_len = len;
+}
+
+void hash_sha256_final(hash_sha256_t *ctx, unsigned char *digest) {
+  uint64_t      bit_len = ctx->len * 8;
+  unsigned char pad[72] = {0x80};
+  size_t        pad_len = 0;
+
+  if (56 > ctx->block_len) {
+    pad_len = 56 - ctx->block_len;
+  } else {
+    pad_len = 64 + 56 - ctx->block_len;
+  }
+
+  for (size_t i = 0; i < 8; i++) {
+    pad[pad_len + i] = (unsigned char)(bit_len >> (56 - i * 8));
+  }
+
+  hash_sha256_update(ctx, pad, pad_len + 8);
+
+  for (size_t i = 0; i < 8; i++) {
+    digest[i * 4]     = (unsigned char)(ctx->state[i] >> 24);
+    digest[i * 4 + 1] = (unsigned char)(ctx->state[i] >> 16);
+    digest[i * 4 + 2] = (unsigned char)(ctx->state[i] >> 8);
+    digest[i * 4 + 3] = (unsigned char)ctx->state[i];
+  }
+}
+
+bool hash_sha256_file(unsigned char *digest, const char *path) {
+  FILE *fp = fopen(path, "rb");
+
+  if (NULL == fp) {
+    return false;
+  }
+
+  unsigned char *buf = (unsigned char *)malloc(HASH_READ_BUFSZ);
+  mem_chkoom(buf);
+
+  // The FILE buffer would only add a copy on top of the big reads
+  setvbuf(fp, NULL, _IONBF, 0);
+
+  hash_sha256_t ctx;
+  hash_sha256_init(&ctx);
+
+  size_t read = 0;
+  while (0 < (read = fread(buf, 1, HASH_READ_BUFSZ, fp))) {
+    hash_sha256_update(&ctx, buf, read);
+  }
+
+  bool ret = !ferror(fp);
+
+  if (ret) {
+    hash_sha256_final(&ctx, digest);
+  }
+
+  mem_safe_free(buf);
+  fclose(fp);
+  return ret;
+}
+
+void hash_sha256_str(unsigned char *digest, const char *str) {
+  hash_sha256_t ctx;
+  hash_sha256_init(&ctx);
+  hash_sha256_update(&ctx, str, strlen(str));
+  hash_sha256_final(&ctx, digest);
+}
+
+void hash_tohex(char *dst, const unsigned char *digest, size_t len) {
+  static const char digits[] = "0123456789abcdef";
+
+  for (size_t i = 0; i < len; i++) {
+    dst[i * 2]     = digits[digest[i] >> 4];
+    dst[i * 2 + 1] = digits[digest[i] & 0x0F];
+  }
+
+  dst[len * 2] = 0;
+}
+
+static int hexval(char ch) {
+  if ('0' <= ch && '9' >= ch) {
+    return ch - '0';
+  }
+
+  if ('a' <= ch && 'f' >= ch) {
+    return ch - 'a' + 10;
+  }
+
+  if ('A' <= ch && 'F' >= ch) {
+    return ch - 'A' + 10;
+  }
+
+  return -1;
+}
+
+bool hash_fromhex(unsigned char *dst, const char *hex, size_t len) {
+  for (size_t i = 0; i < len; i++) {
+    if (0 == hex[i * 2] || 0 == hex[i * 2 + 1]) {
+      return false;
+    }
+
+    int high = hexval(hex[i * 2]);
+    int low  = hexval(hex[i * 2 + 1]);
+
+    if (0 > high || 0 > low) {
+      return false;
+    }
+
+    dst[i] = (unsigned char)(high << 4 | low);
+  }
+
+  return true;
+}
@@ -0,0 +1,941 @@
+/*************************************************************************
+| tarman                                                                 |
+| Copyright (C) 2024 Alessandro Salerno                                  |
+|                                                                        |
+| This program is free software: you can redistribute it and/or modify   |
+| it under the terms of the GNU General Public License as published by   |
+| the Free Software Foundation, either version 3 of the License, or      |
+| (at your option) any later version.                                    |
+|                                                                        |
+| This program is distributed in the hope that it will be useful,        |
+| but WITHOUT ANY WARRANTY; without even the implied warranty of         |
+| MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the          |
+| GNU General Public License for more details.                           |
+|                                                                        |
+| You should have received a copy of the GNU General Public License      |
+| along with this program.  If not, see <https://www.gnu.org/licenses/>. |
+*************************************************************************/
+
+
+#include "http.h"
+#include <ctype.h>
+#include <stdarg.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "download.h"
+#include "os/fs.h"
+#include "os/net.h"
+#include "os/thread.h"
+#include "settings.h"
+#include "throttle.h"
+#include "tm-mem.h"
+
+#define SCHEME       "http://"
+#define DEFAULT_PORT "80"
+#define RECV_LEN     (64 * 1024)
+#define MAX_HEAD_LEN (64 * 1024)
+#define MAX_LINE_LEN 1024
+#define MAX_EVENTS   64
+#define TICK_MS      1000
+
+typedef enum {
+  CONN_CONNECTING,
+  CONN_IDLE,
+  CONN_SENDING,
+  CONN_HEAD,
+  CONN_BODY,
+  CONN_CHUNK_SIZE,
+  CONN_CHUNK_DATA,
+  CONN_CHUNK_END,
+  CONN_TRAILERS
+} conn_state_t;
+
+typedef struct {
+  char *host;      // Without brackets, as expected by the resolver
+  char *port;
+  char *authority; // As found in the URL, used for the Host header
+  char *path;      // Including the query
+} url_t;
+
+typedef struct {
+  http_transfer_t *transfer;
+  char            *url;
+  url_t            parsed;
+  size_t           redirects;
+  bool             retried;
+  bool             write_failed;
+  FILE            *out;
+  int              status;
+  char            *location;
+} job_t;
+
+struct host;
+
+typedef struct {
+  os_net_sock_t    sock;
+  os_net_attempt_t attempt; // NULL once connected
+  struct host     *host;
+  job_t           *job; // NULL while idle
+  conn_state_t     state;
+  char            *out;
+  size_t           out_len;
+  size_t           out_pos;
+  char            *in;
+  size_t           in_len;
+  size_t           in_cap;
+  size_t           remaining; // Bytes left in the body or in the current chunk
+  bool             until_close;
+  bool             keep_alive;
+  bool             reused;   // Already served a response
+  bool             received; // Received something for the current job
+  time_t           active;
+} conn_t;
+
+typedef struct host {
+  char   *key; // host:port
+  conn_t *conns[TM_HTTP_MAX_HOST_CONNS];
+  size_t  num_conns;
+  bool    unreachable;
+} host_t;
+
+typedef struct {
+  os_net_poller_t poller;
+  host_t        **hosts;
+  size_t          num_hosts;
+  job_t         **queue;
+  size_t          queue_len;
+  size_t          num_done;
+  throttle_t      throttle; // Shared by all transfers
+} client_t;
+
+static char *dyjoin(size_t num_args, ...) {
+  va_list args;
+  size_t  len = 0;
+
+  va_start(args, num_args);
+  for (size_t i = 0; i < num_args; i++) {
+    len += strlen(va_arg(args, const char *));
+  }
+  va_end(args);
+
+  char *str = (char *)malloc(len + 1);
+  mem_chkoom(str);
+  str[0] = 0;
+
+  va_start(args, num_args);
+  for (size_t i = 0; i < num_args; i++) {
+    strcat(str, va_arg(args, const char *));
+  }
+  va_end(args);
+
+  return str;
+}
+
+static char *dystrndup(const char *str, size_t len) {
+  char *dup = (char *)malloc(len + 1);
+  mem_chkoom(dup);
+  memcpy(dup, str, len);
+  dup[len] = 0;
+  return dup;
+}
+
+static bool has_prefix(const char *url, const char *scheme) {
+  size_t len = strlen(scheme);
+
+  for (size_t i = 0; i < len; i++) {
+    if (scheme[i] != tolower((unsigned char)url[i])) {
+      return false;
+    }
+  }
+
+  return true;
+}
+
+static void free_url(url_t url) {
+  mem_safe_free(url.host);
+  mem_safe_free(url.port);
+  mem_safe_free(url.authority);
+  mem_safe_free(url.path);
+}
+
+// Credentials in URLs are left to curl
+static bool parse_url(url_t *url, const char *str) {
+  *url = (url_t){0};
+
+  if (!has_prefix(str, SCHEME)) {
+    return false;
+  }
+
+  const char *authority = str + strlen(SCHEME);
+  size_t      auth_len  = strcspn(authority, "/?#");
+  const char *path      = authority + auth_len;
+  size_t      path_len  = strcspn(path, "#");
+  const char *port      = NULL;
+  const char *host      = authority;
+  size_t      host_len  = auth_len;
+
+  if (0 == auth_len || auth_len != strcspn(authority, "@/?#")) {
+    return false;
+  }
+
+  if ('[' == authority[0]) {
+    const char *end = memchr(authority, ']', auth_len);
+
+    if (NULL == end) {
+      return false;
+    }
+
+    host     = authority + 1;
+    host_len = end - host;
+    port     = (':' == end[1]) ? end + 2 : NULL;
+  } else {
+    const char *sep = memchr(authority, ':', auth_len);
+    host_len        = (NULL != sep) ? (size_t)(sep - authority) : auth_len;
+    port            = (NULL != sep) ? sep + 1 : NULL;
+  }
+
+  size_t port_len = (NULL != port) ? (size_t)(authority + auth_len - port) : 0;
+
+  url->host      = dystrndup(host, host_len);
+  url->port      = (0 != port_len) ? dystrndup(port, port_len)
+                                   : dystrndup(DEFAULT_PORT, 2);
+  url->authority = dystrndup(authority, auth_len);
+
+  if ('/' == path[0]) {
+    url->path = dystrndup(path, path_len);
+  } else {
+    char *query = dystrndup(path, path_len);
+    url->path   = dyjoin(2, "/", query);
+    mem_safe_free(query);
+  }
+
+  return true;
+}
+
+// Removes '.' and '..' segments from an absolute path, in place
+static void remove_dots(char *path) {
+  size_t len    = strcspn(path, "?");
+  size_t out    = 0;
+  bool   is_dir = false; // The last segment was a dot segment
+
+  for (size_t in = 0; in < len;) {
+    size_t seg_len = strcspn(&path[in + 1], "/?") + 1;
+    is_dir         = false;
+
+    if (3 == seg_len && 0 == strncmp(&path[in], "/..", 3)) {
+      while (0 < out && '/' != path[out - 1]) {
+        out--;
+      }
+
+      out    -= (0 < out) ? 1 : 0;
+      is_dir  = true;
+    } else if (2 == seg_len && 0 == strncmp(&path[in], "/.", 2)) {
+      is_dir = true;
+    } else {
+      memmove(&path[out], &path[in], seg_len);
+      out += seg_len;
+    }
+
+    in += seg_len;
+  }
+
+  if (is_dir) {
+    path[out] = '/';
+    out++;
+  }
+
+  memmove(&path[out], &path[len], strlen(&path[len]) + 1);
+}
+
+// Resolves the Location header against the URL that was requested,
+// covering absolute, scheme-relative, host-relative and relative references
+static char *dyresolve(const url_t *base, const char *location) {
+  if (NULL != strstr(location, "://")) {
+    return dyjoin(1, location);
+  }
+
+  if ('/' == location[0] && '/' == location[1]) {
+    return dyjoin(2, "http:", location);
+  }
+
+  if ('/' == location[0]) {
+    return dyjoin(3, SCHEME, base->authority, location);
+  }
+
+  size_t      dir_len = strcspn(base->path, "?");
+  const char *sep     = base->path;
+
+  for (size_t i = 0; i < dir_len; i++) {
+    if ('/' == base->path[i]) {
+      sep = &base->path[i];
+    }
+  }
+
+  char *dir  = dystrndup(base->path, sep - base->path + 1);
+  char *path = dyjoin(2, dir, location);
+  remove_dots(path);
+  char *ret = dyjoin(3, SCHEME, base->authority, path);
+  mem_safe_free(dir);
+  mem_safe_free(path);
+  return ret;
+}
+
+static void finish_job(client_t *client, job_t *job, http_result_t result) {
+  if (NULL != job->out && 0 != fclose(job->out)) {
+    result = TM_HTTP_RESULT_FAILED;
+  }
+
+  job->out = NULL;
+
+  if (TM_HTTP_RESULT_OK != result) {
+    os_fs_file_rm(job->transfer->dst);
+    download_free_meta(job->transfer->meta);
+    job->transfer->meta = (download_meta_t){0};
+  }
+
+  job->transfer->result = result;
+  client->num_done++;
+}
+
+static void enqueue(client_t *client, job_t *job) {
+  free_url(job->parsed);
+
+  if (!parse_url(&job->parsed, job->url)) {
+    finish_job(client, job, TM_HTTP_RESULT_UNSUPPORTED);
+    return;
+  }
+
+  client->queue[client->queue_len] = job;
+  client->queue_len++;
+}
+
+static host_t *find_host(client_t *client, const url_t *url) {
+  char *key = dyjoin(3, url->host, ":", url->port);
+
+  for (size_t i = 0; i < client->num_hosts; i++) {
+    if (0 == strcmp(client->hosts[i]->key, key)) {
+      mem_safe_free(key);
+      return client->hosts[i];
+    }
+  }
+
+  host_t *host = (host_t *)calloc(1, sizeof(host_t));
+  mem_chkoom(host);
+  host->key     = key;
+  client->hosts = (host_t **)realloc(
+      client->hosts, (client->num_hosts + 1) * sizeof(host_t *));
+  mem_chkoom(client->hosts);
+  client->hosts[client->num_hosts] = host;
+  client->num_hosts++;
+  return host;
+}
+
+static void close_conn(client_t *client, conn_t *conn) {
+  host_t *host = conn->host;
+
+  for (size_t i = 0; i < host->num_conns; i++) {
+    if (conn == host->conns[i]) {
+      host->num_conns--;
+      host->conns[i] = host->conns[host->num_conns];
+      break;
+    }
+  }
+
+  if (NULL != conn->attempt) {
+    os_net_connect_abort(conn->attempt);
+  }
+
+  os_net_poller_unwatch(client->poller, conn->sock);
+  os_net_close(conn->sock);
+  mem_safe_free(conn->out);
+  mem_safe_free(conn->in);
+  mem_safe_free(conn);
+}
+
+// A server may close a kept-alive connection just as it is reused,
+// in which case the request is sent again once on a new connection
+static void fail_conn(client_t *client, conn_t *conn) {
+  job_t *job = conn->job;
+
+  if (NULL != job) {
+    if (conn->reused && !conn->received && !job->retried) {
+      job->retried = true;
+      enqueue(client, job);
+    } else {
+      finish_job(client, job, TM_HTTP_RESULT_FAILED);
+    }
+  }
+
+  close_conn(client, conn);
+}
+
+static void assign(client_t *client, conn_t *conn, job_t *job) {
+  mem_safe_free(job->location);
+  job->location     = NULL;
+  job->status       = 0;
+  job->write_failed = false;
+
+  conn->job      = job;
+  conn->state    = (NULL != conn->attempt) ? CONN_CONNECTING : CONN_SENDING;
+  conn->in_len   = 0;
+  conn->received = false;
+  conn->active   = time(NULL);
+  conn->out      = dyjoin(5,
+                     "GET ",
+                     job->parsed.path,
+                     " HTTP/1.1\r\nHost: ",
+                     job->parsed.authority,
+                     "\r\nUser-Agent: tarman\r\nAccept: */*\r\n\r\n");
+  conn->out_len  = strlen(conn->out);
+  conn->out_pos  = 0;
+
+  os_net_poller_watch(client->poller, conn->sock, TM_NET_EVENT_WRITE, conn);
+}
+
+// New connections are handed a job right away, and send it as soon as
+// they are established
+static conn_t *open_conn(client_t *client, host_t *host, const url_t *url) {
+  os_net_sock_t    sock;
+  os_net_attempt_t attempt;
+
+  if (!os_net_connect_start(&attempt, &sock, url->host, url->port)) {
+    return NULL;
+  }
+
+  conn_t *conn = (conn_t *)calloc(1, sizeof(conn_t));
+  mem_chkoom(conn);
+  conn->sock                   = sock;
+  conn->attempt                = attempt;
+  conn->state                  = CONN_CONNECTING;
+  conn->host                   = host;
+  host->conns[host->num_conns] = conn;
+  host->num_conns++;
+
+  if (!os_net_poller_watch(client->poller, sock, TM_NET_EVENT_WRITE, conn)) {
+    close_conn(client, conn);
+    return NULL;
+  }
+
+  return conn;
+}
+
+// Hands queued jobs to idle connections, opening new ones as long as
+// the server has fewer than TM_HTTP_MAX_HOST_CONNS
+static void dispatch(client_t *client) {
+  size_t kept = 0;
+
+  for (size_t i = 0; i < client->queue_len; i++) {
+    job_t  *job  = client->queue[i];
+    host_t *host = find_host(client, &job->parsed);
+    conn_t *conn = NULL;
+
+    for (size_t j = 0; j < host->num_conns && NULL == conn; j++) {
+      conn = (NULL == host->conns[j]->job) ? host->conns[j] : NULL;
+    }
+
+    // Retries go to a new connection, since the other idle ones
+    // have most likely been closed by the server as well
+    if (NULL != conn && job->retried) {
+      close_conn(client, conn);
+      conn = NULL;
+    }
+
+    if (NULL == conn && host->num_conns < TM_HTTP_MAX_HOST_CONNS &&
+        !host->unreachable) {
+      conn = open_conn(client, host, &job->parsed);
+
+      // The server cannot be resolved, or no socket can be created for it
+      host->unreachable = NULL == conn && 0 == host->num_conns;
+    }
+
+    if (NULL != conn) {
+      assign(client, conn, job);
+    } else if (host->unreachable) {
+      finish_job(client, job, TM_HTTP_RESULT_FAILED);
+    } else {
+      client->queue[kept] = job;
+      kept++;
+    }
+  }
+
+  client->queue_len = kept;
+}
+
+static void complete(client_t *client, conn_t *conn) {
+  job_t *job = conn->job;
+  bool   redirect =
+      300 <= job->status && 400 > job->status && NULL != job->location;
+
+  conn->job    = NULL;
+  conn->reused = true;
+  conn->in_len = 0;
+  conn->state  = CONN_IDLE;
+
+  if (redirect && TM_HTTP_MAX_REDIRECTS > job->redirects) {
+    char *url = dyresolve(&job->parsed, job->location);
+    mem_safe_free(job->url);
+    job->url = url;
+    job->redirects++;
+    job->retried = false;
+    enqueue(client, job);
+  } else if (200 <= job->status && 300 > job->status && !job->write_failed) {
+    finish_job(client, job, TM_HTTP_RESULT_OK);
+  } else {
+    finish_job(client, job, TM_HTTP_RESULT_FAILED);
+  }
+
+  if (!conn->keep_alive) {
+    close_conn(client, conn);
+    return;
+  }
+
+  os_net_poller_watch(client->poller, conn->sock, TM_NET_EVENT_READ, conn);
+}
+
+static void write_body(job_t *job, const char *data, size_t len) {
+  if (NULL != job->out && len != fwrite(data, 1, len, job->out)) {
+    job->write_failed = true;
+  }
+}
+
+static void set_validator(char **dst, const char *value) {
+  mem_safe_free(*dst);
+  *dst = dystrndup(value, strlen(value));
+}
+
+// Returns false if the response cannot be handled
+static bool parse_head(conn_t *conn, char *head) {
+  job_t           *job      = conn->job;
+  http_transfer_t *transfer = job->transfer;
+  int              minor    = 0;
+  bool             chunked  = false;
+  bool             has_len  = false;
+  size_t           body_len = 0;
+
+  if (2 != sscanf(head, "HTTP/1.%d %d", &minor, &job->status)) {
+    return false;
+  }
+
+  conn->keep_alive  = 1 <= minor;
+  conn->until_close = false;
+  download_free_meta(transfer->meta);
+  transfer->meta = (download_meta_t){0};
+
+  for (char *line = strtok(head, "\r\n"); NULL != line;
+       line       = strtok(NULL, "\r\n")) {
+    const char *value = NULL;
+
+    if (NULL != (value = http_header_value(line, "content-length"))) {
+      body_len = strtoull(value, NULL, 10);
+      has_len  = true;
+    } else if (NULL != (value = http_header_value(line, "transfer-encoding"))) {
+      chunked = NULL != strstr(value, "chunked");
+    } else if (NULL != (value = http_header_value(line, "connection"))) {
+      conn->keep_alive = has_prefix(value, "keep-alive") ||
+                         (conn->keep_alive && !has_prefix(value, "close"));
+    } else if (NULL != (value = http_header_value(line, "location"))) {
+      set_validator(&job->location, value);
+    } else if (NULL != (value = http_header_value(line, "etag"))) {
+      set_validator(&transfer->meta.etag, value);
+    } else if (NULL != (value = http_header_value(line, "last-modified"))) {
+      set_validator(&transfer->meta.last_modified, value);
+    }
+  }
+
+  // Informational responses are followed by the actual one
+  if (100 <= job->status && 200 > job->status) {
+    conn->state = CONN_HEAD;
+    return true;
+  }
+
+  // Only the body of the final response is kept, any previous
+  // one (e.g., from a failed attempt) is truncated
+  if (200 <= job->status && 300 > job->status) {
+    if (NULL != job->out) {
+      fclose(job->out);
+    }
+
+    if (NULL == (job->out = fopen(transfer->dst, "wb"))) {
+      return false;
+    }
+  }
+
+  if (204 == job->status || 304 == job->status || (has_len && 0 == body_len)) {
+    conn->state     = CONN_BODY;
+    conn->remaining = 0;
+  } else if (chunked) {
+    conn->state = CONN_CHUNK_SIZE;
+  } else if (has_len) {
+    conn->state     = CONN_BODY;
+    conn->remaining = body_len;
+  } else {
+    conn->state       = CONN_BODY;
+    conn->until_close = true;
+    conn->keep_alive  = false;
+  }
+
+  return true;
+}
+
+static void consume(conn_t *conn, size_t len) {
+  memmove(conn->in, conn->in + len, conn->in_len - len);
+  conn->in_len -= len;
+}
+
+static size_t find_line(conn_t *conn) {
+  char *end = memchr(conn->in, '\n', conn->in_len);
+  return (NULL != end) ? (size_t)(end - conn->in) + 1 : 0;
+}
+
+static size_t find_head(conn_t *conn) {
+  for (size_t i = 3; i < conn->in_len; i++) {
+    if (0 == memcmp(&conn->in[i - 3], "\r\n\r\n", 4)) {
+      return i + 1;
+    }
+  }
+
+  return 0;
+}
+
+// Advances through the buffered input as far as possible.
+// Returns false if the connection must be dropped
+static bool process(client_t *client, conn_t *conn) {
+  while (NULL != conn->job) {
+    job_t *job = conn->job;
+    size_t len = 0;
+
+    switch (conn->state) {
+    case CONN_HEAD:
+      if (0 == (len = find_head(conn))) {
+        return MAX_HEAD_LEN > conn->in_len;
+      }
+
+      conn->in[len - 1] = 0;
+
+      if (!parse_head(conn, conn->in)) {
+        return false;
+      }
+
+      consume(conn, len);
+      break;
+
+    case CONN_BODY:
+      len = (conn->until_close || conn->remaining > conn->in_len)
+                ? conn->in_len
+                : conn->remaining;
+      write_body(job, conn->in, len);
+      consume(conn, len);
+      conn->remaining -= conn->until_close ? 0 : len;
+
+      if (!conn->until_close && 0 == conn->remaining) {
+        complete(client, conn);
+      }
+
+      return true;
+
+    case CONN_CHUNK_SIZE:
+      if (0 == (len = find_line(conn))) {
+        return MAX_LINE_LEN > conn->in_len;
+      }
+
+      conn->remaining = strtoull(conn->in, NULL, 16);
+      conn->state = (0 == conn->remaining) ? CONN_TRAILERS : CONN_CHUNK_DATA;
+      consume(conn, len);
+      break;
+
+    case CONN_CHUNK_DATA:
+      len = (conn->remaining > conn->in_len) ? conn->in_len : conn->remaining;
+      write_body(job, conn->in, len);
+      consume(conn, len);
+      conn->remaining -= len;
+
+      if (0 != conn->remaining) {
+        return true;
+      }
+
+      conn->state = CONN_CHUNK_END;
+      break;
+
+    case CONN_CHUNK_END:
+    case CONN_TRAILERS:
+      if (0 == (len = find_line(conn))) {
+        return MAX_LINE_LEN > conn->in_len;
+      }
+
+      // An empty line ends the trailers, and with them the body
+      if (CONN_TRAILERS == conn->state && 2 >= len) {
+        complete(client, conn);
+        return true;
+      }
+
+      conn->state = (CONN_CHUNK_END == conn->state) ? CONN_CHUNK_SIZE
+                                                    : CONN_TRAILERS;
+      consume(conn, len);
+      break;
+
+    default:
+      return true;
+    }
+  }
+
+  return true;
+}
+
+// Called once the socket is writable, or when the current address has
+// taken too long to answer
+static void on_connected(client_t *client, conn_t *conn, bool timed_out) {
+  host_t      *host   = conn->host;
+  net_status_t status = TM_NET_STATUS_ERR;
+
+  // The socket is replaced if the next address is tried
+  os_net_poller_unwatch(client->poller, conn->sock);
+  status       = os_net_connect_finish(conn->attempt, &conn->sock, timed_out);
+  conn->active = time(NULL);
+
+  if (TM_NET_STATUS_ERR == status) {
+    conn->attempt = NULL;
+
+    // Other jobs for the same server would only wait for the same timeout,
+    // unless some other connection to it did get through
+    host->unreachable = true;
+
+    for (size_t i = 0; i < host->num_conns; i++) {
+      if (NULL == host->conns[i]->attempt && conn != host->conns[i]) {
+        host->unreachable = false;
+      }
+    }
+
+    fail_conn(client, conn);
+    return;
+  }
+
+  if (TM_NET_STATUS_OK == status) {
+    conn->attempt = NULL;
+    conn->state   = CONN_SENDING;
+  }
+
+  if (!os_net_poller_watch(
+          client->poller, conn->sock, TM_NET_EVENT_WRITE, conn)) {
+    fail_conn(client, conn);
+  }
+}
+
+static void on_writable(client_t *client, conn_t *conn) {
+  size_t       sent   = 0;
+  net_status_t status = os_net_send(conn->sock,
+                                    conn->out + conn->out_pos,
+                                    conn->out_len - conn->out_pos,
+                                    &sent);
+
+  if (TM_NET_STATUS_AGAIN == status) {
+    return;
+  }
+
+  if (TM_NET_STATUS_OK != status) {
+    fail_conn(client, conn);
+    return;
+  }
+
+  conn->out_pos += sent;
+  conn->active   = time(NULL);
+
+  if (conn->out_pos == conn->out_len) {
+    mem_safe_free(conn->out);
+    conn->out   = NULL;
+    conn->state = CONN_HEAD;
+    os_net_poller_watch(client->poller, conn->sock, TM_NET_EVENT_READ, conn);
+  }
+}
+
+static void on_readable(client_t *client, conn_t *conn) {
+  if (conn->in_cap - conn->in_len < RECV_LEN) {
+    conn->in_cap = conn->in_len + RECV_LEN;
+    conn->in     = (char *)realloc(conn->in, conn->in_cap);
+    mem_chkoom(conn->in);
+  }
+
+  size_t       received = 0;
+  size_t       len      = throttle_available(&client->throttle);
+  net_status_t status   = TM_NET_STATUS_AGAIN;
+
+  // Data is left in the socket until the rate limit allows reading it,
+  // which in turn makes the server slow down. The server is not idle
+  if (0 == len) {
+    conn->active = time(NULL);
+    return;
+  }
+
+  len    = (RECV_LEN < len) ? RECV_LEN : len;
+  status = os_net_recv(conn->sock, conn->in + conn->in_len, len, &received);
+
+  if (TM_NET_STATUS_AGAIN == status) {
+    return;
+  }
+
+  // Idle connections are only watched to notice when servers close them
+  if (NULL == conn->job) {
+    close_conn(client, conn);
+    return;
+  }
+
+  if (TM_NET_STATUS_CLOSED == status && CONN_BODY == conn->state &&
+      conn->until_close) {
+    complete(client, conn);
+    return;
+  }
+
+  if (TM_NET_STATUS_OK != status) {
+    fail_conn(client, conn);
+    return;
+  }
+
+  throttle_consume(&client->throttle, received);
+  conn->in_len   += received;
+  conn->received  = true;
+  conn->active    = time(NULL);
+
+  if (!process(client, conn)) {
+    fail_conn(client, conn);
+  }
+}
+
+static void check_timeouts(client_t *client) {
+  time_t now = time(NULL);
+
+  for (size_t i = 0; i < client->num_hosts; i++) {
+    host_t *host = client->hosts[i];
+
+    // Iterated backwards as failing a connection removes it
+    for (size_t j = host->num_conns; 0 < j; j--) {
+      conn_t *conn = host->conns[j - 1];
+
+      if (CONN_CONNECTING == conn->state) {
+        if (TM_NET_CONNECT_TIMEOUT / 1000 <= now - conn->active) {
+          on_connected(client, conn, true);
+        }
+        continue;
+      }
+
+      if (NULL != conn->job && TM_HTTP_IDLE_TIMEOUT < now - conn->active) {
+        conn->received = true; // Not worth retrying
+        fail_conn(client, conn);
+      }
+    }
+  }
+}
+
+static void free_client(client_t *client) {
+  for (size_t i = 0; i < client->num_hosts; i++) {
+    host_t *host = client->hosts[i];
+
+    while (0 != host->num_conns) {
+      close_conn(client, host->conns[0]);
+    }
+
+    mem_safe_free(host->key);
+    mem_safe_free(host);
+  }
+
+  os_net_poller_destroy(client->poller);
+  mem_safe_free(client->hosts);
+  mem_safe_free(client->queue);
+}
+
+bool http_supports(const char *url) {
+  url_t parsed;
+  bool  ret = parse_url(&parsed, url);
+  free_url(parsed);
+  return ret;
+}
+
+// Header names are case-insensitive, name must be lowercase
+const char *http_header_value(const char *line, const char *name) {
+  size_t len = strlen(name);
+
+  if (!has_prefix(line, name) || ':' != line[len]) {
+    return NULL;
+  }
+
+  const char *value = &line[len + 1];
+
+  while (' ' == *value || '\t' == *value) {
+    value++;
+  }
+
+  return value;
+}
+
+// All transfers share one event loop. Requests to the same server reuse
+// the connections opened for previous ones instead of connecting again
+void http_fetch_all(http_transfer_t *transfers, size_t count) {
+  client_t client = {0};
+  job_t   *jobs   = (job_t *)calloc(count + 1, sizeof(job_t));
+  mem_chkoom(jobs);
+
+  for (size_t i = 0; i < count; i++) {
+    transfers[i].meta   = (download_meta_t){0};
+    transfers[i].result = TM_HTTP_RESULT_UNSUPPORTED;
+  }
+
+  if (!os_net_poller_create(&client.poller)) {
+    mem_safe_free(jobs);
+    return;
+  }
+
+  throttle_init(&client.throttle, settings_get()->download_rate);
+  client.queue = (job_t **)malloc((count + 1) * sizeof(job_t *));
+  mem_chkoom(client.queue);
+
+  for (size_t i = 0; i < count; i++) {
+    jobs[i].transfer = &transfers[i];
+    jobs[i].url      = dystrndup(transfers[i].url, strlen(transfers[i].url));
+    enqueue(&client, &jobs[i]);
+  }
+
+  while (client.num_done < count) {
+    net_event_t events[MAX_EVENTS];
+
+    dispatch(&client);
+
+    // Otherwise the sockets that cannot be read yet would keep
+    // the poller from waiting at all
+    size_t delay = throttle_delay(&client.throttle);
+
+    if (0 != delay) {
+      os_thread_sleep(delay);
+    }
+
+    size_t num_events =
+        os_net_poller_wait(client.poller, events, MAX_EVENTS, TICK_MS);
+
+    // Each connection shows up at most once, and is only ever
+    // closed while handling its own event
+    for (size_t i = 0; i < num_events; i++) {
+      conn_t *conn = (conn_t *)events[i].data;
+
+      if (CONN_CONNECTING == conn->state) {
+        on_connected(&client, conn, false);
+      } else if (CONN_SENDING == conn->state) {
+        on_writable(&client, conn);
+      } else {
+        on_readable(&client, conn);
+      }
+    }
+
+    check_timeouts(&client);
+  }
+
+  free_client(&client);
+
+  for (size_t i = 0; i < count; i++) {
+    free_url(jobs[i].parsed);
+    mem_safe_free(jobs[i].url);
+    mem_safe_free(jobs[i].location);
+  }
+
+  mem_safe_free(jobs);
+}
@@ -0,0 +1,196 @@
+/*************************************************************************
+| tarman                                                                 |
+| Copyright (C) 2024 Alessandro Salerno                                  |
+|                                                                        |
+| This program is free software: you can redistribute it and/or modify   |
+| it under the terms of the GNU General Public License as published by   |
+| the Free Software Foundation, either version 3 of the License, or      |
+| (at your option) any later version.                                    |
+|                                                                        |
+| This program is distributed in the hope that it will be useful,        |
+| but WITHOUT ANY WARRANTY; without even the implied warranty of         |
+| MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the          |
+| GNU General Public License for more details.                           |
+|                                                                        |
+| You should have received a copy of the GNU General Public License      |
+| along with this program.  If not, see <https://www.gnu.org/licenses/>. |
+*************************************************************************/
+
+
+#include <ctype.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "infer.h"
+#include "magic.h"
+#include "tm-mem.h"
+
+// Longer names are truncated when comparing them
+#define NAME_MAX_LEN 64
+
+// Weights of the individual heuristics
+#define SCORE_NATIVE    30
+#define SCORE_SCRIPT    15
+#define SCORE_NAME_SAME 40
+#define SCORE_NAME_LIKE 30
+#define SCORE_IN_BIN    20
+#define SCORE_AT_ROOT   10
+#define SCORE_DEPTH     3
+#define SCORE_SIZE_MAX  10
+#define SCORE_SOLE      25
+
+// Strips the directory and, for scripts, the extension (e.g., run.sh)
+static size_t base_name(char *dst, const char *path, magic_exec_t magic) {
+  const char *slash = strrchr(path, '/');
+  const char *name  = (NULL == slash) ? path : slash + 1;
+  size_t      len   = 0;
+
+  for (; 0 != name[len] && NAME_MAX_LEN > len; len++) {
+    dst[len] = tolower((unsigned char)name[len]);
+  }
+
+  dst[len]  = 0;
+  char *ext = strrchr(dst, '.');
+
+  if (TM_MAGIC_EXEC_SCRIPT == magic && NULL != ext && ext != dst) {
+    *ext = 0;
+    len  = ext - dst;
+  }
+
+  return len;
+}
+
+// Length of the longest common subsequence, which tolerates the
+// separators and suffixes that often surround the package name
+// (e.g., 'nvim' and 'nvim-qt')
+static size_t common_len(const char *a, size_t a_len, const char *b) {
+  size_t row[NAME_MAX_LEN + 1] = {0};
+
+  for (; 0 != *b; b++) {
+    size_t diag = 0;
+
+    for (size_t i = 1; i <= a_len; i++) {
+      size_t up = row[i];
+      row[i]    = (a[i - 1] == *b)   ? diag + 1
+                  : (row[i - 1] > up) ? row[i - 1]
+                                      : up;
+      diag      = up;
+    }
+  }
+
+  return row[a_len];
+}
+
+static int name_score(const infer_exec_t *exec, const char *pkg_name) {
+  char   name[NAME_MAX_LEN + 1];
+  char   pkg[NAME_MAX_LEN + 1];
+  size_t name_len = base_name(name, exec->path, exec->magic);
+  size_t pkg_len  = base_name(pkg, pkg_name, TM_MAGIC_EXEC_NONE);
+
+  if (0 == strcmp(name, pkg)) {
+    return SCORE_NAME_SAME;
+  }
+
+  size_t max_len = (name_len > pkg_len) ? name_len : pkg_len;
+
+  if (0 == max_len) {
+    return 0;
+  }
+
+  return (int)(SCORE_NAME_LIKE * common_len(name, name_len, pkg) / max_len);
+}
+
+static int location_score(const char *path) {
+  const char *slash = strrchr(path, '/');
+  int         depth = 0;
+
+  for (const char *c = path; 0 != *c; c++) {
+    depth += '/' == *c;
+  }
+
+  if (NULL == slash) {
+    return SCORE_AT_ROOT;
+  }
+
+  int         score  = -SCORE_DEPTH * (depth - 1);
+  const char *parent = slash;
+
+  while (parent != path && '/' != parent[-1]) {
+    parent--;
+  }
+
+  if (3 == slash - parent && 0 == strncmp(parent, "bin", 3)) {
+    score += SCORE_IN_BIN;
+  }
+
+  return score;
+}
+
+// The main program of a package tends to be its largest binary, helpers
+// and wrappers are usually small. Each doubling past 64 KiB counts
+static int size_score(const infer_exec_t *exec) {
+  if (TM_MAGIC_EXEC_SCRIPT == exec->magic) {
+    return 0;
+  }
+
+  int score = 0;
+
+  for (size_t size = exec->size >> 16; 0 != size && SCORE_SIZE_MAX > score;
+       size >>= 1) {
+    score += 2;
+  }
+
+  return score;
+}
+
+static int score_exec(const infer_exec_t *exec, const char *pkg_name) {
+  int score = (TM_MAGIC_EXEC_SCRIPT == exec->magic) ? SCORE_SCRIPT
+                                                      : SCORE_NATIVE;
+
+  return score + name_score(exec, pkg_name) + location_score(exec->path) +
+         size_score(exec);
+}
+
+static int compare_execs(const void *a, const void *b) {
+  const infer_exec_t *exec_a = (const infer_exec_t *)a;
+  const infer_exec_t *exec_b = (const infer_exec_t *)b;
+
+  if (exec_a->score != exec_b->score) {
+    return exec_b->score - exec_a->score;
+  }
+
+  return strcmp(exec_a->path, exec_b->path);
+}
+
+void infer_exec_rank(infer_exec_t *execs, size_t count, const char *pkg_name) {
+  for (size_t i = 0; i < count; i++) {
+    execs[i].score = score_exec(&execs[i], pkg_name);
+  }
+
+  if (1 == count) {
+    execs[0].score += SCORE_SOLE;
+  }
+
+  qsort(execs, count, sizeof(infer_exec_t), compare_execs);
+}
+
+bool infer_exec_confident(const infer_exec_t *execs, size_t count) {
+  if (0 == count || TM_INFER_MIN_SCORE > execs[0].score) {
+    return false;
+  }
+
+  return 1 == count || TM_INFER_MIN_MARGIN <= execs[0].score - execs[1].score;
+}
+
+void infer_exec_free(infer_exec_t *execs, size_t count) {
+  if (NULL == execs) {
+    return;
+  }
+
+  for (size_t i = 0; i < count; i++) {
+    mem_safe_free(execs[i].path);
+  }
+
+  mem_safe_free(execs);
+}
@@ -0,0 +1,115 @@
+/*************************************************************************
+| tarman                                                                 |
+| Copyright (C) 2024 Alessandro Salerno                                  |
+|                                                                        |
+| This program is free software: you can redistribute it and/or modify   |
+| it under the terms of the GNU General Public License as published by   |
+| the Free Software Foundation, either version 3 of the License, or      |
+| (at your option) any later version.                                    |
+|                                                                        |
+| This program is distributed in the hope that it will be useful,        |
+| but WITHOUT ANY WARRANTY; without even the implied warranty of         |
+| MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the          |
+| GNU General Public License for more details.                           |
+|                                                                        |
+| You should have received a copy of the GNU General Public License      |
+| along with this program.  If not, see <https://www.gnu.org/licenses/>. |
+*************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "magic.h"
+
+static const unsigned char ElfMagic[] = {0x7F, 'E', 'L', 'F'};
+
+// Mach-O 32/64-bit in both byte orders plus fat (universal) binaries
+static const unsigned char MachoMagics[][TM_MAGIC_EXEC_LEN] = {
+    {0xFE, 0xED, 0xFA, 0xCE},
+    {0xFE, 0xED, 0xFA, 0xCF},
+    {0xCE, 0xFA, 0xED, 0xFE},
+    {0xCF, 0xFA, 0xED, 0xFE},
+    {0xCA, 0xFE, 0xBA, 0xBE}};
+
+typedef struct {
+  magic_archive_t      format;
+  size_t               offset;
+  size_t               len;
+  const unsigned char *magic;
+} archive_magic_t;
+
+// Compressed formats are assumed to contain a tar archive. Both the POSIX
+// ("ustar\0") and the GNU ("ustar  ") variants of the tar magic match
+static const archive_magic_t ArchiveMagics[] = {
+    {TM_MAGIC_ARCHIVE_GZIP, 0, 2, (const unsigned char *)"\x1F\x8B"},
+    {TM_MAGIC_ARCHIVE_XZ, 0, 6, (const unsigned char *)"\xFD" "7zXZ\0"},
+    {TM_MAGIC_ARCHIVE_ZSTD, 0, 4, (const unsigned char *)"\x28\xB5\x2F\xFD"},
+    {TM_MAGIC_ARCHIVE_BZIP2, 0, 3, (const unsigned char *)"BZh"},
+    {TM_MAGIC_ARCHIVE_ZIP, 0, 4, (const unsigned char *)"PK\x03\x04"},
+    {TM_MAGIC_ARCHIVE_ZIP, 0, 4, (const unsigned char *)"PK\x05\x06"},
+    {TM_MAGIC_ARCHIVE_TAR, 257, 5, (const unsigned char *)"ustar"}};
+
+magic_exec_t magic_exec_detect(const unsigned char *buf, size_t len) {
+  if (2 <= len && '#' == buf[0] && '!' == buf[1]) {
+    return TM_MAGIC_EXEC_SCRIPT;
+  }
+
+  if (TM_MAGIC_EXEC_LEN > len) {
+    return TM_MAGIC_EXEC_NONE;
+  }
+
+  if (0 == memcmp(buf, ElfMagic, sizeof ElfMagic)) {
+    return TM_MAGIC_EXEC_ELF;
+  }
+
+  for (size_t i = 0; i < sizeof MachoMagics / sizeof MachoMagics[0]; i++) {
+    if (0 == memcmp(buf, MachoMagics[i], TM_MAGIC_EXEC_LEN)) {
+      return TM_MAGIC_EXEC_MACHO;
+    }
+  }
+
+  return TM_MAGIC_EXEC_NONE;
+}
+
+magic_exec_t magic_exec_fdetect(const char *path) {
+  FILE *fp = fopen(path, "rb");
+
+  if (NULL == fp) {
+    return TM_MAGIC_EXEC_NONE;
+  }
+
+  unsigned char buf[TM_MAGIC_EXEC_LEN];
+  size_t        len = fread(buf, 1, sizeof buf, fp);
+  fclose(fp);
+
+  return magic_exec_detect(buf, len);
+}
+
+magic_archive_t magic_archive_detect(const unsigned char *buf, size_t len) {
+  for (size_t i = 0; i < sizeof ArchiveMagics / sizeof ArchiveMagics[0];
+       i++) {
+    const archive_magic_t *magic = &ArchiveMagics[i];
+
+    if (magic->offset + magic->len <= len &&
+        0 == memcmp(&buf[magic->offset], magic->magic, magic->len)) {
+      return magic->format;
+    }
+  }
+
+  return TM_MAGIC_ARCHIVE_NONE;
+}
+
+magic_archive_t magic_archive_fdetect(const char *path) {
+  FILE *fp = fopen(path, "rb");
+
+  if (NULL == fp) {
+    return TM_MAGIC_ARCHIVE_NONE;
+  }
+
+  unsigned char buf[TM_MAGIC_ARCHIVE_LEN];
+  size_t        len = fread(buf, 1, sizeof buf, fp);
+  fclose(fp);
+
+  return magic_archive_detect(buf, len);
+}
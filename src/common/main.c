@@ -20,21 +20,8 @@
 #include <stdio.h>
 #include <stdlib.h>
 
-#include "cli/directives/commands.h"
-#include "cli/directives/types.h"
 #include "cli/parser.h"
 
 int main(int argc, char *argv[]) {
-  cli_info_t cli_info        = {0};
-  cli_exec_t command_handler = NULL;
-
-  if (!cli_parse(argc, argv, &cli_info, &command_handler)) {
-    return EXIT_FAILURE;
-  }
-
-  if (NULL == command_handler) {
-    return cli_cmd_help(cli_info);
-  }
-
-  return command_handler(cli_info);
+  return cli_run(argc, argv);
 }
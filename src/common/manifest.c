@@ -0,0 +1,296 @@
+/*************************************************************************
+| tarman                                                                 |
+| Copyright (C) 2024 Alessandro Salerno                                  |
+|                                                                        |
+| This program is free software: you can redistribute it and/or modify   |
+| it under the terms of the GNU General Public License as published by   |
+| the Free Software Foundation, either version 3 of the License, or      |
+| (at your option) any later version.                                    |
+|                                                                        |
+| This program is distributed in the hope that it will be useful,        |
+| but WITHOUT ANY WARRANTY; without even the implied warranty of         |
+| MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the          |
+| GNU General Public License for more details.                           |
+|                                                                        |
+| You should have received a copy of the GNU General Public License      |
+| along with this program.  If not, see <https://www.gnu.org/licenses/>. |
+*************************************************************************/
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "hash.h"
+#include "manifest.h"
+#include "os/fs.h"
+#include "pool.h"
+#include "tm-mem.h"
+#include "walk.h"
+
+// On-disk format (all integers are little-endian):
+//   magic "TMMF", u32 version, u64 entry count
+//   for each entry: u16 path length, path (no terminator),
+//                   u64 size, u32 mode, 32-byte SHA-256
+#define MANIFEST_MAGIC     "TMMF"
+#define MANIFEST_VERSION   1
+#define MANIFEST_MIN_ENTRY (2 + 8 + 4 + TM_HASH_SHA256_LEN)
+
+typedef struct {
+  manifest_entry_t  *entries;
+  manifest_status_t *statuses;
+  const char        *pkg_path;
+  atomic_bool        failed;
+} manifest_job_ctx_t;
+
+static void put_uint(FILE *fp, uint64_t value, size_t size) {
+  for (size_t i = 0; i < size; i++) {
+    fputc((int)(value >> (i * 8)) & 0xFF, fp);
+  }
+}
+
+static bool get_uint(FILE *fp, uint64_t *value, size_t size) {
+  uint64_t ret = 0;
+
+  for (size_t i = 0; i < size; i++) {
+    int ch = fgetc(fp);
+
+    if (EOF == ch) {
+      return false;
+    }
+
+    ret |= (uint64_t)ch << (i * 8);
+  }
+
+  *value = ret;
+  return true;
+}
+
+static bool is_tarman_file(const char *full_path,
+                           const char *rel_path,
+                           fs_dirent_t ent,
+                           void       *ctx) {
+  (void)full_path;
+  (void)ctx;
+
+  if (TM_FS_FILETYPE_REGULAR != ent.file_type &&
+      TM_FS_FILETYPE_EXEC != ent.file_type) {
+    return false;
+  }
+
+  // Metadata written by tarman itself is not part of the package
+  return 0 != strcmp(rel_path, TM_MANIFEST_FILE) &&
+         0 != strcmp(rel_path, "recipe.tarman");
+}
+
+static void hash_job(size_t index, void *ctx) {
+  manifest_job_ctx_t *job_ctx   = (manifest_job_ctx_t *)ctx;
+  manifest_entry_t   *entry     = &job_ctx->entries[index];
+  char               *full_path = NULL;
+  fs_fileinfo_t       info;
+
+  os_fs_path_dyconcat(&full_path, 2, job_ctx->pkg_path, entry->path);
+  mem_chkoom(full_path);
+
+  if (TM_FS_FILEOP_STATUS_OK != os_fs_file_getinfo(&info, full_path) ||
+      !hash_sha256_file(entry->hash, full_path)) {
+    atomic_store(&job_ctx->failed, true);
+    goto cleanup;
+  }
+
+  entry->size = info.size;
+  entry->mode = info.mode;
+
+cleanup:
+  mem_safe_free(full_path);
+}
+
+static void check_job(size_t index, void *ctx) {
+  manifest_job_ctx_t *job_ctx   = (manifest_job_ctx_t *)ctx;
+  manifest_entry_t   *entry     = &job_ctx->entries[index];
+  manifest_status_t  *status    = &job_ctx->statuses[index];
+  char               *full_path = NULL;
+  fs_fileinfo_t       info;
+  unsigned char       hash[TM_HASH_SHA256_LEN];
+
+  os_fs_path_dyconcat(&full_path, 2, job_ctx->pkg_path, entry->path);
+  mem_chkoom(full_path);
+
+  if (TM_FS_FILEOP_STATUS_OK != os_fs_file_getinfo(&info, full_path)) {
+    *status = TM_MANIFEST_STATUS_MISSING;
+    goto cleanup;
+  }
+
+  // Size is checked first so that truncated or grown files
+  // do not have to be read at all
+  if (info.size != entry->size || !hash_sha256_file(hash, full_path) ||
+      0 != memcmp(hash, entry->hash, TM_HASH_SHA256_LEN)) {
+    *status = TM_MANIFEST_STATUS_MODIFIED;
+    goto cleanup;
+  }
+
+  if (info.mode != entry->mode) {
+    *status = TM_MANIFEST_STATUS_MODE;
+    goto cleanup;
+  }
+
+  *status = TM_MANIFEST_STATUS_OK;
+
+cleanup:
+  mem_safe_free(full_path);
+}
+
+bool manifest_dycreate(manifest_t *manifest, const char *pkg_path) {
+  char      **paths = NULL;
+  size_t      count = 0;
+  walk_opts_t opts  = {.filter = is_tarman_file};
+
+  if (!walk_dytree(&paths, &count, pkg_path, opts)) {
+    return false;
+  }
+
+  manifest_entry_t *entries =
+      (manifest_entry_t *)calloc(count + 1, sizeof(manifest_entry_t));
+  mem_chkoom(entries);
+
+  for (size_t i = 0; i < count; i++) {
+    entries[i].path = paths[i];
+  }
+
+  mem_safe_free(paths);
+
+  manifest_job_ctx_t ctx = {.entries = entries, .pkg_path = pkg_path};
+  atomic_init(&ctx.failed, false);
+  pool_run(count, hash_job, &ctx);
+
+  manifest_t ret = {.entries = entries, .count = count};
+
+  if (atomic_load(&ctx.failed)) {
+    manifest_free(ret);
+    return false;
+  }
+
+  *manifest = ret;
+  return true;
+}
+
+bool manifest_dump(const char *file_path, manifest_t manifest) {
+  FILE *fp = fopen(file_path, "wb");
+
+  if (NULL == fp) {
+    return false;
+  }
+
+  fwrite(MANIFEST_MAGIC, 1, strlen(MANIFEST_MAGIC), fp);
+  put_uint(fp, MANIFEST_VERSION, sizeof(uint32_t));
+  put_uint(fp, manifest.count, sizeof(uint64_t));
+
+  for (size_t i = 0; i < manifest.count; i++) {
+    manifest_entry_t entry    = manifest.entries[i];
+    size_t           path_len = strlen(entry.path);
+
+    put_uint(fp, path_len, sizeof(uint16_t));
+    fwrite(entry.path, 1, path_len, fp);
+    put_uint(fp, entry.size, sizeof(uint64_t));
+    put_uint(fp, entry.mode, sizeof(uint32_t));
+    fwrite(entry.hash, 1, TM_HASH_SHA256_LEN, fp);
+  }
+
+  bool ret = !ferror(fp);
+  fclose(fp);
+  return ret;
+}
+
+bool manifest_dyload(manifest_t *manifest, const char *file_path) {
+  FILE *fp = fopen(file_path, "rb");
+
+  if (NULL == fp) {
+    return false;
+  }
+
+  char       magic[sizeof MANIFEST_MAGIC] = {0};
+  uint64_t   version                      = 0;
+  uint64_t   count                        = 0;
+  manifest_t ret                          = {0};
+  bool       success                      = false;
+
+  if (strlen(MANIFEST_MAGIC) != fread(magic, 1, strlen(MANIFEST_MAGIC), fp) ||
+      0 != strcmp(magic, MANIFEST_MAGIC) ||
+      !get_uint(fp, &version, sizeof(uint32_t)) ||
+      MANIFEST_VERSION != version || !get_uint(fp, &count, sizeof(uint64_t))) {
+    goto cleanup;
+  }
+
+  // Manifests may come from untrusted bundles, so the count must be
+  // backed by enough bytes in the file before anything is allocated
+  long header_end = ftell(fp);
+
+  if (0 > header_end || 0 != fseek(fp, 0, SEEK_END)) {
+    goto cleanup;
+  }
+
+  long file_end = ftell(fp);
+
+  if (file_end < header_end || 0 != fseek(fp, header_end, SEEK_SET) ||
+      count > (uint64_t)(file_end - header_end) / MANIFEST_MIN_ENTRY ||
+      count >= SIZE_MAX / sizeof(manifest_entry_t)) {
+    goto cleanup;
+  }
+
+  ret.entries = (manifest_entry_t *)calloc(count + 1, sizeof(manifest_entry_t));
+  mem_chkoom(ret.entries);
+
+  for (; ret.count < count; ret.count++) {
+    manifest_entry_t *entry    = &ret.entries[ret.count];
+    uint64_t          path_len = 0;
+    uint64_t          mode     = 0;
+
+    if (!get_uint(fp, &path_len, sizeof(uint16_t))) {
+      goto cleanup;
+    }
+
+    entry->path = (char *)malloc(path_len + 1);
+    mem_chkoom(entry->path);
+    entry->path[path_len] = 0;
+
+    if (path_len != fread(entry->path, 1, path_len, fp) ||
+        !get_uint(fp, &entry->size, sizeof(uint64_t)) ||
+        !get_uint(fp, &mode, sizeof(uint32_t)) ||
+        TM_HASH_SHA256_LEN != fread(entry->hash, 1, TM_HASH_SHA256_LEN, fp)) {
+      ret.count++; // Make sure the path is freed
+      goto cleanup;
+    }
+
+    entry->mode = (uint32_t)mode;
+  }
+
+  *manifest = ret;
+  success   = true;
+
+cleanup:
+  if (!success) {
+    manifest_free(ret);
+  }
+
+  fclose(fp);
+  return success;
+}
+
+void manifest_check(manifest_status_t *statuses,
+                    manifest_t         manifest,
+                    const char        *pkg_path) {
+  manifest_job_ctx_t ctx = {
+      .entries = manifest.entries, .statuses = statuses, .pkg_path = pkg_path};
+  atomic_init(&ctx.failed, false);
+  pool_run(manifest.count, check_job, &ctx);
+}
+
+void manifest_free(manifest_t manifest) {
+  for (size_t i = 0; i < manifest.count; i++) {
+    mem_safe_free(manifest.entries[i].path);
+  }
+
+  mem_safe_free(manifest.entries);
+}
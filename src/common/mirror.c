@@ -0,0 +1,597 @@
+/*************************************************************************
+| tarman                                                                 |
+| Copyright (C) 2024 Alessandro Salerno                                  |
+|                                                                        |
+| This program is free software: you can redistribute it and/or modify   |
+| it under the terms of the GNU General Public License as published by   |
+| the Free Software Foundation, either version 3 of the License, or      |
+| (at your option) any later version.                                    |
+|                                                                        |
+| This program is distributed in the hope that it will be useful,        |
+| but WITHOUT ANY WARRANTY; without even the implied warranty of         |
+| MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the          |
+| GNU General Public License for more details.                           |
+|                                                                        |
+| You should have received a copy of the GNU General Public License      |
+| along with this program.  If not, see <https://www.gnu.org/licenses/>. |
+*************************************************************************/
+
+
+#include "mirror.h"
+#include <limits.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "cli/output.h"
+#include "download.h"
+#include "os/exec.h"
+#include "os/fs.h"
+#include "os/thread.h"
+#include "plugin/plugin.h"
+#include "pool.h"
+#include "settings.h"
+#include "stream.h"
+#include "tm-mem.h"
+#include "util/misc.h"
+
+#define PROBE_TIMEOUT "5"
+#define TICK_MS       100
+#define MAX_ATTEMPTS  2 // Transfers running at the same time
+#define UNREACHABLE   ULONG_MAX
+#define RATE_BUF_LEN  32
+
+// Transfers that receive less than 1 B/s for this long
+// are aborted by curl, which makes tarman fail over
+#define ABORT_SECS "30"
+
+// Returned by curl when a server does not support resuming
+#define CURL_RANGE_ERROR 33
+
+typedef struct {
+  char         *origin;
+  unsigned long latency; // Milliseconds to the first byte
+  long long     measured;
+} latency_entry_t;
+
+typedef struct {
+  latency_entry_t *entries;
+  size_t           count;
+} latency_table_t;
+
+typedef struct {
+  const mirror_list_t *list;
+  unsigned long       *latencies;
+} probe_ctx_t;
+
+typedef struct {
+  os_proc_t proc;
+  size_t    mirror; // Index in the mirror list
+  char     *part_path;
+  char     *hdr_path;
+  size_t    size; // Bytes received as of the last tick
+  size_t    idle_ms;
+  bool      running;
+} attempt_t;
+
+static char *dystrndup(const char *str, size_t len) {
+  char *dup = (char *)malloc(len + 1);
+  mem_chkoom(dup);
+  memcpy(dup, str, len);
+  dup[len] = 0;
+  return dup;
+}
+
+// Latency depends on the server, not on the file,
+// so mirrors are measured by scheme://host[:port]
+static char *dyorigin(const char *url) {
+  const char *host = strstr(url, "://");
+
+  if (NULL == host) {
+    return dystrndup(url, strlen(url));
+  }
+
+  const char *path = strchr(host + 3, '/');
+  size_t      len  = (NULL != path) ? (size_t)(path - url) : strlen(url);
+  return dystrndup(url, len);
+}
+
+static latency_entry_t *find_entry(latency_table_t *table, const char *url) {
+  char            *origin = dyorigin(url);
+  latency_entry_t *ret    = NULL;
+
+  for (size_t i = 0; i < table->count; i++) {
+    if (0 == strcmp(table->entries[i].origin, origin)) {
+      ret = &table->entries[i];
+      break;
+    }
+  }
+
+  mem_safe_free(origin);
+  return ret;
+}
+
+static void
+set_latency(latency_table_t *table, const char *url, unsigned long latency) {
+  latency_entry_t *entry = find_entry(table, url);
+
+  if (NULL == entry) {
+    table->entries = (latency_entry_t *)realloc(
+        table->entries, (table->count + 1) * sizeof(latency_entry_t));
+    mem_chkoom(table->entries);
+    entry         = &table->entries[table->count];
+    entry->origin = dyorigin(url);
+    table->count++;
+  }
+
+  entry->latency  = latency;
+  entry->measured = (long long)time(NULL);
+}
+
+static void dytable_path(char **dst) {
+  char *home = NULL;
+  os_fs_tm_dyhome(&home);
+  os_fs_path_dyconcat(dst, 2, home, TM_MIRROR_TABLE_FILE);
+  mem_safe_free(home);
+}
+
+// Lines are "<latency> <time of measurement> <origin>"
+static void load_table(latency_table_t *table) {
+  char *path = NULL;
+  char *line = NULL;
+  FILE *fp   = NULL;
+
+  dytable_path(&path);
+
+  if (NULL == (fp = fopen(path, "r"))) {
+    mem_safe_free(path);
+    return;
+  }
+
+  while (0 != stream_dyreadline(fp, &line)) {
+    char         *end      = NULL;
+    unsigned long latency  = strtoul(line, &end, 10);
+    long long     measured = strtoll(end, &end, 10);
+
+    for (; ' ' == *end; end++)
+      ;
+
+    if (0 != *end) {
+      set_latency(table, end, latency);
+      find_entry(table, end)->measured = measured;
+    }
+
+    mem_safe_free(line);
+  }
+
+  fclose(fp);
+  mem_safe_free(path);
+}
+
+// The table is only a hint, so failing to save it is not an error
+static void save_table(latency_table_t table) {
+  char *path     = NULL;
+  char *tmp_path = NULL;
+  FILE *fp       = NULL;
+
+  dytable_path(&path);
+  util_misc_dytmpfile(&tmp_path, "__mirrors", "tarman");
+
+  if (NULL != (fp = fopen(tmp_path, "w"))) {
+    for (size_t i = 0; i < table.count; i++) {
+      fprintf(fp,
+              "%lu %lld %s\n",
+              table.entries[i].latency,
+              table.entries[i].measured,
+              table.entries[i].origin);
+    }
+
+    fclose(fp);
+    os_fs_file_mv(path, tmp_path);
+  }
+
+  os_fs_file_rm(tmp_path);
+  mem_safe_free(path);
+  mem_safe_free(tmp_path);
+}
+
+static void free_table(latency_table_t table) {
+  for (size_t i = 0; i < table.count; i++) {
+    mem_safe_free(table.entries[i].origin);
+  }
+
+  mem_safe_free(table.entries);
+}
+
+// Measures the time to the first byte of the file itself, rather than
+// just the connection, as that is what slow or overloaded mirrors affect
+static void probe_job(size_t index, void *ctx) {
+  probe_ctx_t *probe    = (probe_ctx_t *)ctx;
+  char        *tmp_path = NULL;
+  FILE        *out      = NULL;
+  double       secs     = -1;
+  os_proc_t    proc;
+
+  probe->latencies[index] = UNREACHABLE;
+  util_misc_dytmpfile(&tmp_path, "__probe", "part");
+
+  if (os_exec_pipe(&proc,
+                   &out,
+                   "curl",
+                   "-s",
+                   "-f",
+                   "-L",
+                   "-r",
+                   "0-0",
+                   "--max-time",
+                   PROBE_TIMEOUT,
+                   "-w",
+                   "%{time_starttransfer}",
+                   "-o",
+                   tmp_path,
+                   probe->list->urls[index],
+                   NULL)) {
+    bool parsed = 1 == fscanf(out, "%lf", &secs);
+    fclose(out);
+
+    if (EXIT_SUCCESS == os_exec_wait(proc) && parsed && 0 <= secs) {
+      probe->latencies[index] = (unsigned long)(secs * 1000);
+    }
+  }
+
+  os_fs_file_rm(tmp_path);
+  mem_safe_free(tmp_path);
+}
+
+// Returns the indices of the mirrors from fastest to slowest. Mirrors are
+// only probed when the table has no recent measurement for one of them
+static size_t *dyrank(mirror_list_t list, latency_table_t *table, bool log) {
+  size_t        *order     = (size_t *)malloc(list.count * sizeof(size_t));
+  unsigned long *latencies = (unsigned long *)malloc(list.count *
+                                                     sizeof(unsigned long));
+  long long      now       = (long long)time(NULL);
+  bool           stale     = false;
+  mem_chkoom(order);
+  mem_chkoom(latencies);
+
+  for (size_t i = 0; i < list.count; i++) {
+    latency_entry_t *entry = find_entry(table, list.urls[i]);
+
+    if (NULL == entry || TM_MIRROR_TABLE_TTL < now - entry->measured) {
+      stale = true;
+      break;
+    }
+
+    latencies[i] = entry->latency;
+  }
+
+  if (stale) {
+    char        num_buf[32];
+    probe_ctx_t ctx = {.list = &list, .latencies = latencies};
+    snprintf(num_buf, sizeof num_buf, "%zu", list.count);
+
+    if (log) {
+      cli_out_progress("Measuring latency of %s mirrors", num_buf);
+    }
+
+    pool_run_io(list.count, probe_job, &ctx);
+
+    for (size_t i = 0; i < list.count; i++) {
+      set_latency(table, list.urls[i], latencies[i]);
+    }
+
+    save_table(*table);
+  }
+
+  // Stable, so the primary URL wins ties
+  for (size_t i = 0; i < list.count; i++) {
+    size_t j = i;
+
+    for (; 0 < j && latencies[order[j - 1]] > latencies[i]; j--) {
+      order[j] = order[j - 1];
+    }
+
+    order[j] = i;
+  }
+
+  mem_safe_free(latencies);
+  return order;
+}
+
+static size_t part_size(const char *path) {
+  fs_fileinfo_t info;
+
+  if (TM_FS_FILEOP_STATUS_OK != os_fs_file_getinfo(&info, path)) {
+    return 0;
+  }
+
+  return info.size;
+}
+
+// Transfers always resume from whatever is already in the part file,
+// which is what allows failing over in the middle of a download. The rate
+// limit applies to each attempt, as a hedge only runs while another stalls
+static void start_attempt(attempt_t *attempt, mirror_list_t list, size_t i) {
+  char limit[RATE_BUF_LEN];
+  snprintf(limit, sizeof limit, "%zu", settings_get()->download_rate);
+
+  attempt->mirror  = i;
+  attempt->size    = part_size(attempt->part_path);
+  attempt->idle_ms = 0;
+  attempt->running = os_exec_spawn(&attempt->proc,
+                                   "curl",
+                                   "-s",
+                                   "-f",
+                                   "-L",
+                                   "-C",
+                                   "-",
+                                   "--connect-timeout",
+                                   PROBE_TIMEOUT,
+                                   "--speed-limit",
+                                   "1",
+                                   "--speed-time",
+                                   ABORT_SECS,
+                                   "--limit-rate",
+                                   limit,
+                                   "-D",
+                                   attempt->hdr_path,
+                                   "-o",
+                                   attempt->part_path,
+                                   list.urls[i],
+                                   NULL);
+}
+
+// Returns true if the attempt is still running
+static bool tick_attempt(attempt_t *attempt, int *status) {
+  if (os_exec_poll(attempt->proc, status)) {
+    attempt->running = false;
+    return false;
+  }
+
+  size_t size      = part_size(attempt->part_path);
+  attempt->idle_ms = (size == attempt->size) ? attempt->idle_ms + TICK_MS : 0;
+  attempt->size    = size;
+  return true;
+}
+
+static attempt_t *race(mirror_list_t    list,
+                       const size_t    *order,
+                       attempt_t       *attempts,
+                       latency_table_t *table,
+                       bool             log) {
+  size_t next = 0;
+  start_attempt(&attempts[0], list, order[next++]);
+
+  for (;;) {
+    attempt_t *active      = NULL;
+    attempt_t *idle        = NULL;
+    size_t     num_running = 0;
+
+    for (size_t i = 0; i < MAX_ATTEMPTS; i++) {
+      attempt_t *attempt = &attempts[i];
+      int        status  = EXIT_FAILURE;
+
+      if (attempt->running && tick_attempt(attempt, &status)) {
+        active = attempt;
+        num_running++;
+        continue;
+      }
+
+      if (EXIT_SUCCESS == status) {
+        return attempt;
+      }
+
+      // Attempts that were never started have nothing to fail over
+      if (NULL == attempt->proc) {
+        idle = attempt;
+        continue;
+      }
+
+      attempt->proc = NULL;
+      set_latency(table, list.urls[attempt->mirror], UNREACHABLE);
+
+      if (CURL_RANGE_ERROR == status) {
+        os_fs_file_rm(attempt->part_path);
+      }
+
+      if (next < list.count) {
+        if (log) {
+          cli_out_warning("Mirror '%s' failed, resuming from '%s'",
+                          list.urls[attempt->mirror],
+                          list.urls[order[next]]);
+        }
+
+        start_attempt(attempt, list, order[next++]);
+        active = attempt;
+        num_running++;
+        continue;
+      }
+
+      idle = attempt;
+    }
+
+    if (0 == num_running) {
+      return NULL;
+    }
+
+    // Stalls are often caused by a single overloaded server, so instead of
+    // giving up on it, the next mirror is started and the first to finish wins
+    if (1 == num_running && NULL != idle && next < list.count &&
+        TM_MIRROR_STALL_MS <= active->idle_ms) {
+      if (log) {
+        cli_out_warning("Mirror '%s' stalled, racing '%s'",
+                        list.urls[active->mirror],
+                        list.urls[order[next]]);
+      }
+
+      os_fs_file_rm(idle->part_path);
+      start_attempt(idle, list, order[next++]);
+      active->idle_ms = 0;
+    }
+
+    os_thread_sleep(TICK_MS);
+  }
+}
+
+static bool download_racing(const char      *dst,
+                            mirror_list_t    list,
+                            const size_t    *order,
+                            size_t          *used,
+                            download_meta_t *meta,
+                            latency_table_t *table,
+                            bool             log) {
+  attempt_t  attempts[MAX_ATTEMPTS] = {0};
+  attempt_t *winner                 = NULL;
+  bool       ret                    = false;
+
+  for (size_t i = 0; i < MAX_ATTEMPTS; i++) {
+    util_misc_dytmpfile(&attempts[i].part_path, "__mirror", "part");
+    util_misc_dytmpfile(&attempts[i].hdr_path, "__mirror", "headers");
+  }
+
+  winner = race(list, order, attempts, table, log);
+
+  for (size_t i = 0; i < MAX_ATTEMPTS; i++) {
+    if (attempts[i].running) {
+      os_exec_kill(attempts[i].proc);
+      os_exec_wait(attempts[i].proc);
+    }
+  }
+
+  if (NULL != winner &&
+      TM_FS_FILEOP_STATUS_OK == os_fs_file_mv(dst, winner->part_path)) {
+    FILE *headers = fopen(winner->hdr_path, "r");
+    *used         = winner->mirror;
+    ret           = true;
+
+    // Validators from other mirrors would not match those of the primary URL
+    if (0 == winner->mirror && NULL != headers) {
+      download_parse_headers(headers, meta);
+    }
+
+    if (NULL != headers) {
+      fclose(headers);
+    }
+  }
+
+  for (size_t i = 0; i < MAX_ATTEMPTS; i++) {
+    os_fs_file_rm(attempts[i].part_path);
+    os_fs_file_rm(attempts[i].hdr_path);
+    mem_safe_free(attempts[i].part_path);
+    mem_safe_free(attempts[i].hdr_path);
+  }
+
+  return ret;
+}
+
+// Plugins cannot be monitored, so mirrors are only tried one after the other
+static bool download_plugin(const char      *dst,
+                            mirror_list_t    list,
+                            const size_t    *order,
+                            size_t          *used,
+                            latency_table_t *table,
+                            bool             log) {
+  for (size_t i = 0; i < list.count; i++) {
+    if (download(dst, list.urls[order[i]])) {
+      *used = order[i];
+      return true;
+    }
+
+    set_latency(table, list.urls[order[i]], UNREACHABLE);
+
+    if (log && i + 1 < list.count) {
+      cli_out_warning("Mirror '%s' failed, trying '%s'",
+                      list.urls[order[i]],
+                      list.urls[order[i + 1]]);
+    }
+  }
+
+  return false;
+}
+
+bool mirror_parse_list(mirror_list_t *list,
+                       const char    *primary,
+                       const char    *mirrors) {
+  list->urls  = NULL;
+  list->count = 0;
+
+  const char *cur = (NULL != mirrors) ? mirrors : "";
+
+  // One extra slot for the primary URL
+  size_t max = 2;
+  for (const char *c = cur; 0 != *c; c++) {
+    max += ',' == *c;
+  }
+
+  list->urls = (char **)malloc(max * sizeof(char *));
+  mem_chkoom(list->urls);
+
+  if (NULL != primary) {
+    list->urls[list->count++] = dystrndup(primary, strlen(primary));
+  }
+
+  while (0 != *cur) {
+    for (; ' ' == *cur || ',' == *cur; cur++)
+      ;
+
+    size_t len = strcspn(cur, ",");
+
+    for (; 0 < len && ' ' == cur[len - 1]; len--)
+      ;
+
+    if (0 != len) {
+      list->urls[list->count++] = dystrndup(cur, len);
+    }
+
+    cur += strcspn(cur, ",");
+  }
+
+  return 0 != list->count;
+}
+
+void mirror_free_list(mirror_list_t list) {
+  for (size_t i = 0; i < list.count; i++) {
+    mem_safe_free(list.urls[i]);
+  }
+
+  mem_safe_free(list.urls);
+}
+
+bool mirror_download(const char      *dst,
+                     mirror_list_t    list,
+                     size_t          *used,
+                     download_meta_t *meta,
+                     bool             log) {
+  meta->etag          = NULL;
+  meta->last_modified = NULL;
+  *used               = 0;
+
+  // Probing mirrors would also need the network
+  if (0 == list.count || download_offline()) {
+    return false;
+  }
+
+  if (1 == list.count) {
+    return download_meta(dst, list.urls[0], meta);
+  }
+
+  latency_table_t table = {0};
+  load_table(&table);
+
+  size_t *order = dyrank(list, &table, log);
+  bool    ret   = false;
+
+  if (plugin_exists("download-plugin")) {
+    ret = download_plugin(dst, list, order, used, &table, log);
+  } else {
+    ret = download_racing(dst, list, order, used, meta, &table, log);
+  }
+
+  // Failures are recorded so that dead mirrors are tried last next time
+  save_table(table);
+  free_table(table);
+  mem_safe_free(order);
+  return ret;
+}
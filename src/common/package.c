@@ -16,6 +16,7 @@
 | along with this program.  If not, see <https://www.gnu.org/licenses/>. |
 *************************************************************************/
 
+#include <ctype.h>
 #include <stdarg.h>
 #include <stdbool.h>
 #include <stdio.h>
@@ -61,8 +62,26 @@ rcp_translator(const char *key, const char *value, recipe_t *rcp) {
   const char *add_to_tarman  = NULL;
 
   cfg_prop_match_t match = cfg_eval_prop_matches(
-      4,
+      12,
       cfg_eval_prop("PACKAGE_FORMAT", key, value, &rcp->package_format, 0),
+      cfg_eval_prop("MIRRORS", key, value, &rcp->mirrors, 0),
+      cfg_eval_prop("VERSION", key, value, &rcp->version, 0),
+      cfg_eval_prop("DEPENDS", key, value, &rcp->depends, 0),
+      cfg_eval_prop("ARCHIVE_SHA256", key, value, &rcp->archive_sha256, 0),
+      cfg_eval_prop("DELTA_URL", key, value, &rcp->delta_url, 0),
+      cfg_eval_prop("ARCHIVE_ETAG", key, value, &rcp->archive_etag, 0),
+      cfg_eval_prop("ARCHIVE_LAST_MODIFIED",
+                    key,
+                    value,
+                    &rcp->archive_last_modified,
+                    0),
+      cfg_eval_prop("DELTA_FORMAT",
+                    key,
+                    value,
+                    &rcp->delta_format,
+                    2,
+                    "zstd",
+                    "bsdiff"),
       cfg_eval_prop(
           "ADD_TO_PATH", key, value, &add_to_path, 2, "true", "false"),
       cfg_eval_prop(
@@ -70,10 +89,20 @@ rcp_translator(const char *key, const char *value, recipe_t *rcp) {
       cfg_eval_prop(
           "ADD_TO_TARMAN", key, value, &add_to_tarman, 2, "true", "false"));
 
-  if (TM_CFG_PROP_MATCH_ERR == match) {
+  pkg_dep_t *deps     = NULL;
+  size_t     num_deps = 0;
+
+  if (TM_CFG_PROP_MATCH_ERR == match ||
+      (0 == strcmp("DEPENDS", key) &&
+       !pkg_parse_depends(&deps, &num_deps, value))) {
+    mem_safe_free(add_to_path);
+    mem_safe_free(add_to_desktop);
+    mem_safe_free(add_to_tarman);
     return TM_CFG_PARSE_STATUS_INVVAL;
   }
 
+  pkg_free_depends(deps, num_deps);
+
   if (NULL != add_to_path && 0 == strcmp(add_to_path, "true")) {
     rcp->add_to_path = true;
   }
@@ -167,6 +196,14 @@ bool pkg_dump_frcp(FILE *fp, recipe_t recipe) {
   dump_if_set(fp, "WORKING_DIRECTORY", recipe.pkg_info.working_directory);
   dump_if_set(fp, "ICON_PATH", recipe.pkg_info.icon_path);
   dump_if_set(fp, "PACKAGE_FORMAT", recipe.package_format);
+  dump_if_set(fp, "MIRRORS", recipe.mirrors);
+  dump_if_set(fp, "ARCHIVE_SHA256", recipe.archive_sha256);
+  dump_if_set(fp, "DELTA_URL", recipe.delta_url);
+  dump_if_set(fp, "DELTA_FORMAT", recipe.delta_format);
+  dump_if_set(fp, "ARCHIVE_ETAG", recipe.archive_etag);
+  dump_if_set(fp, "ARCHIVE_LAST_MODIFIED", recipe.archive_last_modified);
+  dump_if_set(fp, "VERSION", recipe.version);
+  dump_if_set(fp, "DEPENDS", recipe.depends);
   dump_bool(fp, "ADD_TO_PATH", recipe.add_to_path);
   dump_bool(fp, "ADD_TO_DESKTOP", recipe.add_to_desktop);
   dump_bool(fp, "ADD_TO_TARMAN", recipe.add_to_tarman);
@@ -198,4 +235,194 @@ void pkg_free_pkg(pkg_info_t pkg_info) {
 void pkg_free_rcp(recipe_t recipe) {
   pkg_free_pkg(recipe.pkg_info);
   mem_safe_free(recipe.package_format);
+  mem_safe_free(recipe.mirrors);
+  mem_safe_free(recipe.archive_sha256);
+  mem_safe_free(recipe.delta_url);
+  mem_safe_free(recipe.delta_format);
+  mem_safe_free(recipe.archive_etag);
+  mem_safe_free(recipe.archive_last_modified);
+  mem_safe_free(recipe.version);
+  mem_safe_free(recipe.depends);
+}
+
+static const char *skip_blanks(const char *str) {
+  while (' ' == *str || '\t' == *str) {
+    str++;
+  }
+
+  return str;
+}
+
+static char *dytrimmed(const char *start, const char *end) {
+  while (end > start && (' ' == end[-1] || '\t' == end[-1])) {
+    end--;
+  }
+
+  char *str = (char *)malloc(end - start + 1);
+  mem_chkoom(str);
+  memcpy(str, start, end - start);
+  str[end - start] = 0;
+  return str;
+}
+
+static pkg_dep_op_t parse_dep_op(const char **str) {
+  static const struct {
+    const char  *text;
+    pkg_dep_op_t op;
+  } ops[] = {{">=", TM_PKG_DEP_GE},
+             {"<=", TM_PKG_DEP_LE},
+             {"==", TM_PKG_DEP_EQ},
+             {">", TM_PKG_DEP_GT},
+             {"<", TM_PKG_DEP_LT},
+             {"=", TM_PKG_DEP_EQ}};
+
+  for (size_t i = 0; i < sizeof ops / sizeof ops[0]; i++) {
+    size_t len = strlen(ops[i].text);
+
+    if (0 == strncmp(*str, ops[i].text, len)) {
+      *str += len;
+      return ops[i].op;
+    }
+  }
+
+  return TM_PKG_DEP_ANY;
+}
+
+// Parses entries like 'jre, node>=18, python<4'. Fails on empty names,
+// operators without a version and names with characters that could not
+// be package names
+bool pkg_parse_depends(pkg_dep_t **deps, size_t *count, const char *depends) {
+  size_t     cap  = 4;
+  size_t     num  = 0;
+  pkg_dep_t *list = (pkg_dep_t *)malloc(cap * sizeof(pkg_dep_t));
+  mem_chkoom(list);
+
+  for (const char *entry = depends; NULL != entry;) {
+    const char *end = strchr(entry, ',');
+    const char *cur = skip_blanks(entry);
+    entry           = (NULL == end) ? NULL : end + 1;
+    end             = (NULL == end) ? cur + strlen(cur) : end;
+
+    // Trailing commas and the like
+    if (cur == end) {
+      continue;
+    }
+
+    const char *name_end = cur;
+
+    while (name_end < end && (isalnum((unsigned char)*name_end) ||
+                              NULL != strchr("._+-", *name_end))) {
+      name_end++;
+    }
+
+    const char  *op_start = skip_blanks(name_end);
+    pkg_dep_op_t op       = parse_dep_op(&op_start);
+    const char  *ver      = skip_blanks(op_start);
+
+    if (name_end == cur || (TM_PKG_DEP_ANY == op && op_start != end) ||
+        (TM_PKG_DEP_ANY != op && ver >= end)) {
+      pkg_free_depends(list, num);
+      return false;
+    }
+
+    if (num == cap) {
+      cap *= 2;
+      list = (pkg_dep_t *)realloc(list, cap * sizeof(pkg_dep_t));
+      mem_chkoom(list);
+    }
+
+    list[num++] = (pkg_dep_t){
+        .name    = dytrimmed(cur, name_end),
+        .op      = op,
+        .version = (TM_PKG_DEP_ANY == op) ? NULL : dytrimmed(ver, end)};
+  }
+
+  *deps  = list;
+  *count = num;
+  return true;
+}
+
+void pkg_free_depends(pkg_dep_t *deps, size_t count) {
+  if (NULL == deps) {
+    return;
+  }
+
+  for (size_t i = 0; i < count; i++) {
+    mem_safe_free(deps[i].name);
+    mem_safe_free(deps[i].version);
+  }
+
+  mem_safe_free(deps);
+}
+
+static bool is_ver_sep(char ch) {
+  return '.' == ch || '-' == ch || '_' == ch || '+' == ch;
+}
+
+// Versions are compared one component at a time, numerically where both
+// components are numbers (so that 1.10 > 1.9) and alphabetically
+// otherwise. Missing components count as lower (1.0 < 1.0.1)
+int pkg_cmp_versions(const char *a, const char *b) {
+  while (0 != *a && 0 != *b) {
+    size_t a_len = 0;
+    size_t b_len = 0;
+
+    while (0 != a[a_len] && !is_ver_sep(a[a_len])) {
+      a_len++;
+    }
+
+    while (0 != b[b_len] && !is_ver_sep(b[b_len])) {
+      b_len++;
+    }
+
+    bool a_num = 0 != a_len && strspn(a, "0123456789") == a_len;
+    bool b_num = 0 != b_len && strspn(b, "0123456789") == b_len;
+    int  cmp   = 0;
+
+    if (a_num && b_num) {
+      unsigned long long a_val = strtoull(a, NULL, 10);
+      unsigned long long b_val = strtoull(b, NULL, 10);
+      cmp                      = (a_val > b_val) - (a_val < b_val);
+    } else {
+      size_t min_len = (a_len < b_len) ? a_len : b_len;
+      cmp            = strncmp(a, b, min_len);
+      cmp            = (0 != cmp) ? cmp : (a_len > b_len) - (a_len < b_len);
+    }
+
+    if (0 != cmp) {
+      return (0 < cmp) - (0 > cmp);
+    }
+
+    a += a_len + (0 != a[a_len]);
+    b += b_len + (0 != b[b_len]);
+  }
+
+  return (0 != *a) - (0 != *b);
+}
+
+bool pkg_dep_satisfied(const pkg_dep_t *dep, const char *version) {
+  if (TM_PKG_DEP_ANY == dep->op) {
+    return true;
+  }
+
+  if (NULL == version) {
+    return false;
+  }
+
+  int cmp = pkg_cmp_versions(version, dep->version);
+
+  switch (dep->op) {
+  case TM_PKG_DEP_EQ:
+    return 0 == cmp;
+  case TM_PKG_DEP_LT:
+    return 0 > cmp;
+  case TM_PKG_DEP_LE:
+    return 0 >= cmp;
+  case TM_PKG_DEP_GT:
+    return 0 < cmp;
+  case TM_PKG_DEP_GE:
+    return 0 <= cmp;
+  default:
+    return true;
+  }
 }
@@ -0,0 +1,501 @@
+/*************************************************************************
+| tarman                                                                 |
+| Copyright (C) 2024 Alessandro Salerno                                  |
+|                                                                        |
+| This program is free software: you can redistribute it and/or modify   |
+| it under the terms of the GNU General Public License as published by   |
+| the Free Software Foundation, either version 3 of the License, or      |
+| (at your option) any later version.                                    |
+|                                                                        |
+| This program is distributed in the hope that it will be useful,        |
+| but WITHOUT ANY WARRANTY; without even the implied warranty of         |
+| MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the          |
+| GNU General Public License for more details.                           |
+|                                                                        |
+| You should have received a copy of the GNU General Public License      |
+| along with this program.  If not, see <https://www.gnu.org/licenses/>. |
+*************************************************************************/
+
+
+#include "peer.h"
+#include <ctype.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "cli/output.h"
+#include "download.h"
+#include "hash.h"
+#include "http.h"
+#include "os/fs.h"
+#include "os/net.h"
+#include "settings.h"
+#include "tm-mem.h"
+
+#define SCHEME       "http://"
+#define MAX_CONNS    256
+#define MAX_HEAD_LEN (8 * 1024)
+#define SEND_LEN     (64 * 1024)
+#define MAX_EVENTS   64
+#define TICK_MS      1000
+
+typedef enum { CONN_READING, CONN_SENDING } conn_state_t;
+
+typedef struct {
+  os_net_sock_t sock;
+  conn_state_t  state;
+  char          in[MAX_HEAD_LEN];
+  size_t        in_len;
+  char          out[SEND_LEN];
+  size_t        out_len;
+  size_t        out_pos;
+  FILE         *file;      // Body being sent, if any
+  uint64_t      remaining; // Bytes of the body not read from file yet
+  bool          keep_alive;
+  time_t        active;
+} conn_t;
+
+typedef struct {
+  os_net_sock_t   listener;
+  os_net_poller_t poller;
+  conn_t         *conns[MAX_CONNS];
+  size_t          num_conns;
+} server_t;
+
+// Peers are given as host or host:port, IPv6 addresses in brackets
+static char *dypeer_url(const char *peer, size_t len, const char *name) {
+  const char *host_end = memchr(peer, ']', len);
+  size_t      skip     = (NULL != host_end) ? (size_t)(host_end - peer) : 0;
+  bool        has_port = NULL != memchr(peer + skip, ':', len - skip);
+  size_t      bufsz    = strlen(SCHEME) + len + strlen(":") +
+                   strlen(TM_PEER_DEFAULT_PORT) + strlen("/") + strlen(name) +
+                   1;
+  char *url = (char *)malloc(bufsz * sizeof(char));
+  mem_chkoom(url);
+
+  snprintf(url,
+           bufsz,
+           "%s%.*s%s%s/%s",
+           SCHEME,
+           (int)len,
+           peer,
+           has_port ? "" : ":",
+           has_port ? "" : TM_PEER_DEFAULT_PORT,
+           name);
+  return url;
+}
+
+bool peer_configured(void) {
+  const char *peers = settings_get()->cache_peers;
+  return NULL != peers && 0 != peers[0] && !download_offline();
+}
+
+bool peer_fetch(const char *dst, const char *name) {
+  peer_item_t item = {.dst = dst, .name = name};
+  peer_fetch_many(&item, 1);
+  return item.ok;
+}
+
+// Peers are asked in the order in which they are listed, each one only for
+// the archives that the previous ones did not have
+void peer_fetch_many(peer_item_t *items, size_t count) {
+  for (size_t i = 0; i < count; i++) {
+    items[i].ok = false;
+  }
+
+  if (!peer_configured() || 0 == count) {
+    return;
+  }
+
+  http_transfer_t *transfers =
+      (http_transfer_t *)malloc((count + 1) * sizeof(http_transfer_t));
+  peer_item_t **owners =
+      (peer_item_t **)malloc((count + 1) * sizeof(peer_item_t *));
+  mem_chkoom(transfers);
+  mem_chkoom(owners);
+
+  const char *peer = settings_get()->cache_peers;
+
+  while (0 != *peer) {
+    size_t len = strcspn(peer, ",");
+    size_t num = 0;
+
+    for (size_t i = 0; i < count && 0 != len; i++) {
+      if (items[i].ok) {
+        continue;
+      }
+
+      transfers[num] = (http_transfer_t){
+          .url = dypeer_url(peer, len, items[i].name), .dst = items[i].dst};
+      owners[num] = &items[i];
+      num++;
+    }
+
+    if (0 != num) {
+      http_fetch_all(transfers, num);
+    }
+
+    for (size_t i = 0; i < num; i++) {
+      owners[i]->ok = TM_HTTP_RESULT_OK == transfers[i].result;
+      download_free_meta(transfers[i].meta);
+      mem_safe_free(transfers[i].url);
+    }
+
+    peer += len;
+    peer += (',' == *peer) ? 1 : 0;
+  }
+
+  // Archives no peer had may have left an error page behind
+  for (size_t i = 0; i < count; i++) {
+    if (!items[i].ok) {
+      os_fs_file_rm(items[i].dst);
+    }
+  }
+
+  mem_safe_free(transfers);
+  mem_safe_free(owners);
+}
+
+// Only archives stored by 'tarman fetch' can be requested, and they are
+// always named <SHA-256>.<package format>. Nothing else in the tarman
+// directory is reachable
+static bool dyfetched_path(char **dst, char *name) {
+  char *dot = strchr(name, '.');
+
+  if (NULL == dot || TM_HASH_SHA256_HEXLEN != dot - name || 0 == dot[1]) {
+    return false;
+  }
+
+  for (const char *c = name; c < dot; c++) {
+    if (!isxdigit((unsigned char)*c)) {
+      return false;
+    }
+  }
+
+  for (const char *c = dot + 1; 0 != *c; c++) {
+    if (!isalnum((unsigned char)*c) && '.' != *c && '-' != *c && '_' != *c) {
+      return false;
+    }
+  }
+
+  *dot = 0;
+  os_fs_tm_dyfetched(dst, name, dot + 1);
+  *dot = '.';
+  return true;
+}
+
+static void
+respond(conn_t *conn, const char *status, uint64_t len, bool keep_alive) {
+  int written = snprintf(conn->out,
+                         sizeof conn->out,
+                         "HTTP/1.1 %s\r\n"
+                         "Content-Length: %llu\r\n"
+                         "Content-Type: application/octet-stream\r\n"
+                         "Connection: %s\r\n"
+                         "\r\n",
+                         status,
+                         (unsigned long long)len,
+                         keep_alive ? "keep-alive" : "close");
+
+  conn->out_len    = (size_t)written;
+  conn->out_pos    = 0;
+  conn->keep_alive = keep_alive;
+  conn->state      = CONN_SENDING;
+}
+
+static bool
+header_has_value(const char *line, const char *name, const char *value) {
+  const char *found = http_header_value(line, name);
+  size_t      len   = strlen(value);
+
+  if (NULL == found) {
+    return false;
+  }
+
+  for (size_t i = 0; i < len; i++) {
+    if (value[i] != tolower((unsigned char)found[i])) {
+      return false;
+    }
+  }
+
+  return true;
+}
+
+// The head ends with an empty line, which has been replaced by a string
+// terminator. Requests never have a body
+static void handle_request(conn_t *conn, char *head) {
+  char          method[8];
+  char          target[MAX_HEAD_LEN];
+  int           minor     = 0;
+  char         *path      = NULL;
+  bool          keep      = false;
+  bool          is_head   = false;
+  fs_fileinfo_t info;
+
+  if (3 != sscanf(head, "%7s %8191s HTTP/1.%d", method, target, &minor)) {
+    respond(conn, "400 Bad Request", 0, false);
+    return;
+  }
+
+  keep = 1 <= minor;
+
+  for (char *line = strstr(head, "\r\n"); NULL != line;
+       line       = strstr(line, "\r\n")) {
+    line += 2;
+
+    if (header_has_value(line, "connection", "close")) {
+      keep = false;
+    } else if (header_has_value(line, "connection", "keep-alive")) {
+      keep = true;
+    }
+  }
+
+  is_head = 0 == strcmp(method, "HEAD");
+
+  if (!is_head && 0 != strcmp(method, "GET")) {
+    respond(conn, "405 Method Not Allowed", 0, keep);
+    return;
+  }
+
+  target[strcspn(target, "?#")] = 0;
+
+  if ('/' != target[0] || !dyfetched_path(&path, &target[1]) ||
+      TM_FS_FILEOP_STATUS_OK != os_fs_file_getinfo(&info, path) ||
+      (TM_FS_FILETYPE_REGULAR != info.file_type &&
+       TM_FS_FILETYPE_EXEC != info.file_type) ||
+      (!is_head && NULL == (conn->file = fopen(path, "rb")))) {
+    respond(conn, "404 Not Found", 0, keep);
+    mem_safe_free(path);
+    return;
+  }
+
+  if (!is_head) {
+    cli_out_progress("Sending '%s'", &target[1]);
+    conn->remaining = info.size;
+  }
+
+  respond(conn, "200 OK", info.size, keep);
+  mem_safe_free(path);
+}
+
+static void close_conn(server_t *server, conn_t *conn) {
+  // There is room for the connections waiting in the backlog again
+  if (MAX_CONNS == server->num_conns) {
+    os_net_poller_watch(
+        server->poller, server->listener, TM_NET_EVENT_READ, server);
+  }
+
+  os_net_poller_unwatch(server->poller, conn->sock);
+  os_net_close(conn->sock);
+
+  if (NULL != conn->file) {
+    fclose(conn->file);
+  }
+
+  for (size_t i = 0; i < server->num_conns; i++) {
+    if (conn == server->conns[i]) {
+      server->num_conns--;
+      server->conns[i] = server->conns[server->num_conns];
+      break;
+    }
+  }
+
+  mem_safe_free(conn);
+}
+
+// Requests may be pipelined, so there can already be another one in the
+// input buffer by the time a response has been sent
+static bool next_request(server_t *server, conn_t *conn) {
+  char *end = NULL;
+
+  conn->in[conn->in_len] = 0;
+
+  if (NULL == (end = strstr(conn->in, "\r\n\r\n"))) {
+    if (MAX_HEAD_LEN - 1 == conn->in_len) {
+      respond(conn, "431 Request Header Fields Too Large", 0, false);
+      return os_net_poller_watch(
+          server->poller, conn->sock, TM_NET_EVENT_WRITE, conn);
+    }
+
+    conn->state = CONN_READING;
+    return os_net_poller_watch(
+        server->poller, conn->sock, TM_NET_EVENT_READ, conn);
+  }
+
+  size_t head_len = (size_t)(end - conn->in) + 4;
+  end[2]          = 0;
+  handle_request(conn, conn->in);
+  memmove(conn->in, conn->in + head_len, conn->in_len - head_len);
+  conn->in_len -= head_len;
+  return os_net_poller_watch(
+      server->poller, conn->sock, TM_NET_EVENT_WRITE, conn);
+}
+
+static bool on_readable(server_t *server, conn_t *conn) {
+  size_t       received = 0;
+  net_status_t status   = os_net_recv(conn->sock,
+                                    conn->in + conn->in_len,
+                                    MAX_HEAD_LEN - 1 - conn->in_len,
+                                    &received);
+
+  if (TM_NET_STATUS_AGAIN == status) {
+    return true;
+  }
+
+  if (TM_NET_STATUS_OK != status) {
+    return false;
+  }
+
+  conn->in_len += received;
+  conn->active = time(NULL);
+  return next_request(server, conn);
+}
+
+static bool on_writable(server_t *server, conn_t *conn) {
+  while (conn->out_pos < conn->out_len) {
+    size_t       sent   = 0;
+    net_status_t status = os_net_send(conn->sock,
+                                      conn->out + conn->out_pos,
+                                      conn->out_len - conn->out_pos,
+                                      &sent);
+
+    if (TM_NET_STATUS_AGAIN == status) {
+      return true;
+    }
+
+    if (TM_NET_STATUS_OK != status) {
+      return false;
+    }
+
+    conn->out_pos += sent;
+    conn->active = time(NULL);
+
+    if (conn->out_pos < conn->out_len || NULL == conn->file) {
+      continue;
+    }
+
+    size_t len = (SEND_LEN < conn->remaining) ? SEND_LEN
+                                              : (size_t)conn->remaining;
+
+    // The length has already been sent, so a file that shrank can only
+    // be reported by closing the connection
+    if (0 != len && len != fread(conn->out, 1, len, conn->file)) {
+      return false;
+    }
+
+    conn->remaining -= len;
+    conn->out_len = len;
+    conn->out_pos = 0;
+
+    if (0 == conn->remaining) {
+      fclose(conn->file);
+      conn->file = NULL;
+    }
+  }
+
+  return conn->keep_alive && next_request(server, conn);
+}
+
+static void accept_conns(server_t *server) {
+  os_net_sock_t sock;
+
+  while (MAX_CONNS > server->num_conns &&
+         TM_NET_STATUS_OK == os_net_accept(server->listener, &sock)) {
+    conn_t *conn = (conn_t *)calloc(1, sizeof(conn_t));
+    mem_chkoom(conn);
+    conn->sock   = sock;
+    conn->state  = CONN_READING;
+    conn->active = time(NULL);
+
+    if (!os_net_poller_watch(
+            server->poller, sock, TM_NET_EVENT_READ, conn)) {
+      os_net_close(sock);
+      mem_safe_free(conn);
+      continue;
+    }
+
+    server->conns[server->num_conns] = conn;
+    server->num_conns++;
+  }
+
+  // Connections are left waiting in the backlog until one is closed
+  if (MAX_CONNS == server->num_conns) {
+    os_net_poller_unwatch(server->poller, server->listener);
+  }
+}
+
+static void check_timeouts(server_t *server) {
+  time_t now = time(NULL);
+
+  // Iterated backwards as closing a connection moves the last one
+  for (size_t i = server->num_conns; 0 < i; i--) {
+    conn_t *conn = server->conns[i - 1];
+
+    if (TM_PEER_IDLE_TIMEOUT < now - conn->active) {
+      close_conn(server, conn);
+    }
+  }
+}
+
+// Serves the archives stored by 'tarman fetch' over plain HTTP, read-only.
+// All connections share one event loop, which only returns on errors
+bool peer_serve(const char *port) {
+  server_t server = {0};
+
+  if (!os_net_listen(&server.listener, NULL, port)) {
+    cli_out_error("Unable to listen on port '%s'", port);
+    return false;
+  }
+
+  if (!os_net_poller_create(&server.poller)) {
+    os_net_close(server.listener);
+    return false;
+  }
+
+  if (!os_net_poller_watch(
+          server.poller, server.listener, TM_NET_EVENT_READ, &server)) {
+    cli_out_error("Unable to accept connections on port '%s'", port);
+    goto cleanup;
+  }
+
+  cli_out_progress("Serving fetched archives on port '%s'", port);
+
+  for (;;) {
+    net_event_t events[MAX_EVENTS];
+    size_t      num_events =
+        os_net_poller_wait(server.poller, events, MAX_EVENTS, TICK_MS);
+
+    // Each connection shows up at most once, and is only ever
+    // closed while handling its own event
+    for (size_t i = 0; i < num_events; i++) {
+      if (&server == events[i].data) {
+        accept_conns(&server);
+        continue;
+      }
+
+      conn_t      *conn  = (conn_t *)events[i].data;
+      unsigned int ready = TM_NET_EVENT_READ | TM_NET_EVENT_WRITE;
+      bool         ok    = false;
+
+      if (CONN_SENDING == conn->state && (ready & events[i].events)) {
+        ok = on_writable(&server, conn);
+      } else if (ready & events[i].events) {
+        ok = on_readable(&server, conn);
+      }
+
+      if (!ok) {
+        close_conn(&server, conn);
+      }
+    }
+
+    check_timeouts(&server);
+  }
+
+cleanup:
+  os_net_poller_destroy(server.poller);
+  os_net_close(server.listener);
+  return false;
+}
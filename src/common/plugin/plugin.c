@@ -16,12 +16,16 @@
 | along with this program.  If not, see <https://www.gnu.org/licenses/>. |
 *************************************************************************/
 
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 
 #include "os/exec.h"
 #include "os/fs.h"
+#include "os/thread.h"
 #include "plugin/plugin.h"
 #include "tm-mem.h"
 
@@ -29,15 +33,131 @@
 #define RQUOTE 1
 #define SPACE  1
 
-bool plugin_exists(const char *plugin) {
-  const char *plugin_path = NULL;
-  os_fs_tm_dyplugin(&plugin_path, plugin);
+#define REGISTRY_EMPTY   0
+#define REGISTRY_LOADING 1
+#define REGISTRY_READY   2
 
-  fs_filetype_t      ftype;
-  fs_fileop_status_t op_status = os_fs_file_gettype(&ftype, plugin_path);
+// Names of the installed plugins, open addressing with linear probing.
+// The table is never more than half full
+typedef struct {
+  char **slots;
+  size_t cap; // Power of two
+  size_t count;
+} registry_t;
 
-  mem_safe_free(plugin_path);
-  return TM_FS_FILETYPE_EXEC == ftype && TM_FS_FILEOP_STATUS_OK == op_status;
+static registry_t Registry = {0};
+static atomic_int RegistryState;
+
+// FNV-1a
+static uint32_t hash_name(const char *name) {
+  uint32_t hash = 2166136261u;
+
+  for (const char *c = name; 0 != *c; c++) {
+    hash ^= (unsigned char)*c;
+    hash *= 16777619u;
+  }
+
+  return hash;
+}
+
+static char **find_slot(char **slots, size_t cap, const char *name) {
+  size_t i = hash_name(name) & (cap - 1);
+
+  while (NULL != slots[i] && 0 != strcmp(slots[i], name)) {
+    i = (i + 1) & (cap - 1);
+  }
+
+  return &slots[i];
+}
+
+static void registry_add(const char *name) {
+  if (2 * (Registry.count + 1) > Registry.cap) {
+    size_t cap   = (0 == Registry.cap) ? 16 : Registry.cap * 2;
+    char **slots = (char **)calloc(cap, sizeof(char *));
+    mem_chkoom(slots);
+
+    for (size_t i = 0; i < Registry.cap; i++) {
+      if (NULL != Registry.slots[i]) {
+        *find_slot(slots, cap, Registry.slots[i]) = Registry.slots[i];
+      }
+    }
+
+    mem_safe_free(Registry.slots);
+    Registry.slots = slots;
+    Registry.cap   = cap;
+  }
+
+  char **slot = find_slot(Registry.slots, Registry.cap, name);
+
+  if (NULL != *slot) {
+    return;
+  }
+
+  *slot = (char *)malloc(strlen(name) + 1);
+  mem_chkoom(*slot);
+  strcpy(*slot, name);
+  Registry.count++;
+}
+
+// Links are followed, as they were before plugins were listed up front
+static bool is_plugin(const char *plugins_path, fs_dirent_t ent) {
+  char         *plugin_path = NULL;
+  fs_filetype_t ftype       = ent.file_type;
+
+  if (TM_FS_FILETYPE_UNKNOWN == ftype) {
+    os_fs_path_dyconcat(&plugin_path, 2, plugins_path, ent.name);
+
+    if (TM_FS_FILEOP_STATUS_OK != os_fs_file_gettype(&ftype, plugin_path)) {
+      ftype = TM_FS_FILETYPE_UNKNOWN;
+    }
+
+    mem_safe_free(plugin_path);
+  }
+
+  return TM_FS_FILETYPE_EXEC == ftype;
+}
+
+static void registry_scan(void) {
+  const char       *plugins_path = NULL;
+  os_fs_dirstream_t stream;
+  fs_dirent_t       ent;
+
+  os_fs_tm_dyplugins(&plugins_path);
+
+  if (TM_FS_DIROP_STATUS_OK == os_fs_dir_open(&stream, plugins_path)) {
+    while (TM_FS_DIROP_STATUS_OK == os_fs_dir_next(stream, &ent)) {
+      if (is_plugin(plugins_path, ent)) {
+        registry_add(ent.name);
+      }
+    }
+
+    os_fs_dir_close(stream);
+  }
+
+  mem_safe_free(plugins_path);
+}
+
+// The plugin directory is only listed the first time a plugin is looked up,
+// by whichever thread gets there first. The others wait for it to finish
+static void registry_load(void) {
+  int expected = REGISTRY_EMPTY;
+
+  if (atomic_compare_exchange_strong(
+          &RegistryState, &expected, REGISTRY_LOADING)) {
+    registry_scan();
+    atomic_store(&RegistryState, REGISTRY_READY);
+    return;
+  }
+
+  while (REGISTRY_READY != atomic_load(&RegistryState)) {
+    os_thread_yield();
+  }
+}
+
+bool plugin_exists(const char *plugin) {
+  registry_load();
+  return 0 != Registry.count &&
+         NULL != *find_slot(Registry.slots, Registry.cap, plugin);
 }
 
 int plugin_run(const char *plugin, const char *dst, const char *src) {
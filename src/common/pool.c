@@ -0,0 +1,168 @@
+/*************************************************************************
+| tarman                                                                 |
+| Copyright (C) 2024 Alessandro Salerno                                  |
+|                                                                        |
+| This program is free software: you can redistribute it and/or modify   |
+| it under the terms of the GNU General Public License as published by   |
+| the Free Software Foundation, either version 3 of the License, or      |
+| (at your option) any later version.                                    |
+|                                                                        |
+| This program is distributed in the hope that it will be useful,        |
+| but WITHOUT ANY WARRANTY; without even the implied warranty of         |
+| MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the          |
+| GNU General Public License for more details.                           |
+|                                                                        |
+| You should have received a copy of the GNU General Public License      |
+| along with this program.  If not, see <https://www.gnu.org/licenses/>. |
+*************************************************************************/
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "os/exec.h"
+#include "os/thread.h"
+#include "pool.h"
+#include "tm-mem.h"
+
+typedef struct {
+  pool_job_t    job;
+  void         *ctx;
+  size_t        num_jobs;
+  atomic_size_t next;
+} pool_state_t;
+
+typedef struct {
+  os_proc_t proc;
+  FILE     *out;
+  bool      started;
+} pool_child_t;
+
+static void *pool_worker(void *arg) {
+  pool_state_t *state = (pool_state_t *)arg;
+
+  // Jobs are handed out one at a time so that workers
+  // that get cheap jobs keep picking up new ones
+  for (size_t i = atomic_fetch_add(&state->next, 1); i < state->num_jobs;
+       i        = atomic_fetch_add(&state->next, 1)) {
+    state->job(i, state->ctx);
+  }
+
+  return NULL;
+}
+
+size_t pool_size(void) {
+  size_t hw_count = os_thread_hwcount();
+
+  if (TM_POOL_MAX_WORKERS < hw_count) {
+    return TM_POOL_MAX_WORKERS;
+  }
+
+  return hw_count;
+}
+
+static void
+run_workers(size_t num_workers, size_t num_jobs, pool_job_t job, void *ctx) {
+  pool_state_t state = {.job = job, .ctx = ctx, .num_jobs = num_jobs};
+  atomic_init(&state.next, 0);
+
+  if (num_workers > num_jobs) {
+    num_workers = num_jobs;
+  }
+
+  if (1 >= num_workers) {
+    pool_worker(&state);
+    return;
+  }
+
+  os_thread_t threads[TM_POOL_MAX_WORKERS];
+  size_t      spawned = 0;
+
+  // The calling thread is a worker too, so only n - 1
+  // additional threads are needed
+  for (; spawned < num_workers - 1; spawned++) {
+    if (!os_thread_create(&threads[spawned], pool_worker, &state)) {
+      break;
+    }
+  }
+
+  pool_worker(&state);
+
+  for (size_t i = 0; i < spawned; i++) {
+    os_thread_join(threads[i], NULL);
+  }
+}
+
+void pool_run(size_t num_jobs, pool_job_t job, void *ctx) {
+  run_workers(pool_size(), num_jobs, job, ctx);
+}
+
+// Jobs that spend most of their time waiting (e.g., on remote servers) do not
+// compete for hardware threads, so as many workers as allowed are used
+void pool_run_io(size_t num_jobs, pool_job_t job, void *ctx) {
+  run_workers(TM_POOL_MAX_WORKERS, num_jobs, job, ctx);
+}
+
+static void start_child(pool_child_t      *child,
+                        const pool_proc_t *proc,
+                        os_exec_fn_t       function) {
+  if (NULL == (child->out = tmpfile())) {
+    return;
+  }
+
+  child->started =
+      os_exec_fork(&child->proc, child->out, function, proc->argc, proc->argv);
+
+  if (!child->started) {
+    fclose(child->out);
+    child->out = NULL;
+  }
+}
+
+static void replay_output(FILE *out) {
+  char   buf[4096];
+  size_t len = 0;
+
+  fflush(out);
+  rewind(out);
+
+  while (0 < (len = fread(buf, 1, sizeof buf, out))) {
+    fwrite(buf, 1, len, stdout);
+  }
+
+  fflush(stdout);
+}
+
+// Each process runs function with its output captured. Processes are
+// started in order and waited for in the same order, so that their output
+// is shown as if they had run one after the other
+void pool_run_procs(size_t             num_procs,
+                    const pool_proc_t *procs,
+                    os_exec_fn_t       function,
+                    pool_done_t        done,
+                    void              *ctx) {
+  pool_child_t *children =
+      (pool_child_t *)calloc(num_procs + 1, sizeof(pool_child_t));
+  size_t workers = pool_size();
+  size_t next    = 0;
+  mem_chkoom(children);
+
+  for (size_t i = 0; i < num_procs; i++) {
+    for (; next < num_procs && next - i < workers; next++) {
+      start_child(&children[next], &procs[next], function);
+    }
+
+    int status = TM_POOL_NOT_STARTED;
+
+    if (children[i].started) {
+      status = os_exec_wait(children[i].proc);
+      replay_output(children[i].out);
+      fclose(children[i].out);
+    }
+
+    done(i, status, ctx);
+  }
+
+  mem_safe_free(children);
+}
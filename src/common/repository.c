@@ -0,0 +1,192 @@
+/*************************************************************************
+| tarman                                                                 |
+| Copyright (C) 2024 Alessandro Salerno                                  |
+|                                                                        |
+| This program is free software: you can redistribute it and/or modify   |
+| it under the terms of the GNU General Public License as published by   |
+| the Free Software Foundation, either version 3 of the License, or      |
+| (at your option) any later version.                                    |
+|                                                                        |
+| This program is distributed in the hope that it will be useful,        |
+| but WITHOUT ANY WARRANTY; without even the implied warranty of         |
+| MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the          |
+| GNU General Public License for more details.                           |
+|                                                                        |
+| You should have received a copy of the GNU General Public License      |
+| along with this program.  If not, see <https://www.gnu.org/licenses/>. |
+*************************************************************************/
+
+#include <ctype.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "config.h"
+#include "hash.h"
+#include "repository.h"
+#include "stream.h"
+#include "tm-mem.h"
+
+#define INDEX_URL_SUFFIX ".index"
+
+static cfg_parse_status_t
+src_translator(const char *key, const char *value, repo_source_t *src) {
+  cfg_prop_match_t match = cfg_eval_prop_matches(
+      4,
+      cfg_eval_prop("URL", key, value, &src->url, 0),
+      cfg_eval_prop("PACKAGE_FORMAT", key, value, &src->package_format, 0),
+      cfg_eval_prop("INDEX_URL", key, value, &src->index_url, 0),
+      cfg_eval_prop("MIRRORS", key, value, &src->mirrors, 0));
+
+  if (TM_CFG_PROP_MATCH_ERR == match) {
+    return TM_CFG_PARSE_STATUS_INVVAL;
+  }
+
+  return TM_CFG_PARSE_STATUS_OK;
+}
+
+cfg_parse_status_t repo_parse_source(repo_source_t *src, const char *path) {
+  FILE *fp = fopen(path, "r");
+
+  if (NULL == fp) {
+    return TM_CFG_PARSE_STATUS_NOFILE;
+  }
+
+  cfg_parse_status_t ret =
+      cfg_parse(fp, (cfg_translator_t)src_translator, src);
+
+  if (TM_CFG_PARSE_STATUS_OK != ret) {
+    repo_free_source(*src);
+  }
+
+  fclose(fp);
+  return ret;
+}
+
+bool repo_dump_source(const char *path, repo_source_t src) {
+  FILE *fp = fopen(path, "w");
+
+  if (NULL == fp) {
+    return false;
+  }
+
+  if (NULL != src.url) {
+    fprintf(fp, "URL=%s\n", src.url);
+  }
+
+  if (NULL != src.package_format) {
+    fprintf(fp, "PACKAGE_FORMAT=%s\n", src.package_format);
+  }
+
+  if (NULL != src.index_url) {
+    fprintf(fp, "INDEX_URL=%s\n", src.index_url);
+  }
+
+  if (NULL != src.mirrors) {
+    fprintf(fp, "MIRRORS=%s\n", src.mirrors);
+  }
+
+  fclose(fp);
+  return true;
+}
+
+void repo_free_source(repo_source_t src) {
+  mem_safe_free(src.url);
+  mem_safe_free(src.package_format);
+  mem_safe_free(src.index_url);
+  mem_safe_free(src.mirrors);
+}
+
+bool repo_index_dyparse(repo_index_t *index, FILE *stream) {
+  size_t              bufsz   = 16;
+  size_t              count   = 0;
+  char               *line    = NULL;
+  repo_index_entry_t *entries = (repo_index_entry_t *)malloc(
+      bufsz * sizeof(repo_index_entry_t));
+  mem_chkoom(entries);
+
+  while (0 != stream_dyreadline(stream, &line)) {
+    repo_index_entry_t entry = {0};
+    const char        *path  = &line[TM_HASH_SHA256_HEXLEN];
+
+    // Lines are "<hash><whitespace>[*]<path>", the * being
+    // how sha256sum marks files hashed in binary mode
+    if (strlen(line) <= TM_HASH_SHA256_HEXLEN ||
+        !isspace((unsigned char)*path) ||
+        !hash_fromhex(entry.hash, line, TM_HASH_SHA256_LEN)) {
+      mem_safe_free(line);
+      repo_index_free((repo_index_t){.entries = entries, .count = count});
+      return false;
+    }
+
+    for (; isspace((unsigned char)*path) || '*' == *path; path++)
+      ;
+
+    entry.path = (char *)malloc(strlen(path) + 1);
+    mem_chkoom(entry.path);
+    strcpy(entry.path, path);
+    mem_safe_free(line);
+
+    if (bufsz == count) {
+      bufsz *= 2;
+      entries = (repo_index_entry_t *)realloc(
+          entries, bufsz * sizeof(repo_index_entry_t));
+      mem_chkoom(entries);
+    }
+
+    entries[count] = entry;
+    count++;
+  }
+
+  index->entries = entries;
+  index->count   = count;
+  return true;
+}
+
+void repo_index_free(repo_index_t index) {
+  for (size_t i = 0; i < index.count; i++) {
+    mem_safe_free(index.entries[i].path);
+  }
+
+  mem_safe_free(index.entries);
+}
+
+size_t repo_dyindex_url(char **dst, repo_source_t src) {
+  const char *base   = src.index_url;
+  const char *suffix = "";
+
+  // By default, the index is expected next to the archive
+  // e.g., https://host/linux-x86_64.tar.gz.index
+  if (NULL == base) {
+    base   = src.url;
+    suffix = INDEX_URL_SUFFIX;
+  }
+
+  size_t bufsz = strlen(base) + strlen(suffix) + 1;
+  char  *buf   = (char *)malloc(bufsz * sizeof(char));
+  mem_chkoom(buf);
+  snprintf(buf, bufsz, "%s%s", base, suffix);
+
+  *dst = buf;
+  return bufsz - 1;
+}
+
+size_t repo_dyentry_url(char **dst, const char *index_url, const char *path) {
+  const char *last_sep = strrchr(index_url, '/');
+  size_t      base_len = strlen(index_url);
+
+  // Paths in the index are relative to the directory containing it
+  if (NULL != last_sep) {
+    base_len = last_sep - index_url + 1;
+  }
+
+  size_t bufsz = base_len + strlen(path) + 1;
+  char  *buf   = (char *)malloc(bufsz * sizeof(char));
+  mem_chkoom(buf);
+  memcpy(buf, index_url, base_len);
+  strcpy(&buf[base_len], path);
+
+  *dst = buf;
+  return bufsz - 1;
+}
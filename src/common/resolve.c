@@ -0,0 +1,397 @@
+/*************************************************************************
+| tarman                                                                 |
+| Copyright (C) 2024 Alessandro Salerno                                  |
+|                                                                        |
+| This program is free software: you can redistribute it and/or modify   |
+| it under the terms of the GNU General Public License as published by   |
+| the Free Software Foundation, either version 3 of the License, or      |
+| (at your option) any later version.                                    |
+|                                                                        |
+| This program is distributed in the hope that it will be useful,        |
+| but WITHOUT ANY WARRANTY; without even the implied warranty of         |
+| MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the          |
+| GNU General Public License for more details.                           |
+|                                                                        |
+| You should have received a copy of the GNU General Public License      |
+| along with this program.  If not, see <https://www.gnu.org/licenses/>. |
+*************************************************************************/
+
+
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "cli/directives/commands.h"
+#include "cli/directives/options.h"
+#include "cli/output.h"
+#include "cli/parser.h"
+#include "download.h"
+#include "os/fs.h"
+#include "package.h"
+#include "pool.h"
+#include "resolve.h"
+#include "tm-mem.h"
+#include "util/repo.h"
+
+// Arguments of 'tarman install -r <name> --headless --yes --offline'
+#define RESOLVE_INSTALL_ARGC 7
+
+typedef struct {
+  resolve_graph_t *graph;
+  size_t           nodes_cap;
+  const char     **path; // Packages being resolved, to detect cycles
+  size_t           path_len;
+  size_t           path_cap;
+} resolve_ctx_t;
+
+typedef struct {
+  const resolve_graph_t *graph;
+  const size_t          *ids;
+  bool                   ok;
+} resolve_level_t;
+
+// Indexed by pkg_dep_op_t
+static const char *DepOps[] = {"", "=", "<", "<=", ">", ">="};
+
+static char *dystrcpy(const char *src) {
+  if (NULL == src) {
+    return NULL;
+  }
+
+  char *dst = (char *)malloc(strlen(src) + 1);
+  mem_chkoom(dst);
+  strcpy(dst, src);
+  return dst;
+}
+
+static bool load_installed(recipe_t *recipe, const char *pkg_name) {
+  char *pkg_path = NULL;
+  char *rcp_path = NULL;
+  os_fs_tm_dypkg(&pkg_path, pkg_name);
+  os_fs_path_dyconcat(&rcp_path, 2, pkg_path, "recipe.tarman");
+
+  bool ret = TM_CFG_PARSE_STATUS_OK == pkg_parse_tmrcp(recipe, rcp_path);
+  mem_safe_free(pkg_path);
+  mem_safe_free(rcp_path);
+  return ret;
+}
+
+static bool load_available(recipe_t *recipe, char **repo, const char *name) {
+  char *rcp_path = NULL;
+
+  if (!util_repo_find_recipe(repo, name)) {
+    return false;
+  }
+
+  os_fs_tm_dyrecipe(&rcp_path, *repo, name);
+  bool ret = TM_CFG_PARSE_STATUS_OK == pkg_parse_tmrcp(recipe, rcp_path);
+  mem_safe_free(rcp_path);
+
+  if (!ret) {
+    mem_safe_free(*repo);
+    *repo = NULL;
+  }
+
+  return ret;
+}
+
+static bool
+find_node(size_t *index, const resolve_graph_t *graph, const char *name) {
+  for (size_t i = 0; i < graph->count; i++) {
+    if (0 == strcmp(graph->nodes[i].name, name)) {
+      *index = i;
+      return true;
+    }
+  }
+
+  return false;
+}
+
+static size_t add_node(resolve_ctx_t *ctx, resolve_node_t node) {
+  resolve_graph_t *graph = ctx->graph;
+
+  if (graph->count == ctx->nodes_cap) {
+    ctx->nodes_cap = (0 == ctx->nodes_cap) ? 8 : ctx->nodes_cap * 2;
+    graph->nodes   = (resolve_node_t *)realloc(
+        graph->nodes, ctx->nodes_cap * sizeof(resolve_node_t));
+    mem_chkoom(graph->nodes);
+  }
+
+  graph->nodes[graph->count] = node;
+  return graph->count++;
+}
+
+static void push_path(resolve_ctx_t *ctx, const char *name) {
+  if (ctx->path_len == ctx->path_cap) {
+    ctx->path_cap = (0 == ctx->path_cap) ? 8 : ctx->path_cap * 2;
+    ctx->path =
+        (const char **)realloc(ctx->path, ctx->path_cap * sizeof(char *));
+    mem_chkoom(ctx->path);
+  }
+
+  ctx->path[ctx->path_len++] = name;
+}
+
+static bool in_path(const resolve_ctx_t *ctx, const char *name) {
+  for (size_t i = 0; i < ctx->path_len; i++) {
+    if (0 == strcmp(ctx->path[i], name)) {
+      return true;
+    }
+  }
+
+  return false;
+}
+
+static bool visit(size_t          *index,
+                  resolve_ctx_t   *ctx,
+                  const pkg_dep_t *dep,
+                  const char      *parent);
+
+static bool visit_all(size_t       **indices,
+                      size_t        *count,
+                      resolve_ctx_t *ctx,
+                      const char    *depends,
+                      const char    *parent) {
+  pkg_dep_t *deps     = NULL;
+  size_t     num_deps = 0;
+  bool       ret      = true;
+
+  if (NULL == depends) {
+    *indices = NULL;
+    *count   = 0;
+    return true;
+  }
+
+  if (!pkg_parse_depends(&deps, &num_deps, depends)) {
+    cli_out_error("Malformed dependency list of package '%s'", parent);
+    return false;
+  }
+
+  *indices = (size_t *)malloc((num_deps + 1) * sizeof(size_t));
+  *count   = 0;
+  mem_chkoom(*indices);
+  push_path(ctx, parent);
+
+  for (size_t i = 0; i < num_deps && ret; i++) {
+    ret = visit(&(*indices)[*count], ctx, &deps[i], parent);
+    *count += ret;
+  }
+
+  ctx->path_len--;
+  pkg_free_depends(deps, num_deps);
+  return ret;
+}
+
+// Depth-first, so that dependencies are added before the packages that
+// need them. Installed packages that satisfy the requirement end the
+// search: their own dependencies were handled when they were installed
+static bool visit(size_t          *index,
+                  resolve_ctx_t   *ctx,
+                  const pkg_dep_t *dep,
+                  const char      *parent) {
+  recipe_t recipe = {0};
+  char    *repo   = NULL;
+  bool     ret    = false;
+
+  if (in_path(ctx, dep->name)) {
+    cli_out_error(
+        "Circular dependency between '%s' and '%s'", parent, dep->name);
+    return false;
+  }
+
+  if (find_node(index, ctx->graph, dep->name)) {
+    const resolve_node_t *node = &ctx->graph->nodes[*index];
+
+    if (!pkg_dep_satisfied(dep, node->version)) {
+      cli_out_error("Package '%s' requires a version of '%s' that conflicts "
+                    "with other requirements",
+                    parent,
+                    dep->name);
+      return false;
+    }
+
+    return true;
+  }
+
+  if (load_installed(&recipe, dep->name) &&
+      pkg_dep_satisfied(dep, recipe.version)) {
+    cli_out_progress("Dependency '%s' is already installed", dep->name);
+    *index = add_node(ctx,
+                      (resolve_node_t){.name      = dystrcpy(dep->name),
+                                       .version   = dystrcpy(recipe.version),
+                                       .satisfied = true});
+    ret    = true;
+    goto cleanup;
+  }
+
+  pkg_free_rcp(recipe);
+  recipe = (recipe_t){0};
+
+  if (!load_available(&recipe, &repo, dep->name)) {
+    cli_out_error("Dependency '%s' of package '%s' not found in local "
+                  "repositories",
+                  dep->name,
+                  parent);
+    goto cleanup;
+  }
+
+  if (!pkg_dep_satisfied(dep, recipe.version)) {
+    cli_out_error("Package '%s' requires '%s' %s %s, repository '%s' does "
+                  "not offer a suitable version",
+                  parent,
+                  dep->name,
+                  DepOps[dep->op],
+                  dep->version,
+                  repo);
+    goto cleanup;
+  }
+
+  resolve_node_t node = {.name    = dystrcpy(dep->name),
+                         .repo    = repo,
+                         .version = dystrcpy(recipe.version)};
+  repo                = NULL;
+
+  if (!visit_all(&node.deps, &node.num_deps, ctx, recipe.depends, dep->name)) {
+    mem_safe_free(node.name);
+    mem_safe_free(node.repo);
+    mem_safe_free(node.version);
+    mem_safe_free(node.deps);
+    goto cleanup;
+  }
+
+  *index = add_node(ctx, node);
+  ret    = true;
+
+cleanup:
+  pkg_free_rcp(recipe);
+  mem_safe_free(repo);
+  return ret;
+}
+
+bool resolve_dependencies(resolve_graph_t *graph,
+                          const char      *pkg_name,
+                          const char      *depends) {
+  resolve_ctx_t ctx     = {.graph = graph};
+  size_t       *indices = NULL;
+  size_t        count   = 0;
+
+  *graph   = (resolve_graph_t){0};
+  bool ret = visit_all(&indices, &count, &ctx, depends, pkg_name);
+
+  mem_safe_free(indices);
+  mem_safe_free(ctx.path);
+
+  if (!ret) {
+    resolve_free(graph);
+  }
+
+  return ret;
+}
+
+// Each dependency is installed by a separate process running
+// 'tarman install -r <name> --headless --yes'. Dependencies installed in an
+// unsuitable version are thus replaced by a new version. Offline installs
+// stay offline for their dependencies too
+static void fill_install_argv(pool_proc_t *proc, const resolve_node_t *node) {
+  bool offline  = download_offline();
+  proc->argc    = RESOLVE_INSTALL_ARGC - (offline ? 0 : 1);
+  proc->argv[0] = "tarman";
+  proc->argv[1] = TARMAN_CMD_INSTALL;
+  proc->argv[2] = TARMAN_SOPT_FROM_REPO;
+  proc->argv[3] = node->name;
+  proc->argv[4] = TARMAN_FOPT_HEADLESS;
+  proc->argv[5] = TARMAN_FOPT_YES;
+  proc->argv[6] = offline ? TARMAN_FOPT_OFFLINE : NULL;
+  proc->argv[7] = NULL;
+}
+
+static void finish_install(size_t index, int status, void *ctx) {
+  resolve_level_t *level = (resolve_level_t *)ctx;
+  const char      *name  = level->graph->nodes[level->ids[index]].name;
+
+  if (TM_POOL_NOT_STARTED == status) {
+    cli_out_error("Unable to start installation of dependency '%s'", name);
+    level->ok = false;
+  } else if (EXIT_SUCCESS != status) {
+    cli_out_error("Unable to install dependency '%s'", name);
+    level->ok = false;
+  }
+}
+
+static bool run_level(const resolve_graph_t *graph,
+                      const size_t          *level,
+                      size_t                 depth) {
+  size_t      *ids   = (size_t *)malloc((graph->count + 1) * sizeof(size_t));
+  pool_proc_t *procs =
+      (pool_proc_t *)malloc((graph->count + 1) * sizeof(pool_proc_t));
+  char **argv = (char **)malloc((graph->count + 1) *
+                                (RESOLVE_INSTALL_ARGC + 1) * sizeof(char *));
+  size_t          count = 0;
+  resolve_level_t ctx   = {.graph = graph, .ids = ids, .ok = true};
+  mem_chkoom(ids);
+  mem_chkoom(procs);
+  mem_chkoom(argv);
+
+  for (size_t i = 0; i < graph->count; i++) {
+    if (depth == level[i]) {
+      procs[count].argv = &argv[count * (RESOLVE_INSTALL_ARGC + 1)];
+      fill_install_argv(&procs[count], &graph->nodes[i]);
+      ids[count++] = i;
+    }
+  }
+
+  pool_run_procs(count, procs, cli_run, finish_install, &ctx);
+
+  mem_safe_free(ids);
+  mem_safe_free(procs);
+  mem_safe_free(argv);
+  return ctx.ok;
+}
+
+// Nodes are grouped by how far they are from the leaves of the graph:
+// those at the same distance cannot depend on each other, so they are
+// installed in parallel
+bool resolve_install(const resolve_graph_t *graph) {
+  size_t *level     = (size_t *)calloc(graph->count + 1, sizeof(size_t));
+  size_t  max_level = 0;
+  bool    ret       = true;
+  mem_chkoom(level);
+
+  for (size_t i = 0; i < graph->count; i++) {
+    const resolve_node_t *node = &graph->nodes[i];
+
+    if (node->satisfied) {
+      continue;
+    }
+
+    level[i] = 1;
+
+    for (size_t j = 0; j < node->num_deps; j++) {
+      if (level[node->deps[j]] + 1 > level[i]) {
+        level[i] = level[node->deps[j]] + 1;
+      }
+    }
+
+    max_level = (level[i] > max_level) ? level[i] : max_level;
+  }
+
+  for (size_t depth = 1; depth <= max_level && ret; depth++) {
+    ret = run_level(graph, level, depth);
+  }
+
+  mem_safe_free(level);
+  return ret;
+}
+
+void resolve_free(resolve_graph_t *graph) {
+  for (size_t i = 0; i < graph->count; i++) {
+    mem_safe_free(graph->nodes[i].name);
+    mem_safe_free(graph->nodes[i].repo);
+    mem_safe_free(graph->nodes[i].version);
+    mem_safe_free(graph->nodes[i].deps);
+  }
+
+  mem_safe_free(graph->nodes);
+  *graph = (resolve_graph_t){0};
+}
@@ -0,0 +1,156 @@
+/*************************************************************************
+| tarman                                                                 |
+| Copyright (C) 2024 Alessandro Salerno                                  |
+|                                                                        |
+| This program is free software: you can redistribute it and/or modify   |
+| it under the terms of the GNU General Public License as published by   |
+| the Free Software Foundation, either version 3 of the License, or      |
+| (at your option) any later version.                                    |
+|                                                                        |
+| This program is distributed in the hope that it will be useful,        |
+| but WITHOUT ANY WARRANTY; without even the implied warranty of         |
+| MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the          |
+| GNU General Public License for more details.                           |
+|                                                                        |
+| You should have received a copy of the GNU General Public License      |
+| along with this program.  If not, see <https://www.gnu.org/licenses/>. |
+*************************************************************************/
+
+
+#include "settings.h"
+#include <ctype.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "config.h"
+#include "os/env.h"
+#include "os/fs.h"
+#include "tm-mem.h"
+
+#define NUM_BUF_LEN 32
+
+// Defaults are used until the configuration file is loaded
+static settings_t Settings = {0};
+
+static cfg_parse_status_t
+settings_translator(const char *key, const char *value, settings_t *settings) {
+  const char *download_rate = NULL;
+  const char *extract_rate  = NULL;
+  const char *idle_priority = NULL;
+  const char *cache_peers   = NULL;
+
+  cfg_prop_match_t match = cfg_eval_prop_matches(
+      4,
+      cfg_eval_prop("DOWNLOAD_RATE_LIMIT", key, value, &download_rate, 0),
+      cfg_eval_prop("EXTRACT_RATE_LIMIT", key, value, &extract_rate, 0),
+      cfg_eval_prop(
+          "IDLE_PRIORITY", key, value, &idle_priority, 2, "true", "false"),
+      cfg_eval_prop("CACHE_PEERS", key, value, &cache_peers, 0));
+
+  cfg_parse_status_t ret = TM_CFG_PARSE_STATUS_OK;
+
+  if (TM_CFG_PROP_MATCH_ERR == match ||
+      (NULL != download_rate &&
+       !settings_parse_rate(&settings->download_rate, download_rate)) ||
+      (NULL != extract_rate &&
+       !settings_parse_rate(&settings->extract_rate, extract_rate))) {
+    ret = TM_CFG_PARSE_STATUS_INVVAL;
+  }
+
+  if (NULL != idle_priority) {
+    settings->idle_priority = 0 == strcmp(idle_priority, "true");
+  }
+
+  if (NULL != cache_peers) {
+    mem_safe_free(settings->cache_peers);
+    settings->cache_peers = cache_peers;
+  }
+
+  mem_safe_free(download_rate);
+  mem_safe_free(extract_rate);
+  mem_safe_free(idle_priority);
+  return ret;
+}
+
+static void export_size(const char *name, size_t value) {
+  char buf[NUM_BUF_LEN];
+  snprintf(buf, sizeof buf, "%zu", value);
+  os_env_set(name, buf);
+}
+
+// Also makes the settings available to plugins through the environment,
+// since they are separate programs
+cfg_parse_status_t settings_load(void) {
+  char              *path     = NULL;
+  FILE              *fp       = NULL;
+  settings_t         settings = {0};
+  cfg_parse_status_t ret      = TM_CFG_PARSE_STATUS_NOFILE;
+
+  if (0 != os_fs_tm_dyconfig(&path)) {
+    fp = fopen(path, "r");
+  }
+
+  if (NULL != fp) {
+    ret = cfg_parse(fp, (cfg_translator_t)settings_translator, &settings);
+    fclose(fp);
+  }
+
+  // The configuration is loaded again by each command that runs in the
+  // same process (e.g., in batch scripts)
+  if (TM_CFG_PARSE_STATUS_OK == ret) {
+    mem_safe_free(Settings.cache_peers);
+    Settings = settings;
+  } else {
+    mem_safe_free(settings.cache_peers);
+  }
+
+  export_size(TM_SETTINGS_ENV_DOWNLOAD_RATE, Settings.download_rate);
+  export_size(TM_SETTINGS_ENV_EXTRACT_RATE, Settings.extract_rate);
+  os_env_set(TM_SETTINGS_ENV_IDLE_PRIORITY,
+             Settings.idle_priority ? "true" : "false");
+
+  mem_safe_free(path);
+  return ret;
+}
+
+const settings_t *settings_get(void) {
+  return &Settings;
+}
+
+// Rates are in bytes per second, optionally followed by K, M or G
+// (powers of 1024, as in curl's --limit-rate). 0 means no limit
+bool settings_parse_rate(size_t *dst, const char *str) {
+  char              *end   = NULL;
+  unsigned long long value = 0;
+
+  if (!isdigit((unsigned char)str[0])) {
+    return false;
+  }
+
+  value = strtoull(str, &end, 10);
+
+  switch (toupper((unsigned char)*end)) {
+  case 'G':
+    value *= 1024;
+    // fall through
+  case 'M':
+    value *= 1024;
+    // fall through
+  case 'K':
+    value *= 1024;
+    end++;
+    break;
+  default:
+    break;
+  }
+
+  if (0 != *end || SIZE_MAX < value) {
+    return false;
+  }
+
+  *dst = (size_t)value;
+  return true;
+}
@@ -0,0 +1,228 @@
+/*************************************************************************
+| tarman                                                                 |
+| Copyright (C) 2024 Alessandro Salerno                                  |
+|                                                                        |
+| This program is free software: you can redistribute it and/or modify   |
+| it under the terms of the GNU General Public License as published by   |
+| the Free Software Foundation, either version 3 of the License, or      |
+| (at your option) any later version.                                    |
+|                                                                        |
+| This program is distributed in the hope that it will be useful,        |
+| but WITHOUT ANY WARRANTY; without even the implied warranty of         |
+| MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the          |
+| GNU General Public License for more details.                           |
+|                                                                        |
+| You should have received a copy of the GNU General Public License      |
+| along with this program.  If not, see <https://www.gnu.org/licenses/>. |
+*************************************************************************/
+
+
+#include "store.h"
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "cli/output.h"
+#include "hash.h"
+#include "os/fs.h"
+#include "package.h"
+#include "tm-mem.h"
+
+static bool same_str(const char *a, const char *b) {
+  if (NULL == a || NULL == b) {
+    return a == b;
+  }
+
+  return 0 == strcmp(a, b);
+}
+
+static bool same_hash(const char *a, const char *b) {
+  unsigned char hash_a[TM_HASH_SHA256_LEN];
+  unsigned char hash_b[TM_HASH_SHA256_LEN];
+
+  return NULL != a && NULL != b && TM_HASH_SHA256_HEXLEN == strlen(a) &&
+         TM_HASH_SHA256_HEXLEN == strlen(b) &&
+         hash_fromhex(hash_a, a, TM_HASH_SHA256_LEN) &&
+         hash_fromhex(hash_b, b, TM_HASH_SHA256_LEN) &&
+         0 == memcmp(hash_a, hash_b, TM_HASH_SHA256_LEN);
+}
+
+// The store may only be used for the archive the user would have installed.
+// Without a hash, the recipe must at least name the version of the package
+static bool same_archive(recipe_t stored, recipe_t recipe) {
+  if (NULL == recipe.pkg_info.url ||
+      !same_str(stored.pkg_info.url, recipe.pkg_info.url) ||
+      !same_str(stored.package_format, recipe.package_format)) {
+    return false;
+  }
+
+  if (NULL != recipe.archive_sha256) {
+    return same_hash(stored.archive_sha256, recipe.archive_sha256);
+  }
+
+  return NULL != recipe.version && same_str(stored.version, recipe.version);
+}
+
+static bool parse_artifact(recipe_t *recipe, const char *ver_path) {
+  char *artifact_path = NULL;
+  os_fs_path_dyconcat(&artifact_path, 2, ver_path, "recipe.tarman");
+
+  bool ret = TM_CFG_PARSE_STATUS_OK == pkg_parse_tmrcp(recipe, artifact_path);
+  mem_safe_free(artifact_path);
+  return ret;
+}
+
+size_t store_dypath(char **dst) {
+  const char *store = getenv(TM_STORE_ENV);
+
+  if (NULL == store) {
+    store = TM_STORE_DEFAULT;
+  }
+
+  if (0 == store[0]) {
+    *dst = NULL;
+    return 0;
+  }
+
+  size_t len = strlen(store);
+  char  *buf = (char *)malloc((len + 1) * sizeof(char));
+  mem_chkoom(buf);
+  strcpy(buf, store);
+  *dst = buf;
+  return len;
+}
+
+size_t store_dypkgdir(char **dst, const char *pkg_name) {
+  char *store = NULL;
+
+  if (0 == store_dypath(&store)) {
+    *dst = NULL;
+    return 0;
+  }
+
+  size_t ret = os_fs_path_dyconcat(dst, 3, store, "pkgs", pkg_name);
+  mem_chkoom(*dst);
+  mem_safe_free(store);
+  return ret;
+}
+
+// Users link to a specific version rather than to the 'current' link, so
+// that publishing a new version does not change their packages
+bool store_dyactive(char **dst, const char *pkg_name) {
+  char *pkg_dir   = NULL;
+  char *link_path = NULL;
+  char *target    = NULL;
+  bool  ret       = false;
+
+  if (0 == store_dypkgdir(&pkg_dir, pkg_name)) {
+    return false;
+  }
+
+  os_fs_path_dyconcat(&link_path, 2, pkg_dir, TM_FS_PKG_CURRENT);
+
+  if (TM_FS_FILEOP_STATUS_OK != os_fs_file_dyreadlink(&target, link_path) ||
+      NULL != strchr(target, '/')) {
+    goto cleanup;
+  }
+
+  os_fs_path_dyconcat(dst, 2, pkg_dir, target);
+  mem_chkoom(*dst);
+  ret = true;
+
+cleanup:
+  mem_safe_free(pkg_dir);
+  mem_safe_free(link_path);
+  mem_safe_free(target);
+  return ret;
+}
+
+bool store_find(char **dst, const char *pkg_name, recipe_t recipe) {
+  char    *ver_path = NULL;
+  recipe_t stored   = {0};
+  bool     ret      = false;
+
+  if (!store_dyactive(&ver_path, pkg_name)) {
+    return false;
+  }
+
+  if (parse_artifact(&stored, ver_path) && same_archive(stored, recipe)) {
+    *dst     = ver_path;
+    ver_path = NULL;
+    ret      = true;
+  }
+
+  mem_safe_free(ver_path);
+  pkg_free_rcp(stored);
+  return ret;
+}
+
+// Only the top-level entries are linked, everything below them is reached
+// through the links. The recipe artifact is the user's own, since it holds
+// the user's choices (e.g., whether to add the package to PATH)
+bool store_link(const char *ver_path, const char *store_ver, bool log) {
+  os_fs_dirstream_t stream;
+  fs_dirent_t       ent;
+  fs_dirop_status_t status;
+  bool              ret = true;
+
+  if (log) {
+    cli_out_progress("Linking '%s' to '%s'", ver_path, store_ver);
+  }
+
+  if (TM_FS_DIROP_STATUS_OK != os_fs_dir_open(&stream, store_ver)) {
+    if (log) {
+      cli_out_error("Unable to open store directory '%s'", store_ver);
+    }
+    return false;
+  }
+
+  while (ret &&
+         TM_FS_DIROP_STATUS_OK == (status = os_fs_dir_next(stream, &ent))) {
+    char *link_path = NULL;
+    char *target    = NULL;
+
+    if (0 == strcmp(ent.name, "recipe.tarman")) {
+      continue;
+    }
+
+    os_fs_path_dyconcat(&link_path, 2, ver_path, ent.name);
+    os_fs_path_dyconcat(&target, 2, store_ver, ent.name);
+    ret = TM_FS_FILEOP_STATUS_OK == os_fs_file_symlink(link_path, target);
+
+    if (!ret && log) {
+      cli_out_error("Unable to create link '%s'", link_path);
+    }
+
+    mem_safe_free(link_path);
+    mem_safe_free(target);
+  }
+
+  os_fs_dir_close(stream);
+  return ret && TM_FS_DIROP_STATUS_END == status;
+}
+
+static void adopt_str(const char **dst, const char **src) {
+  if (NULL == *dst) {
+    *dst = *src;
+    *src = NULL;
+  }
+}
+
+// Details the administrator already gave (or tarman already inferred) when
+// the package was published, so that users are not asked again
+void store_adopt(recipe_t *recipe, const char *store_ver) {
+  recipe_t stored = {0};
+
+  if (!parse_artifact(&stored, store_ver)) {
+    pkg_free_rcp(stored);
+    return;
+  }
+
+  pkg_info_t *pkg = &recipe->pkg_info;
+  adopt_str(&pkg->executable_path, &stored.pkg_info.executable_path);
+  adopt_str(&pkg->application_name, &stored.pkg_info.application_name);
+  adopt_str(&pkg->working_directory, &stored.pkg_info.working_directory);
+  adopt_str(&pkg->icon_path, &stored.pkg_info.icon_path);
+  pkg_free_rcp(stored);
+}
@@ -0,0 +1,1195 @@
+/*************************************************************************
+| tarman                                                                 |
+| Copyright (C) 2024 Alessandro Salerno                                  |
+|                                                                        |
+| This program is free software: you can redistribute it and/or modify   |
+| it under the terms of the GNU General Public License as published by   |
+| the Free Software Foundation, either version 3 of the License, or      |
+| (at your option) any later version.                                    |
+|                                                                        |
+| This program is distributed in the hope that it will be useful,        |
+| but WITHOUT ANY WARRANTY; without even the implied warranty of         |
+| MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the          |
+| GNU General Public License for more details.                           |
+|                                                                        |
+| You should have received a copy of the GNU General Public License      |
+| along with this program.  If not, see <https://www.gnu.org/licenses/>. |
+*************************************************************************/
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "os/fs.h"
+#include "tar.h"
+#include "throttle.h"
+#include "tm-mem.h"
+
+#define TAR_BUF_LEN      (64 * 1024)
+#define TAR_MAX_META_LEN (1024 * 1024)
+
+// Files at least this large are preallocated and copied with os_fs_file_copy.
+// For smaller ones, the extra system calls cost more than they save
+#define TAR_BIG_FILE_LEN (64 * 1024)
+
+// Appended to the name of files that are being replaced during updates
+#define TAR_TMP_SUFFIX ".tarman-part"
+
+// Offsets and lengths of ustar header fields
+#define HDR_NAME         0
+#define HDR_NAME_LEN     100
+#define HDR_MODE         100
+#define HDR_MODE_LEN     8
+#define HDR_UID          108
+#define HDR_GID          116
+#define HDR_ID_LEN       8
+#define HDR_SIZE         124
+#define HDR_SIZE_LEN     12
+#define HDR_MTIME        136
+#define HDR_CHKSUM       148
+#define HDR_CHKSUM_LEN   8
+#define HDR_TYPE         156
+#define HDR_LINK         157
+#define HDR_LINK_LEN     100
+#define HDR_MAGIC        257
+#define HDR_VERSION      263
+#define HDR_PREFIX       345
+#define HDR_PREFIX_LEN   155
+
+typedef struct {
+  char *path;
+  char *target;
+  bool  symbolic;
+} deferred_link_t;
+
+typedef struct {
+  const char              *dst;
+  tar_opts_t              *opts;
+  char                    *last_dir; // Last directory known to exist
+  unsigned char           *buf;
+  unsigned char           *cmp_buf;
+  deferred_link_t         *links;
+  size_t                   num_links;
+  size_t                   links_cap;
+  const manifest_entry_t **installed; // Sorted by path
+  size_t                   num_installed;
+  throttle_t               throttle; // Applies to data written to files
+} extract_ctx_t;
+
+static size_t padding_of(size_t size) {
+  return (TM_TAR_BLOCK_LEN - size % TM_TAR_BLOCK_LEN) % TM_TAR_BLOCK_LEN;
+}
+
+static bool read_exact(FILE *stream, void *buf, size_t len) {
+  return len == fread(buf, 1, len, stream);
+}
+
+// Streams may be pipes, so data is read and discarded instead of seeking
+static bool skip(FILE *stream, size_t len) {
+  unsigned char buf[TM_TAR_BLOCK_LEN * 8];
+
+  while (0 != len) {
+    size_t chunk = (len < sizeof buf) ? len : sizeof buf;
+
+    if (!read_exact(stream, buf, chunk)) {
+      return false;
+    }
+
+    len -= chunk;
+  }
+
+  return true;
+}
+
+static char *dyfield(const unsigned char *field, size_t len) {
+  size_t str_len = 0;
+  for (; str_len < len && 0 != field[str_len]; str_len++)
+    ;
+
+  char *str = (char *)malloc(str_len + 1);
+  mem_chkoom(str);
+  memcpy(str, field, str_len);
+  str[str_len] = 0;
+  return str;
+}
+
+// Numeric fields are octal, or big-endian base-256 (GNU) when the highest
+// bit is set, which is used for sizes that do not fit in 11 octal digits
+static bool parse_number(size_t *dst, const unsigned char *field, size_t len) {
+  size_t val = 0;
+  size_t i   = 0;
+
+  if (0x80 & field[0]) {
+    // Negative values make no sense for any of the fields used here
+    if (0x40 & field[0]) {
+      return false;
+    }
+
+    for (val = field[0] & 0x3f, i = 1; i < len; i++) {
+      if (val > (SIZE_MAX >> 8)) {
+        return false;
+      }
+
+      val = (val << 8) | field[i];
+    }
+
+    *dst = val;
+    return true;
+  }
+
+  for (; i < len && ' ' == field[i]; i++)
+    ;
+
+  for (; i < len && '0' <= field[i] && '7' >= field[i]; i++) {
+    if (val > (SIZE_MAX >> 3)) {
+      return false;
+    }
+
+    val = (val << 3) | (size_t)(field[i] - '0');
+  }
+
+  *dst = val;
+  return true;
+}
+
+static bool is_zero_block(const unsigned char *block) {
+  for (size_t i = 0; i < TM_TAR_BLOCK_LEN; i++) {
+    if (0 != block[i]) {
+      return false;
+    }
+  }
+
+  return true;
+}
+
+// Some old implementations computed the checksum with signed chars,
+// so both variants are accepted
+static bool checksum_ok(const unsigned char *hdr) {
+  size_t        expected;
+  unsigned long usum = 0;
+  long          ssum = 0;
+
+  if (!parse_number(&expected, &hdr[HDR_CHKSUM], HDR_CHKSUM_LEN)) {
+    return false;
+  }
+
+  for (size_t i = 0; i < TM_TAR_BLOCK_LEN; i++) {
+    unsigned char ch = hdr[i];
+
+    if (HDR_CHKSUM <= i && HDR_CHKSUM + HDR_CHKSUM_LEN > i) {
+      ch = ' ';
+    }
+
+    usum += ch;
+    ssum += (signed char)ch;
+  }
+
+  return expected == usum || (long)expected == ssum;
+}
+
+// Reads the data of metadata entries (GNU long names and pax headers)
+static char *dymeta(FILE *stream, size_t size) {
+  if (TAR_MAX_META_LEN < size) {
+    return NULL;
+  }
+
+  char *buf = (char *)malloc(size + 1);
+  mem_chkoom(buf);
+
+  if (!read_exact(stream, buf, size) || !skip(stream, padding_of(size))) {
+    mem_safe_free(buf);
+    return NULL;
+  }
+
+  buf[size] = 0;
+  return buf;
+}
+
+static void replace_str(char **dst, const char *src, size_t len) {
+  mem_safe_free(*dst);
+  *dst = (char *)malloc(len + 1);
+  mem_chkoom(*dst);
+  memcpy(*dst, src, len);
+  (*dst)[len] = 0;
+}
+
+// Pax records look like "<record length> <key>=<value>\n"
+static bool parse_pax(tar_reader_t *reader,
+                      const char   *data,
+                      size_t        len,
+                      size_t       *size,
+                      bool         *has_size) {
+  size_t pos = 0;
+
+  while (pos < len) {
+    size_t rec_len = 0;
+    size_t i       = pos;
+
+    for (; i < len && '0' <= data[i] && '9' >= data[i]; i++) {
+      rec_len = rec_len * 10 + (size_t)(data[i] - '0');
+    }
+
+    if (i == pos || i >= len || ' ' != data[i] || rec_len > len - pos ||
+        rec_len <= i - pos + 1 || '\n' != data[pos + rec_len - 1]) {
+      return false;
+    }
+
+    const char *key     = &data[i + 1];
+    const char *rec_end = &data[pos + rec_len - 1];
+    const char *eq      = memchr(key, '=', rec_end - key);
+
+    if (NULL == eq) {
+      return false;
+    }
+
+    size_t      key_len   = eq - key;
+    const char *value     = eq + 1;
+    size_t      value_len = rec_end - value;
+
+    if (4 == key_len && 0 == strncmp(key, "path", 4)) {
+      replace_str(&reader->path, value, value_len);
+    } else if (8 == key_len && 0 == strncmp(key, "linkpath", 8)) {
+      replace_str(&reader->link, value, value_len);
+    } else if (4 == key_len && 0 == strncmp(key, "size", 4)) {
+      char *end = NULL;
+      char *num = NULL;
+      replace_str(&num, value, value_len);
+      *size     = (size_t)strtoull(num, &end, 10);
+      *has_size = 0 != value_len && 0 == *end;
+      mem_safe_free(num);
+
+      if (!*has_size) {
+        return false;
+      }
+    }
+
+    pos += rec_len;
+  }
+
+  return true;
+}
+
+static tar_entry_type_t translate_type(char type, const char *path) {
+  switch (type) {
+  case '0':
+  case '7':
+    return TM_TAR_ENTRY_FILE;
+
+  // Pre-POSIX archives mark directories with a trailing slash
+  case 0: {
+    size_t len = strlen(path);
+    return (0 != len && '/' == path[len - 1]) ? TM_TAR_ENTRY_DIR
+                                              : TM_TAR_ENTRY_FILE;
+  }
+
+  case '1':
+    return TM_TAR_ENTRY_HARDLINK;
+
+  case '2':
+    return TM_TAR_ENTRY_SYMLINK;
+
+  case '5':
+    return TM_TAR_ENTRY_DIR;
+
+  default:
+    return TM_TAR_ENTRY_OTHER;
+  }
+}
+
+void tar_reader_init(tar_reader_t *reader, FILE *stream) {
+  *reader = (tar_reader_t){.stream = stream};
+}
+
+void tar_reader_free(tar_reader_t *reader) {
+  mem_safe_free(reader->path);
+  mem_safe_free(reader->link);
+  reader->path = NULL;
+  reader->link = NULL;
+}
+
+tar_status_t tar_next(tar_reader_t *reader, tar_entry_t *ent) {
+  size_t pax_size     = 0;
+  bool   has_pax_size = false;
+
+  // Skip whatever the caller did not read from the previous entry, except
+  // for the part that was already read into head
+  size_t buffered = reader->head_len - reader->head_pos;
+
+  if (!skip(reader->stream, reader->remaining - buffered + reader->padding)) {
+    return TM_TAR_STATUS_IO;
+  }
+
+  reader->remaining = 0;
+  reader->padding   = 0;
+  reader->head_len  = 0;
+  reader->head_pos  = 0;
+  tar_reader_free(reader);
+
+  while (true) {
+    unsigned char hdr[TM_TAR_BLOCK_LEN];
+    size_t        size;
+    char         *meta;
+
+    size_t nread = fread(hdr, 1, sizeof hdr, reader->stream);
+
+    // Archives that end right after an entry, without the two zero
+    // blocks, are accepted like tar does
+    if (0 == nread && feof(reader->stream) && NULL == reader->path &&
+        NULL == reader->link) {
+      return TM_TAR_STATUS_END;
+    }
+
+    if (sizeof hdr != nread) {
+      return TM_TAR_STATUS_IO;
+    }
+
+    if (is_zero_block(hdr)) {
+      return TM_TAR_STATUS_END;
+    }
+
+    if (!checksum_ok(hdr) ||
+        !parse_number(&size, &hdr[HDR_SIZE], HDR_SIZE_LEN)) {
+      return TM_TAR_STATUS_MALFORMED;
+    }
+
+    switch (hdr[HDR_TYPE]) {
+    // GNU long name and long link name
+    case 'L':
+    case 'K':
+      if (NULL == (meta = dymeta(reader->stream, size))) {
+        return TM_TAR_STATUS_MALFORMED;
+      }
+
+      replace_str(
+          ('L' == hdr[HDR_TYPE]) ? &reader->path : &reader->link,
+          meta,
+          strlen(meta));
+      mem_safe_free(meta);
+      continue;
+
+    // pax extended header for the next entry
+    case 'x':
+      if (NULL == (meta = dymeta(reader->stream, size))) {
+        return TM_TAR_STATUS_MALFORMED;
+      }
+
+      if (!parse_pax(reader, meta, size, &pax_size, &has_pax_size)) {
+        mem_safe_free(meta);
+        return TM_TAR_STATUS_MALFORMED;
+      }
+
+      mem_safe_free(meta);
+      continue;
+
+    // pax global header, nothing in it is relevant here
+    case 'g':
+      if (!skip(reader->stream, size + padding_of(size))) {
+        return TM_TAR_STATUS_IO;
+      }
+      continue;
+
+    default:
+      break;
+    }
+
+    if (NULL == reader->path) {
+      char *name = dyfield(&hdr[HDR_NAME], HDR_NAME_LEN);
+
+      // Only ustar archives have the prefix field
+      if (0 == memcmp(&hdr[HDR_MAGIC], "ustar\0", 6) &&
+          0 != hdr[HDR_PREFIX]) {
+        char *prefix = dyfield(&hdr[HDR_PREFIX], HDR_PREFIX_LEN);
+        reader->path =
+            (char *)malloc(strlen(prefix) + 1 + strlen(name) + 1);
+        mem_chkoom(reader->path);
+        sprintf(reader->path, "%s/%s", prefix, name);
+        mem_safe_free(prefix);
+        mem_safe_free(name);
+      } else {
+        reader->path = name;
+      }
+    }
+
+    if (NULL == reader->link && 0 != hdr[HDR_LINK]) {
+      reader->link = dyfield(&hdr[HDR_LINK], HDR_LINK_LEN);
+    }
+
+    size_t mode = 0;
+    parse_number(&mode, &hdr[HDR_MODE], HDR_MODE_LEN);
+
+    if (has_pax_size) {
+      size = pax_size;
+    }
+
+    *ent = (tar_entry_t){.type = translate_type(hdr[HDR_TYPE], reader->path),
+                         .path = reader->path,
+                         .link = reader->link,
+                         .size = size,
+                         .mode = (unsigned int)mode & 0777};
+
+    reader->remaining = size;
+    reader->padding   = padding_of(size);
+
+    if (TM_TAR_ENTRY_FILE == ent->type) {
+      reader->head_len = (size < TM_TAR_HEAD_LEN) ? size : TM_TAR_HEAD_LEN;
+
+      if (!read_exact(reader->stream, reader->head, reader->head_len)) {
+        return TM_TAR_STATUS_IO;
+      }
+
+      ent->head     = reader->head;
+      ent->head_len = reader->head_len;
+    }
+
+    return TM_TAR_STATUS_OK;
+  }
+}
+
+// Hands out the part of head the caller has not read yet
+static size_t take_head(tar_reader_t *reader, size_t len) {
+  size_t buffered = reader->head_len - reader->head_pos;
+  return (len < buffered) ? len : buffered;
+}
+
+size_t tar_read(tar_reader_t *reader, void *buf, size_t len) {
+  if (len > reader->remaining) {
+    len = reader->remaining;
+  }
+
+  size_t from_head = take_head(reader, len);
+  memcpy(buf, &reader->head[reader->head_pos], from_head);
+  reader->head_pos += from_head;
+
+  size_t nread = from_head + fread((unsigned char *)buf + from_head,
+                                   1,
+                                   len - from_head,
+                                   reader->stream);
+  reader->remaining -= nread;
+  return nread;
+}
+
+bool tar_copy(tar_reader_t *reader, os_fs_filestream_t out, size_t len) {
+  if (len > reader->remaining) {
+    len = reader->remaining;
+  }
+
+  size_t from_head = take_head(reader, len);
+
+  if (0 != from_head &&
+      TM_FS_FILEOP_STATUS_OK !=
+          os_fs_file_write(out, &reader->head[reader->head_pos], from_head)) {
+    return false;
+  }
+
+  reader->head_pos += from_head;
+  reader->remaining -= from_head;
+  len -= from_head;
+
+  if (TM_FS_FILEOP_STATUS_OK != os_fs_file_copy(out, reader->stream, len)) {
+    return false;
+  }
+
+  reader->remaining -= len;
+  return true;
+}
+
+// Turns archive paths into clean relative paths, removing leading slashes
+// and '.' components. Returns NULL for paths that would escape the
+// destination ('..' components) or that are empty
+static char *dysanitize(const char *path) {
+  char  *clean = (char *)malloc(strlen(path) + 1);
+  size_t len   = 0;
+  mem_chkoom(clean);
+
+  for (const char *comp = path; 0 != *comp;) {
+    const char *end = strchr(comp, '/');
+
+    if (NULL == end) {
+      end = comp + strlen(comp);
+    }
+
+    size_t comp_len = end - comp;
+
+    if (2 == comp_len && 0 == strncmp(comp, "..", 2)) {
+      mem_safe_free(clean);
+      return NULL;
+    }
+
+    if (0 != comp_len && !(1 == comp_len && '.' == comp[0])) {
+      if (0 != len) {
+        clean[len] = '/';
+        len++;
+      }
+
+      memcpy(&clean[len], comp, comp_len);
+      len += comp_len;
+    }
+
+    comp = (0 == *end) ? end : end + 1;
+  }
+
+  if (0 == len) {
+    mem_safe_free(clean);
+    return NULL;
+  }
+
+  clean[len] = 0;
+  return clean;
+}
+
+// Creates all directories in rel_path, excluding the last component unless
+// include_last is set. Archives list many files in the same directory in a
+// row, so the last directory created is remembered to skip redundant calls
+static bool
+make_dirs(extract_ctx_t *ctx, const char *rel_path, bool include_last) {
+  size_t dir_len = strlen(rel_path);
+
+  if (!include_last) {
+    const char *last_sep = strrchr(rel_path, '/');
+
+    if (NULL == last_sep) {
+      return true;
+    }
+
+    dir_len = last_sep - rel_path;
+  }
+
+  if (NULL != ctx->last_dir && strlen(ctx->last_dir) == dir_len &&
+      0 == strncmp(ctx->last_dir, rel_path, dir_len)) {
+    return true;
+  }
+
+  replace_str(&ctx->last_dir, rel_path, dir_len);
+  char *dir_path = NULL;
+  bool  ret      = true;
+
+  for (size_t i = 0; i <= dir_len && ret; i++) {
+    if (dir_len != i && '/' != ctx->last_dir[i]) {
+      continue;
+    }
+
+    char saved        = ctx->last_dir[i];
+    ctx->last_dir[i]  = 0;
+    os_fs_path_dyconcat(&dir_path, 2, ctx->dst, ctx->last_dir);
+    ctx->last_dir[i]  = saved;
+    fs_dirop_status_t status = os_fs_mkdir(dir_path);
+    ret = TM_FS_DIROP_STATUS_OK == status || TM_FS_DIROP_STATUS_EXIST == status;
+    mem_safe_free(dir_path);
+  }
+
+  if (!ret) {
+    mem_safe_free(ctx->last_dir);
+    ctx->last_dir = NULL;
+  }
+
+  return ret;
+}
+
+static bool write_data(extract_ctx_t     *ctx,
+                       tar_reader_t      *reader,
+                       os_fs_filestream_t out,
+                       size_t             len) {
+  // Copies in the kernel cannot be throttled
+  if (TAR_BIG_FILE_LEN <= len && 0 == ctx->throttle.rate) {
+    return tar_copy(reader, out, len);
+  }
+
+  while (0 != len) {
+    size_t chunk = (len < TAR_BUF_LEN) ? len : TAR_BUF_LEN;
+    throttle_wait(&ctx->throttle, chunk);
+
+    if (chunk != tar_read(reader, ctx->buf, chunk) ||
+        TM_FS_FILEOP_STATUS_OK != os_fs_file_write(out, ctx->buf, chunk)) {
+      return false;
+    }
+
+    len -= chunk;
+  }
+
+  return true;
+}
+
+static bool write_file(extract_ctx_t *ctx,
+                       tar_reader_t  *reader,
+                       tar_entry_t    ent,
+                       const char    *rel_path) {
+  char              *full_path = NULL;
+  os_fs_filestream_t out;
+
+  os_fs_path_dyconcat(&full_path, 2, ctx->dst, rel_path);
+
+  if (TM_FS_FILEOP_STATUS_OK != os_fs_file_create(&out, full_path, ent.mode)) {
+    mem_safe_free(full_path);
+    return false;
+  }
+
+  // Preallocation is only a hint to reduce fragmentation,
+  // so file systems that do not support it are not an error
+  if (TAR_BIG_FILE_LEN <= ent.size) {
+    os_fs_file_reserve(out, ent.size);
+  }
+
+  bool ret = write_data(ctx, reader, out, ent.size);
+  ret      = TM_FS_FILEOP_STATUS_OK == os_fs_file_close(out) && ret;
+  mem_safe_free(full_path);
+
+  if (ret && NULL != ctx->opts) {
+    ctx->opts->num_written++;
+  }
+
+  return ret;
+}
+
+static int cmp_installed(const void *a, const void *b) {
+  const manifest_entry_t *const *ea = (const manifest_entry_t *const *)a;
+  const manifest_entry_t *const *eb = (const manifest_entry_t *const *)b;
+  return strcmp((*ea)->path, (*eb)->path);
+}
+
+// Returns the manifest entry for rel_path, if any
+static const manifest_entry_t *find_installed(extract_ctx_t *ctx,
+                                              const char    *rel_path) {
+  manifest_entry_t        key     = {.path = (char *)rel_path};
+  const manifest_entry_t *key_ptr = &key;
+  const manifest_entry_t **found =
+      (const manifest_entry_t **)bsearch(&key_ptr,
+                                         ctx->installed,
+                                         ctx->num_installed,
+                                         sizeof(manifest_entry_t *),
+                                         cmp_installed);
+
+  return (NULL != found) ? *found : NULL;
+}
+
+// Writes the new version of a file next to the old one and renames it over
+// it, so that the installed file is never seen half-written. The first
+// prefix_len bytes are known to be the same as the old file, and pending
+// holds data that was already consumed from the archive
+static bool replace_file(extract_ctx_t *ctx,
+                         tar_reader_t  *reader,
+                         tar_entry_t    ent,
+                         const char    *full_path,
+                         FILE          *old,
+                         size_t         prefix_len,
+                         const void    *pending,
+                         size_t         pending_len) {
+  char              *tmp_path = NULL;
+  os_fs_filestream_t out;
+  size_t             bufsz = strlen(full_path) + strlen(TAR_TMP_SUFFIX) + 1;
+
+  tmp_path = (char *)malloc(bufsz * sizeof(char));
+  mem_chkoom(tmp_path);
+  snprintf(tmp_path, bufsz, "%s%s", full_path, TAR_TMP_SUFFIX);
+
+  if (TM_FS_FILEOP_STATUS_OK != os_fs_file_create(&out, tmp_path, ent.mode)) {
+    mem_safe_free(tmp_path);
+    return false;
+  }
+
+  if (TAR_BIG_FILE_LEN <= ent.size) {
+    os_fs_file_reserve(out, ent.size);
+  }
+
+  bool ret = true;
+
+  throttle_wait(&ctx->throttle, prefix_len + pending_len);
+
+  if (0 != prefix_len) {
+    ret = 0 == fseek(old, 0, SEEK_SET) &&
+          TM_FS_FILEOP_STATUS_OK == os_fs_file_copy(out, old, prefix_len);
+  }
+
+  if (ret && 0 != pending_len) {
+    ret = TM_FS_FILEOP_STATUS_OK == os_fs_file_write(out, pending, pending_len);
+  }
+
+  ret = ret &&
+        write_data(ctx, reader, out, ent.size - prefix_len - pending_len);
+  ret = TM_FS_FILEOP_STATUS_OK == os_fs_file_close(out) && ret &&
+        TM_FS_FILEOP_STATUS_OK == os_fs_file_mv(full_path, tmp_path);
+
+  if (!ret) {
+    os_fs_file_rm(tmp_path);
+  } else {
+    ctx->opts->num_written++;
+  }
+
+  mem_safe_free(tmp_path);
+  return ret;
+}
+
+// Compares the archive data with the installed file while streaming it,
+// only writing anything if the two diverge
+static bool update_file(extract_ctx_t *ctx,
+                        tar_reader_t  *reader,
+                        tar_entry_t    ent,
+                        const char    *rel_path) {
+  const manifest_entry_t *installed = find_installed(ctx, rel_path);
+  const char             *base      = ctx->opts->base;
+  char                   *full_path = NULL;
+  char                   *old_path  = NULL;
+  FILE                   *old       = NULL;
+  fs_fileinfo_t           old_info  = {0};
+  size_t                  matched   = 0;
+  bool                    ret       = false;
+
+  os_fs_path_dyconcat(&full_path, 2, ctx->dst, rel_path);
+  os_fs_path_dyconcat(&old_path, 2, base, rel_path);
+
+  // Owner bits are all that is compared as the rest may have been
+  // masked by umask when the file was first written. The size is taken
+  // from the open file too, as the installed one may have grown since
+  if (NULL == installed || installed->size != ent.size ||
+      0 != ((installed->mode ^ ent.mode) & 0700) ||
+      NULL == (old = fopen(old_path, "rb")) ||
+      TM_FS_FILEOP_STATUS_OK != os_fs_file_fgetinfo(&old_info, old) ||
+      TM_FS_FILETYPE_DIR == old_info.file_type ||
+      TM_FS_FILETYPE_UNKNOWN == old_info.file_type ||
+      old_info.size != ent.size) {
+    ret = replace_file(ctx, reader, ent, full_path, NULL, 0, NULL, 0);
+    goto cleanup;
+  }
+
+  while (matched != ent.size) {
+    size_t left  = ent.size - matched;
+    size_t chunk = (left < TAR_BUF_LEN) ? left : TAR_BUF_LEN;
+
+    if (chunk != tar_read(reader, ctx->buf, chunk)) {
+      goto cleanup;
+    }
+
+    if (chunk != fread(ctx->cmp_buf, 1, chunk, old) ||
+        0 != memcmp(ctx->buf, ctx->cmp_buf, chunk)) {
+      ret = replace_file(
+          ctx, reader, ent, full_path, old, matched, ctx->buf, chunk);
+      goto cleanup;
+    }
+
+    matched += chunk;
+  }
+
+  // Links can only fail if the base is on another file system
+  if (TM_FS_FILEOP_STATUS_OK != os_fs_file_link(full_path, old_path)) {
+    ret = replace_file(ctx, reader, ent, full_path, old, ent.size, NULL, 0);
+    goto cleanup;
+  }
+
+  ctx->opts->num_unchanged++;
+  ret = true;
+
+cleanup:
+  if (NULL != old) {
+    fclose(old);
+  }
+
+  mem_safe_free(full_path);
+  mem_safe_free(old_path);
+  return ret;
+}
+
+// Links are created only once all regular files have been extracted, so
+// that no entry can be written through a link placed by the archive itself
+static void defer_link(extract_ctx_t *ctx,
+                       const char    *path,
+                       const char    *target,
+                       bool           symbolic) {
+  if (ctx->links_cap == ctx->num_links) {
+    ctx->links_cap = (0 == ctx->links_cap) ? 16 : ctx->links_cap * 2;
+    ctx->links     = (deferred_link_t *)realloc(
+        ctx->links, ctx->links_cap * sizeof(deferred_link_t));
+    mem_chkoom(ctx->links);
+  }
+
+  deferred_link_t link = {.symbolic = symbolic};
+  replace_str(&link.path, path, strlen(path));
+  replace_str(&link.target, target, strlen(target));
+  ctx->links[ctx->num_links] = link;
+  ctx->num_links++;
+}
+
+// Symbolic links are created last, but one of them may still be a parent
+// of a later one: 'a -> /somewhere' followed by 'a/b' would write outside of
+// the destination. Each parent of rel_path is checked without following it
+static bool has_link_parent(extract_ctx_t *ctx, const char *rel_path) {
+  char       *parent    = NULL;
+  char       *full_path = NULL;
+  char       *target    = NULL;
+  const char *sep       = strchr(rel_path, '/');
+  bool        ret       = false;
+
+  while (NULL != sep && !ret) {
+    replace_str(&parent, rel_path, sep - rel_path);
+    os_fs_path_dyconcat(&full_path, 2, ctx->dst, parent);
+    ret = TM_FS_FILEOP_STATUS_OK == os_fs_file_dyreadlink(&target, full_path);
+    mem_safe_free(full_path);
+    mem_safe_free(target);
+    full_path = NULL;
+    target    = NULL;
+    sep       = strchr(sep + 1, '/');
+  }
+
+  mem_safe_free(parent);
+  return ret;
+}
+
+static bool create_link(extract_ctx_t *ctx, deferred_link_t link) {
+  char *full_path   = NULL;
+  char *full_target = NULL;
+  bool  ret         = false;
+
+  if (has_link_parent(ctx, link.path) ||
+      (!link.symbolic && has_link_parent(ctx, link.target))) {
+    return false;
+  }
+
+  if (!make_dirs(ctx, link.path, false)) {
+    return false;
+  }
+
+  os_fs_path_dyconcat(&full_path, 2, ctx->dst, link.path);
+
+  if (link.symbolic) {
+    ret = TM_FS_FILEOP_STATUS_OK == os_fs_file_symlink(full_path, link.target);
+  } else {
+    os_fs_path_dyconcat(&full_target, 2, ctx->dst, link.target);
+    ret = TM_FS_FILEOP_STATUS_OK == os_fs_file_link(full_path, full_target);
+  }
+
+  mem_safe_free(full_path);
+  mem_safe_free(full_target);
+  return ret;
+}
+
+static bool create_links(extract_ctx_t *ctx) {
+  // Hard links go first as their targets may sit behind symbolic links
+  for (size_t i = 0; i < ctx->num_links; i++) {
+    if (!ctx->links[i].symbolic && !create_link(ctx, ctx->links[i])) {
+      return false;
+    }
+  }
+
+  for (size_t i = 0; i < ctx->num_links; i++) {
+    if (ctx->links[i].symbolic && !create_link(ctx, ctx->links[i])) {
+      return false;
+    }
+  }
+
+  return true;
+}
+
+static bool extract_entry(extract_ctx_t *ctx,
+                          tar_reader_t  *reader,
+                          tar_entry_t    ent,
+                          const char    *rel_path) {
+  char *target = NULL;
+
+  switch (ent.type) {
+  case TM_TAR_ENTRY_FILE:
+    if (NULL != ctx->installed) {
+      return make_dirs(ctx, rel_path, false) &&
+             update_file(ctx, reader, ent, rel_path);
+    }
+
+    return make_dirs(ctx, rel_path, false) &&
+           write_file(ctx, reader, ent, rel_path);
+
+  case TM_TAR_ENTRY_DIR:
+    return make_dirs(ctx, rel_path, true);
+
+  case TM_TAR_ENTRY_SYMLINK:
+    if (NULL != ent.link) {
+      defer_link(ctx, rel_path, ent.link, true);
+    }
+    return true;
+
+  // Hard link targets are paths inside the archive, so they are held to
+  // the same rules as entry paths
+  case TM_TAR_ENTRY_HARDLINK:
+    if (NULL != ent.link && NULL != (target = dysanitize(ent.link))) {
+      defer_link(ctx, rel_path, target, false);
+      mem_safe_free(target);
+    }
+    return true;
+
+  // Device files and FIFOs cannot be created without privileges
+  // and have no place in a package anyway
+  default:
+    return true;
+  }
+}
+
+static void index_installed(extract_ctx_t *ctx, const manifest_t *manifest) {
+  ctx->num_installed = manifest->count;
+  ctx->installed     = (const manifest_entry_t **)malloc(
+      (manifest->count + 1) * sizeof(manifest_entry_t *));
+  mem_chkoom(ctx->installed);
+
+  for (size_t i = 0; i < manifest->count; i++) {
+    ctx->installed[i] = &manifest->entries[i];
+  }
+
+  qsort(ctx->installed,
+        ctx->num_installed,
+        sizeof(manifest_entry_t *),
+        cmp_installed);
+}
+
+bool tar_extract(const char *dst, FILE *stream, tar_opts_t *opts) {
+  tar_reader_t  reader;
+  tar_entry_t   ent;
+  tar_status_t  status;
+  bool          ret = false;
+  extract_ctx_t ctx = {.dst = dst, .opts = opts};
+  throttle_init(&ctx.throttle, (NULL != opts) ? opts->write_rate : 0);
+
+  ctx.buf = (unsigned char *)malloc(TAR_BUF_LEN);
+  mem_chkoom(ctx.buf);
+  tar_reader_init(&reader, stream);
+
+  if (NULL != opts && NULL != opts->manifest && NULL != opts->base) {
+    ctx.cmp_buf = (unsigned char *)malloc(TAR_BUF_LEN);
+    mem_chkoom(ctx.cmp_buf);
+    index_installed(&ctx, opts->manifest);
+  }
+
+  while (TM_TAR_STATUS_OK == (status = tar_next(&reader, &ent))) {
+    char *rel_path = dysanitize(ent.path);
+
+    // Unsafe paths are skipped, much like tar does
+    if (NULL == rel_path) {
+      continue;
+    }
+
+    bool ok = extract_entry(&ctx, &reader, ent, rel_path);
+
+    if (ok && NULL != opts && NULL != opts->visit) {
+      opts->visit(&ent, rel_path, opts->visit_ctx);
+    }
+
+    mem_safe_free(rel_path);
+
+    if (!ok) {
+      goto cleanup;
+    }
+  }
+
+  ret = TM_TAR_STATUS_END == status && create_links(&ctx);
+
+  if (NULL != opts) {
+    opts->complete = ret;
+  }
+
+cleanup:
+  for (size_t i = 0; i < ctx.num_links; i++) {
+    mem_safe_free(ctx.links[i].path);
+    mem_safe_free(ctx.links[i].target);
+  }
+
+  tar_reader_free(&reader);
+  mem_safe_free(ctx.links);
+  mem_safe_free(ctx.last_dir);
+  mem_safe_free(ctx.buf);
+  mem_safe_free(ctx.cmp_buf);
+  mem_safe_free(ctx.installed);
+  return ret;
+}
+
+// Fills the field with len - 1 octal digits and a NUL. Values that do not
+// fit are written in base-256, see parse_number
+static void put_number(unsigned char *field, size_t len, uint64_t value) {
+  if (value < ((uint64_t)1 << (3 * (len - 1)))) {
+    for (size_t i = len - 1; i > 0; i--) {
+      field[i - 1] = (unsigned char)('0' + (value & 7));
+      value >>= 3;
+    }
+
+    field[len - 1] = 0;
+    return;
+  }
+
+  for (size_t i = len - 1; i > 0; i--) {
+    field[i] = (unsigned char)(value & 0xff);
+    value >>= 8;
+  }
+
+  field[0] = 0x80;
+}
+
+static bool write_padding(tar_writer_t *writer, size_t size) {
+  static const unsigned char zeros[TM_TAR_BLOCK_LEN] = {0};
+  size_t                     len = padding_of(size);
+  return len == fwrite(zeros, 1, len, writer->stream);
+}
+
+static bool write_header(tar_writer_t *writer,
+                         char          type,
+                         const char   *path,
+                         const char   *link,
+                         unsigned int  mode,
+                         size_t        size);
+
+// GNU long name entries, read back by tar_next
+static bool
+write_long(tar_writer_t *writer, char type, const char *str, size_t len) {
+  return write_header(writer, type, "././@LongLink", NULL, 0, len + 1) &&
+         len + 1 == fwrite(str, 1, len + 1, writer->stream) &&
+         write_padding(writer, len + 1);
+}
+
+static bool write_header(tar_writer_t *writer,
+                         char          type,
+                         const char   *path,
+                         const char   *link,
+                         unsigned int  mode,
+                         size_t        size) {
+  unsigned char hdr[TM_TAR_BLOCK_LEN] = {0};
+  size_t        path_len              = strlen(path);
+  size_t        link_len              = (NULL != link) ? strlen(link) : 0;
+  unsigned long sum                   = 0;
+
+  if ((HDR_NAME_LEN < path_len && !write_long(writer, 'L', path, path_len)) ||
+      (HDR_LINK_LEN < link_len && !write_long(writer, 'K', link, link_len))) {
+    return false;
+  }
+
+  memcpy(&hdr[HDR_NAME],
+         path,
+         (HDR_NAME_LEN < path_len) ? HDR_NAME_LEN : path_len);
+
+  if (NULL != link) {
+    memcpy(&hdr[HDR_LINK],
+           link,
+           (HDR_LINK_LEN < link_len) ? HDR_LINK_LEN : link_len);
+  }
+
+  put_number(&hdr[HDR_MODE], HDR_MODE_LEN, mode & 07777);
+  put_number(&hdr[HDR_UID], HDR_ID_LEN, 0);
+  put_number(&hdr[HDR_GID], HDR_ID_LEN, 0);
+  put_number(&hdr[HDR_SIZE], HDR_SIZE_LEN, size);
+  put_number(&hdr[HDR_MTIME], HDR_SIZE_LEN, (uint64_t)writer->mtime);
+  memcpy(&hdr[HDR_MAGIC], "ustar", 6);
+  memcpy(&hdr[HDR_VERSION], "00", 2);
+  hdr[HDR_TYPE] = (unsigned char)type;
+
+  // Computed with the checksum field itself filled with spaces
+  memset(&hdr[HDR_CHKSUM], ' ', HDR_CHKSUM_LEN);
+
+  for (size_t i = 0; i < TM_TAR_BLOCK_LEN; i++) {
+    sum += hdr[i];
+  }
+
+  put_number(&hdr[HDR_CHKSUM], HDR_CHKSUM_LEN - 1, sum);
+  return 1 == fwrite(hdr, sizeof hdr, 1, writer->stream);
+}
+
+void tar_writer_init(tar_writer_t *writer, FILE *stream) {
+  *writer = (tar_writer_t){.stream = stream, .mtime = time(NULL)};
+}
+
+bool tar_write_dir(tar_writer_t *writer, const char *path, unsigned int mode) {
+  return write_header(writer, '5', path, NULL, mode, 0);
+}
+
+bool tar_write_symlink(tar_writer_t *writer,
+                       const char   *path,
+                       const char   *target) {
+  return write_header(writer, '2', path, target, 0777, 0);
+}
+
+bool tar_write_data(tar_writer_t *writer,
+                    const char   *path,
+                    unsigned int  mode,
+                    const void   *data,
+                    size_t        len) {
+  return write_header(writer, '0', path, NULL, mode, len) &&
+         len == fwrite(data, 1, len, writer->stream) &&
+         write_padding(writer, len);
+}
+
+// Files that change while they are being written make the archive unusable,
+// so this fails if the size on disk does not match what was read
+bool tar_write_file(tar_writer_t *writer, const char *path, const char *src) {
+  unsigned char buf[TM_TAR_BLOCK_LEN * 16];
+  fs_fileinfo_t info;
+  FILE         *stream = NULL;
+  size_t        left   = 0;
+  bool          ret    = false;
+
+  if (TM_FS_FILEOP_STATUS_OK != os_fs_file_getinfo(&info, src) ||
+      NULL == (stream = fopen(src, "rb")) ||
+      !write_header(writer, '0', path, NULL, info.mode, info.size)) {
+    goto cleanup;
+  }
+
+  for (left = info.size; 0 != left;) {
+    size_t chunk = (left < sizeof buf) ? left : sizeof buf;
+
+    if (!read_exact(stream, buf, chunk) ||
+        chunk != fwrite(buf, 1, chunk, writer->stream)) {
+      goto cleanup;
+    }
+
+    left -= chunk;
+  }
+
+  ret = write_padding(writer, info.size);
+
+cleanup:
+  if (NULL != stream) {
+    fclose(stream);
+  }
+
+  return ret;
+}
+
+// Symbolic links are stored as such, and never followed
+bool tar_write_tree(tar_writer_t *writer, const char *path, const char *src) {
+  os_fs_dirstream_t stream;
+  fs_dirent_t       ent;
+  fs_fileinfo_t     info;
+  fs_dirop_status_t status;
+  bool              ret = true;
+
+  if (TM_FS_FILEOP_STATUS_OK != os_fs_file_getinfo(&info, src) ||
+      !tar_write_dir(writer, path, info.mode) ||
+      TM_FS_DIROP_STATUS_OK != os_fs_dir_open(&stream, src)) {
+    return false;
+  }
+
+  while (ret &&
+         TM_FS_DIROP_STATUS_OK == (status = os_fs_dir_next(stream, &ent))) {
+    char  *full_path = NULL;
+    char  *target    = NULL;
+    size_t bufsz     = strlen(path) + 1 + strlen(ent.name) + 1;
+    char  *rel_path  = (char *)malloc(bufsz);
+    mem_chkoom(rel_path);
+    snprintf(rel_path, bufsz, "%s/%s", path, ent.name);
+    os_fs_path_dyconcat(&full_path, 2, src, ent.name);
+
+    if (TM_FS_FILEOP_STATUS_OK == os_fs_file_dyreadlink(&target, full_path)) {
+      ret = tar_write_symlink(writer, rel_path, target);
+    } else if (TM_FS_FILETYPE_DIR == ent.file_type) {
+      ret = tar_write_tree(writer, rel_path, full_path);
+    } else if (TM_FS_FILETYPE_REGULAR == ent.file_type ||
+               TM_FS_FILETYPE_EXEC == ent.file_type) {
+      ret = tar_write_file(writer, rel_path, full_path);
+    }
+
+    mem_safe_free(rel_path);
+    mem_safe_free(full_path);
+    mem_safe_free(target);
+  }
+
+  os_fs_dir_close(stream);
+  return ret && TM_FS_DIROP_STATUS_END == status;
+}
+
+// Two zero blocks mark the end of the archive
+bool tar_write_end(tar_writer_t *writer) {
+  static const unsigned char zeros[TM_TAR_BLOCK_LEN * 2] = {0};
+  return 1 == fwrite(zeros, sizeof zeros, 1, writer->stream) &&
+         0 == fflush(writer->stream);
+}
@@ -0,0 +1,112 @@
+/*************************************************************************
+| tarman                                                                 |
+| Copyright (C) 2024 Alessandro Salerno                                  |
+|                                                                        |
+| This program is free software: you can redistribute it and/or modify   |
+| it under the terms of the GNU General Public License as published by   |
+| the Free Software Foundation, either version 3 of the License, or      |
+| (at your option) any later version.                                    |
+|                                                                        |
+| This program is distributed in the hope that it will be useful,        |
+| but WITHOUT ANY WARRANTY; without even the implied warranty of         |
+| MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the          |
+| GNU General Public License for more details.                           |
+|                                                                        |
+| You should have received a copy of the GNU General Public License      |
+| along with this program.  If not, see <https://www.gnu.org/licenses/>. |
+*************************************************************************/
+
+
+#include "throttle.h"
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+#include "os/thread.h"
+
+static void refill(throttle_t *throttle) {
+  size_t now     = os_thread_clock();
+  size_t elapsed = now - throttle->last_refill;
+
+  // Anything past a second would be discarded anyway, and
+  // this keeps the multiplication below from overflowing
+  if (1000 < elapsed) {
+    elapsed = 1000;
+  }
+
+  size_t amount = elapsed * throttle->rate / 1000;
+
+  // Fractions of a byte are kept for the next refill
+  if (0 == amount) {
+    return;
+  }
+
+  throttle->tokens += amount;
+  throttle->last_refill = now;
+
+  if (throttle->rate < throttle->tokens) {
+    throttle->tokens = throttle->rate;
+  }
+}
+
+void throttle_init(throttle_t *throttle, size_t rate) {
+  throttle->rate        = rate;
+  throttle->tokens      = rate;
+  throttle->last_refill = os_thread_clock();
+}
+
+// Returns how many bytes can go through right now
+size_t throttle_available(throttle_t *throttle) {
+  if (0 == throttle->rate) {
+    return SIZE_MAX;
+  }
+
+  refill(throttle);
+  return throttle->tokens;
+}
+
+void throttle_consume(throttle_t *throttle, size_t len) {
+  if (0 == throttle->rate) {
+    return;
+  }
+
+  throttle->tokens = (len < throttle->tokens) ? throttle->tokens - len : 0;
+}
+
+// Returns how many milliseconds to wait before a reasonably sized
+// chunk can go through, 0 if one can go through right now
+size_t throttle_delay(throttle_t *throttle) {
+  size_t chunk = TM_THROTTLE_MIN_CHUNK;
+
+  if (0 == throttle->rate) {
+    return 0;
+  }
+
+  if (throttle->rate < chunk) {
+    chunk = throttle->rate;
+  }
+
+  refill(throttle);
+
+  if (chunk <= throttle->tokens) {
+    return 0;
+  }
+
+  return ((chunk - throttle->tokens) * 1000 + throttle->rate - 1) /
+         throttle->rate;
+}
+
+// Blocks until len bytes have gone through the bucket
+void throttle_wait(throttle_t *throttle, size_t len) {
+  while (0 != len && 0 != throttle->rate) {
+    size_t available = throttle_available(throttle);
+    size_t taken     = (len < available) ? len : available;
+
+    throttle_consume(throttle, taken);
+    len -= taken;
+
+    if (0 != len) {
+      os_thread_sleep(throttle_delay(throttle));
+    }
+  }
+}
@@ -0,0 +1,89 @@
+/*************************************************************************
+| tarman                                                                 |
+| Copyright (C) 2024 Alessandro Salerno                                  |
+|                                                                        |
+| This program is free software: you can redistribute it and/or modify   |
+| it under the terms of the GNU General Public License as published by   |
+| the Free Software Foundation, either version 3 of the License, or      |
+| (at your option) any later version.                                    |
+|                                                                        |
+| This program is distributed in the hope that it will be useful,        |
+| but WITHOUT ANY WARRANTY; without even the implied warranty of         |
+| MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the          |
+| GNU General Public License for more details.                           |
+|                                                                        |
+| You should have received a copy of the GNU General Public License      |
+| along with this program.  If not, see <https://www.gnu.org/licenses/>. |
+*************************************************************************/
+
+
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "cli/output.h"
+#include "os/fs.h"
+#include "tm-mem.h"
+#include "util/lock.h"
+
+#define REGISTRY_LOCK "registry"
+#define PKG_LOCK_EXT  "pkg"
+
+static bool acquire(util_lock_t *lock,
+                    const char  *lock_name,
+                    const char  *what,
+                    bool         exclusive,
+                    bool         log) {
+  char              *lock_path = NULL;
+  fs_fileop_status_t status;
+
+  os_fs_tm_dylock(&lock_path, lock_name);
+  status = os_fs_file_lock(&lock->stream, lock_path, exclusive, false);
+
+  // Only wait if another process holds the lock, so that the user
+  // knows why nothing is happening
+  if (TM_FS_FILEOP_STATUS_BUSY == status) {
+    if (log) {
+      cli_out_progress("Waiting for another tarman process to release %s",
+                       what);
+    }
+
+    status = os_fs_file_lock(&lock->stream, lock_path, exclusive, true);
+  }
+
+  if (TM_FS_FILEOP_STATUS_OK != status && log) {
+    cli_out_error("Unable to lock '%s'", lock_path);
+  }
+
+  lock->held = TM_FS_FILEOP_STATUS_OK == status;
+  mem_safe_free(lock_path);
+  return lock->held;
+}
+
+bool util_lock_registry(util_lock_t *lock, bool exclusive, bool log) {
+  return acquire(lock, REGISTRY_LOCK, "the package registry", exclusive, log);
+}
+
+bool util_lock_pkg(util_lock_t *lock,
+                   const char  *pkg_name,
+                   bool         exclusive,
+                   bool         log) {
+  size_t bufsz     = strlen(pkg_name) + 1 + strlen(PKG_LOCK_EXT) + 1;
+  char  *lock_name = (char *)malloc(bufsz * sizeof(char));
+  char   what[64];
+  mem_chkoom(lock_name);
+  snprintf(lock_name, bufsz, "%s.%s", pkg_name, PKG_LOCK_EXT);
+  snprintf(what, sizeof what, "package '%s'", pkg_name);
+
+  bool ret = acquire(lock, lock_name, what, exclusive, log);
+  mem_safe_free(lock_name);
+  return ret;
+}
+
+void util_lock_release(util_lock_t *lock) {
+  if (lock->held) {
+    os_fs_file_unlock(lock->stream);
+    lock->held = false;
+  }
+}
@@ -40,13 +40,5 @@ size_t util_misc_dyfile(char      **dst,
 
 size_t
 util_misc_dytmpfile(char **dst, const char *filename, const char *filetype) {
-  size_t bufsz = strlen(filename) + 1 + strlen(filetype) + 1;
-  char  *fname = (char *)malloc(bufsz * sizeof(char));
-  mem_chkoom(fname);
-  snprintf(fname, bufsz, "%s.%s", filename, filetype);
-
-  os_fs_tm_dycached(dst, fname);
-  mem_safe_free(fname);
-
-  return bufsz - 1;
+  return os_fs_tm_dytmpfile(dst, filename, filetype);
 }
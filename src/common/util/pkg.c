@@ -16,15 +16,24 @@
 | along with this program.  If not, see <https://www.gnu.org/licenses/>. |
 *************************************************************************/
 
+#include <ctype.h>
 #include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 
 #include "cli/input.h"
 #include "cli/output.h"
 #include "config.h"
+#include "delta.h"
 #include "download.h"
+#include "hash.h"
+#include "manifest.h"
+#include "mirror.h"
 #include "os/env.h"
 #include "os/fs.h"
 #include "package.h"
+#include "peer.h"
 #include "tm-mem.h"
 #include "util/misc.h"
 #include "util/pkg.h"
@@ -38,25 +47,424 @@ static const char *override_if_dst_unset(const char *dst, const char *src) {
   return dst;
 }
 
+static bool check_archive_hash(const char *archive_path,
+                               const char *expected_hex,
+                               bool        log) {
+  unsigned char expected[TM_HASH_SHA256_LEN];
+  unsigned char actual[TM_HASH_SHA256_LEN];
+
+  if (NULL == expected_hex) {
+    return true;
+  }
+
+  if (TM_HASH_SHA256_HEXLEN != strlen(expected_hex) ||
+      !hash_fromhex(expected, expected_hex, TM_HASH_SHA256_LEN)) {
+    if (log) {
+      cli_out_error("Invalid ARCHIVE_SHA256 '%s' in recipe", expected_hex);
+    }
+    return false;
+  }
+
+  if (!hash_sha256_file(actual, archive_path) ||
+      0 != memcmp(expected, actual, TM_HASH_SHA256_LEN)) {
+    if (log) {
+      cli_out_error("Archive '%s' does not match the expected SHA-256",
+                    archive_path);
+    }
+    return false;
+  }
+
+  return true;
+}
+
+bool util_pkg_has_hash(recipe_t recipe) {
+  unsigned char digest[TM_HASH_SHA256_LEN];
+
+  return NULL != recipe.archive_sha256 &&
+         TM_HASH_SHA256_HEXLEN == strlen(recipe.archive_sha256) &&
+         hash_fromhex(digest, recipe.archive_sha256, TM_HASH_SHA256_LEN);
+}
+
+bool util_pkg_check_hash(const char *archive_path, recipe_t recipe, bool log) {
+  return check_archive_hash(archive_path, recipe.archive_sha256, log);
+}
+
+// Archives prefetched with 'tarman fetch' are named after the hash they are
+// expected to have, or after their URL if the recipe does not give one
+static void fetched_key(char *key, recipe_t recipe) {
+  unsigned char digest[TM_HASH_SHA256_LEN];
+
+  if (!util_pkg_has_hash(recipe)) {
+    hash_sha256_str(digest, recipe.pkg_info.url);
+  } else {
+    hash_fromhex(digest, recipe.archive_sha256, TM_HASH_SHA256_LEN);
+  }
+
+  hash_tohex(key, digest, TM_HASH_SHA256_LEN);
+}
+
+void util_pkg_dyfetched(char **dst, recipe_t recipe) {
+  char key[TM_HASH_SHA256_HEXLEN + 1];
+  fetched_key(key, recipe);
+  os_fs_tm_dyfetched(dst, key, recipe.package_format);
+}
+
+// Cache peers are asked for archives by the name they have in the cache
+void util_pkg_dyfetched_name(char **dst, recipe_t recipe) {
+  char   key[TM_HASH_SHA256_HEXLEN + 1];
+  size_t bufsz = TM_HASH_SHA256_HEXLEN + 1 + strlen(recipe.package_format) + 1;
+
+  fetched_key(key, recipe);
+  *dst = (char *)malloc(bufsz * sizeof(char));
+  mem_chkoom(*dst);
+  snprintf(*dst, bufsz, "%s.%s", key, recipe.package_format);
+}
+
+static bool copy_file(const char *dst, const char *src) {
+  FILE  *in  = fopen(src, "rb");
+  FILE  *out = NULL;
+  char   buf[4096];
+  size_t len = 0;
+  bool   ret = false;
+
+  if (NULL == in || NULL == (out = fopen(dst, "wb"))) {
+    goto cleanup;
+  }
+
+  while (0 < (len = fread(buf, 1, sizeof buf, in))) {
+    if (len != fwrite(buf, 1, len, out)) {
+      goto cleanup;
+    }
+  }
+
+  ret = !ferror(in);
+
+cleanup:
+  if (NULL != in) {
+    fclose(in);
+  }
+
+  if (NULL != out && 0 != fclose(out)) {
+    ret = false;
+  }
+
+  return ret;
+}
+
+// The caller gets its own link to the fetched archive, so that removing it
+// or keeping it for delta updates leaves the fetched one in place. Archives
+// named after their URL are moved instead: nothing says the URL still
+// serves the same file, so they are only used once
+static bool use_fetched(char      **dst_file,
+                        const char *pkg_name,
+                        recipe_t    recipe,
+                        bool        log) {
+  char         *fetched_path = NULL;
+  fs_filetype_t type;
+  bool          pinned = util_pkg_has_hash(recipe);
+  bool          ret    = false;
+
+  util_pkg_dyfetched(&fetched_path, recipe);
+
+  if (TM_FS_FILEOP_STATUS_OK != os_fs_file_gettype(&type, fetched_path)) {
+    goto cleanup;
+  }
+
+  util_misc_dytmpfile(dst_file, pkg_name, recipe.package_format);
+
+  if ((pinned ||
+       TM_FS_FILEOP_STATUS_OK != os_fs_file_mv(*dst_file, fetched_path)) &&
+      TM_FS_FILEOP_STATUS_OK != os_fs_file_link(*dst_file, fetched_path) &&
+      !copy_file(*dst_file, fetched_path)) {
+    if (log) {
+      cli_out_warning("Unable to use fetched archive '%s'", fetched_path);
+    }
+
+    os_fs_file_rm(*dst_file);
+    mem_safe_free(*dst_file);
+    *dst_file = NULL;
+    goto cleanup;
+  }
+
+  // Already gone if it was moved
+  if (!pinned) {
+    os_fs_file_rm(fetched_path);
+  }
+
+  if (log) {
+    cli_out_progress("Using fetched archive '%s'", fetched_path);
+  }
+
+  ret = true;
+
+cleanup:
+  mem_safe_free(fetched_path);
+  return ret;
+}
+
+bool util_pkg_store_fetched(const char *archive_path,
+                            const char *pkg_name,
+                            recipe_t    recipe,
+                            bool        log) {
+  char *fetched_path = NULL;
+  bool  ret          = false;
+
+  if (!check_archive_hash(archive_path, recipe.archive_sha256, log)) {
+    goto cleanup;
+  }
+
+  if (NULL == recipe.archive_sha256 && log) {
+    cli_out_warning("Recipe of package '%s' has no ARCHIVE_SHA256, the "
+                    "archive cannot be verified",
+                    pkg_name);
+  }
+
+  util_pkg_dyfetched(&fetched_path, recipe);
+
+  if (TM_FS_FILEOP_STATUS_OK != os_fs_file_mv(fetched_path, archive_path)) {
+    if (log) {
+      cli_out_error("Unable to move archive to '%s'", fetched_path);
+    }
+    goto cleanup;
+  }
+
+  ret = true;
+
+cleanup:
+  mem_safe_free(fetched_path);
+  return ret;
+}
+
+// Peers are neither authenticated nor trusted, so they are only asked for
+// archives whose content is pinned by ARCHIVE_SHA256. Archives that do not
+// match are downloaded again from their URL
+static bool fetch_from_peers(const char *dst_file,
+                             const char *pkg_name,
+                             recipe_t    recipe,
+                             bool        log) {
+  char *name = NULL;
+  bool  ret  = false;
+
+  if (!peer_configured() || !util_pkg_has_hash(recipe)) {
+    return false;
+  }
+
+  util_pkg_dyfetched_name(&name, recipe);
+
+  if (!peer_fetch(dst_file, name)) {
+    goto cleanup;
+  }
+
+  if (!check_archive_hash(dst_file, recipe.archive_sha256, LOG_QUIET)) {
+    if (log) {
+      cli_out_warning("Archive of package '%s' from cache peers does not "
+                      "match ARCHIVE_SHA256",
+                      pkg_name);
+    }
+    goto cleanup;
+  }
+
+  if (log) {
+    cli_out_progress("Downloaded package '%s' from cache peers", pkg_name);
+  }
+
+  ret = true;
+
+cleanup:
+  mem_safe_free(name);
+  return ret;
+}
+
 bool util_pkg_fetch_archive(char      **dst_file,
                             const char *pkg_name,
-                            const char *pkg_fmt,
-                            const char *url,
+                            recipe_t   *recipe,
                             bool        log) {
-  util_misc_dytmpfile(dst_file, pkg_name, pkg_fmt);
+  download_meta_t meta    = {0};
+  mirror_list_t   mirrors = {0};
+  size_t          used    = 0;
+  bool            ret     = false;
+
+  if (use_fetched(dst_file, pkg_name, *recipe, log)) {
+    return true;
+  }
+
+  if (download_offline()) {
+    if (log) {
+      cli_out_error("Archive of package '%s' was not fetched and tarman is "
+                    "offline. Run 'tarman fetch %s' first",
+                    pkg_name,
+                    pkg_name);
+    }
+    return false;
+  }
+
+  util_misc_dytmpfile(dst_file, pkg_name, recipe->package_format);
+
+  if (fetch_from_peers(*dst_file, pkg_name, *recipe, log)) {
+    // The archive was never downloaded from URL
+    mem_safe_free(recipe->archive_etag);
+    mem_safe_free(recipe->archive_last_modified);
+    recipe->archive_etag          = NULL;
+    recipe->archive_last_modified = NULL;
+    return true;
+  }
+
+  mirror_parse_list(&mirrors, recipe->pkg_info.url, recipe->mirrors);
 
   if (log) {
-    cli_out_progress("Downloading package from '%s' to '%s'", url, *dst_file);
+    cli_out_progress("Downloading package from '%s' to '%s'",
+                     recipe->pkg_info.url,
+                     *dst_file);
   }
 
-  if (!download(*dst_file, url)) {
+  if (!mirror_download(*dst_file, mirrors, &used, &meta, log)) {
     if (log) {
       cli_out_error("Unable to download package");
     }
-    return false;
+    goto cleanup;
   }
 
-  return true;
+  if (log && 0 != used) {
+    cli_out_progress("Downloaded package from mirror '%s'", mirrors.urls[used]);
+  }
+
+  // Kept for 'tarman outdated' to ask the server whether the archive changed
+  mem_safe_free(recipe->archive_etag);
+  mem_safe_free(recipe->archive_last_modified);
+  recipe->archive_etag          = meta.etag;
+  recipe->archive_last_modified = meta.last_modified;
+  ret                           = true;
+
+cleanup:
+  mirror_free_list(mirrors);
+  return ret;
+}
+
+// Archive-specific properties (hashes and deltas) describe one exact release,
+// so newer values always replace older ones, even when unset
+static const char *override_archive_prop(const char *dst, const char *src) {
+  mem_safe_free(dst);
+  return src;
+}
+
+static bool fetch_delta(char      **dst_file,
+                        const char *pkg_name,
+                        recipe_t    recipe,
+                        bool        log) {
+  char         *kept_path  = NULL;
+  char         *patch_url  = NULL;
+  char         *patch_path = NULL;
+  char          from_hex[TM_HASH_SHA256_HEXLEN + 1];
+  unsigned char from[TM_HASH_SHA256_LEN];
+  bool          ret = false;
+
+  os_fs_tm_dyarchive(&kept_path, pkg_name, recipe.package_format);
+
+  if (!hash_sha256_file(from, kept_path)) {
+    if (log) {
+      cli_out_progress("No previous archive kept for package '%s'", pkg_name);
+    }
+    goto cleanup;
+  }
+
+  hash_tohex(from_hex, from, TM_HASH_SHA256_LEN);
+  delta_dyurl(&patch_url, recipe.delta_url, from_hex);
+  util_misc_dytmpfile(&patch_path, pkg_name, "patch");
+  util_misc_dytmpfile(dst_file, pkg_name, recipe.package_format);
+
+  if (log) {
+    cli_out_progress("Downloading delta from '%s'", patch_url);
+  }
+
+  // Servers answer with an error page when there is no patch for this
+  // hash, which is then rejected by the patch tool
+  ret = download(patch_path, patch_url) &&
+        delta_apply(*dst_file, kept_path, patch_path, recipe.delta_format) &&
+        check_archive_hash(*dst_file, recipe.archive_sha256, log);
+
+  os_fs_file_rm(patch_path);
+
+  if (!ret) {
+    os_fs_file_rm(*dst_file);
+  }
+
+cleanup:
+  if (!ret && log) {
+    cli_out_warning("No usable delta for package '%s', downloading the full "
+                    "archive",
+                    pkg_name);
+  }
+
+  mem_safe_free(kept_path);
+  mem_safe_free(patch_url);
+  mem_safe_free(patch_path);
+  return ret;
+}
+
+bool util_pkg_fetch_update(char      **dst_file,
+                           const char *pkg_name,
+                           recipe_t   *recipe,
+                           bool        log) {
+  if (use_fetched(dst_file, pkg_name, *recipe, log)) {
+    return check_archive_hash(*dst_file, recipe->archive_sha256, log);
+  }
+
+  // Patched archives can only be trusted if there is a hash to check
+  if (NULL != recipe->delta_url && util_pkg_has_hash(*recipe) &&
+      !download_offline() && fetch_delta(dst_file, pkg_name, *recipe, log)) {
+    if (log) {
+      cli_out_progress("Patched previous archive of package '%s'", pkg_name);
+    }
+
+    // The patched archive was never downloaded from URL
+    mem_safe_free(recipe->archive_etag);
+    mem_safe_free(recipe->archive_last_modified);
+    recipe->archive_etag          = NULL;
+    recipe->archive_last_modified = NULL;
+    return true;
+  }
+
+  mem_safe_free(*dst_file);
+  *dst_file = NULL;
+
+  return util_pkg_fetch_archive(dst_file, pkg_name, recipe, log) &&
+         check_archive_hash(*dst_file, recipe->archive_sha256, log);
+}
+
+void util_pkg_keep_archive(const char *archive_path,
+                           const char *pkg_name,
+                           recipe_t    recipe,
+                           bool        log) {
+  char *kept_path = NULL;
+
+  // Archives are only worth keeping if future updates can be deltas
+  if (NULL != recipe.delta_url && NULL != recipe.package_format) {
+    os_fs_tm_dyarchive(&kept_path, pkg_name, recipe.package_format);
+
+    if (log) {
+      cli_out_progress("Keeping archive in '%s' for delta updates", kept_path);
+    }
+
+    if (TM_FS_FILEOP_STATUS_OK == os_fs_file_mv(kept_path, archive_path)) {
+      mem_safe_free(kept_path);
+      return;
+    }
+
+    if (log) {
+      cli_out_warning("Unable to keep archive, next update will download "
+                      "the full archive");
+    }
+  }
+
+  if (log) {
+    cli_out_progress("Removing cache '%s'", archive_path);
+  }
+
+  if (TM_FS_FILEOP_STATUS_OK != os_fs_file_rm(archive_path) && log) {
+    cli_out_warning("Unable to delete cache");
+  }
+
+  mem_safe_free(kept_path);
 }
 
 bool util_pkg_create_directory_from_path(const char *path, bool log, bool in) {
@@ -71,8 +479,9 @@ bool util_pkg_create_directory_from_path(const char *path, bool log, bool in) {
     switch (pkgdir_status) {
     case TM_FS_DIROP_STATUS_EXIST:
       if (in) {
-        return cli_in_bool(
-            "This pacakge is already installed, proceed with clean install?");
+        return cli_in_bool("This package is already installed, install it "
+                           "again as a new version?",
+                           false);
       }
       if (TM_FS_DIROP_STATUS_OK != os_fs_dir_rm(path)) {
         if (log) {
@@ -100,11 +509,43 @@ fail:
 }
 
 bool util_pkg_create_directory(char      **path,
+                               size_t     *version,
                                const char *pkg_name,
                                bool        log,
                                bool        in) {
-  os_fs_tm_dypkg(path, pkg_name);
-  return util_pkg_create_directory_from_path(*path, log, in);
+  char             *pkg_dir = NULL;
+  bool              ret     = false;
+  fs_dirop_status_t status;
+
+  os_fs_tm_dypkgdir(&pkg_dir, pkg_name);
+
+  if (log) {
+    cli_out_progress("Creating package in '%s'", pkg_dir);
+  }
+
+  status = os_fs_mkdir(pkg_dir);
+
+  if (TM_FS_DIROP_STATUS_OK != status && TM_FS_DIROP_STATUS_EXIST != status) {
+    if (log) {
+      cli_out_error("Unable to create directory in '%s'", pkg_dir);
+    }
+    goto cleanup;
+  }
+
+  // Previous versions are kept either way, but the new one replaces the
+  // active one, so this is only done when asked
+  if (TM_FS_DIROP_STATUS_EXIST == status && in &&
+      !cli_in_bool("This package is already installed, install it again as "
+                   "a new version?",
+                   false)) {
+    goto cleanup;
+  }
+
+  ret = util_pkg_create_version(path, version, pkg_name, log);
+
+cleanup:
+  mem_safe_free(pkg_dir);
+  return ret;
 }
 
 bool util_pkg_add_to_path(const char *exec_full_path, bool log) {
@@ -112,6 +553,9 @@ bool util_pkg_add_to_path(const char *exec_full_path, bool log) {
     cli_out_progress("Adding executable '%s' to PATH", exec_full_path);
   }
 
+  // Links left by a previous install may point to a stale location
+  os_env_path_rm(exec_full_path);
+
   if (!os_env_path_add(exec_full_path)) {
     if (log) {
       cli_out_warning("Could not add executable to PATH");
@@ -289,7 +733,11 @@ bool util_pkg_load_recipe(recipe_t   *recipe,
 
   pkg_info_t *pkg = &recipe->pkg_info;
 
-  pkg->url = override_if_dst_unset(pkg->url, rcp_file_data.pkg_info.url);
+  // The URL has to match ARCHIVE_SHA256, so a recipe that sets it wins
+  if (NULL != rcp_file_data.pkg_info.url) {
+    pkg->url = override_archive_prop(pkg->url, rcp_file_data.pkg_info.url);
+  }
+
   pkg->application_name = override_if_dst_unset(
       pkg->application_name, rcp_file_data.pkg_info.application_name);
   pkg->executable_path = override_if_dst_unset(
@@ -300,6 +748,18 @@ bool util_pkg_load_recipe(recipe_t   *recipe,
       override_if_dst_unset(pkg->icon_path, rcp_file_data.pkg_info.icon_path);
   recipe->package_format = override_if_dst_unset(recipe->package_format,
                                                  rcp_file_data.package_format);
+  recipe->mirrors =
+      override_archive_prop(recipe->mirrors, rcp_file_data.mirrors);
+  recipe->archive_sha256 = override_archive_prop(recipe->archive_sha256,
+                                                 rcp_file_data.archive_sha256);
+  recipe->delta_url =
+      override_archive_prop(recipe->delta_url, rcp_file_data.delta_url);
+  recipe->delta_format =
+      override_archive_prop(recipe->delta_format, rcp_file_data.delta_format);
+  recipe->version =
+      override_archive_prop(recipe->version, rcp_file_data.version);
+  recipe->depends =
+      override_archive_prop(recipe->depends, rcp_file_data.depends);
 
   recipe->add_to_path    = rcp_file_data.add_to_path;
   recipe->add_to_desktop = rcp_file_data.add_to_desktop;
@@ -311,3 +771,302 @@ cleanup:
   mem_safe_free(rcp_file_path);
   return ret;
 }
+
+bool util_pkg_create_manifest(const char *pkg_path, bool log) {
+  manifest_t manifest      = {0};
+  char      *manifest_path = NULL;
+  bool       ret           = false;
+
+  os_fs_path_dyconcat(&manifest_path, 2, pkg_path, TM_MANIFEST_FILE);
+
+  if (log) {
+    cli_out_progress("Creating file manifest in '%s'", manifest_path);
+  }
+
+  if (!manifest_dycreate(&manifest, pkg_path)) {
+    if (log) {
+      cli_out_warning("Unable to hash package files, the package will not be "
+                      "verifiable");
+    }
+    goto cleanup;
+  }
+
+  if (!manifest_dump(manifest_path, manifest)) {
+    if (log) {
+      cli_out_warning("Unable to write file manifest '%s'", manifest_path);
+    }
+    goto cleanup;
+  }
+
+  ret = true;
+
+cleanup:
+  manifest_free(manifest);
+  mem_safe_free(manifest_path);
+  return ret;
+}
+
+static bool parse_version(size_t *version, const char *name) {
+  char         *end = NULL;
+  unsigned long num = 0;
+
+  if (!isdigit((unsigned char)name[0])) {
+    return false;
+  }
+
+  num = strtoul(name, &end, 10);
+
+  if (0 != *end || 0 == num) {
+    return false;
+  }
+
+  *version = (size_t)num;
+  return true;
+}
+
+static int cmp_versions(const void *a, const void *b) {
+  size_t va = *(const size_t *)a;
+  size_t vb = *(const size_t *)b;
+  return (va > vb) - (va < vb);
+}
+
+bool util_pkg_list_versions(size_t    **versions,
+                            size_t     *count,
+                            size_t     *current,
+                            const char *pkg_name) {
+  char             *pkg_dir   = NULL;
+  char             *link_path = NULL;
+  char             *target    = NULL;
+  size_t           *vers      = NULL;
+  size_t            num_vers  = 0;
+  size_t            vers_cap  = 8;
+  os_fs_dirstream_t stream;
+  fs_dirent_t       ent;
+
+  os_fs_tm_dypkgdir(&pkg_dir, pkg_name);
+
+  if (TM_FS_DIROP_STATUS_OK != os_fs_dir_open(&stream, pkg_dir)) {
+    mem_safe_free(pkg_dir);
+    return false;
+  }
+
+  vers = (size_t *)malloc(vers_cap * sizeof(size_t));
+  mem_chkoom(vers);
+
+  while (TM_FS_DIROP_STATUS_OK == os_fs_dir_next(stream, &ent)) {
+    size_t version = 0;
+
+    if (TM_FS_FILETYPE_DIR != ent.file_type ||
+        !parse_version(&version, ent.name)) {
+      continue;
+    }
+
+    if (vers_cap == num_vers) {
+      vers_cap *= 2;
+      vers = (size_t *)realloc(vers, vers_cap * sizeof(size_t));
+      mem_chkoom(vers);
+    }
+
+    vers[num_vers++] = version;
+  }
+
+  os_fs_dir_close(stream);
+  qsort(vers, num_vers, sizeof(size_t), cmp_versions);
+
+  *current = 0;
+  os_fs_path_dyconcat(&link_path, 2, pkg_dir, TM_FS_PKG_CURRENT);
+
+  if (TM_FS_FILEOP_STATUS_OK == os_fs_file_dyreadlink(&target, link_path)) {
+    parse_version(current, target);
+  }
+
+  *versions = vers;
+  *count    = num_vers;
+  mem_safe_free(pkg_dir);
+  mem_safe_free(link_path);
+  mem_safe_free(target);
+  return true;
+}
+
+// Packages installed before versions were kept have their files directly in
+// the package directory. These are moved to version 1
+static bool migrate_legacy(const char *pkg_name, bool log) {
+  char         *pkg_dir     = NULL;
+  char         *tmp_dir     = NULL;
+  char         *ver_path    = NULL;
+  char         *artifact    = NULL;
+  char         *active_path = NULL;
+  fs_filetype_t type;
+  bool          ret = true;
+
+  os_fs_tm_dypkgdir(&pkg_dir, pkg_name);
+  os_fs_tm_dypkg(&active_path, pkg_name);
+  os_fs_path_dyconcat(&artifact, 2, pkg_dir, "recipe.tarman");
+
+  // Either the package is not installed or it already has versions
+  if (0 != strcmp(pkg_dir, active_path) ||
+      TM_FS_FILEOP_STATUS_OK != os_fs_file_gettype(&type, artifact)) {
+    goto cleanup;
+  }
+
+  if (log) {
+    cli_out_progress("Moving package '%s' to version 1", pkg_name);
+  }
+
+  size_t bufsz = strlen(pkg_dir) + strlen(".legacy") + 1;
+  tmp_dir      = (char *)malloc(bufsz * sizeof(char));
+  mem_chkoom(tmp_dir);
+  snprintf(tmp_dir, bufsz, "%s.legacy", pkg_dir);
+  os_fs_tm_dypkgver(&ver_path, pkg_name, 1);
+
+  ret = TM_FS_DIROP_STATUS_OK == os_fs_dir_mv(tmp_dir, pkg_dir) &&
+        TM_FS_DIROP_STATUS_OK == os_fs_mkdir(pkg_dir) &&
+        TM_FS_DIROP_STATUS_OK == os_fs_dir_mv(ver_path, tmp_dir) &&
+        util_pkg_activate_version(pkg_name, 1, log);
+
+  if (!ret && log) {
+    cli_out_error("Unable to move package '%s' to version 1", pkg_name);
+  }
+
+cleanup:
+  mem_safe_free(pkg_dir);
+  mem_safe_free(tmp_dir);
+  mem_safe_free(ver_path);
+  mem_safe_free(artifact);
+  mem_safe_free(active_path);
+  return ret;
+}
+
+bool util_pkg_create_version(char      **ver_path,
+                             size_t     *version,
+                             const char *pkg_name,
+                             bool        log) {
+  char             *pkg_dir  = NULL;
+  size_t           *versions = NULL;
+  size_t            count    = 0;
+  size_t            current  = 0;
+  size_t            next     = 1;
+  bool              ret      = false;
+  fs_dirop_status_t status;
+
+  if (!migrate_legacy(pkg_name, log)) {
+    return false;
+  }
+
+  os_fs_tm_dypkgdir(&pkg_dir, pkg_name);
+  status = os_fs_mkdir(pkg_dir);
+
+  if (TM_FS_DIROP_STATUS_OK != status && TM_FS_DIROP_STATUS_EXIST != status) {
+    if (log) {
+      cli_out_error("Unable to create directory in '%s'", pkg_dir);
+    }
+    goto cleanup;
+  }
+
+  if (util_pkg_list_versions(&versions, &count, &current, pkg_name) &&
+      0 != count) {
+    next = versions[count - 1] + 1;
+  }
+
+  os_fs_tm_dypkgver(ver_path, pkg_name, next);
+
+  if (log) {
+    cli_out_progress("Creating package version in '%s'", *ver_path);
+  }
+
+  if (TM_FS_DIROP_STATUS_OK != os_fs_mkdir(*ver_path)) {
+    if (log) {
+      cli_out_error("Unable to create directory in '%s'", *ver_path);
+    }
+    goto cleanup;
+  }
+
+  if (NULL != version) {
+    *version = next;
+  }
+
+  ret = true;
+
+cleanup:
+  mem_safe_free(pkg_dir);
+  mem_safe_free(versions);
+  return ret;
+}
+
+// Removes the oldest versions of a package, never the active one
+static void prune_versions(const char *pkg_name, bool log) {
+  size_t *versions = NULL;
+  size_t  count    = 0;
+  size_t  current  = 0;
+
+  if (!util_pkg_list_versions(&versions, &count, &current, pkg_name)) {
+    return;
+  }
+
+  for (size_t i = 0; i < count && TM_PKG_KEPT_VERSIONS < count; i++) {
+    char *ver_path = NULL;
+
+    if (versions[i] == current) {
+      continue;
+    }
+
+    os_fs_tm_dypkgver(&ver_path, pkg_name, versions[i]);
+
+    if (log) {
+      cli_out_progress("Removing old package version '%s'", ver_path);
+    }
+
+    if (TM_FS_DIROP_STATUS_OK == os_fs_dir_rm(ver_path)) {
+      count--;
+    } else if (log) {
+      cli_out_warning("Unable to remove old package version '%s'", ver_path);
+    }
+
+    mem_safe_free(ver_path);
+  }
+
+  mem_safe_free(versions);
+}
+
+bool util_pkg_activate_version(const char *pkg_name,
+                               size_t      version,
+                               bool        log) {
+  char *pkg_dir   = NULL;
+  char *link_path = NULL;
+  char *tmp_path  = NULL;
+  char  target[32];
+  bool  ret = false;
+
+  os_fs_tm_dypkgdir(&pkg_dir, pkg_name);
+  os_fs_path_dyconcat(&link_path, 2, pkg_dir, TM_FS_PKG_CURRENT);
+  os_fs_path_dyconcat(&tmp_path, 2, pkg_dir, TM_FS_PKG_CURRENT ".new");
+
+  // The link is relative so that the package directory can be moved
+  snprintf(target, sizeof target, "%zu", version);
+
+  if (log) {
+    cli_out_progress("Activating version %s of package '%s'", target, pkg_name);
+  }
+
+  // A link left behind by an interrupted run would make symlink fail
+  os_fs_file_rm(tmp_path);
+
+  // Renaming the new link over the old one replaces it atomically
+  if (TM_FS_FILEOP_STATUS_OK != os_fs_file_symlink(tmp_path, target) ||
+      TM_FS_FILEOP_STATUS_OK != os_fs_file_mv(link_path, tmp_path)) {
+    if (log) {
+      cli_out_error("Unable to update link '%s'", link_path);
+    }
+    os_fs_file_rm(tmp_path);
+    goto cleanup;
+  }
+
+  prune_versions(pkg_name, log);
+  ret = true;
+
+cleanup:
+  mem_safe_free(pkg_dir);
+  mem_safe_free(link_path);
+  mem_safe_free(tmp_path);
+  return ret;
+}
@@ -0,0 +1,604 @@
+/*************************************************************************
+| tarman                                                                 |
+| Copyright (C) 2024 Alessandro Salerno                                  |
+|                                                                        |
+| This program is free software: you can redistribute it and/or modify   |
+| it under the terms of the GNU General Public License as published by   |
+| the Free Software Foundation, either version 3 of the License, or      |
+| (at your option) any later version.                                    |
+|                                                                        |
+| This program is distributed in the hope that it will be useful,        |
+| but WITHOUT ANY WARRANTY; without even the implied warranty of         |
+| MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the          |
+| GNU General Public License for more details.                           |
+|                                                                        |
+| You should have received a copy of the GNU General Public License      |
+| along with this program.  If not, see <https://www.gnu.org/licenses/>. |
+*************************************************************************/
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "archive.h"
+#include "cli/output.h"
+#include "download.h"
+#include "hash.h"
+#include "mirror.h"
+#include "os/fs.h"
+#include "pool.h"
+#include "repository.h"
+#include "tm-mem.h"
+#include "util/misc.h"
+#include "util/repo.h"
+
+#define RECIPE_EXT     ".tarman"
+#define STAGING_DIR    "__repo_staging"
+#define PART_EXT       "part"
+#define STATUS_BUF_LEN 32
+
+typedef struct {
+  const char *name; // Recipe file name inside the repository directory
+  const char *url;
+  const unsigned char *hash;
+  char                *part_path;
+} sync_item_t;
+
+typedef struct {
+  const char      *repo_path;
+  sync_item_t     *items;
+  download_item_t *downloads;
+  atomic_size_t    num_failed;
+} sync_ctx_t;
+
+static int cmp_names(const void *a, const void *b) {
+  return strcmp(*(const char **)a, *(const char **)b);
+}
+
+static bool has_ext(const char *name, const char *ext) {
+  size_t name_len = strlen(name);
+  size_t ext_len  = strlen(ext);
+  return name_len > ext_len && 0 == strcmp(&name[name_len - ext_len], ext);
+}
+
+// Returns the recipe file name the index entry refers to for the given
+// repository, or NULL if the entry belongs to another repository or does not
+// look like a plain recipe file (e.g., '../x.tarman' or 'a/b/c.tarman')
+static const char *index_entry_name(const char *path, const char *repo_name) {
+  const char *name    = path;
+  const char *sep     = strchr(path, '/');
+  size_t      rep_len = strlen(repo_name);
+
+  if (NULL != sep) {
+    if ((size_t)(sep - path) != rep_len ||
+        0 != strncmp(path, repo_name, rep_len)) {
+      return NULL;
+    }
+
+    name = sep + 1;
+  }
+
+  if ('.' == name[0] || NULL != strchr(name, '/') ||
+      !has_ext(name, RECIPE_EXT)) {
+    return NULL;
+  }
+
+  return name;
+}
+
+static bool is_up_to_date(const char *path, const unsigned char *hash) {
+  unsigned char local[TM_HASH_SHA256_LEN];
+  return hash_sha256_file(local, path) &&
+         0 == memcmp(local, hash, TM_HASH_SHA256_LEN);
+}
+
+// Recipes are downloaded next to their destination and moved into place
+// only once their contents match the index, so that an interrupted or
+// corrupted transfer never replaces a good recipe
+static void sync_job(size_t index, void *ctx) {
+  sync_ctx_t *sync     = (sync_ctx_t *)ctx;
+  sync_item_t item     = sync->items[index];
+  char       *dst_path = NULL;
+  bool        ok       = false;
+
+  os_fs_path_dyconcat(&dst_path, 2, sync->repo_path, item.name);
+
+  if (sync->downloads[index].ok && is_up_to_date(item.part_path, item.hash) &&
+      TM_FS_FILEOP_STATUS_OK == os_fs_file_mv(dst_path, item.part_path)) {
+    ok = true;
+  }
+
+  if (!ok) {
+    os_fs_file_rm(item.part_path);
+    atomic_fetch_add(&sync->num_failed, 1);
+  }
+
+  mem_safe_free(dst_path);
+}
+
+static void dypart_path(char **dst, const char *repo_path, const char *name) {
+  size_t bufsz     = 1 + strlen(name) + 1;
+  char  *part_name = (char *)malloc(bufsz * sizeof(char));
+  mem_chkoom(part_name);
+  snprintf(part_name, bufsz, ".%s", name);
+  util_misc_dyfile(dst, repo_path, part_name, PART_EXT);
+  mem_safe_free(part_name);
+}
+
+// Removes recipes that are no longer listed in the index.
+// Names must be sorted
+static size_t remove_stale(const char *repo_path, const char **names, size_t n) {
+  os_fs_dirstream_t stream;
+  fs_dirent_t       ent;
+  size_t            num_removed = 0;
+  size_t            bufsz       = 16;
+  size_t            count       = 0;
+  char            **stale = (char **)malloc(bufsz * sizeof(char *));
+  mem_chkoom(stale);
+
+  if (TM_FS_DIROP_STATUS_OK != os_fs_dir_open(&stream, repo_path)) {
+    mem_safe_free(stale);
+    return 0;
+  }
+
+  // Names are collected first to avoid modifying the directory
+  // while it is being read
+  while (TM_FS_DIROP_STATUS_OK == os_fs_dir_next(stream, &ent)) {
+    if (TM_FS_FILETYPE_DIR == ent.file_type || '.' == ent.name[0] ||
+        !has_ext(ent.name, RECIPE_EXT) ||
+        NULL != bsearch(&ent.name, names, n, sizeof(char *), cmp_names)) {
+      continue;
+    }
+
+    if (bufsz == count) {
+      bufsz *= 2;
+      stale = (char **)realloc(stale, bufsz * sizeof(char *));
+      mem_chkoom(stale);
+    }
+
+    os_fs_path_dyconcat(&stale[count], 2, repo_path, ent.name);
+    count++;
+  }
+
+  os_fs_dir_close(stream);
+
+  for (size_t i = 0; i < count; i++) {
+    if (TM_FS_FILEOP_STATUS_OK == os_fs_file_rm(stale[i])) {
+      num_removed++;
+    }
+
+    mem_safe_free(stale[i]);
+  }
+
+  mem_safe_free(stale);
+  return num_removed;
+}
+
+static bool move_staged_repo(const char *repos_path,
+                             const char *staging_path,
+                             const char *repo_name,
+                             repo_source_t src,
+                             bool          log) {
+  char         *staged_path = NULL;
+  char         *repo_path   = NULL;
+  char         *src_path    = NULL;
+  repo_source_t published   = {0};
+  bool          ret         = false;
+
+  os_fs_path_dyconcat(&staged_path, 2, staging_path, repo_name);
+  os_fs_path_dyconcat(&repo_path, 2, repos_path, repo_name);
+  os_fs_path_dyconcat(&src_path, 2, staged_path, TM_REPO_SOURCE_FILE);
+
+  // Repositories can publish their own mirrors and index URL in the source
+  // file that tarman would otherwise write, which replace the known ones
+  if (TM_CFG_PARSE_STATUS_OK != repo_parse_source(&published, src_path)) {
+    published = (repo_source_t){0};
+  }
+
+  if (NULL != published.mirrors) {
+    src.mirrors = published.mirrors;
+  }
+
+  if (NULL != published.index_url) {
+    src.index_url = published.index_url;
+  }
+
+  mem_safe_free(src_path);
+  os_fs_path_dyconcat(&src_path, 2, repo_path, TM_REPO_SOURCE_FILE);
+
+  fs_dirop_status_t rm_status = os_fs_dir_rm(repo_path);
+
+  if (TM_FS_DIROP_STATUS_OK != rm_status &&
+      TM_FS_DIROP_STATUS_NOEXIST != rm_status) {
+    if (log) {
+      cli_out_error("Unable to replace repository directory '%s'", repo_path);
+    }
+    goto cleanup;
+  }
+
+  if (TM_FS_DIROP_STATUS_OK != os_fs_dir_mv(repo_path, staged_path)) {
+    if (log) {
+      cli_out_error("Unable to move repository '%s' into '%s'",
+                    repo_name,
+                    repos_path);
+    }
+    goto cleanup;
+  }
+
+  if (!repo_dump_source(src_path, src) && log) {
+    cli_out_warning("Unable to record source of repository '%s', it will "
+                    "not be possible to update it",
+                    repo_name);
+  }
+
+  ret = true;
+
+cleanup:
+  repo_free_source(published);
+  mem_safe_free(staged_path);
+  mem_safe_free(repo_path);
+  mem_safe_free(src_path);
+  return ret;
+}
+
+static bool full_refresh(const char *repo_name, repo_source_t src, bool log) {
+  if (NULL == src.package_format) {
+    src.package_format = "tar.gz";
+  }
+
+  if (!util_repo_fetch_archive(src, log)) {
+    return false;
+  }
+
+  if (log) {
+    cli_out_success("Repository '%s' is up to date", repo_name);
+  }
+
+  return true;
+}
+
+// Each mirror of the archive is expected to have the index next to it,
+// unless the repository uses a separate index URL
+static void dyindex_candidates(mirror_list_t *list, repo_source_t src) {
+  mirror_parse_list(
+      list, src.url, (NULL == src.index_url) ? src.mirrors : NULL);
+
+  for (size_t i = 0; i < list->count; i++) {
+    char         *index_url = NULL;
+    repo_source_t mirror = {.url = list->urls[i], .index_url = src.index_url};
+    repo_dyindex_url(&index_url, mirror);
+    mem_safe_free(list->urls[i]);
+    list->urls[i] = index_url;
+  }
+}
+
+bool util_repo_fetch_archive(repo_source_t src, bool log) {
+  char             *archive_path = NULL;
+  char             *staging_path = NULL;
+  char             *repos_path   = NULL;
+  char            **names        = NULL;
+  size_t            bufsz        = 4;
+  size_t            count        = 0;
+  size_t            used         = 0;
+  bool              ret          = false;
+  mirror_list_t     candidates   = {0};
+  download_meta_t   meta         = {0};
+  os_fs_dirstream_t stream;
+  fs_dirent_t       ent;
+
+  os_fs_tm_dyrepos(&repos_path);
+  os_fs_tm_dycached(&staging_path, STAGING_DIR);
+  util_misc_dytmpfile(&archive_path, "__downloaded_repo", src.package_format);
+
+  if (log) {
+    cli_out_progress("Fetching repository from '%s'", src.url);
+  }
+
+  mirror_parse_list(&candidates, src.url, src.mirrors);
+
+  if (!mirror_download(archive_path, candidates, &used, &meta, log)) {
+    if (log) {
+      cli_out_error("Unable to download repository");
+    }
+    goto cleanup;
+  }
+
+  if (log) {
+    cli_out_progress("Extracting repository files");
+  }
+
+  // The archive is extracted in a staging directory first, so that
+  // repositories are replaced as a whole rather than merged with
+  // leftovers from previous versions
+  os_fs_dir_rm(staging_path);
+
+  if (TM_FS_DIROP_STATUS_OK != os_fs_mkdir(staging_path) ||
+      !archive_extract(staging_path, archive_path, NULL, NULL)) {
+    if (log) {
+      cli_out_error("Unable to extract archive. You may be missing the "
+                    "plugin for this archive type");
+    }
+    goto cleanup;
+  }
+
+  if (TM_FS_DIROP_STATUS_OK != os_fs_dir_open(&stream, staging_path)) {
+    goto cleanup;
+  }
+
+  names = (char **)malloc(bufsz * sizeof(char *));
+  mem_chkoom(names);
+
+  while (TM_FS_DIROP_STATUS_OK == os_fs_dir_next(stream, &ent)) {
+    if (TM_FS_FILETYPE_DIR != ent.file_type) {
+      continue;
+    }
+
+    if (bufsz == count) {
+      bufsz *= 2;
+      names = (char **)realloc(names, bufsz * sizeof(char *));
+      mem_chkoom(names);
+    }
+
+    names[count] = (char *)malloc(strlen(ent.name) + 1);
+    mem_chkoom(names[count]);
+    strcpy(names[count], ent.name);
+    count++;
+  }
+
+  os_fs_dir_close(stream);
+  ret = 0 != count;
+
+  if (!ret && log) {
+    cli_out_error("The archive does not contain any repository");
+  }
+
+  for (size_t i = 0; i < count; i++) {
+    if (log) {
+      cli_out_progress("Installing repository '%s'", names[i]);
+    }
+
+    ret = move_staged_repo(repos_path, staging_path, names[i], src, log) &&
+          ret;
+  }
+
+cleanup:
+  if (NULL != names) {
+    for (size_t i = 0; i < count; i++) {
+      mem_safe_free(names[i]);
+    }
+  }
+
+  os_fs_dir_rm(staging_path);
+  os_fs_file_rm(archive_path);
+  mirror_free_list(candidates);
+  download_free_meta(meta);
+  mem_safe_free(names);
+  mem_safe_free(archive_path);
+  mem_safe_free(staging_path);
+  mem_safe_free(repos_path);
+  return ret;
+}
+
+bool util_repo_sync(const char *repo_name, bool log) {
+  char           *repo_path  = NULL;
+  char           *src_path   = NULL;
+  const char     *index_url  = NULL;
+  char           *index_path = NULL;
+  FILE           *index_fp   = NULL;
+  repo_source_t   src        = {0};
+  repo_index_t    index      = {0};
+  mirror_list_t   indices    = {0};
+  download_meta_t index_meta = {0};
+  sync_item_t    *items      = NULL;
+  const char    **names      = NULL;
+  size_t          num_names  = 0;
+  size_t          num_items  = 0;
+  size_t          used       = 0;
+  bool            ret        = false;
+
+  os_fs_tm_dyrepo(&repo_path, repo_name);
+  os_fs_path_dyconcat(&src_path, 2, repo_path, TM_REPO_SOURCE_FILE);
+
+  if (TM_CFG_PARSE_STATUS_OK != repo_parse_source(&src, src_path)) {
+    src = (repo_source_t){0};
+  }
+
+  if (NULL == src.url) {
+    if (log) {
+      cli_out_error("Repository '%s' does not exist or was not added from a "
+                    "URL. Remove it and add it again to make it updatable",
+                    repo_name);
+    }
+    goto cleanup;
+  }
+
+  dyindex_candidates(&indices, src);
+  util_misc_dytmpfile(&index_path, repo_name, "index");
+
+  if (log) {
+    cli_out_progress("Fetching recipe index from '%s'", indices.urls[0]);
+  }
+
+  // Recipes are then downloaded from wherever the index came from
+  if (!mirror_download(index_path, indices, &used, &index_meta, log) ||
+      NULL == (index_fp = fopen(index_path, "r")) ||
+      !repo_index_dyparse(&index, index_fp)) {
+    if (log) {
+      cli_out_warning("No valid recipe index for repository '%s', "
+                      "downloading the full repository",
+                      repo_name);
+    }
+    ret = full_refresh(repo_name, src, log);
+    goto cleanup;
+  }
+
+  index_url = indices.urls[used];
+  items = (sync_item_t *)malloc((index.count + 1) * sizeof(sync_item_t));
+  mem_chkoom(items);
+  names = (const char **)malloc((index.count + 1) * sizeof(char *));
+  mem_chkoom(names);
+
+  for (size_t i = 0; i < index.count; i++) {
+    const char *name = index_entry_name(index.entries[i].path, repo_name);
+    char       *local_path = NULL;
+
+    if (NULL == name) {
+      continue;
+    }
+
+    names[num_names] = name;
+    num_names++;
+    os_fs_path_dyconcat(&local_path, 2, repo_path, name);
+
+    if (!is_up_to_date(local_path, index.entries[i].hash)) {
+      char *url = NULL;
+      repo_dyentry_url(&url, index_url, index.entries[i].path);
+      items[num_items] = (sync_item_t){
+          .name = name, .url = url, .hash = index.entries[i].hash};
+      dypart_path(&items[num_items].part_path, repo_path, name);
+      num_items++;
+    }
+
+    mem_safe_free(local_path);
+  }
+
+  // An index that lists nothing for this repository most likely
+  // belongs to something else, so it is safer not to trust it
+  if (0 == num_names) {
+    if (log) {
+      cli_out_warning("The recipe index does not list repository '%s', "
+                      "downloading the full repository",
+                      repo_name);
+    }
+    ret = full_refresh(repo_name, src, log);
+    goto cleanup;
+  }
+
+  char num_buf[STATUS_BUF_LEN];
+
+  if (0 != num_items) {
+    sync_ctx_t ctx = {.repo_path = repo_path, .items = items};
+    atomic_init(&ctx.num_failed, 0);
+    ctx.downloads = (download_item_t *)malloc(num_items *
+                                              sizeof(download_item_t));
+    mem_chkoom(ctx.downloads);
+
+    for (size_t i = 0; i < num_items; i++) {
+      ctx.downloads[i] =
+          (download_item_t){.dst = items[i].part_path, .url = items[i].url};
+    }
+
+    snprintf(num_buf, sizeof num_buf, "%zu", num_items);
+
+    if (log) {
+      cli_out_progress("Downloading %s new or changed recipe(s)", num_buf);
+    }
+
+    download_many(ctx.downloads, num_items);
+    pool_run(num_items, sync_job, &ctx);
+    mem_safe_free(ctx.downloads);
+
+    size_t num_failed = atomic_load(&ctx.num_failed);
+
+    if (0 != num_failed) {
+      snprintf(num_buf, sizeof num_buf, "%zu", num_failed);
+      if (log) {
+        cli_out_error("Unable to update %s recipe(s) in repository '%s'",
+                      num_buf,
+                      repo_name);
+      }
+      goto cleanup;
+    }
+  }
+
+  qsort(names, num_names, sizeof(char *), cmp_names);
+  size_t num_removed = remove_stale(repo_path, names, num_names);
+  char   rm_buf[STATUS_BUF_LEN];
+
+  snprintf(num_buf, sizeof num_buf, "%zu", num_items);
+  snprintf(rm_buf, sizeof rm_buf, "%zu", num_removed);
+
+  if (log) {
+    cli_out_success("Repository '%s' is up to date (%s updated, %s removed)",
+                    repo_name,
+                    num_buf,
+                    rm_buf);
+  }
+
+  ret = true;
+
+cleanup:
+  if (NULL != index_fp) {
+    fclose(index_fp);
+  }
+
+  for (size_t i = 0; i < num_items; i++) {
+    mem_safe_free(items[i].url);
+    mem_safe_free(items[i].part_path);
+  }
+
+  if (NULL != index_path) {
+    os_fs_file_rm(index_path);
+  }
+
+  repo_index_free(index);
+  repo_free_source(src);
+  mirror_free_list(indices);
+  download_free_meta(index_meta);
+  mem_safe_free(items);
+  mem_safe_free(names);
+  mem_safe_free(repo_path);
+  mem_safe_free(src_path);
+  mem_safe_free(index_path);
+  return ret;
+}
+
+// When several repositories have a recipe for the package, the first one in
+// alphabetical order is used, so that the choice does not depend on the
+// order of directory entries
+bool util_repo_find_recipe(char **repo_name, const char *pkg_name) {
+  char             *repos_path = NULL;
+  char             *found      = NULL;
+  os_fs_dirstream_t stream;
+  fs_dirent_t       ent;
+
+  os_fs_tm_dyrepos(&repos_path);
+
+  if (TM_FS_DIROP_STATUS_OK != os_fs_dir_open(&stream, repos_path)) {
+    mem_safe_free(repos_path);
+    return false;
+  }
+
+  while (TM_FS_DIROP_STATUS_OK == os_fs_dir_next(stream, &ent)) {
+    if (TM_FS_FILETYPE_DIR != ent.file_type ||
+        0 == strcmp(STAGING_DIR, ent.name) ||
+        (NULL != found && 0 <= strcmp(ent.name, found))) {
+      continue;
+    }
+
+    char         *rcp_path = NULL;
+    fs_filetype_t rcp_type;
+    os_fs_tm_dyrecipe(&rcp_path, ent.name, pkg_name);
+
+    if (TM_FS_FILEOP_STATUS_OK == os_fs_file_gettype(&rcp_type, rcp_path)) {
+      mem_safe_free(found);
+      found = (char *)malloc(strlen(ent.name) + 1);
+      mem_chkoom(found);
+      strcpy(found, ent.name);
+    }
+
+    mem_safe_free(rcp_path);
+  }
+
+  os_fs_dir_close(stream);
+  mem_safe_free(repos_path);
+
+  if (NULL == found) {
+    return false;
+  }
+
+  *repo_name = found;
+  return true;
+}
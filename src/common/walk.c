@@ -0,0 +1,426 @@
+/*************************************************************************
+| tarman                                                                 |
+| Copyright (C) 2024 Alessandro Salerno                                  |
+|                                                                        |
+| This program is free software: you can redistribute it and/or modify   |
+| it under the terms of the GNU General Public License as published by   |
+| the Free Software Foundation, either version 3 of the License, or      |
+| (at your option) any later version.                                    |
+|                                                                        |
+| This program is distributed in the hope that it will be useful,        |
+| but WITHOUT ANY WARRANTY; without even the implied warranty of         |
+| MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the          |
+| GNU General Public License for more details.                           |
+|                                                                        |
+| You should have received a copy of the GNU General Public License      |
+| along with this program.  If not, see <https://www.gnu.org/licenses/>. |
+*************************************************************************/
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "os/fs.h"
+#include "os/thread.h"
+#include "pool.h"
+#include "tm-mem.h"
+#include "walk.h"
+
+typedef struct {
+  char  *rel_path; // NULL for the root of the walk
+  size_t depth;
+} walk_job_t;
+
+// Each worker owns one of these. The owner takes jobs from the head (oldest,
+// and thus shallowest, directories first) while idle workers steal from the
+// tail. This keeps the walk roughly breadth-first, which matters when
+// `max_results` cuts it short
+typedef struct {
+  walk_job_t *jobs;
+  size_t      head;
+  size_t      tail;
+  size_t      bufsz;
+  os_mutex_t  lock;
+} walk_deque_t;
+
+typedef struct {
+  const char   *base_path;
+  walk_opts_t   opts;
+  walk_deque_t *deques;
+  size_t        num_workers;
+  atomic_size_t pending; // Jobs that are queued or being visited
+  atomic_size_t num_idle;
+  atomic_bool   stop;
+  atomic_bool   failed;
+  os_mutex_t    idle_lock;
+  os_cond_t     idle_cond; // Jobs were pushed or pending reached 0
+  os_mutex_t    results_lock;
+  char        **results;
+  size_t        count;
+  size_t        bufsz;
+} walk_state_t;
+
+typedef struct {
+  walk_state_t *state;
+  size_t        id;
+} walk_worker_t;
+
+static void deque_push(walk_deque_t *deque, walk_job_t job) {
+  os_mutex_lock(deque->lock);
+
+  if (deque->bufsz == deque->tail) {
+    if (0 < deque->head) {
+      size_t len = deque->tail - deque->head;
+      memmove(
+          deque->jobs, &deque->jobs[deque->head], len * sizeof(walk_job_t));
+      deque->head = 0;
+      deque->tail = len;
+    } else {
+      deque->bufsz *= 2;
+      deque->jobs = (walk_job_t *)realloc(deque->jobs,
+                                          deque->bufsz * sizeof(walk_job_t));
+      mem_chkoom(deque->jobs);
+    }
+  }
+
+  deque->jobs[deque->tail] = job;
+  deque->tail++;
+  os_mutex_unlock(deque->lock);
+}
+
+static bool deque_pop(walk_deque_t *deque, walk_job_t *job, bool steal) {
+  bool ret = false;
+  os_mutex_lock(deque->lock);
+
+  if (deque->head == deque->tail) {
+    goto unlock;
+  }
+
+  if (steal) {
+    deque->tail--;
+    *job = deque->jobs[deque->tail];
+  } else {
+    *job = deque->jobs[deque->head];
+    deque->head++;
+  }
+
+  if (deque->head == deque->tail) {
+    deque->head = 0;
+    deque->tail = 0;
+  }
+
+  ret = true;
+
+unlock:
+  os_mutex_unlock(deque->lock);
+  return ret;
+}
+
+static bool find_job(walk_state_t *state, size_t id, walk_job_t *job) {
+  if (deque_pop(&state->deques[id], job, false)) {
+    return true;
+  }
+
+  for (size_t i = 1; i < state->num_workers; i++) {
+    size_t victim = (id + i) % state->num_workers;
+
+    if (deque_pop(&state->deques[victim], job, true)) {
+      return true;
+    }
+  }
+
+  return false;
+}
+
+// Workers without jobs sleep until there is one to steal or the walk is over.
+// Both conditions are checked again with idle_lock held, and are only
+// signaled with it held, so that no wake-up is missed
+static bool wait_job(walk_state_t *state, size_t id, walk_job_t *job) {
+  bool found = find_job(state, id, job);
+
+  if (found) {
+    return true;
+  }
+
+  os_mutex_lock(state->idle_lock);
+  atomic_fetch_add(&state->num_idle, 1);
+
+  while (!(found = find_job(state, id, job)) &&
+         0 != atomic_load(&state->pending)) {
+    os_cond_wait(state->idle_cond, state->idle_lock);
+  }
+
+  atomic_fetch_sub(&state->num_idle, 1);
+  os_mutex_unlock(state->idle_lock);
+  return found;
+}
+
+static void push_job(walk_state_t *state, size_t id, walk_job_t job) {
+  atomic_fetch_add(&state->pending, 1);
+  deque_push(&state->deques[id], job);
+
+  if (0 != atomic_load(&state->num_idle)) {
+    os_mutex_lock(state->idle_lock);
+    os_cond_signal(state->idle_cond);
+    os_mutex_unlock(state->idle_lock);
+  }
+}
+
+static void finish_job(walk_state_t *state) {
+  if (1 == atomic_fetch_sub(&state->pending, 1)) {
+    os_mutex_lock(state->idle_lock);
+    os_cond_broadcast(state->idle_cond);
+    os_mutex_unlock(state->idle_lock);
+  }
+}
+
+static bool is_pruned(walk_opts_t opts, const char *name) {
+  for (size_t i = 0; i < opts.num_prune; i++) {
+    if (0 == strcmp(opts.prune[i], name)) {
+      return true;
+    }
+  }
+
+  return false;
+}
+
+static void add_result(walk_state_t *state, char *rel_path) {
+  os_mutex_lock(state->results_lock);
+
+  if (0 != state->opts.max_results &&
+      state->count >= state->opts.max_results) {
+    atomic_store(&state->stop, true);
+    os_mutex_unlock(state->results_lock);
+    mem_safe_free(rel_path);
+    return;
+  }
+
+  if (state->bufsz == state->count) {
+    state->bufsz *= 2;
+    state->results =
+        (char **)realloc(state->results, state->bufsz * sizeof(char *));
+    mem_chkoom(state->results);
+  }
+
+  state->results[state->count] = rel_path;
+  state->count++;
+
+  if (0 != state->opts.max_results &&
+      state->count >= state->opts.max_results) {
+    atomic_store(&state->stop, true);
+  }
+
+  os_mutex_unlock(state->results_lock);
+}
+
+static void visit(walk_state_t *state, size_t id, walk_job_t job) {
+  char *dir_path = (char *)state->base_path;
+
+  if (NULL != job.rel_path) {
+    os_fs_path_dyconcat(&dir_path, 2, state->base_path, job.rel_path);
+    mem_chkoom(dir_path);
+  }
+
+  os_fs_dirstream_t stream;
+
+  if (TM_FS_DIROP_STATUS_OK != os_fs_dir_open(&stream, dir_path)) {
+    atomic_store(&state->failed, true);
+    goto cleanup;
+  }
+
+  fs_dirent_t ent;
+
+  while (!atomic_load(&state->stop) &&
+         TM_FS_DIROP_STATUS_OK == os_fs_dir_next(stream, &ent)) {
+    char *rel_path = NULL;
+
+    if (NULL == job.rel_path) {
+      rel_path = (char *)malloc(strlen(ent.name) + 1);
+      mem_chkoom(rel_path);
+      strcpy(rel_path, ent.name);
+    } else {
+      os_fs_path_dyconcat(&rel_path, 2, job.rel_path, ent.name);
+      mem_chkoom(rel_path);
+    }
+
+    if (TM_FS_FILETYPE_DIR == ent.file_type) {
+      size_t depth = job.depth + 1;
+
+      if ((0 != state->opts.max_depth && depth > state->opts.max_depth) ||
+          is_pruned(state->opts, ent.name)) {
+        mem_safe_free(rel_path);
+        continue;
+      }
+
+      push_job(
+          state, id, (walk_job_t){.rel_path = rel_path, .depth = depth});
+      continue;
+    }
+
+    if (NULL == state->opts.filter) {
+      add_result(state, rel_path);
+      continue;
+    }
+
+    char *full_path = NULL;
+    os_fs_path_dyconcat(&full_path, 2, state->base_path, rel_path);
+    mem_chkoom(full_path);
+
+    if (state->opts.filter(full_path, rel_path, ent, state->opts.ctx)) {
+      add_result(state, rel_path);
+    } else {
+      mem_safe_free(rel_path);
+    }
+
+    mem_safe_free(full_path);
+  }
+
+  os_fs_dir_close(stream);
+
+cleanup:
+  if (NULL != job.rel_path) {
+    mem_safe_free(dir_path);
+  }
+}
+
+static void *walk_worker(void *arg) {
+  walk_worker_t *worker = (walk_worker_t *)arg;
+  walk_state_t  *state  = worker->state;
+
+  while (true) {
+    walk_job_t job;
+
+    if (!wait_job(state, worker->id, &job)) {
+      break;
+    }
+
+    // Jobs are still drained after a stop so that
+    // their paths are released
+    if (!atomic_load(&state->stop)) {
+      visit(state, worker->id, job);
+    }
+
+    mem_safe_free(job.rel_path);
+    finish_job(state);
+  }
+
+  return NULL;
+}
+
+size_t walk_path_depth(const char *path) {
+  size_t depth = 0;
+
+  for (; *path; path++) {
+    if ('/' == *path) {
+      depth++;
+    }
+  }
+
+  return depth;
+}
+
+// Results are found in a nondeterministic order, sorting them
+// by depth and then by name makes them stable and puts
+// top-level files first
+static int compare_results(const void *a, const void *b) {
+  const char *path_a  = *(const char **)a;
+  const char *path_b  = *(const char **)b;
+  size_t      depth_a = walk_path_depth(path_a);
+  size_t      depth_b = walk_path_depth(path_b);
+
+  if (depth_a != depth_b) {
+    return depth_a < depth_b ? -1 : 1;
+  }
+
+  return strcmp(path_a, path_b);
+}
+
+bool walk_dytree(char     ***results,
+                 size_t     *count,
+                 const char *base_path,
+                 walk_opts_t opts) {
+  walk_state_t state = {.base_path   = base_path,
+                        .opts        = opts,
+                        .num_workers = pool_size(),
+                        .bufsz       = 16};
+
+  atomic_init(&state.pending, 1);
+  atomic_init(&state.num_idle, 0);
+  atomic_init(&state.stop, false);
+  atomic_init(&state.failed, false);
+
+  state.results = (char **)malloc(state.bufsz * sizeof(char *));
+  mem_chkoom(state.results);
+  state.deques =
+      (walk_deque_t *)calloc(state.num_workers, sizeof(walk_deque_t));
+  mem_chkoom(state.deques);
+
+  if (!os_mutex_create(&state.results_lock) ||
+      !os_mutex_create(&state.idle_lock) ||
+      !os_cond_create(&state.idle_cond)) {
+    mem_oom();
+  }
+
+  for (size_t i = 0; i < state.num_workers; i++) {
+    walk_deque_t *deque = &state.deques[i];
+    deque->bufsz        = 16;
+    deque->jobs = (walk_job_t *)malloc(deque->bufsz * sizeof(walk_job_t));
+    mem_chkoom(deque->jobs);
+
+    if (!os_mutex_create(&deque->lock)) {
+      mem_oom();
+    }
+  }
+
+  deque_push(&state.deques[0], (walk_job_t){.rel_path = NULL, .depth = 0});
+
+  os_thread_t   threads[TM_POOL_MAX_WORKERS];
+  walk_worker_t workers[TM_POOL_MAX_WORKERS];
+  size_t        spawned = 0;
+
+  for (size_t i = 0; i < state.num_workers; i++) {
+    workers[i] = (walk_worker_t){.state = &state, .id = i};
+  }
+
+  // Worker 0 runs on the calling thread
+  for (size_t i = 1; i < state.num_workers; i++, spawned++) {
+    if (!os_thread_create(&threads[spawned], walk_worker, &workers[i])) {
+      break;
+    }
+  }
+
+  walk_worker(&workers[0]);
+
+  for (size_t i = 0; i < spawned; i++) {
+    os_thread_join(threads[i], NULL);
+  }
+
+  for (size_t i = 0; i < state.num_workers; i++) {
+    mem_safe_free(state.deques[i].jobs);
+    os_mutex_destroy(state.deques[i].lock);
+  }
+
+  mem_safe_free(state.deques);
+  os_mutex_destroy(state.results_lock);
+  os_mutex_destroy(state.idle_lock);
+  os_cond_destroy(state.idle_cond);
+
+  if (atomic_load(&state.failed) && 0 == state.count) {
+    walk_free(state.results, state.count);
+    return false;
+  }
+
+  qsort(state.results, state.count, sizeof(char *), compare_results);
+  *results = state.results;
+  *count   = state.count;
+  return true;
+}
+
+void walk_free(char **results, size_t count) {
+  for (size_t i = 0; i < count; i++) {
+    mem_safe_free(results[i]);
+  }
+
+  mem_safe_free(results);
+}
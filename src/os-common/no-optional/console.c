@@ -27,3 +27,7 @@ csz_t noopt_console_get_sz(void) {
 void noopt_console_set_color(color_t color, bool bold) {
   // Do nothing
 }
+
+FILE *noopt_console_detach_stdout(void) {
+  return NULL;
+}
@@ -0,0 +1,62 @@
+/*************************************************************************
+| tarman                                                                 |
+| Copyright (C) 2024 Alessandro Salerno                                  |
+|                                                                        |
+| This program is free software: you can redistribute it and/or modify   |
+| it under the terms of the GNU General Public License as published by   |
+| the Free Software Foundation, either version 3 of the License, or      |
+| (at your option) any later version.                                    |
+|                                                                        |
+| This program is distributed in the hope that it will be useful,        |
+| but WITHOUT ANY WARRANTY; without even the implied warranty of         |
+| MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the          |
+| GNU General Public License for more details.                           |
+|                                                                        |
+| You should have received a copy of the GNU General Public License      |
+| along with this program.  If not, see <https://www.gnu.org/licenses/>. |
+*************************************************************************/
+
+#include <stdlib.h>
+
+#include "os/no-optional/thread.h"
+#include "os/thread.h"
+
+// Single-threaded fallback: the "thread" runs to completion
+// inside noopt_thread_create and join just hands back its result
+bool noopt_thread_create(os_thread_t *thread, os_thread_fcn_t fcn, void *arg) {
+  *thread = fcn(arg);
+  return true;
+}
+
+bool noopt_thread_join(os_thread_t thread, void **ret) {
+  if (NULL != ret) {
+    *ret = thread;
+  }
+
+  return true;
+}
+
+void noopt_thread_yield(void) {
+  // Do nothing
+}
+
+size_t noopt_thread_hwcount(void) {
+  return 1;
+}
+
+bool noopt_mutex_create(os_mutex_t *mutex) {
+  *mutex = NULL;
+  return true;
+}
+
+void noopt_mutex_lock(os_mutex_t mutex) {
+  (void)mutex;
+}
+
+void noopt_mutex_unlock(os_mutex_t mutex) {
+  (void)mutex;
+}
+
+void noopt_mutex_destroy(os_mutex_t mutex) {
+  (void)mutex;
+}
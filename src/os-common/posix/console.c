@@ -75,3 +75,28 @@ void posix_console_set_color(color_t color, bool bold) {
 
   printf("\033[1;%dm", ansi_color);
 }
+
+// Returns a stream to the original standard output, which is then replaced
+// by standard error, so that messages can still be shown while data is
+// written to the stream (e.g., 'tarman bundle export - | ssh ...')
+FILE *posix_console_detach_stdout(void) {
+  fflush(stdout);
+  int fd = fcntl(STDOUT_FILENO, F_DUPFD_CLOEXEC, 0);
+
+  if (0 > fd) {
+    return NULL;
+  }
+
+  if (0 > dup2(STDERR_FILENO, STDOUT_FILENO)) {
+    close(fd);
+    return NULL;
+  }
+
+  FILE *stream = fdopen(fd, "wb");
+
+  if (NULL == stream) {
+    close(fd);
+  }
+
+  return stream;
+}
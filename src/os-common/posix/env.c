@@ -20,7 +20,9 @@
 #include <tm-os-defs.h>
 
 // Other includes
+#include <pwd.h>
 #include <stdbool.h>
+#include <stdlib.h>
 #include <string.h>
 #include <unistd.h>
 
@@ -29,6 +31,8 @@
 #include "os/posix/fs.h"
 #include "tm-mem.h"
 
+static const char *UsrHome = NULL;
+
 static const char *get_name(const char *path) {
   size_t len      = strlen(path);
   size_t last_idx = len - 2;
@@ -79,3 +83,34 @@ bool posix_env_path_rm(const char *executable) {
   mem_safe_free(path_item);
   return TM_FS_FILEOP_STATUS_OK == rm_status;
 }
+
+// Inherited by all processes started afterwards, including plugins
+bool posix_env_set(const char *name, const char *value) {
+  return 0 == setenv(name, value, 1);
+}
+
+// Resolved once per process. $HOME is preferred because querying the user
+// database may be slow (e.g., LDAP) and it is what the user expects anyway
+const char *posix_env_home(void) {
+  if (NULL != UsrHome) {
+    return UsrHome;
+  }
+
+  const char *home = getenv("HOME");
+
+  if (NULL == home || '/' != home[0]) {
+    struct passwd *pw = getpwuid(getuid());
+
+    if (NULL == pw || NULL == pw->pw_dir || '/' != pw->pw_dir[0]) {
+      return NULL;
+    }
+
+    home = pw->pw_dir;
+  }
+
+  char *usr_home = (char *)malloc((strlen(home) + 1) * sizeof(char));
+  mem_chkoom(usr_home);
+  strcpy(usr_home, home);
+  UsrHome = usr_home;
+  return UsrHome;
+}
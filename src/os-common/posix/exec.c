@@ -15,21 +15,30 @@
 | You should have received a copy of the GNU General Public License      |
 | along with this program.  If not, see <https://www.gnu.org/licenses/>. |
 *************************************************************************/
-
 // MUST BE HERE
-#include <stdio.h>
 #include <tm-os-defs.h>
 
 // Other includes
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
 #include <stdarg.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <sys/resource.h>
 #include <sys/types.h>
 #include <sys/wait.h>
 #include <unistd.h>
 
+#include "os/exec.h"
 #include "os/posix/exec.h"
 #include "tm-mem.h"
 
+#define TM_POSIX_IDLE_NICE 19
+
 static size_t count_args(va_list args) {
   va_list copy;
   va_copy(copy, args);
@@ -40,7 +49,7 @@ static size_t count_args(va_list args) {
   return count + 1 + 1; // Add 1 for NULL and for the program
 }
 
-int posix_vexec(const char *executable, va_list args) {
+static const char **dyargv(const char *executable, va_list args) {
   size_t       arg_count = count_args(args);
   const char **argv      = (const char **)malloc(arg_count * sizeof(char *));
   mem_chkoom(argv);
@@ -51,29 +60,279 @@ int posix_vexec(const char *executable, va_list args) {
     argv[i]   = arg;
   }
 
-  pid_t pid = fork();
+  return argv;
+}
 
-  if (0 > pid) {
-    return EXIT_FAILURE;
+// When this gets called it means that this is the child process
+// Only async-signal-safe calls are allowed here since other threads may
+// have been holding locks (e.g., the one on stdout) when fork was called.
+// This is also why the standard streams are not fclose'd: that would
+// flush the parent's buffered output a second time
+static void run_child(const char  *executable,
+                      const char **argv,
+                      int          in_fd,
+                      int          out_fd) {
+  int null_fd = open("/dev/null", O_RDWR);
+
+  // in_fd may be the standard input itself, so it must not be replaced
+  // before it is duplicated
+  if (0 <= in_fd) {
+    dup2(in_fd, STDIN_FILENO);
+  } else if (0 <= null_fd) {
+    dup2(null_fd, STDIN_FILENO);
   }
 
-  // When fork gets here it means
-  // that this is the child process
-  if (0 == pid) {
-    fclose(stdout);
-    fclose(stderr);
-    fclose(stdin);
-    return execvp(executable, (char **)argv);
+  if (0 <= out_fd) {
+    dup2(out_fd, STDOUT_FILENO);
+  } else if (0 <= null_fd) {
+    dup2(null_fd, STDOUT_FILENO);
+  }
+
+  if (0 <= null_fd) {
+    dup2(null_fd, STDERR_FILENO);
   }
 
+  execvp(executable, (char **)argv);
+  _exit(EXIT_FAILURE);
+}
+
+static int wait_child(pid_t pid) {
   int status;
-  int ret = EXIT_FAILURE;
-  waitpid(pid, &status, 0);
+
+  while (0 > waitpid(pid, &status, 0)) {
+    if (EINTR != errno) {
+      return EXIT_FAILURE;
+    }
+  }
 
   if (WIFEXITED(status)) {
-    ret = WEXITSTATUS(status);
+    return WEXITSTATUS(status);
   }
 
+  return EXIT_FAILURE;
+}
+
+int posix_vexec(const char *executable, va_list args) {
+  const char **argv = dyargv(executable, args);
+  pid_t        pid  = fork();
+
+  if (0 > pid) {
+    mem_safe_free(argv);
+    return EXIT_FAILURE;
+  }
+
+  if (0 == pid) {
+    run_child(executable, argv, -1, -1);
+  }
+
+  int ret = wait_child(pid);
   mem_safe_free(argv);
   return ret;
 }
+
+// One end of the pipe becomes the child's standard input (if to_child is
+// set) or output, and the other one is returned. The other standard stream
+// of the child is fd, or /dev/null if it is negative
+static bool spawn_piped(os_proc_t  *proc,
+                        FILE      **stream,
+                        bool        to_child,
+                        int         fd,
+                        const char *executable,
+                        va_list     args) {
+  int fds[2];
+
+  if (0 != pipe(fds)) {
+    return false;
+  }
+
+  // Keep other children (e.g., those spawned by other threads) from
+  // inheriting the write end, which would prevent EOF from being reached
+  fcntl(fds[0], F_SETFD, FD_CLOEXEC);
+  fcntl(fds[1], F_SETFD, FD_CLOEXEC);
+
+  int          child_end  = to_child ? fds[0] : fds[1];
+  int          parent_end = to_child ? fds[1] : fds[0];
+  const char **argv       = dyargv(executable, args);
+  pid_t        pid        = fork();
+
+  if (0 == pid) {
+    run_child(executable,
+              argv,
+              to_child ? child_end : fd,
+              to_child ? fd : child_end);
+  }
+
+  mem_safe_free(argv);
+  close(child_end);
+
+  if (0 > pid) {
+    close(parent_end);
+    return false;
+  }
+
+  FILE *parent_stream = fdopen(parent_end, to_child ? "wb" : "rb");
+
+  if (NULL == parent_stream) {
+    close(parent_end);
+    wait_child(pid);
+    return false;
+  }
+
+  *proc   = (os_proc_t)(intptr_t)pid;
+  *stream = parent_stream;
+  return true;
+}
+
+bool posix_exec_vpipe(os_proc_t  *proc,
+                      FILE      **out,
+                      const char *executable,
+                      va_list     args) {
+  return spawn_piped(proc, out, false, -1, executable, args);
+}
+
+bool posix_exec_vpipe_from(os_proc_t  *proc,
+                           FILE      **out,
+                           FILE       *in,
+                           const char *executable,
+                           va_list     args) {
+  return spawn_piped(proc, out, false, fileno(in), executable, args);
+}
+
+// Whatever is buffered in out would otherwise end up after the
+// child's output
+bool posix_exec_vpipe_to(os_proc_t  *proc,
+                         FILE      **in,
+                         FILE       *out,
+                         const char *executable,
+                         va_list     args) {
+  fflush(out);
+  return spawn_piped(proc, in, true, fileno(out), executable, args);
+}
+
+// Like posix_exec_vpipe, but the child's output is discarded
+bool posix_exec_vspawn(os_proc_t  *proc,
+                       const char *executable,
+                       va_list     args) {
+  const char **argv = dyargv(executable, args);
+  pid_t        pid  = fork();
+
+  if (0 == pid) {
+    run_child(executable, argv, -1, -1);
+  }
+
+  mem_safe_free(argv);
+
+  if (0 > pid) {
+    return false;
+  }
+
+  *proc = (os_proc_t)(intptr_t)pid;
+  return true;
+}
+
+// Unlike run_child, the child keeps running tarman's own code, so it is
+// given its own copy of the standard streams and flushes them on exit.
+// Callers must not have other threads running
+bool posix_exec_fork(os_proc_t   *proc,
+                     FILE        *out,
+                     os_exec_fn_t function,
+                     int          argc,
+                     char        *argv[]) {
+  // Otherwise, buffered output would be written by both processes
+  fflush(NULL);
+  pid_t pid = fork();
+
+  if (0 > pid) {
+    return false;
+  }
+
+  if (0 == pid) {
+    int null_fd = open("/dev/null", O_RDONLY);
+
+    if (0 <= null_fd) {
+      dup2(null_fd, STDIN_FILENO);
+    }
+
+    dup2(fileno(out), STDOUT_FILENO);
+    dup2(fileno(out), STDERR_FILENO);
+    int status = function(argc, argv);
+    fflush(NULL);
+    _exit(status);
+  }
+
+  *proc = (os_proc_t)(intptr_t)pid;
+  return true;
+}
+
+int posix_exec_wait(os_proc_t proc) {
+  return wait_child((pid_t)(intptr_t)proc);
+}
+
+// Returns true once the process has exited, in which case it has also been
+// reaped and must not be waited for again
+bool posix_exec_poll(os_proc_t proc, int *status) {
+  int   wstatus;
+  pid_t ret = waitpid((pid_t)(intptr_t)proc, &wstatus, WNOHANG);
+
+  if (0 == ret || (0 > ret && EINTR == errno)) {
+    return false;
+  }
+
+  *status = (0 < ret && WIFEXITED(wstatus)) ? WEXITSTATUS(wstatus)
+                                            : EXIT_FAILURE;
+  return true;
+}
+
+void posix_exec_kill(os_proc_t proc) {
+  kill((pid_t)(intptr_t)proc, SIGTERM);
+}
+
+bool posix_exec_exists(const char *executable) {
+  if (NULL != strchr(executable, '/')) {
+    return 0 == access(executable, X_OK);
+  }
+
+  const char *path = getenv("PATH");
+
+  if (NULL == path) {
+    return false;
+  }
+
+  size_t exec_len = strlen(executable);
+
+  for (const char *start = path; 0 != *start;) {
+    const char *end = strchr(start, ':');
+
+    if (NULL == end) {
+      end = start + strlen(start);
+    }
+
+    // Empty PATH entries stand for the current directory
+    size_t      dir_len = end - start;
+    const char *dir     = (0 == dir_len) ? "." : start;
+    dir_len             = (0 == dir_len) ? 1 : dir_len;
+
+    char *candidate = (char *)malloc(dir_len + 1 + exec_len + 1);
+    mem_chkoom(candidate);
+    memcpy(candidate, dir, dir_len);
+    candidate[dir_len] = '/';
+    strcpy(&candidate[dir_len + 1], executable);
+
+    bool found = 0 == access(candidate, X_OK);
+    mem_safe_free(candidate);
+
+    if (found) {
+      return true;
+    }
+
+    start = (0 == *end) ? end : end + 1;
+  }
+
+  return false;
+}
+
+// Only CPU priority can be lowered portably. The niceness is inherited
+// by processes started afterwards
+bool posix_exec_idle_priority(void) {
+  return 0 == setpriority(PRIO_PROCESS, 0, TM_POSIX_IDLE_NICE);
+}
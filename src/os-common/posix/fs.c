@@ -22,24 +22,30 @@
 // General includes
 #include <dirent.h>
 #include <errno.h>
-#include <pwd.h>
+#include <fcntl.h>
 #include <stdarg.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/file.h>
 #include <sys/stat.h>
 #include <sys/types.h>
 #include <unistd.h>
 
 #include "os/fs.h"
+#include "os/posix/env.h"
 #include "os/posix/fs.h"
 #include "tm-mem.h"
 
+#define COPY_BUF_LEN (64 * 1024)
+
 typedef struct {
   char  *buf;
   size_t len;
 } tmstr_t;
 
+static tmstr_t Root       = {0};
 static tmstr_t Home       = {0};
 static tmstr_t Repos      = {0};
 static tmstr_t Pkgs       = {0};
@@ -47,10 +53,54 @@ static tmstr_t Extract    = {0};
 static tmstr_t Plugins    = {0};
 static tmstr_t PluginConf = {0};
 static tmstr_t Path       = {0};
+static tmstr_t Archives   = {0};
+static tmstr_t Locks      = {0};
+static tmstr_t Fetched    = {0};
+
+// TARMAN_ROOT replaces ~/.tarman altogether, so that the whole layout can
+// be moved (e.g., to a tmpfs in CI). Relative roots are made absolute here,
+// since commands may change the working directory
+static const char *get_tarman_root(void) {
+  if (NULL != Root.buf) {
+    return Root.buf;
+  }
+
+  const char *root = getenv(TM_FS_ROOT_ENV);
+
+  if (NULL != root && 0 != root[0]) {
+    if ('/' == root[0]) {
+      Root.len = strlen(root);
+      Root.buf = (char *)malloc((Root.len + 1) * sizeof(char));
+      mem_chkoom(Root.buf);
+      strcpy(Root.buf, root);
+    } else {
+      char *cwd = realpath(".", NULL);
+
+      if (NULL == cwd) {
+        return NULL;
+      }
+
+      Root.len = os_fs_path_dyconcat(&Root.buf, 2, cwd, root);
+      mem_chkoom(Root.buf);
+      free(cwd);
+    }
+
+    // Paths are built by appending to the root
+    while (1 < Root.len && '/' == Root.buf[Root.len - 1]) {
+      Root.buf[--Root.len] = 0;
+    }
 
-static const char *get_home_directory(void) {
-  struct passwd *pw = getpwuid(getuid());
-  return pw->pw_dir;
+    return Root.buf;
+  }
+
+  const char *usr_home = posix_env_home();
+
+  if (NULL == usr_home) {
+    return NULL;
+  }
+
+  Root.len = os_fs_path_dyconcat(&Root.buf, 2, usr_home, ".tarman");
+  return Root.buf;
 }
 
 static fs_dirop_status_t simplify(fs_dirop_status_t s) {
@@ -267,6 +317,14 @@ fs_dirop_status_t posix_fs_dir_next(os_fs_dirstream_t stream,
   return TM_FS_DIROP_STATUS_OK;
 }
 
+fs_dirop_status_t posix_fs_dir_mv(const char *dst, const char *src) {
+  if (0 == rename(src, dst)) {
+    return TM_FS_DIROP_STATUS_OK;
+  }
+
+  return translate_direrr();
+}
+
 fs_fileop_status_t posix_fs_file_rm(const char *path) {
   if (0 == unlink(path)) {
     return TM_FS_FILEOP_STATUS_OK;
@@ -275,6 +333,14 @@ fs_fileop_status_t posix_fs_file_rm(const char *path) {
   return translate_fileerr();
 }
 
+fs_fileop_status_t posix_fs_file_mv(const char *dst, const char *src) {
+  if (0 == rename(src, dst)) {
+    return TM_FS_FILEOP_STATUS_OK;
+  }
+
+  return translate_fileerr();
+}
+
 fs_fileop_status_t posix_fs_file_gettype(fs_filetype_t *dst, const char *path) {
   struct stat st;
 
@@ -300,6 +366,217 @@ fs_fileop_status_t posix_fs_file_gettype(fs_filetype_t *dst, const char *path) {
   return TM_FS_FILEOP_STATUS_ERR;
 }
 
+static fs_fileinfo_t translate_stat(const struct stat *st) {
+  fs_fileinfo_t info = {.file_type = TM_FS_FILETYPE_UNKNOWN,
+                        .size      = (size_t)st->st_size,
+                        .mode      = st->st_mode & 07777};
+
+  if (S_ISREG(st->st_mode) && S_IXUSR & st->st_mode) {
+    info.file_type = TM_FS_FILETYPE_EXEC;
+  } else if (S_ISREG(st->st_mode)) {
+    info.file_type = TM_FS_FILETYPE_REGULAR;
+  } else if (S_ISDIR(st->st_mode)) {
+    info.file_type = TM_FS_FILETYPE_DIR;
+  }
+
+  return info;
+}
+
+fs_fileop_status_t posix_fs_file_getinfo(fs_fileinfo_t *dst, const char *path) {
+  struct stat st;
+
+  if (0 > stat(path, &st)) {
+    return translate_fileerr();
+  }
+
+  *dst = translate_stat(&st);
+  return TM_FS_FILEOP_STATUS_OK;
+}
+
+fs_fileop_status_t posix_fs_file_fgetinfo(fs_fileinfo_t *dst, FILE *file) {
+  struct stat st;
+
+  if (0 > fstat(fileno(file), &st)) {
+    return translate_fileerr();
+  }
+
+  *dst = translate_stat(&st);
+  return TM_FS_FILEOP_STATUS_OK;
+}
+
+// Existing files are unlinked rather than truncated, so that links (either
+// hard or symbolic) left at the same path are never written through
+static bool unlink_existing(const char *path) {
+  return 0 == unlink(path) || ENOENT == errno;
+}
+
+fs_fileop_status_t posix_fs_file_create(os_fs_filestream_t *stream,
+                                        const char         *path,
+                                        unsigned int        mode) {
+  if (!unlink_existing(path)) {
+    return translate_fileerr();
+  }
+
+  int fd = open(path, O_WRONLY | O_CREAT | O_EXCL | O_CLOEXEC, mode & 07777);
+
+  if (0 > fd) {
+    return translate_fileerr();
+  }
+
+  *stream = (os_fs_filestream_t)(intptr_t)fd;
+  return TM_FS_FILEOP_STATUS_OK;
+}
+
+fs_fileop_status_t
+posix_fs_file_write(os_fs_filestream_t stream, const void *buf, size_t len) {
+  int                  fd    = (int)(intptr_t)stream;
+  const unsigned char *bytes = (const unsigned char *)buf;
+
+  while (0 != len) {
+    ssize_t written = write(fd, bytes, len);
+
+    if (0 > written) {
+      if (EINTR == errno) {
+        continue;
+      }
+
+      return translate_fileerr();
+    }
+
+    bytes += written;
+    len -= (size_t)written;
+  }
+
+  return TM_FS_FILEOP_STATUS_OK;
+}
+
+fs_fileop_status_t
+posix_fs_file_copy(os_fs_filestream_t stream, FILE *src, size_t len) {
+  unsigned char     *buf    = (unsigned char *)malloc(COPY_BUF_LEN);
+  fs_fileop_status_t status = TM_FS_FILEOP_STATUS_OK;
+  mem_chkoom(buf);
+
+  while (0 != len && TM_FS_FILEOP_STATUS_OK == status) {
+    size_t chunk = (len < COPY_BUF_LEN) ? len : COPY_BUF_LEN;
+
+    if (chunk != fread(buf, 1, chunk, src)) {
+      status = TM_FS_FILEOP_STATUS_ERR;
+      break;
+    }
+
+    status = posix_fs_file_write(stream, buf, chunk);
+    len -= chunk;
+  }
+
+  mem_safe_free(buf);
+  return status;
+}
+
+fs_fileop_status_t posix_fs_file_close(os_fs_filestream_t stream) {
+  if (0 != close((int)(intptr_t)stream)) {
+    return translate_fileerr();
+  }
+
+  return TM_FS_FILEOP_STATUS_OK;
+}
+
+int posix_fs_file_getfd(os_fs_filestream_t stream) {
+  return (int)(intptr_t)stream;
+}
+
+fs_fileop_status_t posix_fs_file_link(const char *dst, const char *target) {
+  if (!unlink_existing(dst) || 0 != link(target, dst)) {
+    return translate_fileerr();
+  }
+
+  return TM_FS_FILEOP_STATUS_OK;
+}
+
+fs_fileop_status_t posix_fs_file_symlink(const char *dst, const char *target) {
+  if (!unlink_existing(dst) || 0 != symlink(target, dst)) {
+    return translate_fileerr();
+  }
+
+  return TM_FS_FILEOP_STATUS_OK;
+}
+
+fs_fileop_status_t posix_fs_file_chmod(const char *path, unsigned int mode) {
+  if (0 != chmod(path, mode & 07777)) {
+    return translate_fileerr();
+  }
+
+  return TM_FS_FILEOP_STATUS_OK;
+}
+
+fs_fileop_status_t posix_fs_file_dyreadlink(char **dst, const char *path) {
+  size_t bufsz = 64;
+  char  *buf   = NULL;
+
+  for (;;) {
+    buf = (char *)realloc(buf, bufsz * sizeof(char));
+    mem_chkoom(buf);
+    ssize_t len = readlink(path, buf, bufsz);
+
+    if (0 > len) {
+      mem_safe_free(buf);
+      return translate_fileerr();
+    }
+
+    // The result may have been truncated
+    if ((size_t)len < bufsz) {
+      buf[len] = 0;
+      *dst     = buf;
+      return TM_FS_FILEOP_STATUS_OK;
+    }
+
+    bufsz *= 2;
+  }
+}
+
+// Locks are held on open file descriptions, so they are released when the
+// process exits, even if it crashes
+fs_fileop_status_t posix_fs_file_lock(os_fs_filestream_t *lock,
+                                      const char         *path,
+                                      bool                exclusive,
+                                      bool                wait) {
+  int fd = open(path, O_RDWR | O_CREAT | O_CLOEXEC, 0600);
+  int op = ((exclusive) ? LOCK_EX : LOCK_SH) | ((wait) ? 0 : LOCK_NB);
+  int rc = 0;
+
+  if (0 > fd) {
+    return translate_fileerr();
+  }
+
+  while (0 != (rc = flock(fd, op)) && EINTR == errno)
+    ;
+
+  if (0 != rc) {
+    fs_fileop_status_t status = (EWOULDBLOCK == errno)
+                                    ? TM_FS_FILEOP_STATUS_BUSY
+                                    : translate_fileerr();
+    close(fd);
+    return status;
+  }
+
+  *lock = (os_fs_filestream_t)(intptr_t)fd;
+  return TM_FS_FILEOP_STATUS_OK;
+}
+
+fs_fileop_status_t posix_fs_file_unlock(os_fs_filestream_t lock) {
+  if (0 != close(posix_fs_file_getfd(lock))) {
+    return translate_fileerr();
+  }
+
+  return TM_FS_FILEOP_STATUS_OK;
+}
+
+// POSIX has no way to flush a single file system, so everything is flushed
+fs_fileop_status_t posix_fs_sync(const char *path) {
+  (void)path;
+  sync();
+  return TM_FS_FILEOP_STATUS_OK;
+}
+
 size_t posix_fs_path_vlen(size_t num_args, va_list args) {
   size_t len = 0;
 
@@ -431,6 +708,24 @@ size_t posix_fs_tm_dyrepo(char **dst, const char *repo_name) {
 }
 
 size_t posix_fs_tm_dypkg(char **dst, const char *pkg_name) {
+  char       *tm_pkg;
+  struct stat st;
+  size_t      ret = os_fs_path_dyconcat(
+      &tm_pkg, 3, Pkgs.buf, pkg_name, TM_FS_PKG_CURRENT);
+  mem_chkoom(tm_pkg);
+
+  // Packages installed before versions were kept have no link to the
+  // active version, their files are directly in the package directory
+  if (0 != lstat(tm_pkg, &st)) {
+    mem_safe_free(tm_pkg);
+    return posix_fs_tm_dypkgdir(dst, pkg_name);
+  }
+
+  *dst = tm_pkg;
+  return ret;
+}
+
+size_t posix_fs_tm_dypkgdir(char **dst, const char *pkg_name) {
   char  *tm_pkg;
   size_t ret = os_fs_path_dyconcat(&tm_pkg, 2, Pkgs.buf, pkg_name);
   mem_chkoom(tm_pkg);
@@ -438,6 +733,16 @@ size_t posix_fs_tm_dypkg(char **dst, const char *pkg_name) {
   return ret;
 }
 
+size_t posix_fs_tm_dypkgver(char **dst, const char *pkg_name, size_t version) {
+  char   ver_name[32];
+  char  *tm_ver;
+  snprintf(ver_name, sizeof ver_name, "%zu", version);
+  size_t ret = os_fs_path_dyconcat(&tm_ver, 3, Pkgs.buf, pkg_name, ver_name);
+  mem_chkoom(tm_ver);
+  *dst = tm_ver;
+  return ret;
+}
+
 size_t posix_fs_tm_dycached(char **dst, const char *item_name) {
   char  *tm_cached;
   size_t ret = os_fs_path_dyconcat(&tm_cached, 2, Extract.buf, item_name);
@@ -446,6 +751,59 @@ size_t posix_fs_tm_dycached(char **dst, const char *item_name) {
   return ret;
 }
 
+// The random part keeps concurrent tarman processes from using the same
+// file. The extension is preserved as archives are recognized by it
+size_t posix_fs_tm_dytmpfile(char **dst, const char *name, const char *ext) {
+  size_t bufsz = strlen(name) + strlen(".XXXXXX.") + strlen(ext) + 1;
+  char  *fname = (char *)malloc(bufsz * sizeof(char));
+  mem_chkoom(fname);
+  snprintf(fname, bufsz, "%s.XXXXXX.%s", name, ext);
+
+  char  *tm_tmp;
+  size_t ret = os_fs_path_dyconcat(&tm_tmp, 2, Extract.buf, fname);
+  mem_chkoom(tm_tmp);
+
+  // The file is created here so that no other process can pick the same
+  // name. If that fails, the name is still usable, just not unique
+  int fd = mkstemps(tm_tmp, (int)(strlen(ext) + 1));
+
+  if (0 <= fd) {
+    close(fd);
+  }
+
+  mem_safe_free(fname);
+  *dst = tm_tmp;
+  return ret;
+}
+
+size_t posix_fs_tm_dylock(char **dst, const char *lock_name) {
+  size_t bufsz = strlen(lock_name) + strlen(".lock") + 1;
+  char  *fname = (char *)malloc(bufsz * sizeof(char));
+  mem_chkoom(fname);
+  snprintf(fname, bufsz, "%s.lock", lock_name);
+
+  char  *tm_lock;
+  size_t ret = os_fs_path_dyconcat(&tm_lock, 2, Locks.buf, fname);
+  mem_chkoom(tm_lock);
+
+  mem_safe_free(fname);
+  *dst = tm_lock;
+  return ret;
+}
+
+// Does not depend on posix_fs_tm_init, as the configuration is read
+// before running any command
+size_t posix_fs_tm_dyconfig(char **dst) {
+  const char *tm_root = get_tarman_root();
+
+  if (NULL == tm_root) {
+    *dst = NULL;
+    return 0;
+  }
+
+  return os_fs_path_dyconcat(dst, 2, tm_root, "config.tarman");
+}
+
 size_t
 posix_fs_tm_dyrecipe(char **dst, const char *repo_name, const char *pkg_name) {
   size_t ret = 0;
@@ -463,6 +821,36 @@ posix_fs_tm_dyrecipe(char **dst, const char *repo_name, const char *pkg_name) {
   return ret;
 }
 
+size_t posix_fs_tm_dyarchive(char      **dst,
+                             const char *pkg_name,
+                             const char *pkg_fmt) {
+  size_t bufsz = strlen(pkg_name) + 1 + strlen(pkg_fmt) + 1;
+  char  *archive_name = (char *)malloc(bufsz * sizeof(char));
+  mem_chkoom(archive_name);
+  snprintf(archive_name, bufsz, "%s.%s", pkg_name, pkg_fmt);
+
+  char  *tm_archive;
+  size_t ret = os_fs_path_dyconcat(&tm_archive, 2, Archives.buf, archive_name);
+
+  mem_safe_free(archive_name);
+  *dst = tm_archive;
+  return ret;
+}
+
+size_t posix_fs_tm_dyfetched(char **dst, const char *key, const char *pkg_fmt) {
+  size_t bufsz      = strlen(key) + 1 + strlen(pkg_fmt) + 1;
+  char  *entry_name = (char *)malloc(bufsz * sizeof(char));
+  mem_chkoom(entry_name);
+  snprintf(entry_name, bufsz, "%s.%s", key, pkg_fmt);
+
+  char  *tm_fetched;
+  size_t ret = os_fs_path_dyconcat(&tm_fetched, 2, Fetched.buf, entry_name);
+
+  mem_safe_free(entry_name);
+  *dst = tm_fetched;
+  return ret;
+}
+
 size_t posix_fs_tm_dyplugins(const char **dst) {
   char *tm_plugins = (char *)malloc((Plugins.len + 1) * sizeof(char));
   mem_chkoom(tm_plugins);
@@ -504,32 +892,51 @@ size_t posix_fs_tm_dyexecpath(const char **dst, const char *exec) {
 }
 
 bool posix_fs_tm_init(void) {
-  const char *usr_home = get_home_directory();
-
-  Home.len  = os_fs_path_dyconcat(&Home.buf, 2, usr_home, ".tarman");
-  Repos.len = os_fs_path_dyconcat(&Repos.buf, 3, usr_home, ".tarman", "repos");
-  Pkgs.len  = os_fs_path_dyconcat(&Pkgs.buf, 3, usr_home, ".tarman", "pkgs");
-  Extract.len =
-      os_fs_path_dyconcat(&Extract.buf, 3, usr_home, ".tarman", "tmp");
-  Plugins.len =
-      os_fs_path_dyconcat(&Plugins.buf, 3, usr_home, ".tarman", "plugins");
-  PluginConf.len =
-      os_fs_path_dyconcat(&PluginConf.buf, 3, usr_home, ".tarman", "conf");
-  Path.len = os_fs_path_dyconcat(&Path.buf, 3, usr_home, ".tarman", "path");
+  // Paths are only computed once per process, even when it runs
+  // several commands
+  if (NULL != Home.buf) {
+    goto make_dirs;
+  }
+
+  const char *tm_root = get_tarman_root();
+
+  if (NULL == tm_root) {
+    return false;
+  }
+
+  Home.len = strlen(tm_root);
+  Home.buf = (char *)malloc((Home.len + 1) * sizeof(char));
+  mem_chkoom(Home.buf);
+  strcpy(Home.buf, tm_root);
+
+  Repos.len      = os_fs_path_dyconcat(&Repos.buf, 2, tm_root, "repos");
+  Pkgs.len       = os_fs_path_dyconcat(&Pkgs.buf, 2, tm_root, "pkgs");
+  Extract.len    = os_fs_path_dyconcat(&Extract.buf, 2, tm_root, "tmp");
+  Plugins.len    = os_fs_path_dyconcat(&Plugins.buf, 2, tm_root, "plugins");
+  PluginConf.len = os_fs_path_dyconcat(&PluginConf.buf, 2, tm_root, "conf");
+  Path.len       = os_fs_path_dyconcat(&Path.buf, 2, tm_root, "path");
+  Archives.len   = os_fs_path_dyconcat(&Archives.buf, 2, tm_root, "archives");
+  Locks.len      = os_fs_path_dyconcat(&Locks.buf, 2, tm_root, "locks");
+  Fetched.len    = os_fs_path_dyconcat(&Fetched.buf, 2, tm_root, "cache");
 
   if (NULL == Home.buf || NULL == Repos.buf || NULL == Pkgs.buf ||
       NULL == Extract.buf || NULL == Plugins.buf || NULL == PluginConf.buf ||
-      NULL == Path.buf) {
+      NULL == Path.buf || NULL == Archives.buf || NULL == Locks.buf ||
+      NULL == Fetched.buf) {
     return false;
   }
 
+make_dirs:
   if (TM_FS_DIROP_STATUS_OK != simplify(os_fs_mkdir(Home.buf)) ||
       TM_FS_DIROP_STATUS_OK != simplify(os_fs_mkdir(Repos.buf)) ||
       TM_FS_DIROP_STATUS_OK != simplify(os_fs_mkdir(Pkgs.buf)) ||
       TM_FS_DIROP_STATUS_OK != simplify(os_fs_mkdir(Extract.buf)) ||
       TM_FS_DIROP_STATUS_OK != simplify(os_fs_mkdir(Plugins.buf)) ||
       TM_FS_DIROP_STATUS_OK != simplify(os_fs_mkdir(PluginConf.buf)) ||
-      TM_FS_DIROP_STATUS_OK != simplify(os_fs_mkdir(Path.buf))) {
+      TM_FS_DIROP_STATUS_OK != simplify(os_fs_mkdir(Path.buf)) ||
+      TM_FS_DIROP_STATUS_OK != simplify(os_fs_mkdir(Archives.buf)) ||
+      TM_FS_DIROP_STATUS_OK != simplify(os_fs_mkdir(Locks.buf)) ||
+      TM_FS_DIROP_STATUS_OK != simplify(os_fs_mkdir(Fetched.buf))) {
     return false;
   }
 
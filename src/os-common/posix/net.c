@@ -0,0 +1,364 @@
+/*************************************************************************
+| tarman                                                                 |
+| Copyright (C) 2024 Alessandro Salerno                                  |
+|                                                                        |
+| This program is free software: you can redistribute it and/or modify   |
+| it under the terms of the GNU General Public License as published by   |
+| the Free Software Foundation, either version 3 of the License, or      |
+| (at your option) any later version.                                    |
+|                                                                        |
+| This program is distributed in the hope that it will be useful,        |
+| but WITHOUT ANY WARRANTY; without even the implied warranty of         |
+| MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the          |
+| GNU General Public License for more details.                           |
+|                                                                        |
+| You should have received a copy of the GNU General Public License      |
+| along with this program.  If not, see <https://www.gnu.org/licenses/>. |
+*************************************************************************/
+
+
+// MUST BE HERE
+#include <tm-os-defs.h>
+
+// Other includes
+#include <errno.h>
+#include <fcntl.h>
+#include <netdb.h>
+#include <poll.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/types.h>
+#include <unistd.h>
+
+#include "os/net.h"
+#include "os/posix/net.h"
+#include "tm-mem.h"
+
+// Writing to a peer that went away must not kill the process
+#ifdef MSG_NOSIGNAL
+#define SEND_FLAGS MSG_NOSIGNAL
+#else
+#define SEND_FLAGS 0
+#endif
+
+typedef struct {
+  struct pollfd *fds;
+  void         **data;
+  size_t         count;
+  size_t         cap;
+} poller_t;
+
+typedef struct {
+  struct addrinfo *addrs;
+  struct addrinfo *next; // Next address to try if the current one fails
+} attempt_t;
+
+// Sockets are non-blocking from the start, so that connecting never holds
+// up other transfers. Addresses are tried in the order given by the
+// resolver, e.g., both IPv6 and IPv4 for localhost
+static int connect_next(attempt_t *attempt) {
+  while (NULL != attempt->next) {
+    struct addrinfo *ai = attempt->next;
+    attempt->next       = ai->ai_next;
+    int fd = socket(ai->ai_family, ai->ai_socktype, ai->ai_protocol);
+
+    if (0 > fd) {
+      continue;
+    }
+
+    fcntl(fd, F_SETFD, FD_CLOEXEC);
+    fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+
+#ifdef SO_NOSIGPIPE
+    int one = 1;
+    setsockopt(fd, SOL_SOCKET, SO_NOSIGPIPE, &one, sizeof one);
+#endif
+
+    if (0 == connect(fd, ai->ai_addr, ai->ai_addrlen) ||
+        EINPROGRESS == errno) {
+      return fd;
+    }
+
+    close(fd);
+  }
+
+  return -1;
+}
+
+bool posix_net_connect_start(os_net_attempt_t *attempt,
+                             os_net_sock_t    *sock,
+                             const char       *host,
+                             const char       *port) {
+  struct addrinfo hints = {.ai_family = AF_UNSPEC, .ai_socktype = SOCK_STREAM};
+  attempt_t      *handle = (attempt_t *)calloc(1, sizeof(attempt_t));
+  mem_chkoom(handle);
+
+  if (0 != getaddrinfo(host, port, &hints, &handle->addrs)) {
+    mem_safe_free(handle);
+    return false;
+  }
+
+  handle->next = handle->addrs;
+  int fd       = connect_next(handle);
+
+  if (0 > fd) {
+    posix_net_connect_abort(handle);
+    return false;
+  }
+
+  *attempt = handle;
+  *sock    = (os_net_sock_t)(intptr_t)fd;
+  return true;
+}
+
+net_status_t posix_net_connect_finish(os_net_attempt_t attempt,
+                                      os_net_sock_t   *sock,
+                                      bool             timed_out) {
+  int       fd  = posix_net_fd(*sock);
+  int       err = 0;
+  socklen_t len = sizeof err;
+
+  if (!timed_out && 0 == getsockopt(fd, SOL_SOCKET, SO_ERROR, &err, &len) &&
+      0 == err) {
+    posix_net_connect_abort(attempt);
+    return TM_NET_STATUS_OK;
+  }
+
+  int next = connect_next((attempt_t *)attempt);
+
+  if (0 > next) {
+    posix_net_connect_abort(attempt);
+    return TM_NET_STATUS_ERR;
+  }
+
+  close(fd);
+  *sock = (os_net_sock_t)(intptr_t)next;
+  return TM_NET_STATUS_AGAIN;
+}
+
+void posix_net_connect_abort(os_net_attempt_t attempt) {
+  attempt_t *handle = (attempt_t *)attempt;
+
+  if (NULL != handle->addrs) {
+    freeaddrinfo(handle->addrs);
+  }
+
+  mem_safe_free(handle);
+}
+
+// Sockets that are still being closed do not keep the port busy, so
+// that the server can be restarted right away
+static int listen_any(struct addrinfo *addrs) {
+  for (struct addrinfo *ai = addrs; NULL != ai; ai = ai->ai_next) {
+    int fd  = socket(ai->ai_family, ai->ai_socktype, ai->ai_protocol);
+    int one = 1;
+
+    if (0 > fd) {
+      continue;
+    }
+
+    fcntl(fd, F_SETFD, FD_CLOEXEC);
+    fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+    setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof one);
+
+    if (0 == bind(fd, ai->ai_addr, ai->ai_addrlen) &&
+        0 == listen(fd, SOMAXCONN)) {
+      return fd;
+    }
+
+    close(fd);
+  }
+
+  return -1;
+}
+
+bool posix_net_listen(os_net_sock_t *sock,
+                      const char    *host,
+                      const char    *port) {
+  struct addrinfo  hints = {.ai_family   = AF_UNSPEC,
+                            .ai_socktype = SOCK_STREAM,
+                            .ai_flags    = AI_PASSIVE};
+  struct addrinfo *addrs = NULL;
+
+  if (0 != getaddrinfo(host, port, &hints, &addrs)) {
+    return false;
+  }
+
+  int fd = listen_any(addrs);
+  freeaddrinfo(addrs);
+
+  if (0 > fd) {
+    return false;
+  }
+
+  *sock = (os_net_sock_t)(intptr_t)fd;
+  return true;
+}
+
+net_status_t posix_net_accept(os_net_sock_t listener, os_net_sock_t *conn) {
+  int fd = accept((int)(intptr_t)listener, NULL, NULL);
+
+  if (0 > fd) {
+    // The client may have given up before its connection was accepted
+    return (EAGAIN == errno || EWOULDBLOCK == errno || EINTR == errno ||
+            ECONNABORTED == errno)
+               ? TM_NET_STATUS_AGAIN
+               : TM_NET_STATUS_ERR;
+  }
+
+  fcntl(fd, F_SETFD, FD_CLOEXEC);
+  fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+
+#ifdef SO_NOSIGPIPE
+  int one = 1;
+  setsockopt(fd, SOL_SOCKET, SO_NOSIGPIPE, &one, sizeof one);
+#endif
+
+  *conn = (os_net_sock_t)(intptr_t)fd;
+  return TM_NET_STATUS_OK;
+}
+
+net_status_t posix_net_send(os_net_sock_t sock,
+                            const void   *buf,
+                            size_t        len,
+                            size_t       *sent) {
+  ssize_t ret = send((int)(intptr_t)sock, buf, len, SEND_FLAGS);
+
+  if (0 <= ret) {
+    *sent = (size_t)ret;
+    return TM_NET_STATUS_OK;
+  }
+
+  if (EAGAIN == errno || EWOULDBLOCK == errno || EINTR == errno) {
+    return TM_NET_STATUS_AGAIN;
+  }
+
+  return (EPIPE == errno || ECONNRESET == errno) ? TM_NET_STATUS_CLOSED
+                                                 : TM_NET_STATUS_ERR;
+}
+
+net_status_t posix_net_recv(os_net_sock_t sock,
+                            void         *buf,
+                            size_t        len,
+                            size_t       *received) {
+  ssize_t ret = recv((int)(intptr_t)sock, buf, len, 0);
+
+  if (0 < ret) {
+    *received = (size_t)ret;
+    return TM_NET_STATUS_OK;
+  }
+
+  if (0 == ret) {
+    return TM_NET_STATUS_CLOSED;
+  }
+
+  if (EAGAIN == errno || EWOULDBLOCK == errno || EINTR == errno) {
+    return TM_NET_STATUS_AGAIN;
+  }
+
+  return (ECONNRESET == errno) ? TM_NET_STATUS_CLOSED : TM_NET_STATUS_ERR;
+}
+
+void posix_net_close(os_net_sock_t sock) {
+  close((int)(intptr_t)sock);
+}
+
+int posix_net_fd(os_net_sock_t sock) {
+  return (int)(intptr_t)sock;
+}
+
+bool posix_net_poller_create(os_net_poller_t *poller) {
+  poller_t *handle = (poller_t *)calloc(1, sizeof(poller_t));
+
+  if (NULL == handle) {
+    return false;
+  }
+
+  *poller = handle;
+  return true;
+}
+
+bool posix_net_poller_watch(os_net_poller_t poller,
+                            os_net_sock_t   sock,
+                            unsigned int    events,
+                            void           *data) {
+  poller_t *handle = (poller_t *)poller;
+  int       fd     = posix_net_fd(sock);
+  short     mask   = 0;
+  size_t    i      = 0;
+
+  mask |= (TM_NET_EVENT_READ & events) ? POLLIN : 0;
+  mask |= (TM_NET_EVENT_WRITE & events) ? POLLOUT : 0;
+
+  for (; i < handle->count && fd != handle->fds[i].fd; i++)
+    ;
+
+  if (i == handle->cap) {
+    handle->cap  = (0 == handle->cap) ? 16 : handle->cap * 2;
+    handle->fds  = (struct pollfd *)realloc(handle->fds,
+                                           handle->cap * sizeof(struct pollfd));
+    handle->data = (void **)realloc(handle->data, handle->cap * sizeof(void *));
+    mem_chkoom(handle->fds);
+    mem_chkoom(handle->data);
+  }
+
+  if (i == handle->count) {
+    handle->count++;
+  }
+
+  handle->fds[i]  = (struct pollfd){.fd = fd, .events = mask};
+  handle->data[i] = data;
+  return true;
+}
+
+void posix_net_poller_unwatch(os_net_poller_t poller, os_net_sock_t sock) {
+  poller_t *handle = (poller_t *)poller;
+  int       fd     = posix_net_fd(sock);
+
+  for (size_t i = 0; i < handle->count; i++) {
+    if (fd == handle->fds[i].fd) {
+      handle->count--;
+      handle->fds[i]  = handle->fds[handle->count];
+      handle->data[i] = handle->data[handle->count];
+      return;
+    }
+  }
+}
+
+size_t posix_net_poller_wait(os_net_poller_t poller,
+                             net_event_t    *events,
+                             size_t          max_events,
+                             int             timeout_ms) {
+  poller_t *handle = (poller_t *)poller;
+  size_t    num    = 0;
+
+  if (0 >= poll(handle->fds, handle->count, timeout_ms)) {
+    return 0;
+  }
+
+  for (size_t i = 0; i < handle->count && num < max_events; i++) {
+    short        revents = handle->fds[i].revents;
+    unsigned int mask    = 0;
+
+    mask |= (POLLIN & revents) ? TM_NET_EVENT_READ : 0;
+    mask |= (POLLOUT & revents) ? TM_NET_EVENT_WRITE : 0;
+    mask |= ((POLLERR | POLLHUP | POLLNVAL) & revents) ? TM_NET_EVENT_ERROR : 0;
+
+    if (0 != mask) {
+      events[num] = (net_event_t){.data = handle->data[i], .events = mask};
+      num++;
+    }
+  }
+
+  return num;
+}
+
+void posix_net_poller_destroy(os_net_poller_t poller) {
+  poller_t *handle = (poller_t *)poller;
+  mem_safe_free(handle->fds);
+  mem_safe_free(handle->data);
+  mem_safe_free(handle);
+}
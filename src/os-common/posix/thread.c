@@ -0,0 +1,149 @@
+/*************************************************************************
+| tarman                                                                 |
+| Copyright (C) 2024 Alessandro Salerno                                  |
+|                                                                        |
+| This program is free software: you can redistribute it and/or modify   |
+| it under the terms of the GNU General Public License as published by   |
+| the Free Software Foundation, either version 3 of the License, or      |
+| (at your option) any later version.                                    |
+|                                                                        |
+| This program is distributed in the hope that it will be useful,        |
+| but WITHOUT ANY WARRANTY; without even the implied warranty of         |
+| MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the          |
+| GNU General Public License for more details.                           |
+|                                                                        |
+| You should have received a copy of the GNU General Public License      |
+| along with this program.  If not, see <https://www.gnu.org/licenses/>. |
+*************************************************************************/
+
+// MUST BE HERE
+#include <tm-os-defs.h>
+
+// Other includes
+#include <errno.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "os/posix/thread.h"
+#include "os/thread.h"
+
+bool posix_thread_create(os_thread_t *thread, os_thread_fcn_t fcn, void *arg) {
+  pthread_t *handle = (pthread_t *)malloc(sizeof(pthread_t));
+
+  if (NULL == handle) {
+    return false;
+  }
+
+  if (0 != pthread_create(handle, NULL, fcn, arg)) {
+    free(handle);
+    return false;
+  }
+
+  *thread = handle;
+  return true;
+}
+
+bool posix_thread_join(os_thread_t thread, void **ret) {
+  pthread_t *handle = (pthread_t *)thread;
+  bool       status = 0 == pthread_join(*handle, ret);
+
+  free(handle);
+  return status;
+}
+
+void posix_thread_yield(void) {
+  sched_yield();
+}
+
+void posix_thread_sleep(size_t ms) {
+  struct timespec req = {.tv_sec  = (time_t)(ms / 1000),
+                         .tv_nsec = (long)(ms % 1000) * 1000000L};
+
+  // The remaining time is written back to req when interrupted
+  while (0 != nanosleep(&req, &req) && EINTR == errno)
+    ;
+}
+
+// Milliseconds since an arbitrary point, unaffected by changes to the
+// system clock
+size_t posix_thread_clock(void) {
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return (size_t)now.tv_sec * 1000 + (size_t)now.tv_nsec / 1000000;
+}
+
+size_t posix_thread_hwcount(void) {
+  long count = sysconf(_SC_NPROCESSORS_ONLN);
+
+  if (1 > count) {
+    return 1;
+  }
+
+  return (size_t)count;
+}
+
+bool posix_mutex_create(os_mutex_t *mutex) {
+  pthread_mutex_t *handle = (pthread_mutex_t *)malloc(sizeof(pthread_mutex_t));
+
+  if (NULL == handle) {
+    return false;
+  }
+
+  if (0 != pthread_mutex_init(handle, NULL)) {
+    free(handle);
+    return false;
+  }
+
+  *mutex = handle;
+  return true;
+}
+
+void posix_mutex_lock(os_mutex_t mutex) {
+  pthread_mutex_lock((pthread_mutex_t *)mutex);
+}
+
+void posix_mutex_unlock(os_mutex_t mutex) {
+  pthread_mutex_unlock((pthread_mutex_t *)mutex);
+}
+
+void posix_mutex_destroy(os_mutex_t mutex) {
+  pthread_mutex_destroy((pthread_mutex_t *)mutex);
+  free(mutex);
+}
+
+bool posix_cond_create(os_cond_t *cond) {
+  pthread_cond_t *handle = (pthread_cond_t *)malloc(sizeof(pthread_cond_t));
+
+  if (NULL == handle) {
+    return false;
+  }
+
+  if (0 != pthread_cond_init(handle, NULL)) {
+    free(handle);
+    return false;
+  }
+
+  *cond = handle;
+  return true;
+}
+
+void posix_cond_wait(os_cond_t cond, os_mutex_t mutex) {
+  pthread_cond_wait((pthread_cond_t *)cond, (pthread_mutex_t *)mutex);
+}
+
+void posix_cond_signal(os_cond_t cond) {
+  pthread_cond_signal((pthread_cond_t *)cond);
+}
+
+void posix_cond_broadcast(os_cond_t cond) {
+  pthread_cond_broadcast((pthread_cond_t *)cond);
+}
+
+void posix_cond_destroy(os_cond_t cond) {
+  pthread_cond_destroy((pthread_cond_t *)cond);
+  free(cond);
+}
@@ -47,3 +47,7 @@ bool os_env_desktop_rm(const char *app_name) {
   (void)app_name;
   return false;
 }
+
+bool os_env_set(const char *name, const char *value) {
+  return posix_env_set(name, value);
+}
@@ -17,6 +17,9 @@
 *************************************************************************/
 
 #include <stdarg.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <sys/resource.h>
 
 #include "os/exec.h"
 #include "os/posix/exec.h"
@@ -32,3 +35,96 @@ int os_exec(const char *executable, ...) {
   va_end(args);
   return ret;
 }
+
+bool os_exec_vpipe(os_proc_t  *proc,
+                   FILE      **out,
+                   const char *executable,
+                   va_list     args) {
+  return posix_exec_vpipe(proc, out, executable, args);
+}
+
+bool os_exec_pipe(os_proc_t *proc, FILE **out, const char *executable, ...) {
+  va_list args;
+  va_start(args, executable);
+  bool ret = os_exec_vpipe(proc, out, executable, args);
+  va_end(args);
+  return ret;
+}
+
+bool os_exec_vpipe_from(os_proc_t  *proc,
+                        FILE      **out,
+                        FILE       *in,
+                        const char *executable,
+                        va_list     args) {
+  return posix_exec_vpipe_from(proc, out, in, executable, args);
+}
+
+bool os_exec_pipe_from(
+    os_proc_t *proc, FILE **out, FILE *in, const char *executable, ...) {
+  va_list args;
+  va_start(args, executable);
+  bool ret = os_exec_vpipe_from(proc, out, in, executable, args);
+  va_end(args);
+  return ret;
+}
+
+bool os_exec_vpipe_to(os_proc_t  *proc,
+                      FILE      **in,
+                      FILE       *out,
+                      const char *executable,
+                      va_list     args) {
+  return posix_exec_vpipe_to(proc, in, out, executable, args);
+}
+
+bool os_exec_pipe_to(
+    os_proc_t *proc, FILE **in, FILE *out, const char *executable, ...) {
+  va_list args;
+  va_start(args, executable);
+  bool ret = os_exec_vpipe_to(proc, in, out, executable, args);
+  va_end(args);
+  return ret;
+}
+
+bool os_exec_vspawn(os_proc_t *proc, const char *executable, va_list args) {
+  return posix_exec_vspawn(proc, executable, args);
+}
+
+bool os_exec_spawn(os_proc_t *proc, const char *executable, ...) {
+  va_list args;
+  va_start(args, executable);
+  bool ret = os_exec_vspawn(proc, executable, args);
+  va_end(args);
+  return ret;
+}
+
+bool os_exec_fork(os_proc_t   *proc,
+                  FILE        *out,
+                  os_exec_fn_t function,
+                  int          argc,
+                  char        *argv[]) {
+  return posix_exec_fork(proc, out, function, argc, argv);
+}
+
+int os_exec_wait(os_proc_t proc) {
+  return posix_exec_wait(proc);
+}
+
+bool os_exec_poll(os_proc_t proc, int *status) {
+  return posix_exec_poll(proc, status);
+}
+
+void os_exec_kill(os_proc_t proc) {
+  posix_exec_kill(proc);
+}
+
+bool os_exec_exists(const char *executable) {
+  return posix_exec_exists(executable);
+}
+
+// Throttled disk I/O is the closest macOS has to an idle class
+bool os_exec_idle_priority(void) {
+  bool ret = posix_exec_idle_priority();
+  return 0 == setiopolicy_np(
+                  IOPOL_TYPE_DISK, IOPOL_SCOPE_PROCESS, IOPOL_THROTTLE) &&
+         ret;
+}
@@ -16,6 +16,9 @@
 | along with this program.  If not, see <https://www.gnu.org/licenses/>. |
 *************************************************************************/
 
+#include <fcntl.h>
+#include <stdio.h>
+
 #include "os/fs.h"
 
 #include "os/posix/fs.h"
@@ -44,14 +47,94 @@ fs_dirop_status_t os_fs_dir_next(os_fs_dirstream_t stream, fs_dirent_t *ent) {
   return posix_fs_dir_next(stream, ent);
 }
 
+fs_dirop_status_t os_fs_dir_mv(const char *dst, const char *src) {
+  return posix_fs_dir_mv(dst, src);
+}
+
 fs_fileop_status_t os_fs_file_rm(const char *path) {
   return posix_fs_file_rm(path);
 }
 
+fs_fileop_status_t os_fs_file_mv(const char *dst, const char *src) {
+  return posix_fs_file_mv(dst, src);
+}
+
 fs_fileop_status_t os_fs_file_gettype(fs_filetype_t *dst, const char *path) {
   return posix_fs_file_gettype(dst, path);
 }
 
+fs_fileop_status_t os_fs_file_getinfo(fs_fileinfo_t *dst, const char *path) {
+  return posix_fs_file_getinfo(dst, path);
+}
+
+fs_fileop_status_t os_fs_file_fgetinfo(fs_fileinfo_t *dst, FILE *file) {
+  return posix_fs_file_fgetinfo(dst, file);
+}
+
+fs_fileop_status_t os_fs_file_create(os_fs_filestream_t *stream,
+                                     const char         *path,
+                                     unsigned int        mode) {
+  return posix_fs_file_create(stream, path, mode);
+}
+
+fs_fileop_status_t
+os_fs_file_write(os_fs_filestream_t stream, const void *buf, size_t len) {
+  return posix_fs_file_write(stream, buf, len);
+}
+
+fs_fileop_status_t os_fs_file_reserve(os_fs_filestream_t stream, size_t size) {
+  fstore_t store = {.fst_flags   = F_ALLOCATEALL,
+                    .fst_posmode = F_PEOFPOSMODE,
+                    .fst_offset  = 0,
+                    .fst_length  = (off_t)size};
+
+  if (-1 == fcntl(posix_fs_file_getfd(stream), F_PREALLOCATE, &store)) {
+    return TM_FS_FILEOP_STATUS_ERR;
+  }
+
+  return TM_FS_FILEOP_STATUS_OK;
+}
+
+fs_fileop_status_t
+os_fs_file_copy(os_fs_filestream_t stream, FILE *src, size_t len) {
+  return posix_fs_file_copy(stream, src, len);
+}
+
+fs_fileop_status_t os_fs_file_close(os_fs_filestream_t stream) {
+  return posix_fs_file_close(stream);
+}
+
+fs_fileop_status_t os_fs_file_link(const char *dst, const char *target) {
+  return posix_fs_file_link(dst, target);
+}
+
+fs_fileop_status_t os_fs_file_symlink(const char *dst, const char *target) {
+  return posix_fs_file_symlink(dst, target);
+}
+
+fs_fileop_status_t os_fs_file_chmod(const char *path, unsigned int mode) {
+  return posix_fs_file_chmod(path, mode);
+}
+
+fs_fileop_status_t os_fs_file_dyreadlink(char **dst, const char *path) {
+  return posix_fs_file_dyreadlink(dst, path);
+}
+
+fs_fileop_status_t os_fs_file_lock(os_fs_filestream_t *lock,
+                                   const char         *path,
+                                   bool                exclusive,
+                                   bool                wait) {
+  return posix_fs_file_lock(lock, path, exclusive, wait);
+}
+
+fs_fileop_status_t os_fs_file_unlock(os_fs_filestream_t lock) {
+  return posix_fs_file_unlock(lock);
+}
+
+fs_fileop_status_t os_fs_sync(const char *path) {
+  return posix_fs_sync(path);
+}
+
 size_t os_fs_path_vlen(size_t num_args, va_list args) {
   return posix_fs_path_vlen(num_args, args);
 }
@@ -126,15 +209,45 @@ size_t os_fs_tm_dypkg(char **dst, const char *pkg_name) {
   return posix_fs_tm_dypkg(dst, pkg_name);
 }
 
+size_t os_fs_tm_dypkgdir(char **dst, const char *pkg_name) {
+  return posix_fs_tm_dypkgdir(dst, pkg_name);
+}
+
+size_t os_fs_tm_dypkgver(char **dst, const char *pkg_name, size_t version) {
+  return posix_fs_tm_dypkgver(dst, pkg_name, version);
+}
+
 size_t os_fs_tm_dycached(char **dst, const char *item_name) {
   return posix_fs_tm_dycached(dst, item_name);
 }
 
+size_t os_fs_tm_dytmpfile(char **dst, const char *name, const char *ext) {
+  return posix_fs_tm_dytmpfile(dst, name, ext);
+}
+
+size_t os_fs_tm_dylock(char **dst, const char *lock_name) {
+  return posix_fs_tm_dylock(dst, lock_name);
+}
+
+size_t os_fs_tm_dyconfig(char **dst) {
+  return posix_fs_tm_dyconfig(dst);
+}
+
 size_t
 os_fs_tm_dyrecipe(char **dst, const char *repo_name, const char *pkg_name) {
   return posix_fs_tm_dyrecipe(dst, repo_name, pkg_name);
 }
 
+size_t os_fs_tm_dyarchive(char      **dst,
+                          const char *pkg_name,
+                          const char *pkg_fmt) {
+  return posix_fs_tm_dyarchive(dst, pkg_name, pkg_fmt);
+}
+
+size_t os_fs_tm_dyfetched(char **dst, const char *key, const char *pkg_fmt) {
+  return posix_fs_tm_dyfetched(dst, key, pkg_fmt);
+}
+
 size_t os_fs_tm_dyplugins(const char **dst) {
   return posix_fs_tm_dyplugins(dst);
 }
@@ -0,0 +1,91 @@
+/*************************************************************************
+| tarman                                                                 |
+| Copyright (C) 2024 Alessandro Salerno                                  |
+|                                                                        |
+| This program is free software: you can redistribute it and/or modify   |
+| it under the terms of the GNU General Public License as published by   |
+| the Free Software Foundation, either version 3 of the License, or      |
+| (at your option) any later version.                                    |
+|                                                                        |
+| This program is distributed in the hope that it will be useful,        |
+| but WITHOUT ANY WARRANTY; without even the implied warranty of         |
+| MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the          |
+| GNU General Public License for more details.                           |
+|                                                                        |
+| You should have received a copy of the GNU General Public License      |
+| along with this program.  If not, see <https://www.gnu.org/licenses/>. |
+*************************************************************************/
+
+
+#include <stdbool.h>
+#include <stdlib.h>
+
+#include "os/net.h"
+#include "os/posix/net.h"
+
+bool os_net_connect_start(os_net_attempt_t *attempt,
+                          os_net_sock_t    *sock,
+                          const char       *host,
+                          const char       *port) {
+  return posix_net_connect_start(attempt, sock, host, port);
+}
+
+net_status_t os_net_connect_finish(os_net_attempt_t attempt,
+                                   os_net_sock_t   *sock,
+                                   bool             timed_out) {
+  return posix_net_connect_finish(attempt, sock, timed_out);
+}
+
+void os_net_connect_abort(os_net_attempt_t attempt) {
+  posix_net_connect_abort(attempt);
+}
+
+bool os_net_listen(os_net_sock_t *sock, const char *host, const char *port) {
+  return posix_net_listen(sock, host, port);
+}
+
+net_status_t os_net_accept(os_net_sock_t listener, os_net_sock_t *conn) {
+  return posix_net_accept(listener, conn);
+}
+
+net_status_t os_net_send(os_net_sock_t sock,
+                         const void   *buf,
+                         size_t        len,
+                         size_t       *sent) {
+  return posix_net_send(sock, buf, len, sent);
+}
+
+net_status_t
+os_net_recv(os_net_sock_t sock, void *buf, size_t len, size_t *received) {
+  return posix_net_recv(sock, buf, len, received);
+}
+
+void os_net_close(os_net_sock_t sock) {
+  posix_net_close(sock);
+}
+
+bool os_net_poller_create(os_net_poller_t *poller) {
+  return posix_net_poller_create(poller);
+}
+
+bool os_net_poller_watch(os_net_poller_t poller,
+                         os_net_sock_t   sock,
+                         unsigned int    events,
+                         void           *data) {
+  return posix_net_poller_watch(poller, sock, events, data);
+}
+
+void os_net_poller_unwatch(os_net_poller_t poller, os_net_sock_t sock) {
+  posix_net_poller_unwatch(poller, sock);
+}
+
+size_t os_net_poller_wait(os_net_poller_t poller,
+                          net_event_t    *events,
+                          size_t          max_events,
+                          int             timeout_ms) {
+  return posix_net_poller_wait(poller, events, max_events, timeout_ms);
+}
+
+void os_net_poller_destroy(os_net_poller_t poller) {
+  posix_net_poller_destroy(poller);
+}
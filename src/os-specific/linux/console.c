@@ -27,3 +27,7 @@ csz_t os_console_get_sz(void) {
 void os_console_set_color(color_t color, bool bold) {
   posix_console_set_color(color, bold);
 }
+
+FILE *os_console_detach_stdout(void) {
+  return posix_console_detach_stdout();
+}
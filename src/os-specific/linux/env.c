@@ -16,7 +16,6 @@
 | along with this program.  If not, see <https://www.gnu.org/licenses/>. |
 *************************************************************************/
 
-#include <pwd.h>
 #include <stdbool.h>
 #include <stdio.h>
 #include <string.h>
@@ -26,11 +25,6 @@
 #include "os/posix/env.h"
 #include "tm-mem.h"
 
-static const char *get_home_directory(void) {
-  struct passwd *pw = getpwuid(getuid());
-  return pw->pw_dir;
-}
-
 bool os_env_path_add(const char *executable) {
   return posix_env_path_add(executable);
 }
@@ -47,9 +41,13 @@ bool os_env_desktop_add(const char *app_name,
     return false;
   }
 
-  const char *usr_home      = get_home_directory();
+  const char *usr_home      = posix_env_home();
   const char *app_file_path = NULL;
 
+  if (NULL == usr_home) {
+    return false;
+  }
+
   size_t app_bufflen   = strlen(app_name) + 1 + strlen("desktop") + 1;
   char  *app_file_name = (char *)malloc(app_bufflen * sizeof(char));
   mem_chkoom(app_file_name);
@@ -107,9 +105,13 @@ bool os_env_desktop_rm(const char *app_name) {
     return false;
   }
 
-  const char *usr_home      = get_home_directory();
+  const char *usr_home      = posix_env_home();
   const char *app_file_path = NULL;
 
+  if (NULL == usr_home) {
+    return false;
+  }
+
   size_t app_bufflen   = strlen(app_name) + 1 + strlen("desktop") + 1;
   char  *app_file_name = (char *)malloc(app_bufflen * sizeof(char));
   mem_chkoom(app_file_name);
@@ -131,3 +133,7 @@ bool os_env_desktop_rm(const char *app_name) {
   mem_safe_free(app_file_path);
   return TM_FS_FILEOP_STATUS_OK == rm_status;
 }
+
+bool os_env_set(const char *name, const char *value) {
+  return posix_env_set(name, value);
+}
@@ -16,11 +16,24 @@
 | along with this program.  If not, see <https://www.gnu.org/licenses/>. |
 *************************************************************************/
 
+// MUST BE HERE
+#include <tm-os-defs.h>
+
+// Other includes
 #include <stdarg.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <sys/syscall.h>
+#include <unistd.h>
 
 #include "os/exec.h"
 #include "os/posix/exec.h"
 
+// From linux/ioprio.h, which is not always installed
+#define IOPRIO_CLASS_IDLE  3
+#define IOPRIO_CLASS_SHIFT 13
+#define IOPRIO_WHO_PROCESS 1
+
 int os_vexec(const char *executable, va_list args) {
   return posix_vexec(executable, args);
 }
@@ -32,3 +45,99 @@ int os_exec(const char *executable, ...) {
   va_end(args);
   return ret;
 }
+
+bool os_exec_vpipe(os_proc_t  *proc,
+                   FILE      **out,
+                   const char *executable,
+                   va_list     args) {
+  return posix_exec_vpipe(proc, out, executable, args);
+}
+
+bool os_exec_pipe(os_proc_t *proc, FILE **out, const char *executable, ...) {
+  va_list args;
+  va_start(args, executable);
+  bool ret = os_exec_vpipe(proc, out, executable, args);
+  va_end(args);
+  return ret;
+}
+
+bool os_exec_vpipe_from(os_proc_t  *proc,
+                        FILE      **out,
+                        FILE       *in,
+                        const char *executable,
+                        va_list     args) {
+  return posix_exec_vpipe_from(proc, out, in, executable, args);
+}
+
+bool os_exec_pipe_from(
+    os_proc_t *proc, FILE **out, FILE *in, const char *executable, ...) {
+  va_list args;
+  va_start(args, executable);
+  bool ret = os_exec_vpipe_from(proc, out, in, executable, args);
+  va_end(args);
+  return ret;
+}
+
+bool os_exec_vpipe_to(os_proc_t  *proc,
+                      FILE      **in,
+                      FILE       *out,
+                      const char *executable,
+                      va_list     args) {
+  return posix_exec_vpipe_to(proc, in, out, executable, args);
+}
+
+bool os_exec_pipe_to(
+    os_proc_t *proc, FILE **in, FILE *out, const char *executable, ...) {
+  va_list args;
+  va_start(args, executable);
+  bool ret = os_exec_vpipe_to(proc, in, out, executable, args);
+  va_end(args);
+  return ret;
+}
+
+bool os_exec_vspawn(os_proc_t *proc, const char *executable, va_list args) {
+  return posix_exec_vspawn(proc, executable, args);
+}
+
+bool os_exec_spawn(os_proc_t *proc, const char *executable, ...) {
+  va_list args;
+  va_start(args, executable);
+  bool ret = os_exec_vspawn(proc, executable, args);
+  va_end(args);
+  return ret;
+}
+
+bool os_exec_fork(os_proc_t   *proc,
+                  FILE        *out,
+                  os_exec_fn_t function,
+                  int          argc,
+                  char        *argv[]) {
+  return posix_exec_fork(proc, out, function, argc, argv);
+}
+
+int os_exec_wait(os_proc_t proc) {
+  return posix_exec_wait(proc);
+}
+
+bool os_exec_poll(os_proc_t proc, int *status) {
+  return posix_exec_poll(proc, status);
+}
+
+void os_exec_kill(os_proc_t proc) {
+  posix_exec_kill(proc);
+}
+
+bool os_exec_exists(const char *executable) {
+  return posix_exec_exists(executable);
+}
+
+// Both are per-thread on Linux, so they apply to the calling thread
+// and to the processes it starts afterwards (e.g., decompressors)
+bool os_exec_idle_priority(void) {
+  bool ret = posix_exec_idle_priority();
+  return 0 == syscall(SYS_ioprio_set,
+                      IOPRIO_WHO_PROCESS,
+                      0,
+                      IOPRIO_CLASS_IDLE << IOPRIO_CLASS_SHIFT) &&
+         ret;
+}
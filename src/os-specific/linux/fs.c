@@ -16,6 +16,15 @@
 | along with this program.  If not, see <https://www.gnu.org/licenses/>. |
 *************************************************************************/
 
+// Needed for fallocate, copy_file_range and syncfs
+#define _GNU_SOURCE
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <sys/types.h>
+#include <unistd.h>
+
 #include "os/posix/fs.h"
 
 #include "os/fs.h"
@@ -44,14 +53,128 @@ fs_dirop_status_t os_fs_dir_next(os_fs_dirstream_t stream, fs_dirent_t *ent) {
   return posix_fs_dir_next(stream, ent);
 }
 
+fs_dirop_status_t os_fs_dir_mv(const char *dst, const char *src) {
+  return posix_fs_dir_mv(dst, src);
+}
+
 fs_fileop_status_t os_fs_file_rm(const char *path) {
   return posix_fs_file_rm(path);
 }
 
+fs_fileop_status_t os_fs_file_mv(const char *dst, const char *src) {
+  return posix_fs_file_mv(dst, src);
+}
+
 fs_fileop_status_t os_fs_file_gettype(fs_filetype_t *dst, const char *path) {
   return posix_fs_file_gettype(dst, path);
 }
 
+fs_fileop_status_t os_fs_file_getinfo(fs_fileinfo_t *dst, const char *path) {
+  return posix_fs_file_getinfo(dst, path);
+}
+
+fs_fileop_status_t os_fs_file_fgetinfo(fs_fileinfo_t *dst, FILE *file) {
+  return posix_fs_file_fgetinfo(dst, file);
+}
+
+fs_fileop_status_t os_fs_file_create(os_fs_filestream_t *stream,
+                                     const char         *path,
+                                     unsigned int        mode) {
+  return posix_fs_file_create(stream, path, mode);
+}
+
+fs_fileop_status_t
+os_fs_file_write(os_fs_filestream_t stream, const void *buf, size_t len) {
+  return posix_fs_file_write(stream, buf, len);
+}
+
+// Space is reserved without changing the file size, so a failed or
+// partial extraction does not leave zero-filled tails behind
+fs_fileop_status_t os_fs_file_reserve(os_fs_filestream_t stream, size_t size) {
+  if (0 != fallocate(
+               posix_fs_file_getfd(stream), FALLOC_FL_KEEP_SIZE, 0, size)) {
+    return TM_FS_FILEOP_STATUS_ERR;
+  }
+
+  return TM_FS_FILEOP_STATUS_OK;
+}
+
+// When src is a regular file, data is copied by the kernel (possibly
+// sharing extents on CoW file systems) instead of going through user space
+fs_fileop_status_t
+os_fs_file_copy(os_fs_filestream_t stream, FILE *src, size_t len) {
+  off_t offset = ftello(src);
+
+  if (0 > offset) {
+    return posix_fs_file_copy(stream, src, len);
+  }
+
+  while (0 != len) {
+    ssize_t copied = copy_file_range(
+        fileno(src), &offset, posix_fs_file_getfd(stream), NULL, len, 0);
+
+    if (0 >= copied) {
+      break;
+    }
+
+    len -= (size_t)copied;
+  }
+
+  // ftello accounts for data buffered by src, so seeking to the
+  // new offset keeps the stream consistent
+  if (0 != fseeko(src, offset, SEEK_SET)) {
+    return TM_FS_FILEOP_STATUS_ERR;
+  }
+
+  return posix_fs_file_copy(stream, src, len);
+}
+
+fs_fileop_status_t os_fs_file_close(os_fs_filestream_t stream) {
+  return posix_fs_file_close(stream);
+}
+
+fs_fileop_status_t os_fs_file_link(const char *dst, const char *target) {
+  return posix_fs_file_link(dst, target);
+}
+
+fs_fileop_status_t os_fs_file_symlink(const char *dst, const char *target) {
+  return posix_fs_file_symlink(dst, target);
+}
+
+fs_fileop_status_t os_fs_file_chmod(const char *path, unsigned int mode) {
+  return posix_fs_file_chmod(path, mode);
+}
+
+fs_fileop_status_t os_fs_file_dyreadlink(char **dst, const char *path) {
+  return posix_fs_file_dyreadlink(dst, path);
+}
+
+fs_fileop_status_t os_fs_file_lock(os_fs_filestream_t *lock,
+                                   const char         *path,
+                                   bool                exclusive,
+                                   bool                wait) {
+  return posix_fs_file_lock(lock, path, exclusive, wait);
+}
+
+fs_fileop_status_t os_fs_file_unlock(os_fs_filestream_t lock) {
+  return posix_fs_file_unlock(lock);
+}
+
+// Flushes the whole file system containing path with a single call,
+// which is far cheaper than calling fsync on every extracted file
+fs_fileop_status_t os_fs_sync(const char *path) {
+  int fd = open(path, O_RDONLY | O_CLOEXEC);
+
+  if (0 > fd) {
+    return (ENOENT == errno) ? TM_FS_FILEOP_STATUS_NOEXIST
+                             : TM_FS_FILEOP_STATUS_ERR;
+  }
+
+  int ret = syncfs(fd);
+  close(fd);
+  return (0 == ret) ? TM_FS_FILEOP_STATUS_OK : TM_FS_FILEOP_STATUS_ERR;
+}
+
 size_t os_fs_path_vlen(size_t num_args, va_list args) {
   return posix_fs_path_vlen(num_args, args);
 }
@@ -126,15 +249,45 @@ size_t os_fs_tm_dypkg(char **dst, const char *pkg_name) {
   return posix_fs_tm_dypkg(dst, pkg_name);
 }
 
+size_t os_fs_tm_dypkgdir(char **dst, const char *pkg_name) {
+  return posix_fs_tm_dypkgdir(dst, pkg_name);
+}
+
+size_t os_fs_tm_dypkgver(char **dst, const char *pkg_name, size_t version) {
+  return posix_fs_tm_dypkgver(dst, pkg_name, version);
+}
+
 size_t os_fs_tm_dycached(char **dst, const char *item_name) {
   return posix_fs_tm_dycached(dst, item_name);
 }
 
+size_t os_fs_tm_dytmpfile(char **dst, const char *name, const char *ext) {
+  return posix_fs_tm_dytmpfile(dst, name, ext);
+}
+
+size_t os_fs_tm_dylock(char **dst, const char *lock_name) {
+  return posix_fs_tm_dylock(dst, lock_name);
+}
+
+size_t os_fs_tm_dyconfig(char **dst) {
+  return posix_fs_tm_dyconfig(dst);
+}
+
 size_t
 os_fs_tm_dyrecipe(char **dst, const char *repo_name, const char *pkg_name) {
   return posix_fs_tm_dyrecipe(dst, repo_name, pkg_name);
 }
 
+size_t os_fs_tm_dyarchive(char      **dst,
+                          const char *pkg_name,
+                          const char *pkg_fmt) {
+  return posix_fs_tm_dyarchive(dst, pkg_name, pkg_fmt);
+}
+
+size_t os_fs_tm_dyfetched(char **dst, const char *key, const char *pkg_fmt) {
+  return posix_fs_tm_dyfetched(dst, key, pkg_fmt);
+}
+
 size_t os_fs_tm_dyplugins(const char **dst) {
   return posix_fs_tm_dyplugins(dst);
 }
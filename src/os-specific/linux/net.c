@@ -0,0 +1,141 @@
+/*************************************************************************
+| tarman                                                                 |
+| Copyright (C) 2024 Alessandro Salerno                                  |
+|                                                                        |
+| This program is free software: you can redistribute it and/or modify   |
+| it under the terms of the GNU General Public License as published by   |
+| the Free Software Foundation, either version 3 of the License, or      |
+| (at your option) any later version.                                    |
+|                                                                        |
+| This program is distributed in the hope that it will be useful,        |
+| but WITHOUT ANY WARRANTY; without even the implied warranty of         |
+| MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the          |
+| GNU General Public License for more details.                           |
+|                                                                        |
+| You should have received a copy of the GNU General Public License      |
+| along with this program.  If not, see <https://www.gnu.org/licenses/>. |
+*************************************************************************/
+
+
+// MUST BE HERE
+#include <tm-os-defs.h>
+
+// Other includes
+#include <errno.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <sys/epoll.h>
+#include <unistd.h>
+
+#include "os/net.h"
+#include "os/posix/net.h"
+
+// Upper bound on the number of events fetched by each call to epoll_wait
+#define MAX_BATCH 64
+
+bool os_net_connect_start(os_net_attempt_t *attempt,
+                          os_net_sock_t    *sock,
+                          const char       *host,
+                          const char       *port) {
+  return posix_net_connect_start(attempt, sock, host, port);
+}
+
+net_status_t os_net_connect_finish(os_net_attempt_t attempt,
+                                   os_net_sock_t   *sock,
+                                   bool             timed_out) {
+  return posix_net_connect_finish(attempt, sock, timed_out);
+}
+
+void os_net_connect_abort(os_net_attempt_t attempt) {
+  posix_net_connect_abort(attempt);
+}
+
+bool os_net_listen(os_net_sock_t *sock, const char *host, const char *port) {
+  return posix_net_listen(sock, host, port);
+}
+
+net_status_t os_net_accept(os_net_sock_t listener, os_net_sock_t *conn) {
+  return posix_net_accept(listener, conn);
+}
+
+net_status_t os_net_send(os_net_sock_t sock,
+                         const void   *buf,
+                         size_t        len,
+                         size_t       *sent) {
+  return posix_net_send(sock, buf, len, sent);
+}
+
+net_status_t
+os_net_recv(os_net_sock_t sock, void *buf, size_t len, size_t *received) {
+  return posix_net_recv(sock, buf, len, received);
+}
+
+void os_net_close(os_net_sock_t sock) {
+  posix_net_close(sock);
+}
+
+// Unlike poll, epoll does not go through every socket on each wait,
+// which matters when many transfers are running at the same time
+bool os_net_poller_create(os_net_poller_t *poller) {
+  int fd = epoll_create1(EPOLL_CLOEXEC);
+
+  if (0 > fd) {
+    return false;
+  }
+
+  *poller = (os_net_poller_t)(intptr_t)fd;
+  return true;
+}
+
+bool os_net_poller_watch(os_net_poller_t poller,
+                         os_net_sock_t   sock,
+                         unsigned int    events,
+                         void           *data) {
+  int                epfd = (int)(intptr_t)poller;
+  int                fd   = posix_net_fd(sock);
+  struct epoll_event ev   = {0};
+
+  ev.events |= (TM_NET_EVENT_READ & events) ? EPOLLIN : 0;
+  ev.events |= (TM_NET_EVENT_WRITE & events) ? EPOLLOUT : 0;
+  ev.data.ptr = data;
+
+  if (0 == epoll_ctl(epfd, EPOLL_CTL_MOD, fd, &ev)) {
+    return true;
+  }
+
+  return ENOENT == errno && 0 == epoll_ctl(epfd, EPOLL_CTL_ADD, fd, &ev);
+}
+
+void os_net_poller_unwatch(os_net_poller_t poller, os_net_sock_t sock) {
+  struct epoll_event ev = {0};
+  epoll_ctl((int)(intptr_t)poller, EPOLL_CTL_DEL, posix_net_fd(sock), &ev);
+}
+
+size_t os_net_poller_wait(os_net_poller_t poller,
+                          net_event_t    *events,
+                          size_t          max_events,
+                          int             timeout_ms) {
+  struct epoll_event batch[MAX_BATCH];
+  int                max = (MAX_BATCH < max_events) ? MAX_BATCH : max_events;
+  int num = epoll_wait((int)(intptr_t)poller, batch, max, timeout_ms);
+
+  if (0 >= num) {
+    return 0;
+  }
+
+  for (int i = 0; i < num; i++) {
+    unsigned int mask = 0;
+
+    mask |= (EPOLLIN & batch[i].events) ? TM_NET_EVENT_READ : 0;
+    mask |= (EPOLLOUT & batch[i].events) ? TM_NET_EVENT_WRITE : 0;
+    mask |= ((EPOLLERR | EPOLLHUP) & batch[i].events) ? TM_NET_EVENT_ERROR : 0;
+    events[i] = (net_event_t){.data = batch[i].data.ptr, .events = mask};
+  }
+
+  return (size_t)num;
+}
+
+void os_net_poller_destroy(os_net_poller_t poller) {
+  close((int)(intptr_t)poller);
+}
@@ -0,0 +1,81 @@
+/*************************************************************************
+| tarman                                                                 |
+| Copyright (C) 2024 Alessandro Salerno                                  |
+|                                                                        |
+| This program is free software: you can redistribute it and/or modify   |
+| it under the terms of the GNU General Public License as published by   |
+| the Free Software Foundation, either version 3 of the License, or      |
+| (at your option) any later version.                                    |
+|                                                                        |
+| This program is distributed in the hope that it will be useful,        |
+| but WITHOUT ANY WARRANTY; without even the implied warranty of         |
+| MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the          |
+| GNU General Public License for more details.                           |
+|                                                                        |
+| You should have received a copy of the GNU General Public License      |
+| along with this program.  If not, see <https://www.gnu.org/licenses/>. |
+*************************************************************************/
+
+#include "os/posix/thread.h"
+
+#include "os/thread.h"
+
+bool os_thread_create(os_thread_t *thread, os_thread_fcn_t fcn, void *arg) {
+  return posix_thread_create(thread, fcn, arg);
+}
+
+bool os_thread_join(os_thread_t thread, void **ret) {
+  return posix_thread_join(thread, ret);
+}
+
+void os_thread_yield(void) {
+  posix_thread_yield();
+}
+
+void os_thread_sleep(size_t ms) {
+  posix_thread_sleep(ms);
+}
+
+size_t os_thread_clock(void) {
+  return posix_thread_clock();
+}
+
+size_t os_thread_hwcount(void) {
+  return posix_thread_hwcount();
+}
+
+bool os_mutex_create(os_mutex_t *mutex) {
+  return posix_mutex_create(mutex);
+}
+
+void os_mutex_lock(os_mutex_t mutex) {
+  posix_mutex_lock(mutex);
+}
+
+void os_mutex_unlock(os_mutex_t mutex) {
+  posix_mutex_unlock(mutex);
+}
+
+void os_mutex_destroy(os_mutex_t mutex) {
+  posix_mutex_destroy(mutex);
+}
+
+bool os_cond_create(os_cond_t *cond) {
+  return posix_cond_create(cond);
+}
+
+void os_cond_wait(os_cond_t cond, os_mutex_t mutex) {
+  posix_cond_wait(cond, mutex);
+}
+
+void os_cond_signal(os_cond_t cond) {
+  posix_cond_signal(cond);
+}
+
+void os_cond_broadcast(os_cond_t cond) {
+  posix_cond_broadcast(cond);
+}
+
+void os_cond_destroy(os_cond_t cond) {
+  posix_cond_destroy(cond);
+}
@@ -0,0 +1,140 @@
+#!/bin/sh
+# tarman
+# Copyright (C) 2024 Alessandro Salerno
+#
+# This program is free software: you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by
+# the Free Software Foundation, either version 3 of the License, or
+# (at your option) any later version.
+#
+# This program is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+#
+# You should have received a copy of the GNU General Public License
+# along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+
+# Checks that 'tarman bundle' exports installed packages with their
+# dependencies, that another tarman directory can import them without
+# network, and that damaged bundles are rejected.
+# Usage: sh tests/bundle.sh [<path to tarman>]
+
+. "$(dirname "$0")/lib.sh"
+
+# Another machine, which imports the bundles
+other() {
+  TARMAN_ROOT="$WORK/other" "$TARMAN" "$@" --headless
+}
+
+# Each package has a single file. The second argument is the DEPENDS line
+make_package() {
+  mkdir -p "$WORK/src/$1"
+  echo "This is package $1" >"$WORK/src/$1/$1.txt"
+  tar -cf "$WORK/$1.tar" -C "$WORK/src/$1" "$1.txt"
+  name=$(serve "$WORK/$1.tar" tar)
+
+  cat >"$WORK/repo/testrepo/$1.tarman" <<RECIPE
+URL=http://127.0.0.1:$PORT/$name
+PACKAGE_FORMAT=tar
+ARCHIVE_SHA256=$(sha256 "$WORK/$1.tar")
+EXECUTABLE_PATH=$1.txt
+ADD_TO_PATH=true
+VERSION=1
+DEPENDS=$2
+RECIPE
+}
+
+# Unpacks a bundle so that it can be changed, see repack
+unpack() {
+  rm -rf "$WORK/unpacked"
+  mkdir -p "$WORK/unpacked"
+  tar -xzf "$1" -C "$WORK/unpacked"
+}
+
+# The index has to come first
+repack() {
+  tar -czf "$1" -C "$WORK/unpacked" index.tarman pkgs
+}
+
+mkdir -p "$WORK/repo/testrepo"
+make_package lib ""
+make_package app "lib"
+make_package extra ""
+
+tar -czf "$WORK/repo.tar.gz" -C "$WORK/repo" testrepo
+REPO=$(serve "$WORK/repo.tar.gz" tar.gz)
+start_server
+
+expect_ok "add a repository" client add-repo "http://127.0.0.1:$PORT/$REPO"
+expect_ok "install the packages" client install -r app
+expect_ok "install another package" client install -r extra
+
+expect_ok "export a package" client bundle export "$WORK/app.bundle" app
+tar -xzOf "$WORK/app.bundle" index.tarman >"$WORK/index.tarman"
+expect_ok "the package is exported" grep -q "^PACKAGE=app" "$WORK/index.tarman"
+expect_ok "dependencies are exported too" \
+  grep -q "^PACKAGE=lib" "$WORK/index.tarman"
+expect_fail "other packages are not exported" \
+  grep -q "^PACKAGE=extra" "$WORK/index.tarman"
+expect_fail "missing packages cannot be exported" \
+  client bundle export "$WORK/none.bundle" nothere
+
+# Nothing is downloaded from here on
+kill "$SERVER" 2>/dev/null
+wait "$SERVER" 2>/dev/null
+SERVER=
+
+expect_ok "import a bundle" other bundle import "$WORK/app.bundle"
+
+for pkg in lib app; do
+  expect_ok "package $pkg is imported" \
+    cmp "$WORK/other/pkgs/$pkg/current/$pkg.txt" "$WORK/src/$pkg/$pkg.txt"
+  expect_ok "imported package $pkg is intact" other verify "$pkg"
+done
+
+expect_ok "imported packages are added to PATH" \
+  test -L "$WORK/other/path/app.txt"
+expect_ok "import a bundle again" other bundle import "$WORK/app.bundle"
+expect_ok "imports create new versions" \
+  test "$(readlink "$WORK/other/pkgs/app/current")" = 2
+
+expect_ok "export and import through a pipe" \
+  sh -c "TARMAN_ROOT='$WORK/client' '$TARMAN' bundle export - --all |
+    TARMAN_ROOT='$WORK/pipe' '$TARMAN' bundle import - --headless"
+
+for pkg in lib app extra; do
+  expect_ok "package $pkg is imported through a pipe" \
+    test -f "$WORK/pipe/pkgs/$pkg/current/$pkg.txt"
+done
+
+unpack "$WORK/app.bundle"
+echo "tampered" >>"$WORK/unpacked/pkgs/lib/lib.txt"
+repack "$WORK/tampered.bundle"
+expect_output "damaged packages are rejected" \
+  "Unable to install package 'lib' from the bundle" \
+  other bundle import "$WORK/tampered.bundle"
+expect_fail "imports with damaged packages fail" \
+  other bundle import "$WORK/tampered.bundle"
+expect_ok "damaged packages leave the active version alone" \
+  test "$(readlink "$WORK/other/pkgs/lib/current")" = 2
+
+unpack "$WORK/app.bundle"
+echo "PACKAGE=../escape" >>"$WORK/unpacked/index.tarman"
+repack "$WORK/badname.bundle"
+expect_output "invalid package names are rejected" "no valid index" \
+  other bundle import "$WORK/badname.bundle"
+
+unpack "$WORK/app.bundle"
+sed -i.bak 's/^FORMAT=.*/FORMAT=99/' "$WORK/unpacked/index.tarman"
+rm -f "$WORK/unpacked/index.tarman.bak"
+repack "$WORK/newer.bundle"
+expect_output "unknown formats are rejected" "no valid index" \
+  other bundle import "$WORK/newer.bundle"
+
+head -c 100 "$WORK/app.bundle" >"$WORK/truncated.bundle"
+expect_fail "truncated bundles are rejected" \
+  other bundle import "$WORK/truncated.bundle"
+
+exit $FAILED
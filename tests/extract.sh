@@ -0,0 +1,108 @@
+#!/bin/sh
+# tarman
+# Copyright (C) 2024 Alessandro Salerno
+#
+# This program is free software: you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by
+# the Free Software Foundation, either version 3 of the License, or
+# (at your option) any later version.
+#
+# This program is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+#
+# You should have received a copy of the GNU General Public License
+# along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+
+# Feeds hand-crafted archives to the built-in tar extractor, which must keep
+# every entry inside the package directory. PATH is emptied so that tarman
+# cannot fall back to the system's tar. Archives are crafted with GNU tar.
+# Usage: sh tests/extract.sh [<path to tarman>]
+
+. "$(dirname "$0")/lib.sh"
+
+TAR=$(command -v tar)
+OUTSIDE=$WORK/outside
+PKGS=$WORK/client/pkgs
+
+native() {
+  PATH=/nonexistent TARMAN_ROOT="$WORK/client" "$TARMAN" "$@" --headless
+}
+
+install_archive() {
+  native install "$WORK/$1.tar" -n "$1" -f tar -x program
+}
+
+mkdir -p "$WORK/src" "$OUTSIDE"
+echo "#!/bin/sh" >"$WORK/src/program"
+echo "payload" >"$WORK/src/payload"
+echo "secret" >"$OUTSIDE/secret"
+
+"$TAR" -cf "$WORK/plain.tar" -C "$WORK/src" program payload
+expect_ok "plain archives are extracted natively" install_archive plain
+expect_ok "extracted files are intact" \
+  cmp "$PKGS/plain/current/payload" "$WORK/src/payload"
+
+"$TAR" -cf "$WORK/dotdot.tar" -C "$WORK/src" program \
+  --transform "s,^payload,../../../../outside/dotdot," payload
+install_archive dotdot >/dev/null 2>&1
+expect_fail "entries cannot climb out with '..'" test -e "$OUTSIDE/dotdot"
+
+"$TAR" -cf "$WORK/absolute.tar" -P -C "$WORK/src" program \
+  --transform "s,^payload,$OUTSIDE/absolute," payload
+install_archive absolute >/dev/null 2>&1
+expect_fail "absolute entries stay inside" test -e "$OUTSIDE/absolute"
+
+# A symlink to the outside, then a file written through it
+mkdir -p "$WORK/symdir"
+cp "$WORK/src/program" "$WORK/src/payload" "$WORK/symdir"
+ln -s "$OUTSIDE" "$WORK/symdir/link"
+"$TAR" -cf "$WORK/symdir.tar" -C "$WORK/symdir" link program \
+  --transform "s,^payload,link/written," payload
+install_archive symdir >/dev/null 2>&1
+expect_fail "files are not written behind symlinks" \
+  test -e "$OUTSIDE/written"
+
+# A symlink to the outside, then a hard link to a file behind it. Only the
+# link target is renamed
+mkdir -p "$WORK/hardlink"
+cp "$WORK/src/program" "$WORK/hardlink"
+ln -s "$OUTSIDE" "$WORK/hardlink/link"
+echo "target" >"$WORK/hardlink/target"
+ln "$WORK/hardlink/target" "$WORK/hardlink/stolen"
+"$TAR" -cf "$WORK/hardlink.tar" -C "$WORK/hardlink" \
+  --transform "s,^target$,link/secret,RS" link program target stolen
+install_archive hardlink >/dev/null 2>&1
+expect_ok "hard links cannot reach files behind symlinks" \
+  cmp "$OUTSIDE/secret" /dev/stdin <<SECRET
+secret
+SECRET
+expect_fail "no hard link to the outside is created" \
+  test "$OUTSIDE/secret" -ef "$PKGS/hardlink/current/stolen"
+
+# The same file twice: the last entry wins, as with tar
+mkdir -p "$WORK/first" "$WORK/second"
+cp "$WORK/src/program" "$WORK/first"
+echo "first" >"$WORK/first/data"
+echo "second" >"$WORK/second/data"
+"$TAR" -cf "$WORK/duplicate.tar" -C "$WORK/first" program data
+"$TAR" -rf "$WORK/duplicate.tar" -C "$WORK/second" data
+expect_ok "archives with duplicate entries are extracted" \
+  install_archive duplicate
+expect_ok "the last of duplicate entries wins" \
+  cmp "$PKGS/duplicate/current/data" "$WORK/second/data"
+
+# A symlink to the outside, then a file with the same name
+mkdir -p "$WORK/relink"
+ln -s "$OUTSIDE/secret" "$WORK/relink/data"
+"$TAR" -cf "$WORK/relink.tar" -C "$WORK/relink" data
+"$TAR" -rf "$WORK/relink.tar" -C "$WORK/first" program data
+install_archive relink >/dev/null 2>&1
+expect_ok "files are not written through symlinks of the same name" \
+  cmp "$OUTSIDE/secret" /dev/stdin <<SECRET
+secret
+SECRET
+
+exit $FAILED
@@ -0,0 +1,76 @@
+#!/bin/sh
+# tarman
+# Copyright (C) 2024 Alessandro Salerno
+#
+# This program is free software: you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by
+# the Free Software Foundation, either version 3 of the License, or
+# (at your option) any later version.
+#
+# This program is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+#
+# You should have received a copy of the GNU General Public License
+# along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+# Runs the built-in HTTP client against a local server, so that no network
+# access is needed. The server is 'tarman serve-cache', which serves the
+# archives in its cache directory by name.
+# Usage: sh tests/http.sh [<path to tarman>]
+
+. "$(dirname "$0")/lib.sh"
+
+# Each package has a single file with different contents
+make_package() {
+  mkdir -p "$WORK/src/$1"
+  echo "This is package $1" >"$WORK/src/$1/$1.txt"
+  tar -cf "$WORK/$1.tar" -C "$WORK/src/$1" "$1.txt"
+  name=$(serve "$WORK/$1.tar" tar)
+
+  cat >"$WORK/repo/testrepo/$1.tarman" <<RECIPE
+URL=http://127.0.0.1:$PORT/$name
+PACKAGE_FORMAT=tar
+ARCHIVE_SHA256=$(sha256 "$WORK/$1.tar")
+EXECUTABLE_PATH=$1.txt
+VERSION=1
+RECIPE
+}
+
+mkdir -p "$WORK/repo/testrepo"
+
+for pkg in alpha beta gamma delta; do
+  make_package "$pkg"
+done
+
+tar -czf "$WORK/repo.tar.gz" -C "$WORK/repo" testrepo
+REPO=$(serve "$WORK/repo.tar.gz" tar.gz)
+ALPHA=$(sha256 "$WORK/alpha.tar").tar
+LOCAL=http://localhost:$PORT
+REFUSED=http://127.0.0.1:$((PORT + 1))
+MISSING=0000000000000000000000000000000000000000000000000000000000000000.tar
+
+start_server
+
+expect_ok "download a package" \
+  client install -u "http://127.0.0.1:$PORT/$ALPHA" -n alpha -f tar -x alpha.txt
+expect_ok "downloaded package is intact" \
+  cmp "$WORK/client/pkgs/alpha/current/alpha.txt" "$WORK/src/alpha/alpha.txt"
+expect_ok "resolve the name of the server" \
+  client install -u "$LOCAL/$ALPHA" -n alpha2 -f tar -x alpha.txt
+expect_fail "missing files are errors" \
+  client install -u "http://127.0.0.1:$PORT/$MISSING" -n missing -f tar -x a
+expect_fail "refused connections are errors" \
+  client install -u "$REFUSED/$ALPHA" -n refused -f tar -x a
+expect_ok "add a repository" \
+  client add-repo "http://127.0.0.1:$PORT/$REPO"
+expect_ok "download packages in parallel" \
+  client fetch beta gamma delta
+
+for pkg in beta gamma delta; do
+  expect_ok "fetched package $pkg is intact" \
+    cmp "$WORK/client/cache/$(sha256 "$WORK/$pkg.tar").tar" "$WORK/$pkg.tar"
+done
+
+exit $FAILED
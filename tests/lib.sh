@@ -0,0 +1,115 @@
+#!/bin/sh
+# tarman
+# Copyright (C) 2024 Alessandro Salerno
+#
+# This program is free software: you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by
+# the Free Software Foundation, either version 3 of the License, or
+# (at your option) any later version.
+#
+# This program is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+#
+# You should have received a copy of the GNU General Public License
+# along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+
+# Helpers shared by the test scripts, which source this file first. Each
+# script runs against a scratch directory that is removed on exit, and
+# prints one PASS or FAIL line per check.
+
+EXEC=${1:-bin/tarman}
+TARMAN=$(cd "$(dirname "$EXEC")" && pwd)/$(basename "$EXEC")
+PORT=${TARMAN_TEST_PORT:-18790}
+WORK=$(mktemp -d)
+SERVER=
+FAILED=0
+
+# Nothing outside of WORK is touched
+export HOME="$WORK"
+export TARMAN_STORE=
+
+cleanup() {
+  if [ -n "$SERVER" ]; then
+    kill "$SERVER" 2>/dev/null
+    wait "$SERVER" 2>/dev/null
+  fi
+
+  rm -rf "$WORK"
+}
+
+trap cleanup EXIT
+trap 'exit 1' INT TERM
+
+mkdir -p "$WORK/server/cache"
+
+sha256() {
+  if command -v sha256sum >/dev/null 2>&1; then
+    sha256sum "$1" | cut -d ' ' -f 1
+  else
+    shasum -a 256 "$1" | cut -d ' ' -f 1
+  fi
+}
+
+client() {
+  TARMAN_ROOT="$WORK/client" "$TARMAN" "$@" --headless
+}
+
+report() {
+  if [ "$2" -eq 0 ]; then
+    echo "PASS: $1"
+  else
+    echo "FAIL: $1"
+    sed 's/^/    /' "$WORK/log"
+    FAILED=1
+  fi
+}
+
+expect_ok() {
+  name=$1
+  shift
+  "$@" >"$WORK/log" 2>&1
+  report "$name" $?
+}
+
+expect_fail() {
+  name=$1
+  shift
+  ! "$@" >"$WORK/log" 2>&1
+  report "$name" $?
+}
+
+# Only checks that the output has a line matching the pattern, whether the
+# command succeeds or not
+expect_output() {
+  name=$1
+  pattern=$2
+  shift 2
+  "$@" >"$WORK/log" 2>&1
+  grep -q -- "$pattern" "$WORK/log"
+  report "$name" $?
+}
+
+# Serves a copy of the given file, and prints the name it is served as
+serve() {
+  name=$(sha256 "$1").$2
+  cp "$1" "$WORK/server/cache/$name"
+  echo "$name"
+}
+
+# The server is 'tarman serve-cache', which serves the archives in its
+# cache directory by name
+start_server() {
+  TARMAN_ROOT="$WORK/server" "$TARMAN" serve-cache "$PORT" \
+    >"$WORK/server.log" 2>&1 &
+  SERVER=$!
+  sleep 1
+
+  if ! kill -0 "$SERVER" 2>/dev/null; then
+    echo "FAIL: unable to start 'tarman serve-cache' on port $PORT"
+    sed 's/^/    /' "$WORK/server.log"
+    exit 1
+  fi
+}
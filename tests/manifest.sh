@@ -0,0 +1,79 @@
+#!/bin/sh
+# tarman
+# Copyright (C) 2024 Alessandro Salerno
+#
+# This program is free software: you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by
+# the Free Software Foundation, either version 3 of the License, or
+# (at your option) any later version.
+#
+# This program is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+#
+# You should have received a copy of the GNU General Public License
+# along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+
+# Checks that installs record a manifest of the package's files, and that
+# 'tarman verify' reports files that no longer match it and rejects
+# manifests that are damaged.
+# Usage: sh tests/manifest.sh [<path to tarman>]
+
+. "$(dirname "$0")/lib.sh"
+
+PKG=$WORK/client/pkgs/sample/current
+
+mkdir -p "$WORK/src/bin" "$WORK/src/share"
+echo "#!/bin/sh" >"$WORK/src/bin/sample"
+echo "first data file" >"$WORK/src/share/one.txt"
+echo "second data file" >"$WORK/src/share/two.txt"
+chmod 755 "$WORK/src/bin/sample"
+tar -cf "$WORK/sample.tar" -C "$WORK/src" bin share
+
+expect_ok "install a package" \
+  client install "$WORK/sample.tar" -n sample -f tar -x bin/sample
+expect_ok "a manifest is written" test -s "$PKG/manifest.tarman"
+expect_output "an untouched package is intact" "is intact (3 files)" \
+  client verify sample
+expect_ok "all packages can be verified at once" client verify --all
+
+echo "tampered" >>"$PKG/share/one.txt"
+expect_output "modified files are reported" "Modified file 'share/one.txt'" \
+  client verify sample
+expect_fail "verification fails with modified files" client verify sample
+cp "$WORK/src/share/one.txt" "$PKG/share/one.txt"
+
+chmod 600 "$PKG/bin/sample"
+expect_output "permission changes are reported" \
+  "Changed permissions on file 'bin/sample'" client verify sample
+chmod 755 "$PKG/bin/sample"
+
+rm "$PKG/share/two.txt"
+expect_output "missing files are reported" "Missing file 'share/two.txt'" \
+  client verify sample
+cp "$WORK/src/share/two.txt" "$PKG/share/two.txt"
+expect_ok "restored files are intact again" client verify sample
+
+cp "$PKG/manifest.tarman" "$WORK/manifest.tarman"
+
+head -c 20 "$WORK/manifest.tarman" >"$PKG/manifest.tarman"
+expect_output "truncated manifests are rejected" "no valid file manifest" \
+  client verify sample
+
+# Claims far more entries than the file could hold
+printf 'TMMF\001\000\000\000\377\377\377\377\377\377\377\177' \
+  >"$PKG/manifest.tarman"
+expect_output "impossible entry counts are rejected" "no valid file manifest" \
+  client verify sample
+
+printf 'XXXX\001\000\000\000\000\000\000\000\000\000\000\000' \
+  >"$PKG/manifest.tarman"
+expect_output "unknown formats are rejected" "no valid file manifest" \
+  client verify sample
+
+cp "$WORK/manifest.tarman" "$PKG/manifest.tarman"
+expect_ok "the original manifest still verifies" client verify sample
+
+exit $FAILED
@@ -0,0 +1,117 @@
+#!/bin/sh
+# tarman
+# Copyright (C) 2024 Alessandro Salerno
+#
+# This program is free software: you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by
+# the Free Software Foundation, either version 3 of the License, or
+# (at your option) any later version.
+#
+# This program is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+#
+# You should have received a copy of the GNU General Public License
+# along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+
+# Checks that 'tarman install -r' installs the dependencies of a package
+# first, in an order that respects their own dependencies, skips those that
+# are already installed, replaces those installed in an unsuitable version
+# and rejects circular and unsatisfiable requirements.
+# Usage: sh tests/resolve.sh [<path to tarman>]
+
+. "$(dirname "$0")/lib.sh"
+
+PKGS=$WORK/client/pkgs
+
+# Each package has a single file. The second argument is the DEPENDS line
+make_package() {
+  mkdir -p "$WORK/src/$1"
+  echo "This is package $1" >"$WORK/src/$1/$1.txt"
+  tar -cf "$WORK/$1.tar" -C "$WORK/src/$1" "$1.txt"
+  name=$(serve "$WORK/$1.tar" tar)
+
+  cat >"$WORK/repo/testrepo/$1.tarman" <<RECIPE
+URL=http://127.0.0.1:$PORT/$name
+PACKAGE_FORMAT=tar
+ARCHIVE_SHA256=$(sha256 "$WORK/$1.tar")
+EXECUTABLE_PATH=$1.txt
+VERSION=${VERSION:-1}
+DEPENDS=$2
+RECIPE
+}
+
+# The repository is always served under the same name, like a repository
+# that is updated in place
+publish() {
+  tar -czf "$WORK/server/cache/$REPO" -C "$WORK/repo" testrepo
+}
+
+installed() {
+  test -f "$PKGS/$1/current/$1.txt"
+}
+
+mkdir -p "$WORK/repo/testrepo"
+
+make_package base ""
+make_package left "base>=1"
+make_package right "base"
+make_package top "left, right"
+make_package cyca "cycb"
+make_package cycb "cyca"
+make_package needsnew "base>=2"
+make_package orphan "nothere"
+make_package broken ""
+make_package onbroken "broken"
+
+# The server no longer has the archive of this one
+rm "$WORK/server/cache/$(sha256 "$WORK/broken.tar").tar"
+
+REPO=0000000000000000000000000000000000000000000000000000000000000001.tar.gz
+publish
+start_server
+
+expect_ok "add a repository" client add-repo "http://127.0.0.1:$PORT/$REPO"
+
+expect_ok "install a package with dependencies" client install -r top
+
+for pkg in base left right top; do
+  expect_ok "package $pkg is installed" installed "$pkg"
+done
+
+expect_output "installed dependencies are skipped" \
+  "Dependency 'left' is already installed" client install -r top -y
+expect_ok "skipped dependencies keep their version" \
+  test "$(readlink "$PKGS/left/current")" = 1
+
+expect_output "circular dependencies are rejected" \
+  "Circular dependency between 'cycb' and 'cyca'" client install -r cyca
+expect_fail "packages with circular dependencies are not installed" \
+  installed cyca
+
+expect_output "unknown dependencies are rejected" \
+  "Dependency 'nothere' of package 'orphan' not found" \
+  client install -r orphan
+expect_output "unsuitable versions in the repository are rejected" \
+  "repository 'testrepo' does not offer a suitable version" \
+  client install -r needsnew
+expect_fail "packages with missing dependencies are not installed" \
+  installed needsnew
+
+expect_output "failed dependencies stop the installation" \
+  "Unable to install dependency 'broken'" client install -r onbroken
+expect_fail "packages are not installed before their dependencies" \
+  installed onbroken
+
+VERSION=2 make_package base ""
+publish
+expect_ok "refresh the repository" client update-repo testrepo
+expect_ok "dependencies in an unsuitable version are replaced" \
+  client install -r needsnew
+expect_ok "the dependency is replaced by a new version" \
+  test "$(readlink "$PKGS/base/current")" = 2
+expect_ok "the package is installed after its dependency" installed needsnew
+
+exit $FAILED
@@ -0,0 +1,109 @@
+#!/bin/sh
+# tarman
+# Copyright (C) 2024 Alessandro Salerno
+#
+# This program is free software: you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by
+# the Free Software Foundation, either version 3 of the License, or
+# (at your option) any later version.
+#
+# This program is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+#
+# You should have received a copy of the GNU General Public License
+# along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+
+# Checks that packages keep their versions side by side: updates create a
+# new version that shares unchanged files with the previous one, rollback
+# switches back to it and failed installs leave the active version alone.
+# Usage: sh tests/versions.sh [<path to tarman>]
+
+. "$(dirname "$0")/lib.sh"
+
+PKG=$WORK/client/pkgs/sample
+
+# Builds version $1 of the package, in which only changed.txt differs
+make_version() {
+  mkdir -p "$WORK/v$1/data"
+  echo "#!/bin/sh" >"$WORK/v$1/program"
+  echo "echo version $1" >>"$WORK/v$1/program"
+  chmod 755 "$WORK/v$1/program"
+  echo "same in every version" >"$WORK/v$1/data/same.txt"
+  echo "version $1" >"$WORK/v$1/data/changed.txt"
+  tar -cf "$WORK/v$1.tar" -C "$WORK/v$1" program data
+  name=$(serve "$WORK/v$1.tar" tar)
+
+  mkdir -p "$WORK/repo/testrepo"
+  cat >"$WORK/repo/testrepo/sample.tarman" <<RECIPE
+URL=http://127.0.0.1:$PORT/$name
+PACKAGE_FORMAT=tar
+ARCHIVE_SHA256=$(sha256 "$WORK/v$1.tar")
+EXECUTABLE_PATH=program
+ADD_TO_PATH=true
+VERSION=$1
+RECIPE
+
+  # The repository is always served under the same name, like a
+  # repository that is updated in place
+  tar -czf "$WORK/server/cache/$REPO" -C "$WORK/repo" testrepo
+}
+
+active() {
+  readlink "$PKG/current"
+}
+
+num_versions() {
+  ls "$PKG" | grep -c '^[0-9][0-9]*$'
+}
+
+REPO=0000000000000000000000000000000000000000000000000000000000000001.tar.gz
+make_version 1
+start_server
+
+expect_ok "add a repository" client add-repo "http://127.0.0.1:$PORT/$REPO"
+expect_ok "install the first version" client install -r sample
+expect_ok "the first version is active" test "$(active)" = 1
+
+make_version 2
+expect_ok "refresh the repository" client update-repo testrepo
+expect_ok "update to the second version" client update sample
+expect_ok "the second version is active" test "$(active)" = 2
+expect_ok "both versions are kept" test -d "$PKG/1" -a -d "$PKG/2"
+expect_ok "changed files are updated" \
+  cmp "$PKG/current/data/changed.txt" "$WORK/v2/data/changed.txt"
+expect_ok "unchanged files are shared with the previous version" \
+  test "$PKG/1/data/same.txt" -ef "$PKG/2/data/same.txt"
+expect_ok "the updated version is intact" client verify sample
+
+expect_ok "roll back" client rollback sample
+expect_ok "the first version is active again" test "$(active)" = 1
+expect_ok "rolled back files are restored" \
+  cmp "$PKG/current/data/changed.txt" "$WORK/v1/data/changed.txt"
+expect_output "PATH points at the active version" "echo version 1" \
+  cat "$WORK/client/path/program"
+expect_fail "there is nothing older to roll back to" client rollback sample
+
+echo "not an archive" >"$WORK/broken.tar"
+expect_fail "broken archives cannot be installed" \
+  client install "$WORK/broken.tar" -n sample -f tar -x program -y
+expect_ok "failed installs keep the active version" test "$(active)" = 1
+expect_ok "failed installs leave no version behind" \
+  test "$(num_versions)" -eq 2
+
+expect_fail "reinstalls need confirmation in headless mode" \
+  client install "$WORK/v2.tar" -n sample -f tar -x program
+expect_ok "confirmed reinstalls create a new version" \
+  client install "$WORK/v2.tar" -n sample -f tar -x program -y
+expect_ok "the new version is active" test "$(active)" = 3
+
+ln -s 1 "$PKG/current.new"
+expect_ok "stale links from interrupted runs are replaced" \
+  client install "$WORK/v1.tar" -n sample -f tar -x program -y
+expect_ok "the version after it is active" test "$(active)" = 4
+expect_ok "only the last three versions are kept" test "$(num_versions)" -eq 3
+expect_fail "the oldest version is removed" test -d "$PKG/1"
+
+exit $FAILED